@@ -0,0 +1,219 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include "nes-batch.h"
+#include "cpu.h"
+
+
+using namespace Qk;
+using namespace Qk::NES;
+
+
+/*
+	Batch runner: runs many independent NES sessions spread over all cores,
+	and streams out one result line per session as it completes.
+*/
+
+struct Options
+{
+	std::vector<std::string> RomPaths;
+	std::string JobFile;
+	qword Frames = 600;
+	unsigned int Repeat = 1;
+	unsigned int Threads = 0;
+	bool PinThreads = false;
+	MOS6502::CoreType Core = MOS6502::CoreType::Block;
+	bool IdleSkipping = true;
+};
+
+
+static void PrintUsage()
+{
+	std::cout
+		<< "usage: qk-batch [options] [path to nes romfile ...]" << std::endl
+		<< std::endl
+		<< "  -f, --frames N        frames per session (default 600)" << std::endl
+		<< "  -n, --repeat N        run every ROM N times (default 1)" << std::endl
+		<< "  -j, --jobs FILE       read sessions from FILE, one per line:" << std::endl
+		<< "                        <romfile> <frames> [input script]" << std::endl
+		<< "  -t, --threads N       worker threads (default: one per hardware thread)" << std::endl
+		<< "  -p, --pin             pin worker threads to cores" << std::endl
+		<< "  -c, --core NAME       CPU core: block (default), fused, reference, jit" << std::endl
+		<< "                        or jit-lockstep (checks jit against fused)" << std::endl
+		<< "  --no-idle-skip        run idle loops instruction by instruction" << std::endl
+		<< std::endl
+		<< "Prints one line per session as it completes:" << std::endl
+		<< "  <job> <worker> <ok|error code> <frames> <state hash> <seconds> <romfile>" << std::endl;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue = i + 1 < argc;
+
+		if ((arg == "-f" || arg == "--frames") && hasValue)
+			options.Frames = std::strtoull(argv[++i], nullptr, 10);
+		else if ((arg == "-n" || arg == "--repeat") && hasValue)
+			options.Repeat = std::atoi(argv[++i]);
+		else if ((arg == "-j" || arg == "--jobs") && hasValue)
+			options.JobFile = argv[++i];
+		else if ((arg == "-t" || arg == "--threads") && hasValue)
+			options.Threads = std::atoi(argv[++i]);
+		else if (arg == "-p" || arg == "--pin")
+			options.PinThreads = true;
+		else if ((arg == "-c" || arg == "--core") && hasValue)
+		{
+			std::string core(argv[++i]);
+
+			if (core == "jit")
+				options.Core = MOS6502::CoreType::JIT;
+			else if (core == "jit-lockstep")
+				options.Core = MOS6502::CoreType::JITLockstep;
+			else if (core == "block")
+				options.Core = MOS6502::CoreType::Block;
+			else if (core == "fused")
+				options.Core = MOS6502::CoreType::Fused;
+			else if (core == "reference")
+				options.Core = MOS6502::CoreType::Reference;
+			else
+				return false;
+		}
+		else if (arg == "--no-idle-skip")
+			options.IdleSkipping = false;
+		else if (arg[0] != '-')
+			options.RomPaths.push_back(arg);
+		else
+			return false;
+	}
+
+	return !options.RomPaths.empty() || !options.JobFile.empty();
+}
+
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	try
+	{
+		// Every ROM file is loaded once, and shared by all its sessions
+		std::map<std::string, std::shared_ptr<const ROMImage>> images;
+		std::vector<BatchJob> jobs;
+		std::vector<std::string> jobRoms;
+
+		auto addJob = [&](const std::string& romPath, qword frames, const std::vector<InputEvent>& input)
+		{
+			auto& image = images[romPath];
+
+			if (!image)
+				image = std::make_shared<const ROMImage>(romPath);
+
+			BatchJob job;
+			job.ROM = image;
+			job.Frames = frames;
+			job.Input = input;
+
+			jobs.push_back(job);
+			jobRoms.push_back(romPath);
+		};
+
+		for (unsigned int n = 0; n < options.Repeat; n++)
+		{
+			for (const std::string& romPath : options.RomPaths)
+				addJob(romPath, options.Frames, std::vector<InputEvent>());
+		}
+
+		if (!options.JobFile.empty())
+		{
+			std::ifstream file(options.JobFile);
+
+			if (!file)
+				throw QkError("Cannot open job file", 7500);
+
+			std::string line;
+
+			while (std::getline(file, line))
+			{
+				std::size_t start = line.find_first_not_of(" \t\r");
+
+				if (start == std::string::npos || line[start] == '#')
+					continue;
+
+				std::istringstream fields(line);
+				std::string romPath, inputScript;
+				qword frames;
+
+				if (!(fields >> romPath >> frames))
+					throw QkError("Invalid line in job file", 7501);
+
+				std::vector<InputEvent> input;
+
+				if (fields >> inputScript)
+					input = LoadInputScript(inputScript);
+
+				addJob(romPath, frames, input);
+			}
+		}
+
+		BatchRunner runner(options.Threads, options.PinThreads);
+		runner.SetCPUCore(options.Core);
+		runner.SetIdleLoopSkipping(options.IdleSkipping);
+
+		qword totalFrames = 0;
+		double totalEmulatedSeconds = 0;
+		std::size_t failed = 0;
+
+		auto start = std::chrono::steady_clock::now();
+
+		runner.Run(jobs, [&](const BatchResult& result)
+		{
+			std::cout << result.Job << "\t" << result.Worker << "\t";
+
+			if (result.Succeeded)
+				std::cout << "ok";
+			else
+				std::cout << "error " << result.ErrorCode;
+
+			std::cout << "\t" << result.Frames << "\t"
+				<< std::hex << std::setfill('0') << std::setw(16) << result.StateHash << std::dec << "\t"
+				<< std::fixed << std::setprecision(3) << result.WallSeconds << "\t"
+				<< jobRoms[result.Job] << std::endl;
+
+			totalFrames += result.Frames;
+			totalEmulatedSeconds += result.MasterClock / (NES_CPU_CLOCK_FREQ * NES_PPU_TICKS_PER_CPU_CYCLE);
+			failed += result.Succeeded ? 0 : 1;
+		});
+
+		auto end = std::chrono::steady_clock::now();
+		double wallSeconds = std::chrono::duration<double>(end - start).count();
+
+		// Summary
+		std::cout << std::fixed << std::setprecision(3)
+			<< "# sessions: " << jobs.size() << " (" << failed << " failed)" << std::endl
+			<< "# threads:  " << runner.GetThreadCount() << std::endl
+			<< "# wall:     " << wallSeconds << " s" << std::endl
+			<< "# fps:      " << (wallSeconds > 0 ? totalFrames / wallSeconds : 0.0) << std::endl
+			<< "# ratio:    " << (wallSeconds > 0 ? totalEmulatedSeconds / wallSeconds : 0.0) << "x" << std::endl;
+
+		return failed > 0 ? 1 : 0;
+	}
+	catch (const QkError& ex)
+	{
+		std::cout << "[ERROR] " << ex.what() << std::endl;
+		return ex.code();
+	}
+}
@@ -0,0 +1,732 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include "cpu-ops.h"
+#include "hw-counters.h"
+#include "mem-mirror.h"
+#include "memory.h"
+#include "nes-apu.h"
+#include "nes-cartridge.h"
+#include "nes-ppu.h"
+
+
+using namespace Qk;
+using namespace Qk::NES;
+
+
+/*
+	Microbenchmarks: fixed, repeatable workloads on the emulator's hot paths,
+	each run a number of times and reported as work per second of host time.
+	Output is JSON, for comparing builds; see README.md for the layout. With
+	--counters, host hardware counters are read around the timed runs too.
+
+		cpu/<mode>			Instructions of one addressing mode, from RAM
+		bus/<region>/<op>	Bus::ReadFromBus/WriteToBus over RAM, the PPU
+							registers and mirrors, and cartridge space
+		ppu/...				RP2C02 frames, rendering off, or on with 0, 8
+							or 64 sprites
+		apu/second			One emulated second of APU::Cycle, mixing every
+							sample, with the frame counter stepping
+*/
+
+struct Options
+{
+	int Runs = 5;
+	std::string OutputPath;
+	std::string Filter;
+	MOS6502::CoreType Core = MOS6502::CoreType::Block;
+	std::string CoreName = "block";
+	bool List = false;
+	bool Counters = false;
+};
+
+static void PrintUsage()
+{
+	std::cout
+		<< "usage: qk-bench [options]" << std::endl
+		<< std::endl
+		<< "  -n, --runs N          timed runs per benchmark, after one warm-up (default 5)" << std::endl
+		<< "  -o, --output FILE     write results to FILE as JSON, and a table to stdout;" << std::endl
+		<< "                        without, JSON goes to stdout" << std::endl
+		<< "  -f, --filter TEXT     only run benchmarks whose name contains TEXT" << std::endl
+		<< "  -c, --core NAME       CPU core: block (default), fused, reference or jit" << std::endl
+		<< "  -p, --counters        read host hardware counters around the timed runs" << std::endl
+		<< "                        and report them per unit of work (Linux" << std::endl
+		<< "                        perf_event_open; skipped if unavailable)" << std::endl
+		<< "  -l, --list            list benchmarks and exit" << std::endl;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue = i + 1 < argc;
+
+		if ((arg == "-n" || arg == "--runs") && hasValue)
+			options.Runs = std::atoi(argv[++i]);
+		else if ((arg == "-o" || arg == "--output") && hasValue)
+			options.OutputPath = argv[++i];
+		else if ((arg == "-f" || arg == "--filter") && hasValue)
+			options.Filter = argv[++i];
+		else if ((arg == "-c" || arg == "--core") && hasValue)
+		{
+			options.CoreName = argv[++i];
+
+			if (options.CoreName == "jit")
+				options.Core = MOS6502::CoreType::JIT;
+			else if (options.CoreName == "block")
+				options.Core = MOS6502::CoreType::Block;
+			else if (options.CoreName == "fused")
+				options.Core = MOS6502::CoreType::Fused;
+			else if (options.CoreName == "reference")
+				options.Core = MOS6502::CoreType::Reference;
+			else
+				return false;
+		}
+		else if (arg == "-p" || arg == "--counters")
+			options.Counters = true;
+		else if (arg == "-l" || arg == "--list")
+			options.List = true;
+		else
+			return false;
+	}
+
+	return options.Runs > 0;
+}
+
+
+/*
+	CPU: 256 instructions of one addressing mode, then a JMP back, in RAM
+*/
+
+class CPUBench
+{
+public:
+	static constexpr word PROGRAM = 0x1000;
+	static constexpr int LENGTH = 256;
+
+	// Cycles per run; a frame's worth per RunBlock call, like the NES
+	static constexpr qword CYCLES = 20000000;
+	static constexpr int BLOCK_CYCLES = 29781;
+
+	// Operand: none, a byte, an absolute address, or a pointer to the
+	// next instruction
+	enum class Operand
+	{
+		None, Byte, Address, Pointer
+	};
+
+	struct Program
+	{
+		const char* Mode;
+		byte Opcode;
+		Operand Kind;
+		byte Value;		// Byte operand
+		bool CMOS;
+	};
+
+	// Reads where there is a choice; JMP for the indirect modes
+	static constexpr Program Programs[] = {
+		{ "IMP", 0xE8, Operand::None, 0, false },		// INX
+		{ "IMM", 0xA9, Operand::Byte, 0x5A, false },	// LDA #$5A
+		{ "ACC", 0x2A, Operand::None, 0, false },		// ROL A
+		{ "ZP0", 0xA5, Operand::Byte, 0x10, false },	// LDA $10
+		{ "ZPX", 0xB5, Operand::Byte, 0x10, false },	// LDA $10,X
+		{ "ZPY", 0xB6, Operand::Byte, 0x10, false },	// LDX $10,Y
+		{ "REL", 0xD0, Operand::Byte, 0x00, false },	// BNE to the next one, taken
+		{ "ABS", 0xAD, Operand::Address, 0, false },	// LDA $0300
+		{ "ABX", 0xBD, Operand::Address, 0, false },	// LDA $0300,X
+		{ "ABY", 0xB9, Operand::Address, 0, false },	// LDA $0300,Y
+		{ "IND", 0x6C, Operand::Pointer, 0, false },	// JMP ($0400+2n) to the next one
+		{ "IZX", 0xA1, Operand::Byte, 0x20, false },	// LDA ($20,X)
+		{ "IZY", 0xB1, Operand::Byte, 0x20, false },	// LDA ($20),Y
+		{ "ZPI", 0xB2, Operand::Byte, 0x20, true },		// LDA ($20)
+		{ "IAX", 0x7C, Operand::Pointer, 0, true },		// JMP ($0400+2n,X) to the next one
+	};
+
+public:
+	CPUBench(const Program& program, MOS6502::CoreType core)
+		: m_ram(m_bus, AddressRange(0x0000, 0x7FFF)), m_cpu(m_bus), m_memory(m_bus)
+	{
+		if (program.CMOS)
+			m_cpu.UseMemoryMap<MOS6502::WDC65C02>(m_memory, core);
+		else
+			m_cpu.UseMemoryMap<MOS6502::NMOS>(m_memory, core);
+
+		// Loops over RAM would be fast-forwarded otherwise
+		m_cpu.SetIdleLoopSkipping(false);
+		m_cpu.PowerOn();
+
+		// Pointer for the (zp) modes, to data at $0300
+		m_bus.WriteToBus(0x0020, 0x00);
+		m_bus.WriteToBus(0x0021, 0x03);
+
+		word address = PROGRAM;
+
+		for (int n = 0; n < LENGTH; n++)
+		{
+			int length = program.Kind == Operand::None ? 1 : program.Kind == Operand::Byte ? 2 : 3;
+			word next = address + length;
+			word pointer = 0x0400 + 2 * n;
+
+			m_bus.WriteToBus(address, program.Opcode);
+
+			if (program.Kind == Operand::Byte)
+			{
+				m_bus.WriteToBus(address + 1, program.Value);
+			}
+			else if (program.Kind == Operand::Address)
+			{
+				m_bus.WriteToBus(address + 1, 0x00);
+				m_bus.WriteToBus(address + 2, 0x03);
+			}
+			else if (program.Kind == Operand::Pointer)
+			{
+				m_bus.WriteToBus(pointer, (byte)next);
+				m_bus.WriteToBus(pointer + 1, next >> 8);
+				m_bus.WriteToBus(address + 1, (byte)pointer);
+				m_bus.WriteToBus(address + 2, pointer >> 8);
+			}
+
+			address = next;
+		}
+
+		// JMP PROGRAM
+		m_bus.WriteToBus(address, 0x4C);
+		m_bus.WriteToBus(address + 1, (byte)PROGRAM);
+		m_bus.WriteToBus(address + 2, PROGRAM >> 8);
+
+		// Cycles once round the loop, a step at a time
+		m_cpu.Reset(PROGRAM);
+
+		do
+			m_loopCycles += m_cpu.Step();
+		while (m_cpu.Registers.PC != PROGRAM);
+	}
+
+	// Instructions run
+	qword Run()
+	{
+		m_cpu.Reset(PROGRAM);
+
+		qword cycles = 0;
+
+		while (cycles < CYCLES)
+		{
+			m_host.Limit = (int)std::min<qword>(CYCLES - cycles, BLOCK_CYCLES);
+			cycles += m_cpu.RunBlock(m_host);
+		}
+
+		return cycles * (LENGTH + 1) / m_loopCycles;
+	}
+
+protected:
+	// Runs blocks for as long as asked, looking at nothing else
+	class Host : public MOS6502::BlockHost
+	{
+	public:
+		int Limit = 0;
+
+		bool ContinueBlock(int cycles) override { return cycles < Limit; }
+		int GetQuietCycles() override { return Limit; }
+		bool WatchesRegisters() override { return false; }
+	};
+
+	Bus m_bus;
+	RAM m_ram;
+	MOS6502 m_cpu;
+	MOS6502::BusMemory m_memory;
+	Host m_host;
+	qword m_loopCycles = 0;
+};
+
+constexpr CPUBench::Program CPUBench::Programs[];
+
+
+/*
+	NES parts, wired as in NESConsole, with a cartridge built in memory:
+	NROM, 32 KB PRG ROM and 8 KB CHR ROM of pseudo-random bytes
+*/
+
+static std::shared_ptr<Cartridge> MakeCartridge()
+{
+	CartridgeMetadata metadata;
+	metadata.FileFormat = CartridgeMetadata::FileFormatType::iNES;
+	metadata.PRGROMSize = 0x8000;
+	metadata.CHRROMSize = 0x2000;
+
+	std::vector<byte> prgrom(metadata.PRGROMSize);
+	std::vector<byte> chrrom(metadata.CHRROMSize);
+	dword seed = 1;
+
+	for (byte& value : prgrom)
+		value = (byte)((seed = seed * 1103515245 + 12345) >> 16);
+
+	for (byte& value : chrrom)
+		value = (byte)((seed = seed * 1103515245 + 12345) >> 16);
+
+	return std::make_shared<Cartridge>(std::make_shared<const ROMImage>(metadata, std::move(prgrom), std::move(chrrom)));
+}
+
+
+/*
+	Bus: reads or writes across one region, in address order
+*/
+
+class BusBench
+{
+public:
+	static constexpr qword ACCESSES = 20000000;
+
+public:
+	BusBench(word start, word size, bool write)
+		: m_ram(m_bus, AddressRange(0x0000, 0x07FF)),
+		  m_rmm(m_bus, m_ram, AddressRange(0x0800, 0x1FFF)),
+		  m_cas(m_bus, AddressRange(0x4020, 0xFFFF)),
+		  m_ppu(m_bus, AddressRange(0x2000, 0x2007), m_cas),
+		  m_pmm(m_bus, m_ppu, AddressRange(0x2008, 0x3FFF)),
+		  m_start(start), m_mask(size - 1), m_write(write)
+	{
+		m_cas.InsertCartridge(MakeCartridge());
+	}
+
+	// Accesses made
+	qword Run()
+	{
+		byte sum = 0;
+
+		if (m_write)
+		{
+			for (qword n = 0; n < ACCESSES; n++)
+				m_bus.WriteToBus(m_start + (word)(n & m_mask), (byte)n);
+		}
+		else
+		{
+			for (qword n = 0; n < ACCESSES; n++)
+				sum += m_bus.ReadFromBus(m_start + (word)(n & m_mask));
+		}
+
+		Sink = sum;
+		return ACCESSES;
+	}
+
+	volatile byte Sink = 0;
+
+protected:
+	Bus m_bus;
+	RAM m_ram;
+	MemoryMirror m_rmm;
+	CartridgeSlot m_cas;
+	RP2C02 m_ppu;
+	MemoryMirror m_pmm;
+	word m_start;
+	word m_mask;
+	bool m_write;
+};
+
+
+/*
+	PPU: whole frames, of pseudo-random tiles and sprites
+*/
+
+class PPUBench
+{
+public:
+	static constexpr int FRAMES = 30;
+	static constexpr qword FRAME_TICKS = 341 * 262;
+
+public:
+	PPUBench(bool rendering, int sprites)
+		: m_cas(m_bus, AddressRange(0x4020, 0xFFFF)),
+		  m_ppu(m_bus, AddressRange(0x2000, 0x2007), m_cas)
+	{
+		m_cas.InsertCartridge(MakeCartridge());
+		m_ppu.PowerOn();
+
+		dword seed = 7;
+		auto next = [&seed]() { return (byte)((seed = seed * 1103515245 + 12345) >> 16); };
+
+		for (auto& table : m_ppu.VRAM.Nametable)
+		{
+			for (byte& value : table)
+				value = next();
+		}
+
+		for (byte& value : m_ppu.VRAM.Palette)
+			value = next() & 0x3F;
+
+		// Sprites spread over the screen, the rest hidden below it
+		for (int n = 0; n < 64; n++)
+		{
+			byte* sprite = &m_ppu.VRAM.OAM[n * 4];
+			sprite[0] = n < sprites ? (byte)(n * 29 % 224) : 0xFF;
+			sprite[1] = next();
+			sprite[2] = next() & 0xE3;
+			sprite[3] = (byte)(n * 53 % 248);
+		}
+
+		// Background from $0000, sprites from $1000, all of it shown
+		m_ppu.Registers.PPUCtrl = 0x08;
+		m_ppu.Registers.PPUMask = rendering ? 0x1E : 0x00;
+	}
+
+	// Frames rendered
+	qword Run()
+	{
+		for (int n = 0; n < FRAMES; n++)
+			m_ppu.RunUntil(m_time += FRAME_TICKS);
+
+		return FRAMES;
+	}
+
+protected:
+	Bus m_bus;
+	CartridgeSlot m_cas;
+	RP2C02 m_ppu;
+	qword m_time = 0;
+};
+
+
+/*
+	APU: all four channels playing, every sample mixed, the frame counter
+	stepping on schedule
+*/
+
+class APUBench
+{
+public:
+	static constexpr qword CYCLES = (qword)NES_CPU_CLOCK_FREQ;
+
+public:
+	APUBench() : m_apu(m_bus)
+	{
+		static const std::pair<word, byte> writes[] = {
+			{ 0x4015, 0x0F },
+			{ 0x4000, 0xBF }, { 0x4002, 0xFD }, { 0x4003, 0x00 },	// Pulse 1: 50% duty, ~440 Hz
+			{ 0x4004, 0x7F }, { 0x4006, 0x80 }, { 0x4007, 0x01 },	// Pulse 2: 25% duty
+			{ 0x4008, 0xFF }, { 0x400A, 0x40 }, { 0x400B, 0x00 },	// Triangle
+			{ 0x400C, 0x3F }, { 0x400E, 0x05 }, { 0x400F, 0x00 },	// Noise
+		};
+
+		for (const auto& write : writes)
+			m_apu.WriteToDevice(write.first, write.second);
+
+		// The APU only schedules its frame counter with audio enabled
+		if (!m_bus.Events.IsPending(SIGNAL_APU_FRC))
+			m_bus.Events.Post(m_bus.Events.Now(), SIGNAL_APU_FRC);
+	}
+
+	// APU cycles run
+	qword Run()
+	{
+		audiosample buffer[APU_SAMPLE_BUFFER_SIZE];
+		qword end = m_cycle + CYCLES;
+
+		while (m_cycle < end)
+		{
+			// Frame counter steps due, as the bus would emit them
+			while (m_bus.Events.GetNextEventTime() <= m_cycle * NES_PPU_TICKS_PER_CPU_CYCLE)
+			{
+				m_bus.Events.PopNextEvent();
+				m_apu.OnBusSignal(SIGNAL_APU_FRC);
+			}
+
+			qword next = (m_bus.Events.GetNextEventTime() + NES_PPU_TICKS_PER_CPU_CYCLE - 1) / NES_PPU_TICKS_PER_CPU_CYCLE;
+
+			if (next > end)
+				next = end;
+
+			qword start = m_cycle;
+
+#ifdef NES_AUDIO_ENABLED
+			// Catch up as the console does, so the step doesn't run them again
+			m_apu.RunUntil(next);
+			m_cycle = next;
+#else
+			for (; m_cycle < next; m_cycle++)
+				m_apu.Cycle();
+#endif
+
+			// Play the samples every 64K cycles, as the audio device would
+			if ((start ^ m_cycle) & ~(qword)0xFFFF)
+				m_apu.FillAudioBuffer(buffer, APU_SAMPLE_BUFFER_SIZE);
+		}
+
+		return CYCLES;
+	}
+
+protected:
+	Bus m_bus;
+	APU m_apu;
+	qword m_cycle = 0;
+};
+
+
+/*
+	Running and reporting
+*/
+
+struct Benchmark
+{
+	std::string Name;
+	const char* Unit;
+	std::function<std::function<qword()>()> Setup;
+};
+
+struct Result
+{
+	std::string Name;
+	const char* Unit;
+	qword Work;
+	std::vector<double> Rates;	// Sorted
+	HardwareCounters::Sample Counters;	// Over all timed runs
+	qword TotalWork;
+};
+
+static std::vector<Benchmark> GetBenchmarks(const Options& options)
+{
+	std::vector<Benchmark> benchmarks;
+	MOS6502::CoreType core = options.Core;
+
+	for (const CPUBench::Program& program : CPUBench::Programs)
+	{
+		benchmarks.push_back({ std::string("cpu/") + program.Mode, "instructions/s",
+			[program, core]() {
+				std::shared_ptr<CPUBench> bench = std::make_shared<CPUBench>(program, core);
+				return [bench]() { return bench->Run(); };
+			} });
+	}
+
+	struct Region
+	{
+		const char* Name;
+		word Start;
+		word Size;
+	};
+
+	static const Region regions[] = {
+		{ "ram", 0x0000, 0x2000 },	// Internal RAM and its mirrors
+		{ "ppu", 0x2000, 0x2000 },	// PPU registers and their mirrors
+		{ "cart", 0x8000, 0x8000 },	// PRG ROM
+	};
+
+	for (const Region& region : regions)
+	{
+		for (bool write : { false, true })
+		{
+			benchmarks.push_back({ std::string("bus/") + region.Name + (write ? "/write" : "/read"), "accesses/s",
+				[region, write]() {
+					std::shared_ptr<BusBench> bench = std::make_shared<BusBench>(region.Start, region.Size, write);
+					return [bench]() { return bench->Run(); };
+				} });
+		}
+	}
+
+	struct Scene
+	{
+		const char* Name;
+		bool Rendering;
+		int Sprites;
+	};
+
+	static const Scene scenes[] = {
+		{ "ppu/off", false, 0 },
+		{ "ppu/on/0-sprites", true, 0 },
+		{ "ppu/on/8-sprites", true, 8 },
+		{ "ppu/on/64-sprites", true, 64 },
+	};
+
+	for (const Scene& scene : scenes)
+	{
+		benchmarks.push_back({ scene.Name, "frames/s",
+			[scene]() {
+				std::shared_ptr<PPUBench> bench = std::make_shared<PPUBench>(scene.Rendering, scene.Sprites);
+				return [bench]() { return bench->Run(); };
+			} });
+	}
+
+	benchmarks.push_back({ "apu/second", "cycles/s",
+		[]() {
+			std::shared_ptr<APUBench> bench = std::make_shared<APUBench>();
+			return [bench]() { return bench->Run(); };
+		} });
+
+	return benchmarks;
+}
+
+static Result RunBenchmark(const Benchmark& benchmark, int runs, const HardwareCounters& counters)
+{
+	std::function<qword()> run = benchmark.Setup();
+	Result result = { benchmark.Name, benchmark.Unit, 0, {}, {}, 0 };
+
+	// Warm-up: caches, branch predictors, block and JIT caches
+	run();
+
+	for (int n = 0; n < runs; n++)
+	{
+		HardwareCounters::Sample before = counters.Read();
+		auto start = std::chrono::steady_clock::now();
+		result.Work = run();
+		auto end = std::chrono::steady_clock::now();
+		HardwareCounters::Sample after = counters.Read();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		result.Rates.push_back(seconds > 0 ? result.Work / seconds : 0.0);
+
+		HardwareCounters::Sample counted = HardwareCounters::Difference(before, after);
+
+		for (int e = 0; e < HardwareCounters::EVENT_COUNT; e++)
+			result.Counters.Values[e] += counted.Values[e];
+
+		result.TotalWork += result.Work;
+	}
+
+	std::sort(result.Rates.begin(), result.Rates.end());
+	return result;
+}
+
+static double Median(const std::vector<double>& sorted)
+{
+	std::size_t n = sorted.size();
+	return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// Counted per unit of work, over all timed runs
+static double PerUnit(const Result& result, HardwareCounters::Event event)
+{
+	return result.TotalWork > 0 ? (double)result.Counters.Get(event) / result.TotalWork : 0.0;
+}
+
+static void WriteJSON(std::ostream& out, const Options& options, const std::vector<Result>& results, const HardwareCounters& counters)
+{
+	out << std::fixed << std::setprecision(1)
+		<< "{\"tool\": \"qk-bench\", \"core\": \"" << options.CoreName << "\", \"runs\": " << options.Runs << ",\n"
+		<< " \"results\": [";
+
+	const char* separator = "\n  ";
+
+	for (const Result& result : results)
+	{
+		out << separator << "{\"name\": \"" << result.Name << "\", \"unit\": \"" << result.Unit << "\""
+			<< ", \"work\": " << result.Work
+			<< ", \"median\": " << Median(result.Rates)
+			<< ", \"best\": " << result.Rates.back()
+			<< ", \"worst\": " << result.Rates.front();
+
+		if (counters.IsAnyAvailable())
+		{
+			const char* comma = "";
+			out << std::setprecision(6) << ", \"counters\": {";
+
+			for (int e = 0; e < HardwareCounters::EVENT_COUNT; e++)
+			{
+				HardwareCounters::Event event = (HardwareCounters::Event)e;
+
+				if (counters.IsAvailable(event))
+				{
+					out << comma << "\"" << HardwareCounters::EventNames[e] << "\": " << PerUnit(result, event);
+					comma = ", ";
+				}
+			}
+
+			out << "}" << std::setprecision(1);
+		}
+
+		out << "}";
+		separator = ",\n  ";
+	}
+
+	out << "\n]}\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	try
+	{
+		std::vector<Benchmark> benchmarks = GetBenchmarks(options);
+
+		if (options.List)
+		{
+			for (const Benchmark& benchmark : benchmarks)
+				std::cout << benchmark.Name << std::endl;
+
+			return 0;
+		}
+
+		std::ofstream file;
+
+		if (!options.OutputPath.empty())
+		{
+			file.open(options.OutputPath);
+
+			if (!file)
+				throw QkError("Cannot write benchmark results file", 7700);
+		}
+
+		// Counters, if asked for and the host has them; benchmarks run on
+		// this thread
+		HardwareCounters counters;
+
+		if (options.Counters && !counters.Open())
+			std::cerr << "[WARNING] Hardware counters unavailable, running without: " << counters.GetError() << std::endl;
+
+		std::vector<Result> results;
+
+		for (const Benchmark& benchmark : benchmarks)
+		{
+			if (benchmark.Name.find(options.Filter) == std::string::npos)
+				continue;
+
+			results.push_back(RunBenchmark(benchmark, options.Runs, counters));
+
+			if (file.is_open())
+			{
+				const Result& result = results.back();
+
+				std::cout << std::left << std::setw(20) << result.Name << std::right << std::fixed << std::setprecision(0)
+					<< std::setw(16) << Median(result.Rates) << " " << result.Unit;
+
+				if (counters.IsAnyAvailable())
+					std::cout << std::setw(17 - (int)std::strlen(result.Unit)) << "";
+
+				if (counters.IsAvailable(HardwareCounters::Event::Cycles) && counters.IsAvailable(HardwareCounters::Event::Instructions))
+				{
+					double cycles = PerUnit(result, HardwareCounters::Event::Cycles);
+					std::cout << std::setprecision(2) << std::setw(8) << (cycles > 0 ? PerUnit(result, HardwareCounters::Event::Instructions) / cycles : 0.0) << " ipc";
+				}
+
+				if (counters.IsAvailable(HardwareCounters::Event::BranchMisses))
+					std::cout << std::setprecision(4) << std::setw(10) << PerUnit(result, HardwareCounters::Event::BranchMisses) << " br-miss";
+
+				std::cout << std::endl;
+			}
+		}
+
+		WriteJSON(file.is_open() ? file : std::cout, options, results, counters);
+	}
+	catch (const QkError& ex)
+	{
+		std::cout << "[ERROR] " << ex.what() << std::endl;
+		return ex.code();
+	}
+
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include "bus.h"
+#include "timers.h"
 
 using namespace Qk;
 
@@ -24,70 +25,223 @@ Bus::~Bus()
 	Internals
 */
 
-bool Bus::CheckAddressBelongsTo(const Device& device, word address) const
+bool Bus::CheckRangeAvailable(const AddressRange& range, bool isWrite) const
 {
-	const AddressRange& devRange = device.GetAddressableRange();
-	return address >= devRange.Min && address <= devRange.Max;
+	// Reads and writes are claimed separately, so only
+	// mappings serving the same direction can conflict
+	for (const Mapping& m : m_mappings)
+	{
+		bool serves = isWrite ? m.Write != nullptr : m.Read != nullptr;
+
+		if (serves && range.Min <= m.Max && range.Max >= m.Min)
+			return false;
+	}
+
+	return true;
 }
 
-bool Bus::CheckAddressRangeConflict(const Device& device, const AddressRange& range) const
+/*
+	Interfacing with device subclasses
+*/
+
+// Connecting devices
+
+void Bus::ConnectDevice(Device& device)
 {
-	const AddressRange& devRange = device.GetAddressableRange();
-	return (range.Min >= devRange.Min && range.Min <= devRange.Max) || (range.Max >= devRange.Min && range.Max <= devRange.Max);
+	if (!device.IsAddressable())
+	{
+		m_nonAddressableDevices.push_back(&device);
+		return;
+	}
+
+	m_addressableDevices.push_back(&device);
+	MapDevice(device, device.GetAddressableRange(), &Device::ReadFromDevice, &Device::WriteToDevice);
 }
 
-bool Bus::CheckRangeAvailable(const AddressRange& range) const
+void Bus::MapDevice(Device& device, const AddressRange& range, Device::ReadHandler read, Device::WriteHandler write)
 {
-	for (auto device : m_addressableDevices)
+	if (range.Min > range.Max)
+		throw QkError("Invalid address range: min exceeds max", 310);
+
+	if ((read != nullptr && !CheckRangeAvailable(range, false)) || (write != nullptr && !CheckRangeAvailable(range, true)))
+		throw QkError("Address mapping conflict: two devices want to occupy overlapping address ranges on bus", 301);
+
+	m_mappings.push_back({ &device, read, write, range.Min, range.Max, range.Min, 0xFFFF });
+
+	RebuildPages(device);
+}
+
+void Bus::SubscribeDevice(Device& device, int signalId)
+{
+	std::vector<Device*>& listeners = m_signalListeners[signalId];
+
+	for (auto ptr : listeners)
 	{
-		if (CheckAddressRangeConflict(*device, range))
-			return false;
+		if (ptr == &device)
+			return;
 	}
 
-	return true;
+	listeners.push_back(&device);
 }
 
-Bus::Device* Bus::GetDeviceAt(word address)
+void Bus::RedirectDevice(Device& device, Device& target, word targetBase, word wrapMask)
 {
-	// First check if another call to previous device
-	if (CheckAddressBelongsTo(*m_cachedDevicePtr, address))
-		return m_cachedDevicePtr;
-
-	for (auto device : m_addressableDevices)
+	// Resolve mirrors once, at map time: retarget the device's pages
+	// so accesses never hop through the mirroring device at runtime
+	for (Mapping& m : m_mappings)
 	{
-		if (CheckAddressBelongsTo(*device, address))
+		if (m.Target == &device)
 		{
-			m_cachedDevicePtr = device;
-			return device;
+			m.Target = &target;
+			m.Base = targetBase;
+			m.Mask = wrapMask;
 		}
 	}
 
-	return nullptr;
+	RebuildPages(target);
 }
 
-/*
-	Interfacing with device subclasses
-*/
+// Page table
 
-// Connecting devices
+void Bus::RebuildPages(const Device& device)
+{
+	bool rebuild[256] = {};
+	m_mappingGeneration++;
 
-void Bus::ConnectDevice(Device& device)
+	for (const Mapping& m : m_mappings)
+	{
+		if (m.Target != &device)
+			continue;
+
+		for (int p = m.Min >> 8; p <= (m.Max >> 8); p++)
+			rebuild[p] = true;
+	}
+
+	for (int p = 0; p < 256; p++)
+	{
+		if (rebuild[p])
+		{
+			BuildPage(p, false);
+			BuildPage(p, true);
+		}
+	}
+}
+
+void Bus::BuildPage(int index, bool isWrite)
 {
-	if (!device.IsAddressable())
+	Page& page = isWrite ? m_writePages[index] : m_readPages[index];
+	const int first = index << 8;
+	const int last = first | 0x00FF;
+
+	// Resolve every address in the page to a device port
+	Port ports[256];
+	std::vector<const Mapping*> candidates;
+
+	for (const Mapping& m : m_mappings)
 	{
-		m_nonAddressableDevices.push_back(&device);
+		if (m.Max < first || m.Min > last)
+			continue;
+
+		if ((isWrite ? m.Write == nullptr : m.Read == nullptr))
+			continue;
+
+		candidates.push_back(&m);
+
+		int lo = m.Min > first ? m.Min : first;
+		int hi = m.Max < last ? m.Max : last;
+
+		for (int a = lo; a <= hi; a++)
+		{
+			Port& port = ports[a & 0x00FF];
+			port.Target = m.Target;
+			port.Read = m.Read;
+			port.Write = m.Write;
+			port.Min = m.Min;
+			port.Base = m.Base;
+			port.Mask = m.Mask;
+		}
+	}
+
+	page.Memory = nullptr;
+	page.IO = Port();
+
+	if (candidates.empty())
+	{
+		page.SharedIO.reset();
 		return;
 	}
 
-	if (CheckRangeAvailable(device.GetAddressableRange()))
+	// Pages where every address ends up at the same device handler with
+	// one consistent translation (e.g. the PPU registers and their mirrors)
+	// collapse into a single port
+	const Port* uniform = nullptr;
+	bool sameHandler = ports[0].Target != nullptr;
+
+	for (int i = 1; i < 256 && sameHandler; i++)
 	{
-		m_addressableDevices.push_back(&device);
-		m_cachedDevicePtr = &device;
+		sameHandler = ports[i].Target == ports[0].Target
+			&& ports[i].Read == ports[0].Read
+			&& ports[i].Write == ports[0].Write;
 	}
-	else
+
+	if (sameHandler)
 	{
-		throw QkError("Address mapping conflict: two devices want to occupy overlapping address ranges on bus", 301);
+		for (const Mapping* m : candidates)
+		{
+			Port candidate;
+			candidate.Target = m->Target;
+			candidate.Read = m->Read;
+			candidate.Write = m->Write;
+			candidate.Min = m->Min;
+			candidate.Base = m->Base;
+			candidate.Mask = m->Mask;
+
+			bool matches = candidate.Target == ports[0].Target
+				&& candidate.Read == ports[0].Read
+				&& candidate.Write == ports[0].Write;
+
+			for (int i = 0; i < 256 && matches; i++)
+			{
+				word address = (word)(first | i);
+				matches = candidate.Translate(address) == ports[i].Translate(address);
+			}
+
+			if (matches)
+			{
+				page.IO = candidate;
+				uniform = &page.IO;
+				break;
+			}
+		}
+	}
+
+	if (uniform == nullptr)
+	{
+		if (!page.SharedIO)
+			page.SharedIO.reset(new Port[256]);
+
+		for (int i = 0; i < 256; i++)
+			page.SharedIO[i] = ports[i];
+
+		return;
 	}
+
+	page.SharedIO.reset();
+
+	// Direct host memory is only possible if the page maps linearly
+	// onto the device, through its regular bus I/O handlers
+	if (isWrite ? uniform->Write != &Device::WriteToDevice : uniform->Read != &Device::ReadFromDevice)
+		return;
+
+	word base = uniform->Translate((word)first);
+
+	for (int i = 1; i < 256; i++)
+	{
+		if (uniform->Translate((word)(first | i)) != (word)(base + i))
+			return;
+	}
+
+	page.Memory = uniform->Target->GetDirectMemory(base, isWrite);
 }
 
 
@@ -95,40 +249,48 @@ void Bus::ConnectDevice(Device& device)
 	Bus I/O
 */
 
-byte Bus::ReadFromBus(word address)
+byte Bus::ReadFromPort(const Page& page, word address, bool peek)
 {
-	Device* dev = GetDeviceAt(address);
+	QK_TIMER(Bus);
+	const Port& port = page.SharedIO ? page.SharedIO[address & 0x00FF] : page.IO;
 
-	if (dev != nullptr)
-		return dev->ReadFromDevice(address);
+	if (port.Target != nullptr)
+		return (port.Target->*port.Read)(port.Translate(address), peek);
 	else
 		return 0;
 }
 
-void Bus::WriteToBus(word address, byte data)
+void Bus::WriteToPort(const Page& page, word address, byte data)
 {
-	Device* dev = GetDeviceAt(address);
-	
-	if (dev != nullptr)
-		dev->WriteToDevice(address, data);
+	QK_TIMER(Bus);
+	const Port& port = page.SharedIO ? page.SharedIO[address & 0x00FF] : page.IO;
+
+	if (port.Target != nullptr)
+		(port.Target->*port.Write)(port.Translate(address), data);
 }
 
 void Bus::EmitSignal(int signalId)
 {
-	// Loop over all devices, call on signal
-	// function. May want to optimize this at 
-	// some point, as not all devices are
-	// actually listening for particular signals
-	// or any signal at all
+	// Only devices that subscribed to this
+	// particular signal get called
+	auto it = m_signalListeners.find(signalId);
+
+	if (it == m_signalListeners.end())
+		return;
 
-	for (auto ptr : m_addressableDevices)
+	for (auto ptr : it->second)
 	{
 		ptr->OnBusSignal(signalId);
 	}
+}
 
-	for (auto ptr : m_nonAddressableDevices)
+void Bus::RunEvents(qword timestamp)
+{
+	// Emit all scheduled signals that are due by timestamp, in order.
+	// Devices may post new events while handling them.
+	while (Events.GetNextEventTime() <= timestamp)
 	{
-		ptr->OnBusSignal(signalId);
+		EmitSignal(Events.PopNextEvent());
 	}
 }
 
@@ -139,12 +301,30 @@ byte Bus::Peek(word address)
 	// unaffected by the read. This may be necessary, as some
 	// emulated hardware changes state when read.
 
-	Device* dev = GetDeviceAt(address);
+	const Page& page = m_readPages[address >> 8];
 
-	if (dev != nullptr)
-		return dev->ReadFromDevice(address, true);
-	else
-		return 0;
+	if (page.Memory != nullptr)
+		return page.Memory[address & 0x00FF];
+
+	return ReadFromPort(page, address, true);
+}
+
+byte* Bus::GetDirectPage(word address, bool isWrite) const
+{
+	return (isWrite ? m_writePages : m_readPages)[address >> 8].Memory;
+}
+
+const byte* Bus::GetReadOnlyPage(word address) const
+{
+	// Direct reads, and writes going anywhere but that same memory: a
+	// device never changes memory it handed out for reading only (ROM)
+	const Page& read = m_readPages[address >> 8];
+	const Page& write = m_writePages[address >> 8];
+
+	if (read.Memory == nullptr || write.Memory != nullptr)
+		return nullptr;
+
+	return read.Memory;
 }
 
 
@@ -209,3 +389,39 @@ void Qk::Bus::Device::OnBusSignal(int signalId)
 	// Default signal behaviour: ignore
 	return;
 }
+
+byte* Qk::Bus::Device::GetDirectMemory(word address, bool isWrite)
+{
+	// Default: no direct access, go through Read/WriteToDevice
+	return nullptr;
+}
+
+
+/*
+	Bus mapping maintenance
+*/
+
+void Qk::Bus::Device::RefreshBusMapping()
+{
+	BUS.RebuildPages(*this);
+}
+
+void Qk::Bus::Device::ListenForSignal(int signalId)
+{
+	BUS.SubscribeDevice(*this, signalId);
+}
+
+void Qk::Bus::Device::RedirectBusMapping(Device& target, word targetBase, word wrapMask)
+{
+	BUS.RedirectDevice(*this, target, targetBase, wrapMask);
+}
+
+void Qk::Bus::Device::MapReadHandler(const AddressRange& range, ReadHandler handler)
+{
+	BUS.MapDevice(*this, range, handler, nullptr);
+}
+
+void Qk::Bus::Device::MapWriteHandler(const AddressRange& range, WriteHandler handler)
+{
+	BUS.MapDevice(*this, range, nullptr, handler);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <unordered_map>
 #include "definitions.h"
+#include "scheduler.h"
 
 
 namespace Qk
@@ -12,11 +15,40 @@ namespace Qk
 	static constexpr int SIGNAL_CPU_HLT = 577; // CPU halt
 	static constexpr int SIGNAL_CPU_RSM = 578; // CPU resume
 
-	class Bus 
+	class Bus
 	{
 	public:
+		// Direct signal line for hot signals (e.g. interrupt requests): the
+		// emitting device raises it, the receiving device polls it. No bus
+		// dispatch is involved at all.
+		class Line
+		{
+		public:
+			void Raise() { m_raised = true; }
+			void Clear() { m_raised = false; }
+			bool IsRaised() const { return m_raised; }
+
+			// Check and clear in one go, for requests that are
+			// serviced once (edge-triggered)
+			bool Acknowledge()
+			{
+				bool raised = m_raised;
+				m_raised = false;
+				return raised;
+			}
+
+		private:
+			bool m_raised = false;
+		};
+
 		class Device
 		{
+		public:
+			// Handlers serving a mapped address range. Devices that occupy
+			// more than one range can route each to its own handler.
+			typedef byte(Device::* ReadHandler)(word address, bool peek);
+			typedef void(Device::* WriteHandler)(word address, byte data);
+
 		protected:
 			const AddressRange m_addressableRange;
 			const bool m_isAddressable;
@@ -27,6 +59,7 @@ namespace Qk
 		public:
 			Device(Bus& bus, bool isAddressable, const AddressRange& addressRange);
 			Device(Bus&);
+			virtual ~Device() = default;
 
 			const AddressRange& GetAddressableRange() const;
 			bool IsAddressable() const;
@@ -34,6 +67,46 @@ namespace Qk
 			virtual byte ReadFromDevice(word address, bool peek = false);
 			virtual void WriteToDevice(word address, byte data);
 			virtual void OnBusSignal(int signalId);
+
+			// Plain memory devices can hand the bus a host pointer to the byte
+			// backing address, valid for the following 255 bytes as well. The bus
+			// then reads/writes that page directly, without calling the device.
+			// Return nullptr if the page must go through Read/WriteToDevice.
+			// Memory handed out for reading but not for writing is taken to
+			// be ROM: it must not change while mapped.
+			virtual byte* GetDirectMemory(word address, bool isWrite);
+
+		protected:
+			// Ask the bus to rebuild the pages this device occupies, e.g. after
+			// the memory returned by GetDirectMemory has moved or changed
+			void RefreshBusMapping();
+
+			// Subscribe to a bus signal; OnBusSignal is only called
+			// for signals the device subscribed to
+			void ListenForSignal(int signalId);
+
+			// Route our address range straight to another device: address A
+			// in our range ends up at targetBase + ((A - our min) & wrapMask)
+			void RedirectBusMapping(Device& target, word targetBase, word wrapMask);
+
+			// Claim additional address ranges (or single registers) besides the
+			// one passed to the constructor, for reading and/or writing only.
+			// Read and write claims are checked for conflicts separately, so
+			// e.g. a read-only and a write-only register may share an address.
+			void MapReadHandler(const AddressRange& range, ReadHandler handler);
+			void MapWriteHandler(const AddressRange& range, WriteHandler handler);
+
+			template <class T>
+			void MapReadHandler(const AddressRange& range, byte(T::* handler)(word, bool))
+			{
+				MapReadHandler(range, static_cast<ReadHandler>(handler));
+			}
+
+			template <class T>
+			void MapWriteHandler(const AddressRange& range, void(T::* handler)(word, byte))
+			{
+				MapWriteHandler(range, static_cast<WriteHandler>(handler));
+			}
 		};
 
 		friend class Device;
@@ -47,15 +120,105 @@ namespace Qk
 		void EmitSignal(int signalId);
 		byte Peek(word address);
 
+		// Host pointer to the 256 byte page holding address, if reads (or writes)
+		// there go straight to memory; nullptr if they go through a device
+		byte* GetDirectPage(word address, bool isWrite) const;
+
+		// Same, if reads there come straight from memory that can't be written
+		// over the bus (i.e. ROM). Lets the CPU decode code there ahead of time.
+		const byte* GetReadOnlyPage(word address) const;
+
+		// Changes whenever the page table is rebuilt, e.g. on a mapper bank switch
+		// or cartridge swap, so anything derived from it can tell it's out of date
+		dword GetMappingGeneration() const { return m_mappingGeneration; }
+
+		// CPU interrupt request lines, polled by CPU
+		Line NMI;
+		Line IRQ;
+
+		// Signals to be emitted at future master clock timestamps
+		Scheduler Events;
+		void RunEvents(qword timestamp);
+
 	protected:
+		// A device's claim on a range of bus addresses
+		struct Mapping
+		{
+			Device* Target;
+			Device::ReadHandler Read;   // nullptr if range is not readable
+			Device::WriteHandler Write; // nullptr if range is not writable
+			word Min;
+			word Max;
+			word Base; // Device address that Min translates to
+			word Mask; // Wraps offsets from Min, for mirrored ranges
+		};
+
+		// Resolved device access for (part of) a page
+		struct Port
+		{
+			Device* Target = nullptr;
+			Device::ReadHandler Read = nullptr;
+			Device::WriteHandler Write = nullptr;
+			word Min = 0;
+			word Base = 0;
+			word Mask = 0;
+
+			word Translate(word address) const { return Base + ((address - Min) & Mask); }
+		};
+
+		// One entry per 256-byte page of the address space, built at map time.
+		// Pages backed by plain memory resolve to a host pointer; everything
+		// else falls back to a device callback.
+		struct Page
+		{
+			byte* Memory = nullptr;
+			Port IO;
+			std::unique_ptr<Port[]> SharedIO; // Per-address ports, for pages shared by several devices
+		};
+
 		std::vector<Device*> m_addressableDevices;
 		std::vector<Device*> m_nonAddressableDevices;
-		Device* m_cachedDevicePtr = nullptr;
-		
-		bool CheckAddressBelongsTo(const Device& device, word address) const;
-		bool CheckAddressRangeConflict(const Device& device, const AddressRange& range) const;
-		bool CheckRangeAvailable(const AddressRange& range) const;
-		Device* GetDeviceAt(word address);
+		std::vector<Mapping> m_mappings;
+		std::unordered_map<int, std::vector<Device*>> m_signalListeners;
+
+		Page m_readPages[256];
+		Page m_writePages[256];
+		dword m_mappingGeneration = 0;
+
+		bool CheckRangeAvailable(const AddressRange& range, bool isWrite) const;
 		void ConnectDevice(Device& device);
+		void SubscribeDevice(Device& device, int signalId);
+		void MapDevice(Device& device, const AddressRange& range, Device::ReadHandler read, Device::WriteHandler write);
+		void RedirectDevice(Device& device, Device& target, word targetBase, word wrapMask);
+		void RebuildPages(const Device& device);
+		void BuildPage(int index, bool isWrite);
+
+		byte ReadFromPort(const Page& page, word address, bool peek);
+		void WriteToPort(const Page& page, word address, byte data);
 	};
+
+
+	/*
+		Bus I/O fast paths -- inline, as every CPU access goes through here
+	*/
+
+	inline byte Bus::ReadFromBus(word address)
+	{
+		const Page& page = m_readPages[address >> 8];
+
+		if (page.Memory != nullptr)
+			return page.Memory[address & 0x00FF];
+
+		return ReadFromPort(page, address, false);
+	}
+
+	inline void Bus::WriteToBus(word address, byte data)
+	{
+		const Page& page = m_writePages[address >> 8];
+
+		if (page.Memory != nullptr)
+			page.Memory[address & 0x00FF] = data;
+		else
+			WriteToPort(page, address, data);
+	}
 }
@@ -0,0 +1,392 @@
+#pragma once
+
+// Block cache core implementation. Templated on the memory access policy,
+// like the other cores; cpu-ops.h includes this file.
+//
+// Runs the fused core's handlers, so behaves exactly like it -- the only
+// bus accesses it skips are reads of code bytes from ROM, which have no
+// side effects. Within a run, handlers keep the N and Z flags lazily (see
+// FusedCore::SetNZ); P is complete again whenever the run returns, and
+// whenever the host may look at it in between.
+
+#include "cpu.h"
+#include "cpu-fused.h"
+
+namespace Qk
+{
+	/*
+		Constructor
+	*/
+
+	template <class Memory, class Variant>
+	MOS6502::BlockCore<Memory, Variant>::BlockCore(MOS6502& parent, Memory& memory)
+		: FusedCore<Memory, Variant>(parent, memory), m_blocks(new Block[CACHE_SIZE]()), m_generation(parent.BUS.GetMappingGeneration())
+	{
+
+	}
+
+	// Block size limits (constexpr static members need one pre-C++17)
+	template <class Memory, class Variant>
+	constexpr int MOS6502::BlockCore<Memory, Variant>::MAX_BLOCK_LENGTH;
+	template <class Memory, class Variant>
+	constexpr int MOS6502::BlockCore<Memory, Variant>::CACHE_SIZE;
+
+
+	/*
+		Running blocks
+	*/
+
+	template <class Memory, class Variant>
+	int MOS6502::BlockCore<Memory, Variant>::ExecuteBlock(BlockHost& host)
+	{
+		return host.WatchesRegisters() ? RunBlocks<true>(host) : RunBlocks<false>(host);
+	}
+
+	template <class Memory, class Variant>
+	template <bool Watched>
+	int MOS6502::BlockCore<Memory, Variant>::RunBlocks(BlockHost& host)
+	{
+		RegisterFile& R = this->CPU.Registers;
+		int cycles = 0;
+		IdleWatch idle;
+
+		this->LoadFlags(R);
+
+		for (;;)
+		{
+			const Block* block = Lookup(R.PC);
+
+			if (block == nullptr)
+			{
+				// Not ROM code; decode as we go
+				this->StoreFlags(R);
+				cycles += FusedCore<Memory, Variant>::ExecuteNextInstruction();
+				this->LoadFlags(R);
+				idle.Loop = nullptr;
+			}
+			else
+			{
+				WatchIdle(idle, *block, cycles);
+
+				for (int n = 0; ; )
+				{
+					const Instruction& instruction = block->Code[n];
+
+					this->m_opcode = instruction.Opcode;
+					this->m_cycles = instruction.Execute(*this, R, instruction.Operand);
+					cycles += this->m_cycles;
+
+					if (++n == block->Length)
+						break;
+
+					if (!MayContinue<Watched>(host, cycles))
+						return cycles;
+				}
+
+				SkipIdle(host, idle, *block, cycles);
+			}
+
+			// On to the next block
+			if (!MayContinue<Watched>(host, cycles))
+				return cycles;
+		}
+	}
+
+	template <class Memory, class Variant>
+	template <bool Watched>
+	QK_FORCEINLINE bool MOS6502::BlockCore<Memory, Variant>::MayContinue(BlockHost& host, int cycles)
+	{
+		// Only go on where running one instruction at a time would have done
+		// nothing else in between: no interrupt request to service, CPU not
+		// halted, code still mapped as it was, and nothing else due in the host
+		MOS6502& cpu = this->CPU;
+		bool proceed = !cpu.BUS.NMI.IsRaised() && !cpu.BUS.IRQ.IsRaised() && !cpu.m_halted
+			&& cpu.BUS.GetMappingGeneration() == m_generation;
+
+		// P must be complete whenever the host may look at it,
+		// and once the run is over
+		if (Watched)
+			this->StoreFlags(cpu.Registers);
+
+		if (proceed && host.ContinueBlock(cycles))
+		{
+			// ...and it may have changed it, too
+			if (Watched)
+				this->LoadFlags(cpu.Registers);
+
+			return true;
+		}
+
+		if (!Watched)
+			this->StoreFlags(cpu.Registers);
+
+		return false;
+	}
+
+
+	/*
+		Block cache
+	*/
+
+	template <class Memory, class Variant>
+	const typename MOS6502::BlockCore<Memory, Variant>::Block* MOS6502::BlockCore<Memory, Variant>::Lookup(word address)
+	{
+		// Blocks decoded before the page table last changed are stale;
+		// they're keyed by address and the generation of the mapping (i.e.
+		// the banks) they were decoded under
+		m_generation = this->CPU.BUS.GetMappingGeneration();
+
+		if (GetCode(address) == nullptr)
+			return nullptr;
+
+		Block& block = m_blocks[address % CACHE_SIZE];
+
+		if (block.Length == 0 || block.Start != address || block.Generation != m_generation)
+		{
+			Decode(block, address);
+			DetectIdleLoop(block);
+		}
+
+		return block.Length > 0 ? &block : nullptr;
+	}
+
+	template <class Memory, class Variant>
+	void MOS6502::BlockCore<Memory, Variant>::Decode(Block& block, word address)
+	{
+		block.Generation = m_generation;
+		block.Start = address;
+		block.Length = 0;
+
+		while (block.Length < MAX_BLOCK_LENGTH)
+		{
+			const byte* code = GetCode(address);
+
+			if (code == nullptr)
+				break;
+
+			const OpcodeInfo& info = Variant::Opcodes[*code];
+			int length = GetInstructionLength(info.Mode);
+
+			// Operand bytes must be ROM too
+			word operand = 0;
+
+			for (int n = 1; n < length; n++)
+			{
+				const byte* next = GetCode(address + n);
+
+				if (next == nullptr)
+					return;
+
+				operand |= (word)*next << (8 * (n - 1));
+			}
+
+			block.Code[block.Length++] = { Handlers[*code], operand, *code };
+			address += length;
+
+			// Block ends where control flow may go elsewhere
+			switch (info.Op)
+			{
+			case Operation::BRK: case Operation::RTI:
+			case Operation::JMP: case Operation::JSR: case Operation::RTS:
+			case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+			case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS:
+			case Operation::BRA:
+				return;
+			default:
+				break;
+			}
+		}
+	}
+
+	template <class Memory, class Variant>
+	const byte* MOS6502::BlockCore<Memory, Variant>::GetCode(word address) const
+	{
+		const byte* page = this->CPU.BUS.GetReadOnlyPage(address);
+
+		return page != nullptr ? page + (address & 0x00FF) : nullptr;
+	}
+
+
+	/*
+		Idle loops
+	*/
+
+	template <class Memory, class Variant>
+	void MOS6502::BlockCore<Memory, Variant>::DetectIdleLoop(Block& block) const
+	{
+		// Candidates jump straight back to their own start, and have no
+		// effect but on the registers: no writes, no stack, and reads only
+		// from memory at fixed addresses -- or from one I/O register, which
+		// the host must know about
+		const Bus& bus = this->CPU.BUS;
+		word address = block.Start;
+
+		block.MayIdle = false;
+		block.Polled = -1;
+
+		for (int n = 0; n < block.Length; n++)
+		{
+			const Instruction& instruction = block.Code[n];
+			const OpcodeInfo& info = Variant::Opcodes[instruction.Opcode];
+			bool last = n == block.Length - 1;
+
+			address += GetInstructionLength(info.Mode);
+
+			switch (info.Op)
+			{
+			case Operation::NOP:
+			case Operation::TAX: case Operation::TAY: case Operation::TXA: case Operation::TYA:
+			case Operation::TSX: case Operation::TXS:
+			case Operation::INX: case Operation::INY: case Operation::DEX: case Operation::DEY:
+			case Operation::CLC: case Operation::CLD: case Operation::CLI: case Operation::CLV:
+			case Operation::SEC: case Operation::SED: case Operation::SEI:
+				break;
+
+			case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+				if (info.Mode != AddressingMode::ACC)
+					return;
+				break;
+
+			case Operation::LDA: case Operation::LDX: case Operation::LDY:
+			case Operation::AND: case Operation::EOR: case Operation::ORA: case Operation::BIT:
+			case Operation::ADC: case Operation::SBC:
+			case Operation::CMP: case Operation::CPX: case Operation::CPY:
+				if (info.Mode == AddressingMode::ZP0 || info.Mode == AddressingMode::ZPX || info.Mode == AddressingMode::ZPY)
+				{
+					if (bus.GetDirectPage(0x0000, false) == nullptr)
+						return;
+				}
+				else if (info.Mode == AddressingMode::ABS)
+				{
+					if (bus.GetDirectPage(instruction.Operand, false) != nullptr)
+						break;
+
+					if (block.Polled != -1 && block.Polled != instruction.Operand)
+						return;
+
+					block.Polled = instruction.Operand;
+				}
+				else if (info.Mode != AddressingMode::IMM)
+				{
+					return;
+				}
+				break;
+
+			case Operation::JMP:
+				if (info.Mode != AddressingMode::ABS || !last)
+					return;
+				block.MayIdle = instruction.Operand == block.Start;
+				return;
+
+			case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+			case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS:
+			case Operation::BRA:
+				if (!last)
+					return;
+				block.MayIdle = (word)(address + (int)(signed char)instruction.Operand) == block.Start;
+				return;
+
+			default:
+				return;
+			}
+		}
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::BlockCore<Memory, Variant>::WatchIdle(IdleWatch& watch, const Block& block, int cycles)
+	{
+		if (!block.MayIdle || !this->CPU.m_idleLoopSkipping)
+		{
+			watch.Loop = nullptr;
+			return;
+		}
+
+		if (watch.Loop != &block)
+		{
+			watch.Loop = &block;
+			watch.Streak = 0;
+		}
+
+		watch.Entry = this->CPU.Registers;
+		watch.Entry.P = this->template GetP<true>(watch.Entry);
+		watch.Start = cycles;
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::BlockCore<Memory, Variant>::SkipIdle(BlockHost& host, IdleWatch& watch, const Block& block, int& cycles)
+	{
+		if (watch.Loop != &block)
+			return;
+
+		const RegisterFile& R = this->CPU.Registers;
+
+		if (R.PC != block.Start)
+		{
+			watch.Loop = nullptr;
+			return;
+		}
+
+		const RegisterFile& E = watch.Entry;
+
+		if (R.A != E.A || R.X != E.X || R.Y != E.Y || R.S != E.S || this->template GetP<true>(R) != E.P)
+		{
+			watch.Streak = 0;
+			return;
+		}
+
+		// The first run may have read an I/O register before a read reset
+		// it (e.g. a status flag); by the second, all reads see what the
+		// ones after will, as long as host finds nothing changes them.
+		// The host is only asked within a single RunBlock call, so nothing
+		// else has happened in between.
+		if (++watch.Streak < 2)
+			return;
+
+		int length = cycles - watch.Start;
+		int limit = host.GetIdleCycles(block.Polled);
+
+		if (limit <= cycles || length <= 0)
+			return;
+
+		// Skip whole runs, all of which would have started in time
+		int skipped = ((limit - cycles) / length) * length;
+
+		if (skipped == 0)
+			return;
+
+		cycles += skipped;
+		this->CPU.m_idleCyclesSkipped += skipped;
+		host.QuietInstructionsRan(cycles - this->m_cycles);
+	}
+
+
+	/*
+		Handlers
+	*/
+
+	template <class Memory, class Variant>
+	template <byte Opcode>
+	int MOS6502::BlockCore<Memory, Variant>::ExecuteDecoded(BlockCore& core, RegisterFile& R, word operand)
+	{
+		R.PC++; // Opcode
+		return core.template Execute<Variant::Opcodes[Opcode].Mode, Variant::Opcodes[Opcode].Op, Variant::Opcodes[Opcode].BaseCycles, true, true>(R, operand);
+	}
+
+#define QK_BLOCK_HANDLER(n) &BlockCore<Memory, Variant>::template ExecuteDecoded<(n)>,
+#define QK_BLOCK_HANDLER16(n) \
+	QK_BLOCK_HANDLER(n + 0x0) QK_BLOCK_HANDLER(n + 0x1) QK_BLOCK_HANDLER(n + 0x2) QK_BLOCK_HANDLER(n + 0x3) \
+	QK_BLOCK_HANDLER(n + 0x4) QK_BLOCK_HANDLER(n + 0x5) QK_BLOCK_HANDLER(n + 0x6) QK_BLOCK_HANDLER(n + 0x7) \
+	QK_BLOCK_HANDLER(n + 0x8) QK_BLOCK_HANDLER(n + 0x9) QK_BLOCK_HANDLER(n + 0xA) QK_BLOCK_HANDLER(n + 0xB) \
+	QK_BLOCK_HANDLER(n + 0xC) QK_BLOCK_HANDLER(n + 0xD) QK_BLOCK_HANDLER(n + 0xE) QK_BLOCK_HANDLER(n + 0xF)
+
+	template <class Memory, class Variant>
+	const typename MOS6502::BlockCore<Memory, Variant>::Handler MOS6502::BlockCore<Memory, Variant>::Handlers[256] = {
+		QK_BLOCK_HANDLER16(0x00) QK_BLOCK_HANDLER16(0x10) QK_BLOCK_HANDLER16(0x20) QK_BLOCK_HANDLER16(0x30)
+		QK_BLOCK_HANDLER16(0x40) QK_BLOCK_HANDLER16(0x50) QK_BLOCK_HANDLER16(0x60) QK_BLOCK_HANDLER16(0x70)
+		QK_BLOCK_HANDLER16(0x80) QK_BLOCK_HANDLER16(0x90) QK_BLOCK_HANDLER16(0xA0) QK_BLOCK_HANDLER16(0xB0)
+		QK_BLOCK_HANDLER16(0xC0) QK_BLOCK_HANDLER16(0xD0) QK_BLOCK_HANDLER16(0xE0) QK_BLOCK_HANDLER16(0xF0)
+	};
+
+#undef QK_BLOCK_HANDLER16
+#undef QK_BLOCK_HANDLER
+}
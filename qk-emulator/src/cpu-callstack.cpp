@@ -0,0 +1,195 @@
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include "cpu-callstack.h"
+#include "cpu.h"
+
+
+using namespace Qk;
+
+
+/*
+	Constructor
+*/
+
+CPUCallProfiler::CPUCallProfiler()
+{
+	// Root: whatever runs outside of any call, from reset on
+	Node root;
+	root.Key = 0;
+	root.Parent = -1;
+	m_nodes.push_back(root);
+	m_stack.push_back({ 0, 0x100 });
+
+	SetCMOS(false);
+}
+
+
+/*
+	Public interface methods
+*/
+
+void CPUCallProfiler::SetCMOS(bool cmos)
+{
+	using OP = MOS6502::Operation;
+
+	for (int n = 0; n < 256; n++)
+	{
+		OP op = (cmos ? MOS6502::OpcodeTable65C02 : MOS6502::OpcodeTable)[n].Op;
+
+		m_ops[n] = op == OP::JSR ? CALL : op == OP::BRK ? BREAK : op == OP::RTS || op == OP::RTI ? RETURN : OTHER;
+	}
+}
+
+void CPUCallProfiler::SetSymbols(const SymbolTable* symbols)
+{
+	m_symbols = symbols;
+}
+
+
+/*
+	Call tree
+*/
+
+void CPUCallProfiler::Push(Kind kind, word address, byte s)
+{
+	// Runaway recursion or stack tricks: count on in the deepest routine
+	if ((int)m_stack.size() >= MAX_DEPTH)
+		return;
+
+	int node = FindChild(m_stack.back().Node, (dword)kind << 16 | address);
+	m_nodes[node].Calls++;
+	m_stack.push_back({ node, s });
+}
+
+int CPUCallProfiler::FindChild(int parent, dword key)
+{
+	int child = m_nodes[parent].FirstChild;
+
+	for (; child >= 0; child = m_nodes[child].NextSibling)
+	{
+		if (m_nodes[child].Key == key)
+			return child;
+	}
+
+	Node node;
+	node.Key = key;
+	node.Parent = parent;
+	node.NextSibling = m_nodes[parent].FirstChild;
+
+	child = (int)m_nodes.size();
+	m_nodes.push_back(node);
+	m_nodes[parent].FirstChild = child;
+
+	return child;
+}
+
+std::string CPUCallProfiler::GetName(dword key) const
+{
+	static const char* const prefixes[] = { "", "[NMI]", "[IRQ]", "[BRK]" };
+
+	if (key == 0)
+		return "[main]";
+
+	word address = (word)key;
+	const std::string* symbol = m_symbols != nullptr ? m_symbols->Find(address) : nullptr;
+	std::ostringstream name;
+	name << prefixes[key >> 16];
+
+	if (symbol != nullptr)
+		name << *symbol;
+	else
+		name << "$" << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << address;
+
+	// Separators in folded stacks
+	std::string text = name.str();
+
+	for (char& c : text)
+	{
+		if (c == ';' || c == ' ' || c == ',')
+			c = '_';
+	}
+
+	return text;
+}
+
+
+/*
+	Output
+*/
+
+void CPUCallProfiler::WriteFolded(std::ostream& out) const
+{
+	std::vector<std::string> names(m_nodes.size());
+	std::vector<int> path;
+
+	for (std::size_t n = 0; n < m_nodes.size(); n++)
+		names[n] = GetName(m_nodes[n].Key);
+
+	for (int n = 0; n < (int)m_nodes.size(); n++)
+	{
+		if (m_nodes[n].Self == 0)
+			continue;
+
+		path.clear();
+
+		for (int node = n; node >= 0; node = m_nodes[node].Parent)
+			path.push_back(node);
+
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
+			out << (it != path.rbegin() ? ";" : "") << names[*it];
+
+		out << " " << m_nodes[n].Self << "\n";
+	}
+}
+
+void CPUCallProfiler::WriteRoutines(std::ostream& out) const
+{
+	struct Routine
+	{
+		qword Calls = 0;
+		qword Inclusive = 0;
+		qword Exclusive = 0;
+	};
+
+	// Children always come after their parent, so totals add up backwards
+	std::vector<qword> totals(m_nodes.size());
+
+	for (int n = (int)m_nodes.size() - 1; n >= 0; n--)
+	{
+		totals[n] += m_nodes[n].Self;
+
+		if (m_nodes[n].Parent >= 0)
+			totals[m_nodes[n].Parent] += totals[n];
+	}
+
+	std::map<dword, Routine> routines;
+
+	for (int n = 0; n < (int)m_nodes.size(); n++)
+	{
+		const Node& node = m_nodes[n];
+		Routine& routine = routines[node.Key];
+		routine.Calls += node.Calls;
+		routine.Exclusive += node.Self;
+
+		// Inclusive cycles from the outermost call only
+		int parent = node.Parent;
+
+		while (parent >= 0 && m_nodes[parent].Key != node.Key)
+			parent = m_nodes[parent].Parent;
+
+		if (parent < 0)
+			routine.Inclusive += totals[n];
+	}
+
+	out << "routine,name,calls,inclusive_cycles,exclusive_cycles\n";
+
+	for (const auto& entry : routines)
+	{
+		out << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << (entry.first & 0xFFFF) << std::dec
+			<< "," << GetName(entry.first)
+			<< "," << entry.second.Calls
+			<< "," << entry.second.Inclusive
+			<< "," << entry.second.Exclusive << "\n";
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "definitions.h"
+#include "cpu-symbols.h"
+
+
+namespace Qk
+{
+	/*
+		CPU call stack profiler: cycles by the chain of guest calls that led
+		to them. A shadow call stack follows JSR, BRK and interrupts in, and
+		RTS and RTI out, and the routine on top of it gets the cycles.
+
+		Returns are matched by stack pointer rather than by address, so code
+		that pulls its return address to read inline data, or that resets
+		the stack, unwinds the shadow stack as far as S says it should.
+		Calls nested deeper than MAX_DEPTH, e.g. recursion that never
+		returns, are not pushed; their cycles go to the deepest routine kept.
+	*/
+
+	class CPUCallProfiler
+	{
+	public:
+		enum class Kind
+		{
+			Call, NMI, IRQ, BRK
+		};
+
+		static constexpr int MAX_DEPTH = 256;
+
+	public:
+		CPUCallProfiler();
+
+		// Opcode table for telling calls and returns apart; set by
+		// MOS6502::SetCallProfiler
+		void SetCMOS(bool cmos);
+
+		// Names for routines; without, they go by address. Not copied.
+		void SetSymbols(const SymbolTable* symbols);
+
+		// Filled by the CPU: one instruction, or an interrupt sequence, with
+		// the stack pointer before and the PC and stack pointer after
+		void RecordInstruction(byte s, byte opcode, byte sAfter, word pcAfter, int cycles);
+		void RecordInterrupt(bool nmi, byte s, byte sAfter, word pcAfter, int cycles);
+
+		// Folded stacks, one line per call chain: "[main];$C123;$C456 1234",
+		// cycles spent in the last routine itself. Flame graph tools take it
+		// as is.
+		void WriteFolded(std::ostream& out) const;
+
+		// One row per routine: calls, inclusive and exclusive cycles.
+		// Recursive calls count towards a routine's inclusive cycles once.
+		void WriteRoutines(std::ostream& out) const;
+
+	protected:
+		// Call tree: one node per chain of calls, children linked by sibling
+		struct Node
+		{
+			dword Key;			// Kind << 16 | routine address
+			int Parent;
+			int FirstChild = -1;
+			int NextSibling = -1;
+			qword Self = 0;		// Cycles in this routine itself
+			qword Calls = 0;
+		};
+
+		// Shadow stack: the node, and S before the call; the frame is gone
+		// once S is back up there
+		struct Frame
+		{
+			int Node;
+			int S;
+		};
+
+		enum Op : byte
+		{
+			OTHER, CALL, BREAK, RETURN
+		};
+
+		std::vector<Node> m_nodes;
+		std::vector<Frame> m_stack;
+		const SymbolTable* m_symbols = nullptr;
+		Op m_ops[256];
+
+		void Unwind(int s);
+		void Push(Kind kind, word address, byte s);
+		int FindChild(int parent, dword key);
+
+		std::string GetName(dword key) const;
+	};
+
+
+	/*
+		Shadow stack upkeep, once per instruction
+	*/
+
+	inline void CPUCallProfiler::Unwind(int s)
+	{
+		while (m_stack.back().S <= s)
+			m_stack.pop_back();
+	}
+
+	inline void CPUCallProfiler::RecordInstruction(byte s, byte opcode, byte sAfter, word pcAfter, int cycles)
+	{
+		// Frames whose return address was pulled some other way first
+		Unwind(s);
+		m_nodes[m_stack.back().Node].Self += cycles;
+
+		switch (m_ops[opcode])
+		{
+		case CALL:
+			Push(Kind::Call, pcAfter, s);
+			break;
+
+		case BREAK:
+			Push(Kind::BRK, pcAfter, s);
+			break;
+
+		case RETURN:
+			Unwind(sAfter);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	inline void CPUCallProfiler::RecordInterrupt(bool nmi, byte s, byte sAfter, word pcAfter, int cycles)
+	{
+		Unwind(s);
+
+		// A masked IRQ pushes nothing
+		if (sAfter != s)
+			Push(nmi ? Kind::NMI : Kind::IRQ, pcAfter, s);
+
+		m_nodes[m_stack.back().Node].Self += cycles;
+	}
+}
@@ -0,0 +1,807 @@
+#pragma once
+
+// Fused instruction core implementation. Templated on the memory access
+// policy and CPU variant, like the reference core in cpu-ops.h, which
+// includes this file.
+//
+// Behaves exactly like the reference core -- same bus accesses in the same
+// order, same cycle counts -- so the two can be swapped at any time.
+
+#include "cpu.h"
+#include "util.h"
+
+namespace Qk
+{
+	/*
+		Constructor
+	*/
+
+	template <class Memory, class Variant>
+	MOS6502::FusedCore<Memory, Variant>::FusedCore(MOS6502& parent, Memory& memory) : CPU(parent), MEM(memory)
+	{
+
+	}
+
+	/*
+		External interface methods
+	*/
+
+	template <class Memory, class Variant>
+	int MOS6502::FusedCore<Memory, Variant>::ExecuteNextInstruction()
+	{
+		RegisterFile R = CPU.Registers;
+
+		byte opcode = ReadCode(R.PC++);
+		m_opcode = opcode;
+
+		// One case per opcode; the compiler turns this into a jump table
+		// straight into each handler, inlined
+#define QK_FUSED_CASE(n) case (n): m_cycles = ExecuteOpcode<(n)>(R); break;
+#define QK_FUSED_CASE16(n) \
+		QK_FUSED_CASE(n + 0x0) QK_FUSED_CASE(n + 0x1) QK_FUSED_CASE(n + 0x2) QK_FUSED_CASE(n + 0x3) \
+		QK_FUSED_CASE(n + 0x4) QK_FUSED_CASE(n + 0x5) QK_FUSED_CASE(n + 0x6) QK_FUSED_CASE(n + 0x7) \
+		QK_FUSED_CASE(n + 0x8) QK_FUSED_CASE(n + 0x9) QK_FUSED_CASE(n + 0xA) QK_FUSED_CASE(n + 0xB) \
+		QK_FUSED_CASE(n + 0xC) QK_FUSED_CASE(n + 0xD) QK_FUSED_CASE(n + 0xE) QK_FUSED_CASE(n + 0xF)
+
+		switch (opcode)
+		{
+			QK_FUSED_CASE16(0x00) QK_FUSED_CASE16(0x10) QK_FUSED_CASE16(0x20) QK_FUSED_CASE16(0x30)
+			QK_FUSED_CASE16(0x40) QK_FUSED_CASE16(0x50) QK_FUSED_CASE16(0x60) QK_FUSED_CASE16(0x70)
+			QK_FUSED_CASE16(0x80) QK_FUSED_CASE16(0x90) QK_FUSED_CASE16(0xA0) QK_FUSED_CASE16(0xB0)
+			QK_FUSED_CASE16(0xC0) QK_FUSED_CASE16(0xD0) QK_FUSED_CASE16(0xE0) QK_FUSED_CASE16(0xF0)
+		}
+
+#undef QK_FUSED_CASE16
+#undef QK_FUSED_CASE
+
+		CPU.Registers = R;
+
+		return m_cycles;
+	}
+
+	template <class Memory, class Variant>
+	byte MOS6502::FusedCore<Memory, Variant>::GetLastInstructionOpcode() const
+	{
+		return m_opcode;
+	}
+
+	template <class Memory, class Variant>
+	int MOS6502::FusedCore<Memory, Variant>::GetLastInstructionCycles() const
+	{
+		return m_cycles;
+	}
+
+	template <class Memory, class Variant>
+	std::string MOS6502::FusedCore<Memory, Variant>::GetLastInstructionMnemonic() const
+	{
+		return std::string(Variant::Opcodes[m_opcode].Mnemonic);
+	}
+
+	template <class Memory, class Variant>
+	std::string MOS6502::FusedCore<Memory, Variant>::GetLastInstructionAddressingModeMnemonic() const
+	{
+		return std::string(AddressingModeMnemonics[static_cast<int>(Variant::Opcodes[m_opcode].Mode)]);
+	}
+
+
+	/*
+		Common functionality
+	*/
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE byte MOS6502::FusedCore<Memory, Variant>::Read(word address)
+	{
+		return MEM.Read(address);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE byte MOS6502::FusedCore<Memory, Variant>::ReadCode(word address)
+	{
+		// Opcode and operand bytes: straight from the fetch window, if code
+		// runs from plain memory and isn't being traced
+		const byte* code = CPU.FetchWindow(address);
+
+		if (code != nullptr)
+			return *code;
+
+		return Read(address);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::Write(word address, byte data)
+	{
+		MEM.Write(address, data);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::Push(RegisterFile& R, byte data)
+	{
+		Write(0x0100 | R.S, data);
+		R.S--;
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE byte MOS6502::FusedCore<Memory, Variant>::Pull(RegisterFile& R)
+	{
+		R.S++;
+		return Read(0x0100 | R.S);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::SetFlag(RegisterFile& R, byte flag, bool state)
+	{
+		R.P = state ? (R.P | flag) : (R.P & ~flag);
+	}
+
+	template <class Memory, class Variant>
+	template <bool Lazy>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::SetNZ(RegisterFile& R, byte value)
+	{
+		SetNZ<Lazy>(R, value, value);
+	}
+
+	template <class Memory, class Variant>
+	template <bool Lazy>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::SetNZ(RegisterFile& R, byte n, byte z)
+	{
+		// Lazy: just a store, instead of merging both bits into P. One
+		// word, always accessed whole, so reads get it straight from the
+		// store buffer.
+		if (Lazy)
+			m_nz = ((word)n << 8) | z;
+		else
+			R.P = (R.P & ~(FLAG_N | FLAG_Z)) | (n & FLAG_N) | (z == 0 ? FLAG_Z : 0);
+	}
+
+	template <class Memory, class Variant>
+	template <bool Lazy>
+	QK_FORCEINLINE bool MOS6502::FusedCore<Memory, Variant>::CheckN(const RegisterFile& R) const
+	{
+		return Lazy ? (m_nz & (FLAG_N << 8)) != 0 : (R.P & FLAG_N) != 0;
+	}
+
+	template <class Memory, class Variant>
+	template <bool Lazy>
+	QK_FORCEINLINE bool MOS6502::FusedCore<Memory, Variant>::CheckZ(const RegisterFile& R) const
+	{
+		return Lazy ? (m_nz & 0x00FF) == 0 : (R.P & FLAG_Z) != 0;
+	}
+
+	template <class Memory, class Variant>
+	template <bool Lazy>
+	QK_FORCEINLINE byte MOS6502::FusedCore<Memory, Variant>::GetP(const RegisterFile& R) const
+	{
+		if (!Lazy)
+			return R.P;
+
+		return (R.P & ~(FLAG_N | FLAG_Z)) | ((m_nz >> 8) & FLAG_N) | ((m_nz & 0x00FF) == 0 ? FLAG_Z : 0);
+	}
+
+	template <class Memory, class Variant>
+	template <bool Lazy>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::SetP(RegisterFile& R, byte p)
+	{
+		R.P = p;
+
+		if (Lazy)
+			LoadFlags(R);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::LoadFlags(const RegisterFile& R)
+	{
+		m_nz = ((word)R.P << 8) | (~R.P & FLAG_Z);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::StoreFlags(RegisterFile& R) const
+	{
+		R.P = GetP<true>(R);
+	}
+
+	template <class Memory, class Variant>
+	QK_FORCEINLINE int MOS6502::FusedCore<Memory, Variant>::Branch(RegisterFile& R, bool condition, word target)
+	{
+		if (!condition)
+			return 0;
+
+		// Additional cycle if branch succeeds, and another
+		// one in case of page boundary pass
+		int cycles = ((R.PC & 0xFF00) != (target & 0xFF00)) ? 2 : 1;
+		R.PC = target;
+
+		return cycles;
+	}
+
+	template <class Memory, class Variant>
+	template <bool Decoded>
+	QK_FORCEINLINE byte MOS6502::FusedCore<Memory, Variant>::OperandByte(RegisterFile& R, word operand, int index)
+	{
+		// Code is only decoded ahead from ROM, where
+		// reads have no side effects to skip
+		R.PC++;
+
+		if (Decoded)
+			return (operand >> (8 * index)) & 0x00FF;
+
+		return ReadCode(R.PC - 1);
+	}
+
+	template <class Memory, class Variant>
+	template <MOS6502::AddressingMode Mode, bool Decoded>
+	QK_FORCEINLINE byte MOS6502::FusedCore<Memory, Variant>::Fetch(RegisterFile& R, word address, word operand)
+	{
+		// Implied and accumulator addressing don't touch memory
+		if (Mode == AddressingMode::ACC)
+			return R.A;
+		if (Mode == AddressingMode::IMP)
+			return 0;
+
+		// Immediate operand is a code byte too
+		byte value;
+
+		if (Mode == AddressingMode::IMM)
+			value = Decoded ? (operand & 0x00FF) : ReadCode(address);
+		else
+			value = Read(address);
+
+		return value;
+	}
+
+	template <class Memory, class Variant>
+	template <MOS6502::AddressingMode Mode>
+	QK_FORCEINLINE void MOS6502::FusedCore<Memory, Variant>::Store(RegisterFile& R, word address, byte data)
+	{
+		// Read-modify-write result: accumulator or memory
+		if (Mode == AddressingMode::ACC || Mode == AddressingMode::IMP)
+			R.A = data;
+		else
+			Write(address, data);
+	}
+
+
+	/*
+		SYSTEM INTERRUPTS
+	*/
+
+	template <class Memory, class Variant>
+	void MOS6502::FusedCore<Memory, Variant>::IRQ()
+	{
+		if (!(CPU.Registers.P & FLAG_I))
+			Interrupt(0xFFFE);
+	}
+
+	template <class Memory, class Variant>
+	void MOS6502::FusedCore<Memory, Variant>::NMI()
+	{
+		Interrupt(0xFFFA);
+	}
+
+	template <class Memory, class Variant>
+	void MOS6502::FusedCore<Memory, Variant>::Interrupt(word vector)
+	{
+		RegisterFile& R = CPU.Registers;
+
+		// Push PC and P, jump to interrupt vector
+		Push(R, (R.PC >> 8) & 0x00FF);
+		Push(R, R.PC & 0x00FF);
+
+		R.P = (R.P & ~FLAG_B) | FLAG_I;
+		Push(R, R.P);
+
+		if (Variant::CMOS)
+			R.P &= ~FLAG_D;
+
+		R.PC = ((word)Read(vector + 1) << 8) | (word)Read(vector);
+
+		// IRQ counted as 8 cycles too, like the reference core does
+		m_cycles = 8;
+	}
+
+
+	/*
+		INSTRUCTIONS
+
+		See cpu-ops.h for the reference implementation of each operation
+	*/
+
+	template <class Memory, class Variant>
+	template <byte Opcode>
+	QK_FORCEINLINE int MOS6502::FusedCore<Memory, Variant>::ExecuteOpcode(RegisterFile& R)
+	{
+		return Execute<Variant::Opcodes[Opcode].Mode, Variant::Opcodes[Opcode].Op, Variant::Opcodes[Opcode].BaseCycles>(R);
+	}
+
+	template <class Memory, class Variant>
+	template <MOS6502::AddressingMode Mode, MOS6502::Operation Op, int BaseCycles, bool Decoded, bool Lazy>
+	QK_FORCEINLINE int MOS6502::FusedCore<Memory, Variant>::Execute(RegisterFile& R, word operand)
+	{
+		word address = 0;
+		bool pageCrossed = false;
+
+		// Resolve address. Mode is a constant, so only one case survives.
+		switch (Mode)
+		{
+		case AddressingMode::IMP:
+		case AddressingMode::ACC:
+			break;
+
+		case AddressingMode::IMM:
+			address = R.PC++;
+			break;
+
+		case AddressingMode::ZP0:
+			address = OperandByte<Decoded>(R, operand, 0);
+			break;
+
+		case AddressingMode::ZPX:
+			address = (OperandByte<Decoded>(R, operand, 0) + R.X) & 0x00FF;
+			break;
+
+		case AddressingMode::ZPY:
+			address = (OperandByte<Decoded>(R, operand, 0) + R.Y) & 0x00FF;
+			break;
+
+		case AddressingMode::REL:
+		{
+			byte offset = OperandByte<Decoded>(R, operand, 0);
+			address = R.PC + (int)(signed char)offset;
+			break;
+		}
+
+		case AddressingMode::ABS:
+		{
+			word lowerByte = OperandByte<Decoded>(R, operand, 0);
+			word upperByte = OperandByte<Decoded>(R, operand, 1) << 8;
+			address = upperByte | lowerByte;
+			break;
+		}
+
+		case AddressingMode::ABX:
+		case AddressingMode::ABY:
+		{
+			word lowerByte = OperandByte<Decoded>(R, operand, 0);
+			word upperByte = OperandByte<Decoded>(R, operand, 1) << 8;
+			address = (upperByte | lowerByte) + (Mode == AddressingMode::ABX ? R.X : R.Y);
+			pageCrossed = (address & 0xFF00) != upperByte;
+			break;
+		}
+
+		case AddressingMode::IND:
+		{
+			// Including the NMOS page wrap bug, see reference core
+			word ptrLowerByte = OperandByte<Decoded>(R, operand, 0);
+			word ptrUpperByte = OperandByte<Decoded>(R, operand, 1) << 8;
+			word ptrAddress = (ptrUpperByte | ptrLowerByte);
+
+			if (ptrLowerByte == 0x00FF && !Variant::CMOS)
+				address = (Read(ptrAddress & 0xFF00) << 8) | Read(ptrAddress);
+			else
+				address = (Read(ptrAddress + 1) << 8) | Read(ptrAddress);
+			break;
+		}
+
+		case AddressingMode::IZX:
+		{
+			word ptr = OperandByte<Decoded>(R, operand, 0) + R.X;
+			word lowerByte = Read(ptr & 0x00FF);
+			word upperByte = Read((ptr + 1) & 0x00FF) << 8;
+			address = upperByte | lowerByte;
+			break;
+		}
+
+		case AddressingMode::IZY:
+		{
+			word ptr = OperandByte<Decoded>(R, operand, 0);
+			word lowerByte = Read(ptr & 0x00FF);
+			word upperByte = Read((ptr + 1) & 0x00FF) << 8;
+			address = (upperByte | lowerByte) + R.Y;
+			pageCrossed = (address & 0xFF00) != upperByte;
+			break;
+		}
+
+		case AddressingMode::ZPI:
+		{
+			word ptr = OperandByte<Decoded>(R, operand, 0);
+			word lowerByte = Read(ptr & 0x00FF);
+			word upperByte = Read((ptr + 1) & 0x00FF) << 8;
+			address = upperByte | lowerByte;
+			break;
+		}
+
+		case AddressingMode::IAX:
+		{
+			word ptrLowerByte = OperandByte<Decoded>(R, operand, 0);
+			word ptrUpperByte = OperandByte<Decoded>(R, operand, 1) << 8;
+			word ptrAddress = (ptrUpperByte | ptrLowerByte) + R.X;
+			address = (Read(ptrAddress + 1) << 8) | Read(ptrAddress);
+			break;
+		}
+		}
+
+		// Read operations take an extra cycle when indexing crosses a page
+		int cycles = BaseCycles;
+
+		// Do operation. Op is a constant too.
+		switch (Op)
+		{
+		case Operation::XXX:
+		case Operation::NOP:
+			break;
+
+		case Operation::BRK:
+		{
+			R.PC++;
+
+			// The reference core pushes (PC >> 8) & 0xFF00 as the high
+			// byte, which is always 0; stay in step with it
+			Push(R, 0x00);
+			Push(R, R.PC & 0x00FF);
+
+			R.P |= FLAG_B;
+			Push(R, GetP<Lazy>(R));
+			R.P &= ~FLAG_B;
+
+			if (Variant::CMOS)
+				R.P &= ~FLAG_D;
+
+			R.PC = (word)Read(0xFFFE) | ((word)Read(0xFFFF) << 8);
+			break;
+		}
+
+		case Operation::RTI:
+		{
+			// Break flag is not pulled; expansion bit is always set
+			byte p = Pull(R);
+			SetP<Lazy>(R, (p & ~FLAG_B) | (R.P & FLAG_B) | FLAG_U);
+
+			word lowerByte = Pull(R);
+			word upperByte = Pull(R);
+			R.PC = (upperByte << 8) | lowerByte;
+			break;
+		}
+
+		// Loads and stores
+		case Operation::LDA:
+			R.A = Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, R.A);
+			cycles += pageCrossed;
+			break;
+
+		case Operation::LDX:
+			R.X = Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, R.X);
+			cycles += pageCrossed;
+			break;
+
+		case Operation::LDY:
+			R.Y = Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, R.Y);
+			cycles += pageCrossed;
+			break;
+
+		case Operation::STA:
+			Write(address, R.A);
+			break;
+
+		case Operation::STX:
+			Write(address, R.X);
+			break;
+
+		case Operation::STY:
+			Write(address, R.Y);
+			break;
+
+		// Transfers and stack
+		case Operation::TAX:
+			R.X = R.A;
+			SetNZ<Lazy>(R, R.X);
+			break;
+
+		case Operation::TAY:
+			R.Y = R.A;
+			SetNZ<Lazy>(R, R.Y);
+			break;
+
+		case Operation::TXA:
+			R.A = R.X;
+			SetNZ<Lazy>(R, R.A);
+			break;
+
+		case Operation::TYA:
+			R.A = R.Y;
+			SetNZ<Lazy>(R, R.A);
+			break;
+
+		case Operation::TSX:
+			R.X = R.S;
+			SetNZ<Lazy>(R, R.X);
+			break;
+
+		case Operation::TXS:
+			R.S = R.X;
+			break;
+
+		case Operation::PHA:
+			Push(R, R.A);
+			break;
+
+		case Operation::PHP:
+			R.P |= FLAG_B;
+			Push(R, GetP<Lazy>(R));
+			R.P &= ~FLAG_B;
+			break;
+
+		case Operation::PLA:
+			R.A = Pull(R);
+			SetNZ<Lazy>(R, R.A);
+			break;
+
+		case Operation::PLP:
+		{
+			byte p = Pull(R);
+			SetP<Lazy>(R, (p & ~FLAG_B) | (R.P & FLAG_B) | FLAG_U);
+			break;
+		}
+
+		// Logic and arithmetic
+		case Operation::AND:
+			R.A &= Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, R.A);
+			cycles += pageCrossed;
+			break;
+
+		case Operation::EOR:
+			R.A ^= Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, R.A);
+			cycles += pageCrossed;
+			break;
+
+		case Operation::ORA:
+			R.A |= Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, R.A);
+			cycles += pageCrossed;
+			break;
+
+		case Operation::BIT:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+
+			// 65C02 BIT #imm only sets Z
+			if (Mode == AddressingMode::IMM)
+			{
+				SetNZ<Lazy>(R, CheckN<Lazy>(R) ? 0x80 : 0x00, data & R.A);
+				break;
+			}
+
+			R.P = (R.P & ~FLAG_V) | (data & FLAG_V);
+			SetNZ<Lazy>(R, data, data & R.A);
+			cycles += pageCrossed;
+			break;
+		}
+
+		case Operation::ADC:
+		case Operation::SBC:
+		{
+			bool carry = (R.P & FLAG_C) != 0;
+
+			if (!Variant::DecimalMode || !(R.P & FLAG_D)) // Binary mode
+			{
+				// Subtraction is addition of the inverted operand
+				word aval = R.A;
+				word value = Fetch<Mode, Decoded>(R, address, operand);
+
+				if (Op == Operation::SBC)
+					value ^= 0x00FF;
+
+				word temp = aval + value + (carry ? 0x01 : 0x00);
+
+				SetFlag(R, FLAG_C, (temp & 0xFF00) != 0);
+				SetFlag(R, FLAG_V, (~(aval ^ value) & (aval ^ temp)) & 0x0080);
+				R.A = temp & 0x00FF;
+				SetNZ<Lazy>(R, R.A);
+			}
+			else if (Op == Operation::ADC) // Decimal mode
+			{
+				byte valueBCD = Fetch<Mode, Decoded>(R, address, operand);
+				byte temp = Util::BCDtoBIN(R.A) + Util::BCDtoBIN(valueBCD) + (carry ? 0x01 : 0x00);
+				byte resultBCD = Util::BINtoBCD((temp > 99 ? temp - 100 : temp) & 0x00FF);
+
+				SetFlag(R, FLAG_C, temp > 99);
+				SetFlag(R, FLAG_V, false);
+				R.A = resultBCD;
+				SetNZ<Lazy>(R, R.A);
+			}
+			else
+			{
+				byte valueBCD = Fetch<Mode, Decoded>(R, address, operand);
+				int temp = Util::BCDtoBIN(R.A) - Util::BCDtoBIN(valueBCD) - (carry ? 0x00 : 0x01);
+				byte resultBCD = Util::BINtoBCD((temp < 0 ? 99 + temp : temp) & 0xFF);
+
+				SetFlag(R, FLAG_C, temp < 0);
+				SetFlag(R, FLAG_V, false);
+				R.A = resultBCD;
+				SetNZ<Lazy>(R, R.A);
+			}
+
+			// The 65C02 takes a cycle more to fix up its decimal flags
+			if (Variant::CMOS && Variant::DecimalMode && (R.P & FLAG_D))
+				cycles++;
+
+			cycles += pageCrossed;
+			break;
+		}
+
+		case Operation::CMP:
+		case Operation::CPX:
+		case Operation::CPY:
+		{
+			byte reg = Op == Operation::CMP ? R.A : (Op == Operation::CPX ? R.X : R.Y);
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+
+			SetFlag(R, FLAG_C, reg >= data);
+			SetNZ<Lazy>(R, reg - data);
+
+			if (Op == Operation::CMP)
+				cycles += pageCrossed;
+			break;
+		}
+
+		// Increments and decrements
+		case Operation::INC:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand) + 1;
+			SetNZ<Lazy>(R, data);
+			Store<Mode>(R, address, data);
+			break;
+		}
+
+		case Operation::INX:
+			R.X++;
+			SetNZ<Lazy>(R, R.X);
+			break;
+
+		case Operation::INY:
+			R.Y++;
+			SetNZ<Lazy>(R, R.Y);
+			break;
+
+		case Operation::DEC:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand) - 1;
+			SetNZ<Lazy>(R, data);
+			Store<Mode>(R, address, data);
+			break;
+		}
+
+		case Operation::DEX:
+			R.X--;
+			SetNZ<Lazy>(R, R.X);
+			break;
+
+		case Operation::DEY:
+			R.Y--;
+			SetNZ<Lazy>(R, R.Y);
+			break;
+
+		// Shifts and rotates
+		case Operation::ASL:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+			SetFlag(R, FLAG_C, data & 0x80);
+			data = data << 1;
+			SetNZ<Lazy>(R, data);
+			Store<Mode>(R, address, data);
+			// 65C02 abs,X shifts are a cycle shorter, unless they cross a page
+			cycles += Variant::CMOS && pageCrossed;
+			break;
+		}
+
+		case Operation::LSR:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+			SetFlag(R, FLAG_C, data & 0x01);
+			data = data >> 1;
+			SetNZ<Lazy>(R, data);
+			Store<Mode>(R, address, data);
+			cycles += Variant::CMOS && pageCrossed;
+			break;
+		}
+
+		case Operation::ROL:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+			byte carry = R.P & FLAG_C;
+			SetFlag(R, FLAG_C, data & 0x80);
+			data = (data << 1) | carry;
+			SetNZ<Lazy>(R, data);
+			Store<Mode>(R, address, data);
+			cycles += Variant::CMOS && pageCrossed;
+			break;
+		}
+
+		case Operation::ROR:
+		{
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+			byte carry = R.P & FLAG_C;
+			SetFlag(R, FLAG_C, data & 0x01);
+			data = (data >> 1) | (carry ? 0x80 : 0x00);
+			SetNZ<Lazy>(R, data);
+			Store<Mode>(R, address, data);
+			cycles += Variant::CMOS && pageCrossed;
+			break;
+		}
+
+		// Jumps and subroutines
+		case Operation::JMP:
+			R.PC = address;
+			break;
+
+		case Operation::JSR:
+			R.PC--;
+			Push(R, (R.PC >> 8) & 0x00FF);
+			Push(R, R.PC & 0x00FF);
+			R.PC = address;
+			break;
+
+		case Operation::RTS:
+		{
+			word pc = Pull(R);
+			pc |= (word)Pull(R) << 8;
+			R.PC = pc + 1;
+			break;
+		}
+
+		// Branches
+		case Operation::BCC: cycles += Branch(R, !(R.P & FLAG_C), address); break;
+		case Operation::BCS: cycles += Branch(R, R.P & FLAG_C, address); break;
+		case Operation::BEQ: cycles += Branch(R, CheckZ<Lazy>(R), address); break;
+		case Operation::BMI: cycles += Branch(R, CheckN<Lazy>(R), address); break;
+		case Operation::BNE: cycles += Branch(R, !CheckZ<Lazy>(R), address); break;
+		case Operation::BPL: cycles += Branch(R, !CheckN<Lazy>(R), address); break;
+		case Operation::BVC: cycles += Branch(R, !(R.P & FLAG_V), address); break;
+		case Operation::BVS: cycles += Branch(R, R.P & FLAG_V, address); break;
+
+		// Flags
+		case Operation::CLC: R.P &= ~FLAG_C; break;
+		case Operation::CLD: R.P &= ~FLAG_D; break;
+		case Operation::CLI: R.P &= ~FLAG_I; break;
+		case Operation::CLV: R.P &= ~FLAG_V; break;
+		case Operation::SEC: R.P |= FLAG_C; break;
+		case Operation::SED: R.P |= FLAG_D; break;
+		case Operation::SEI: R.P |= FLAG_I; break;
+
+		// 65C02 additions
+		case Operation::BRA: cycles += Branch(R, true, address); break;
+
+		case Operation::PHX: Push(R, R.X); break;
+		case Operation::PHY: Push(R, R.Y); break;
+
+		case Operation::PLX:
+			R.X = Pull(R);
+			SetNZ<Lazy>(R, R.X);
+			break;
+
+		case Operation::PLY:
+			R.Y = Pull(R);
+			SetNZ<Lazy>(R, R.Y);
+			break;
+
+		case Operation::STZ:
+			Write(address, 0x00);
+			break;
+
+		case Operation::TRB:
+		case Operation::TSB:
+		{
+			// Z from A AND memory, like BIT; N is left alone
+			byte data = Fetch<Mode, Decoded>(R, address, operand);
+			SetNZ<Lazy>(R, CheckN<Lazy>(R) ? 0x80 : 0x00, data & R.A);
+			Write(address, Op == Operation::TSB ? (data | R.A) : (data & ~R.A));
+			break;
+		}
+		}
+
+		return cycles;
+	}
+}
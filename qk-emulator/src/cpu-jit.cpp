@@ -0,0 +1,1001 @@
+#include "cpu-jit.h"
+
+#ifdef QK_JIT_AVAILABLE
+
+#include <cstddef>
+#include <initializer_list>
+#include <sys/mman.h>
+
+using namespace Qk;
+
+
+/*
+	x86-64 machine code emitter
+
+	Just the instructions the compiler needs, written straight into the
+	code arena. Register use in compiled code:
+
+		r15		JitCompiler::Context
+		rbx		RegisterFile
+		r14d		CPU cycle count
+		rax, rcx, rdx	scratch
+		rsi, rdi	host address read from / written to
+		r8d - r10d	scratch
+*/
+
+namespace
+{
+	enum Reg
+	{
+		RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+		R8, R9, R10, R11, R12, R13, R14, R15
+	};
+
+	// Condition codes, for jcc and setcc
+	enum Cond
+	{
+		CC_O = 0x0, CC_B = 0x2, CC_AE = 0x3, CC_Z = 0x4, CC_NZ = 0x5, CC_GE = 0xD
+	};
+
+	// Memory operand: [base + index * scale + disp]
+	struct Mem
+	{
+		int Base;
+		int Index;
+		int Scale;
+		int Disp;
+	};
+
+	Mem At(int base, int disp = 0) { return { base, -1, 1, disp }; }
+	Mem At(int base, int index, int scale, int disp) { return { base, index, scale, disp }; }
+
+	class Emitter
+	{
+	public:
+		Emitter(byte* buffer, size_t capacity) : m_buffer(buffer), m_capacity(capacity) { }
+
+		size_t Size() const { return m_size; }
+		bool Overflowed() const { return m_overflow; }
+		byte* Here() const { return m_buffer + m_size; }
+
+		// Raw bytes
+		void Byte(int value)
+		{
+			if (m_size < m_capacity)
+				m_buffer[m_size++] = (byte)value;
+			else
+				m_overflow = true;
+		}
+
+		void Word(int value) { Byte(value); Byte(value >> 8); }
+		void Dword(int value) { Word(value); Word(value >> 16); }
+		void Qword(qword value) { Dword((int)value); Dword((int)(value >> 32)); }
+
+		// Forward jumps: emit with a placeholder, bind once the target is known
+		size_t Jcc(Cond cc) { Byte(0x0F); Byte(0x80 | cc); Dword(0); return m_size; }
+		size_t Jmp() { Byte(0xE9); Dword(0); return m_size; }
+
+		void Bind(size_t jump) { Bind(jump, Here()); }
+
+		void Bind(size_t jump, const byte* target)
+		{
+			if (m_overflow)
+				return;
+
+			int rel = (int)(target - (m_buffer + jump));
+			std::memcpy(m_buffer + jump - 4, &rel, 4);
+		}
+
+		void JmpTo(const byte* target) { size_t jump = Jmp(); Bind(jump, target); }
+		void JmpReg(int reg) { Rex(false, 0, -1, reg); Byte(0xFF); Byte(0xC0 | (4 << 3) | (reg & 7)); }
+
+		void Push(int reg) { Rex(false, 0, -1, reg); Byte(0x50 | (reg & 7)); }
+		void Pop(int reg) { Rex(false, 0, -1, reg); Byte(0x58 | (reg & 7)); }
+		void Ret() { Byte(0xC3); }
+
+		// Moves
+		void MovLoad8(int reg, const Mem& m) { Op(false, { 0x8A }, reg, m); }
+		void MovStore8(const Mem& m, int reg) { Op(false, { 0x88 }, reg, m); }
+		void MovStore16(const Mem& m, int reg) { Byte(0x66); Op(false, { 0x89 }, reg, m); }
+		void MovImm16(const Mem& m, int imm) { Byte(0x66); Op(false, { 0xC7 }, 0, m); Word(imm); }
+		void MovImm32(const Mem& m, int imm) { Op(false, { 0xC7 }, 0, m); Dword(imm); }
+		void MovLoad64(int reg, const Mem& m) { Op(true, { 0x8B }, reg, m); }
+		void MovRR32(int dst, int src) { OpRR(false, { 0x89 }, src, dst); }
+		void MovRR64(int dst, int src) { OpRR(true, { 0x89 }, src, dst); }
+		void MovRI8(int reg, int imm) { Byte(0xB0 | reg); Byte(imm); }
+		void MovRI64(int reg, const void* imm) { Rex(true, 0, -1, reg); Byte(0xB8 | (reg & 7)); Qword((qword)(size_t)imm); }
+		void MovzxLoad8(int reg, const Mem& m) { Op(false, { 0x0F, 0xB6 }, reg, m); }
+		void MovzxRR8(int dst, int src) { OpRR(false, { 0x0F, 0xB6 }, dst, src); }
+
+		// Arithmetic; 'ext' is the operation (ADD 0, OR 1, ADC 2, AND 4, SUB 5, XOR 6, CMP 7)
+		void Alu8RR(int ext, int dst, int src) { OpRR(false, { ext * 8 + 2 }, dst, src); }
+		void Alu8RI(int ext, int reg, int imm) { OpRR(false, { 0x80 }, ext, reg); Byte(imm); }
+		void Alu8MI(int ext, const Mem& m, int imm) { Op(false, { 0x80 }, ext, m); Byte(imm); }
+		void Alu8MR(int ext, const Mem& m, int reg) { Op(false, { ext * 8 }, reg, m); }
+		void Alu32RR(int ext, int dst, int src) { OpRR(false, { ext * 8 + 3 }, dst, src); }
+		void Alu32RI(int ext, int reg, int imm) { OpRR(false, { 0x81 }, ext, reg); Dword(imm); }
+		void Alu32RM(int ext, int reg, const Mem& m) { Op(false, { ext * 8 + 3 }, reg, m); }
+		void Alu32MR(int ext, const Mem& m, int reg) { Op(false, { ext * 8 + 1 }, reg, m); }
+		void Alu32MI(int ext, const Mem& m, int imm) { Op(false, { 0x81 }, ext, m); Dword(imm); }
+		void Alu64RR(int ext, int dst, int src) { OpRR(true, { ext * 8 + 3 }, dst, src); }
+
+		void Test8MI(const Mem& m, int imm) { Op(false, { 0xF6 }, 0, m); Byte(imm); }
+		void Test32RI(int reg, int imm) { OpRR(false, { 0xF7 }, 0, reg); Dword(imm); }
+		void Test64RR(int a, int b) { OpRR(true, { 0x85 }, b, a); }
+		void Bt32RI(int reg, int bit) { OpRR(false, { 0x0F, 0xBA }, 4, reg); Byte(bit); }
+		void SetCC(Cond cc, int reg) { OpRR(false, { 0x0F, 0x90 | cc }, 0, reg); }
+
+		// Unary and shifts; 'ext' as in the x86 group encodings
+		void Inc8M(const Mem& m) { Op(false, { 0xFE }, 0, m); }
+		void Dec8M(const Mem& m) { Op(false, { 0xFE }, 1, m); }
+		void Inc8R(int reg) { OpRR(false, { 0xFE }, 0, reg); }
+		void Dec8R(int reg) { OpRR(false, { 0xFE }, 1, reg); }
+		void Inc32R(int reg) { OpRR(false, { 0xFF }, 0, reg); }
+		void Not8R(int reg) { OpRR(false, { 0xF6 }, 2, reg); }
+		void Shl8RI(int reg, int n) { OpRR(false, { 0xC0 }, 4, reg); Byte(n); }
+		void Shr8RI(int reg, int n) { OpRR(false, { 0xC0 }, 5, reg); Byte(n); }
+		void Shl32RI(int reg, int n) { OpRR(false, { 0xC1 }, 4, reg); Byte(n); }
+		void Shr32RI(int reg, int n) { OpRR(false, { 0xC1 }, 5, reg); Byte(n); }
+
+	private:
+		byte* m_buffer;
+		size_t m_capacity;
+		size_t m_size = 0;
+		bool m_overflow = false;
+
+		// Byte registers are only ever al, cl or dl, so a REX prefix
+		// is needed for the extended registers and 64-bit operands only
+		void Rex(bool w, int reg, int index, int base)
+		{
+			int rex = (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index >= 0 && (index & 8)) ? 2 : 0) | ((base & 8) ? 1 : 0);
+
+			if (rex != 0)
+				Byte(0x40 | rex);
+		}
+
+		void Opcode(std::initializer_list<int> opcode)
+		{
+			for (int b : opcode)
+				Byte(b);
+		}
+
+		// Register, memory operand; always with a 32-bit displacement
+		void Op(bool w, std::initializer_list<int> opcode, int reg, const Mem& m)
+		{
+			Rex(w, reg, m.Index, m.Base);
+			Opcode(opcode);
+
+			if (m.Index >= 0 || (m.Base & 7) == RSP)
+			{
+				int scale = m.Scale == 8 ? 3 : (m.Scale == 4 ? 2 : (m.Scale == 2 ? 1 : 0));
+				Byte(0x84 | ((reg & 7) << 3));
+				Byte((scale << 6) | ((m.Index >= 0 ? m.Index & 7 : RSP) << 3) | (m.Base & 7));
+			}
+			else
+			{
+				Byte(0x80 | ((reg & 7) << 3) | (m.Base & 7));
+			}
+
+			Dword(m.Disp);
+		}
+
+		// Register, register
+		void OpRR(bool w, std::initializer_list<int> opcode, int reg, int rm)
+		{
+			Rex(w, reg, -1, rm);
+			Opcode(opcode);
+			Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+		}
+	};
+
+	// Status register bits
+	const int FLAG_C = 0x01;
+	const int FLAG_Z = 0x02;
+	const int FLAG_I = 0x04;
+	const int FLAG_D = 0x08;
+	const int FLAG_B = 0x10;
+	const int FLAG_U = 0x20;
+	const int FLAG_V = 0x40;
+	const int FLAG_N = 0x80;
+
+	// Executable memory for all compiled code
+	const size_t ARENA_SIZE = 8 * 1024 * 1024;
+}
+
+
+/**************************************************
+	Qk::MOS6502::JitCompiler::BlockCompiler
+***************************************************/
+
+// Generates the code for one block, instruction by instruction. Each
+// instruction's code first resolves its address, leaving through a side
+// exit if that isn't RAM or ROM; from there on it runs to completion.
+class MOS6502::JitCompiler::BlockCompiler
+{
+public:
+	BlockCompiler(Emitter& emitter, const Context& context, const byte* exit, const OpcodeInfo* opcodes, bool decimalMode, bool cmos)
+		: X(emitter), m_context(context), m_exit(exit), m_opcodes(opcodes), m_decimalMode(decimalMode), m_cmos(cmos) { }
+
+	// Returns the instruction's entry point, or nullptr if it's left to the
+	// handlers. If 'check' is set, the code before the entry point leaves
+	// when the cycle limit is reached.
+	const byte* Instruction(int index, word pc, byte opcode, word operand, bool check);
+
+	// Leave at instruction 'index'
+	void Exit(size_t jump, int index, word pc);
+
+	// End of block, after the last instruction; set PC unless it did
+	void Finish(int length, word pc, bool setPC);
+
+	// Code for all side exits
+	void EmitExits();
+
+private:
+	Emitter& X;
+	const Context& m_context;
+	const byte* m_exit;
+	const OpcodeInfo* m_opcodes;
+	bool m_decimalMode;
+	bool m_cmos;
+
+	enum Offsets : int
+	{
+		CTX_CYCLE_LIMIT = offsetof(Context, CycleLimit),
+		CTX_EXIT = offsetof(Context, Exit),
+		CTX_LAST_OPCODE = offsetof(Context, LastOpcode),
+		CTX_LAST_CYCLES = offsetof(Context, LastCycles),
+		CTX_READ_PAGES = offsetof(Context, ReadPages),
+		CTX_WRITE_PAGES = offsetof(Context, WritePages),
+		CTX_NZ = offsetof(Context, NZ),
+
+		REG_A = offsetof(RegisterFile, A),
+		REG_X = offsetof(RegisterFile, X),
+		REG_Y = offsetof(RegisterFile, Y),
+		REG_PC = offsetof(RegisterFile, PC),
+		REG_P = offsetof(RegisterFile, P),
+		REG_S = offsetof(RegisterFile, S)
+	};
+
+	struct SideExit
+	{
+		size_t Jump;
+		int Index;
+		word PC;
+	};
+
+	std::vector<SideExit> m_exits;
+
+	static Mem Register(int offset) { return At(RBX, offset); }
+	static Mem Field(int offset) { return At(R15, offset); }
+
+	void SetNZ(int reg);
+	void Push();
+	void Pull();
+	void LookUpPage(bool reads, bool writes, int index, word pc);
+};
+
+const byte* MOS6502::JitCompiler::BlockCompiler::Instruction(int index, word pc, byte opcode, word operand, bool check)
+{
+	const OpcodeInfo& info = m_opcodes[opcode];
+	const AddressingMode mode = info.Mode;
+	const Operation op = info.Op;
+
+	bool reads = false;
+	bool writes = false;
+	bool crossCycle = false;
+
+	// 65C02 additions are left to the handlers
+	if (op > Operation::SEI || mode == AddressingMode::ZPI || mode == AddressingMode::IAX)
+		return nullptr;
+
+	switch (op)
+	{
+	case Operation::BRK:
+	case Operation::RTI:
+		return nullptr;
+
+	case Operation::LDA: case Operation::LDX: case Operation::LDY:
+	case Operation::AND: case Operation::EOR: case Operation::ORA:
+	case Operation::ADC: case Operation::SBC: case Operation::CMP:
+		reads = true;
+		crossCycle = true;
+		break;
+
+	case Operation::BIT:
+		if (mode == AddressingMode::IMM || mode == AddressingMode::ABX)
+			return nullptr;
+		reads = true;
+		break;
+
+	case Operation::CPX: case Operation::CPY:
+		reads = true;
+		break;
+
+	case Operation::STA: case Operation::STX: case Operation::STY:
+		writes = true;
+		break;
+
+	case Operation::INC: case Operation::DEC:
+		if (mode == AddressingMode::ACC)
+			return nullptr;
+		reads = true;
+		writes = true;
+		break;
+
+	case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+		reads = true;
+		writes = true;
+		crossCycle = m_cmos;	// 65C02 abs,X
+		break;
+
+	case Operation::JMP:
+		if (mode == AddressingMode::IND)
+			return nullptr;
+		break;
+
+	default:
+		break;
+	}
+
+	// Stack must be direct memory
+	bool pushes = op == Operation::PHA || op == Operation::PHP || op == Operation::JSR;
+	bool pulls = op == Operation::PLA || op == Operation::PLP || op == Operation::RTS;
+
+	// Implied operands read as 0, like in the fused core (e.g. SBC on $EB)
+	if (mode == AddressingMode::IMP || mode == AddressingMode::IMM || mode == AddressingMode::ACC)
+		reads = writes = false;
+
+	if ((pushes && m_context.WritePages[0x01] == nullptr) || (pulls && m_context.ReadPages[0x01] == nullptr))
+		return nullptr;
+
+	// So must zero page pointers and indexing, and fixed addresses
+	byte* const* readPages = m_context.ReadPages;
+	byte* const* writePages = m_context.WritePages;
+	bool jumps = op == Operation::JMP || op == Operation::JSR;
+	word fixed = mode == AddressingMode::ABS ? operand : (operand & 0x00FF);
+
+	switch (mode)
+	{
+	case AddressingMode::ZP0:
+	case AddressingMode::ABS:
+		if (!jumps && ((reads && readPages[fixed >> 8] == nullptr) || (writes && writePages[fixed >> 8] == nullptr)))
+			return nullptr;
+		break;
+
+	case AddressingMode::ZPX:
+	case AddressingMode::ZPY:
+		if ((reads && readPages[0] == nullptr) || (writes && writePages[0] == nullptr))
+			return nullptr;
+		break;
+
+	case AddressingMode::IZX:
+	case AddressingMode::IZY:
+		if (readPages[0] == nullptr)
+			return nullptr;
+		break;
+
+	default:
+		break;
+	}
+
+	if (check)
+	{
+		X.Alu32RM(7, R14, Field(CTX_CYCLE_LIMIT));
+		Exit(X.Jcc(CC_GE), index, pc);
+	}
+
+	const byte* entry = X.Here();
+
+	// Resolve address: host memory to read from in rsi, to write to in
+	// rdi, and r10d set if indexing crossed a page
+	switch (mode)
+	{
+	case AddressingMode::ZP0:
+	case AddressingMode::ABS:
+		if (reads && !jumps)
+			X.MovRI64(RSI, readPages[fixed >> 8] + (fixed & 0x00FF));
+		if (writes && !jumps)
+			X.MovRI64(RDI, writePages[fixed >> 8] + (fixed & 0x00FF));
+		break;
+
+	case AddressingMode::ZPX:
+	case AddressingMode::ZPY:
+		X.MovzxLoad8(RCX, Register(mode == AddressingMode::ZPX ? REG_X : REG_Y));
+		X.Alu8RI(0, RCX, operand & 0x00FF);
+		X.MovzxRR8(RCX, RCX);
+
+		if (reads)
+		{
+			X.MovRI64(RSI, readPages[0]);
+			X.Alu64RR(0, RSI, RCX);
+		}
+
+		if (writes)
+		{
+			X.MovRI64(RDI, writePages[0]);
+			X.Alu64RR(0, RDI, RCX);
+		}
+		break;
+
+	case AddressingMode::ABX:
+	case AddressingMode::ABY:
+		X.MovzxLoad8(RCX, Register(mode == AddressingMode::ABX ? REG_X : REG_Y));
+		X.Alu32RI(0, RCX, operand);
+		X.Alu32RI(4, RCX, 0xFFFF);
+		X.MovRR32(RAX, RCX);
+		X.Alu32RI(6, RAX, operand);
+		X.Test32RI(RAX, 0xFF00);
+		X.SetCC(CC_NZ, RAX);
+		X.MovzxRR8(R10, RAX);
+		LookUpPage(reads, writes, index, pc);
+		break;
+
+	case AddressingMode::IZX:
+		X.MovRI64(RAX, readPages[0]);
+		X.MovzxLoad8(RCX, Register(REG_X));
+		X.Alu8RI(0, RCX, operand & 0x00FF);
+		X.MovzxRR8(RCX, RCX);
+		X.MovzxLoad8(RDX, At(RAX, RCX, 1, 0));
+		X.Inc8R(RCX);
+		X.MovzxRR8(RCX, RCX);
+		X.MovzxLoad8(RCX, At(RAX, RCX, 1, 0));
+		X.Shl32RI(RCX, 8);
+		X.Alu32RR(1, RCX, RDX);
+		LookUpPage(reads, writes, index, pc);
+		break;
+
+	case AddressingMode::IZY:
+		X.MovRI64(RAX, readPages[0]);
+		X.MovzxLoad8(RDX, At(RAX, operand & 0x00FF));
+		X.MovzxLoad8(RCX, At(RAX, (operand + 1) & 0x00FF));
+		X.Shl32RI(RCX, 8);
+		X.Alu32RR(1, RCX, RDX);
+		X.MovRR32(R8, RCX);
+		X.MovzxLoad8(RAX, Register(REG_Y));
+		X.Alu32RR(0, RCX, RAX);
+		X.Alu32RI(4, RCX, 0xFFFF);
+		X.Alu32RR(6, R8, RCX);
+		X.Test32RI(R8, 0xFF00);
+		X.SetCC(CC_NZ, RAX);
+		X.MovzxRR8(R10, RAX);
+		LookUpPage(reads, writes, index, pc);
+		break;
+
+	default:
+		break;
+	}
+
+	// Decimal mode arithmetic is left to the handlers
+	if (m_decimalMode && (op == Operation::ADC || op == Operation::SBC))
+	{
+		X.Test8MI(Register(REG_P), FLAG_D);
+		Exit(X.Jcc(CC_NZ), index, pc);
+	}
+
+	// No way back from here: account for the instruction
+	X.MovImm32(Field(CTX_LAST_OPCODE), opcode);
+	X.MovImm32(Field(CTX_LAST_CYCLES), info.BaseCycles);
+	X.Alu32RI(0, R14, info.BaseCycles);
+
+	if (crossCycle && (mode == AddressingMode::ABX || mode == AddressingMode::ABY || mode == AddressingMode::IZY))
+	{
+		X.Alu32MR(0, Field(CTX_LAST_CYCLES), R10);
+		X.Alu32RR(0, R14, R10);
+	}
+
+	// Operand into cl
+	auto fetch = [&]()
+	{
+		if (mode == AddressingMode::IMP)
+			X.MovRI8(RCX, 0x00);
+		else if (mode == AddressingMode::IMM)
+			X.MovRI8(RCX, operand & 0x00FF);
+		else if (mode == AddressingMode::ACC)
+			X.MovLoad8(RCX, Register(REG_A));
+		else
+			X.MovLoad8(RCX, At(RSI));
+	};
+
+	// Read-modify-write result from al
+	auto store = [&]()
+	{
+		if (mode == AddressingMode::ACC)
+			X.MovStore8(Register(REG_A), RAX);
+		else
+			X.MovStore8(At(RDI), RAX);
+	};
+
+	// Carry flag from cl
+	auto setCarry = [&]()
+	{
+		X.Alu8MI(4, Register(REG_P), ~FLAG_C & 0xFF);
+		X.Alu8MR(1, Register(REG_P), RCX);
+	};
+
+	auto registerFor = [&](Operation a, Operation x) -> int
+	{
+		return op == a ? REG_A : (op == x ? REG_X : REG_Y);
+	};
+
+	word next = pc + GetInstructionLength(mode);
+
+	// Do operation; same order as the fused core
+	switch (op)
+	{
+	case Operation::XXX:
+	case Operation::NOP:
+		break;
+
+	// Loads and stores
+	case Operation::LDA: case Operation::LDX: case Operation::LDY:
+		fetch();
+		X.MovStore8(Register(registerFor(Operation::LDA, Operation::LDX)), RCX);
+		SetNZ(RCX);
+		break;
+
+	case Operation::STA: case Operation::STX: case Operation::STY:
+		X.MovLoad8(RAX, Register(registerFor(Operation::STA, Operation::STX)));
+		X.MovStore8(At(RDI), RAX);
+		break;
+
+	// Transfers and stack
+	case Operation::TAX: X.MovLoad8(RAX, Register(REG_A)); X.MovStore8(Register(REG_X), RAX); SetNZ(RAX); break;
+	case Operation::TAY: X.MovLoad8(RAX, Register(REG_A)); X.MovStore8(Register(REG_Y), RAX); SetNZ(RAX); break;
+	case Operation::TXA: X.MovLoad8(RAX, Register(REG_X)); X.MovStore8(Register(REG_A), RAX); SetNZ(RAX); break;
+	case Operation::TYA: X.MovLoad8(RAX, Register(REG_Y)); X.MovStore8(Register(REG_A), RAX); SetNZ(RAX); break;
+	case Operation::TSX: X.MovLoad8(RAX, Register(REG_S)); X.MovStore8(Register(REG_X), RAX); SetNZ(RAX); break;
+	case Operation::TXS: X.MovLoad8(RAX, Register(REG_X)); X.MovStore8(Register(REG_S), RAX); break;
+
+	case Operation::PHA:
+		X.MovLoad8(RAX, Register(REG_A));
+		Push();
+		break;
+
+	case Operation::PHP:
+		X.Alu8MI(1, Register(REG_P), FLAG_B);
+		X.MovLoad8(RAX, Register(REG_P));
+		Push();
+		X.Alu8MI(4, Register(REG_P), ~FLAG_B & 0xFF);
+		break;
+
+	case Operation::PLA:
+		Pull();
+		X.MovStore8(Register(REG_A), RAX);
+		SetNZ(RAX);
+		break;
+
+	case Operation::PLP:
+		// Break flag is not pulled; expansion bit is always set
+		Pull();
+		X.Alu8RI(4, RAX, ~FLAG_B & 0xFF);
+		X.MovLoad8(RCX, Register(REG_P));
+		X.Alu8RI(4, RCX, FLAG_B);
+		X.Alu8RR(1, RAX, RCX);
+		X.Alu8RI(1, RAX, FLAG_U);
+		X.MovStore8(Register(REG_P), RAX);
+		break;
+
+	// Logic and arithmetic
+	case Operation::AND: case Operation::EOR: case Operation::ORA:
+		fetch();
+		X.MovLoad8(RAX, Register(REG_A));
+		X.Alu8RR(op == Operation::AND ? 4 : (op == Operation::EOR ? 6 : 1), RAX, RCX);
+		X.MovStore8(Register(REG_A), RAX);
+		SetNZ(RAX);
+		break;
+
+	case Operation::BIT:
+		fetch();
+		X.MovLoad8(RAX, Register(REG_A));
+		X.Alu8RR(4, RAX, RCX);
+		X.SetCC(CC_Z, RAX);
+		X.Shl8RI(RAX, 1);
+		X.MovLoad8(RDX, Register(REG_P));
+		X.Alu8RI(4, RDX, ~(FLAG_Z | FLAG_V | FLAG_N) & 0xFF);
+		X.Alu8RR(1, RDX, RAX);
+		X.Alu8RI(4, RCX, FLAG_V | FLAG_N);
+		X.Alu8RR(1, RDX, RCX);
+		X.MovStore8(Register(REG_P), RDX);
+		break;
+
+	case Operation::ADC: case Operation::SBC:
+		// Subtraction is addition of the inverted operand; host
+		// carry and overflow then are exactly the 6502's
+		fetch();
+
+		if (op == Operation::SBC)
+			X.Not8R(RCX);
+
+		X.MovLoad8(RAX, Register(REG_A));
+		X.MovzxLoad8(RDX, Register(REG_P));
+		X.Bt32RI(RDX, 0);
+		X.Alu8RR(2, RAX, RCX);
+		X.SetCC(CC_B, RCX);
+		X.SetCC(CC_O, RDX);
+		X.MovStore8(Register(REG_A), RAX);
+		X.Shl8RI(RDX, 6);
+		X.Alu8RR(1, RCX, RDX);
+		X.Alu8MI(4, Register(REG_P), ~(FLAG_C | FLAG_V) & 0xFF);
+		X.Alu8MR(1, Register(REG_P), RCX);
+		SetNZ(RAX);
+		break;
+
+	case Operation::CMP: case Operation::CPX: case Operation::CPY:
+		fetch();
+		X.MovLoad8(RAX, Register(registerFor(Operation::CMP, Operation::CPX)));
+		X.Alu8RR(5, RAX, RCX);
+		X.SetCC(CC_AE, RCX);
+		setCarry();
+		SetNZ(RAX);
+		break;
+
+	// Increments and decrements
+	case Operation::INC: case Operation::DEC:
+		X.MovLoad8(RAX, At(RSI));
+
+		if (op == Operation::INC)
+			X.Inc8R(RAX);
+		else
+			X.Dec8R(RAX);
+
+		store();
+		SetNZ(RAX);
+		break;
+
+	case Operation::INX: X.Inc8M(Register(REG_X)); X.MovLoad8(RAX, Register(REG_X)); SetNZ(RAX); break;
+	case Operation::INY: X.Inc8M(Register(REG_Y)); X.MovLoad8(RAX, Register(REG_Y)); SetNZ(RAX); break;
+	case Operation::DEX: X.Dec8M(Register(REG_X)); X.MovLoad8(RAX, Register(REG_X)); SetNZ(RAX); break;
+	case Operation::DEY: X.Dec8M(Register(REG_Y)); X.MovLoad8(RAX, Register(REG_Y)); SetNZ(RAX); break;
+
+	// Shifts and rotates: value in al, bit shifted out
+	// into cl, carry shifted in from dl
+	case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+	{
+		bool left = op == Operation::ASL || op == Operation::ROL;
+		bool rotate = op == Operation::ROL || op == Operation::ROR;
+
+		X.MovLoad8(RAX, mode == AddressingMode::ACC ? Register(REG_A) : At(RSI));
+		X.MovRR32(RCX, RAX);
+
+		if (left)
+			X.Shr8RI(RCX, 7);
+		else
+			X.Alu8RI(4, RCX, 0x01);
+
+		if (rotate)
+		{
+			X.MovLoad8(RDX, Register(REG_P));
+			X.Alu8RI(4, RDX, FLAG_C);
+
+			if (!left)
+				X.Shl8RI(RDX, 7);
+		}
+
+		if (left)
+			X.Shl8RI(RAX, 1);
+		else
+			X.Shr8RI(RAX, 1);
+
+		if (rotate)
+			X.Alu8RR(1, RAX, RDX);
+
+		setCarry();
+		store();
+		SetNZ(RAX);
+		break;
+	}
+
+	// Jumps and subroutines
+	case Operation::JMP:
+		X.MovImm16(Register(REG_PC), operand);
+		break;
+
+	case Operation::JSR:
+	{
+		word ret = next - 1;
+
+		X.MovRI8(RAX, (ret >> 8) & 0x00FF);
+		Push();
+		X.MovRI8(RAX, ret & 0x00FF);
+		Push();
+		X.MovImm16(Register(REG_PC), operand);
+		break;
+	}
+
+	case Operation::RTS:
+		Pull();
+		X.MovzxRR8(R8, RAX);
+		Pull();
+		X.MovzxRR8(RAX, RAX);
+		X.Shl32RI(RAX, 8);
+		X.Alu32RR(1, RAX, R8);
+		X.Inc32R(RAX);
+		X.MovStore16(Register(REG_PC), RAX);
+		break;
+
+	// Branches: additional cycle if branch succeeds, and
+	// another one in case of page boundary pass
+	case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+	case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS:
+	{
+		word target = next + (int)(signed char)(operand & 0x00FF);
+		int extra = (next & 0xFF00) != (target & 0xFF00) ? 2 : 1;
+
+		int flag = (op == Operation::BCC || op == Operation::BCS) ? FLAG_C
+			: (op == Operation::BEQ || op == Operation::BNE) ? FLAG_Z
+			: (op == Operation::BMI || op == Operation::BPL) ? FLAG_N : FLAG_V;
+		bool ifSet = op == Operation::BCS || op == Operation::BEQ || op == Operation::BMI || op == Operation::BVS;
+
+		X.MovImm16(Register(REG_PC), next);
+		X.Test8MI(Register(REG_P), flag);
+		size_t notTaken = X.Jcc(ifSet ? CC_Z : CC_NZ);
+		X.MovImm16(Register(REG_PC), target);
+		X.Alu32RI(0, R14, extra);
+		X.Alu32MI(0, Field(CTX_LAST_CYCLES), extra);
+		X.Bind(notTaken);
+		break;
+	}
+
+	// Flags
+	case Operation::CLC: X.Alu8MI(4, Register(REG_P), ~FLAG_C & 0xFF); break;
+	case Operation::CLD: X.Alu8MI(4, Register(REG_P), ~FLAG_D & 0xFF); break;
+	case Operation::CLI: X.Alu8MI(4, Register(REG_P), ~FLAG_I & 0xFF); break;
+	case Operation::CLV: X.Alu8MI(4, Register(REG_P), ~FLAG_V & 0xFF); break;
+	case Operation::SEC: X.Alu8MI(1, Register(REG_P), FLAG_C); break;
+	case Operation::SED: X.Alu8MI(1, Register(REG_P), FLAG_D); break;
+	case Operation::SEI: X.Alu8MI(1, Register(REG_P), FLAG_I); break;
+
+	default:
+		break;
+	}
+
+	return entry;
+}
+
+void MOS6502::JitCompiler::BlockCompiler::Exit(size_t jump, int index, word pc)
+{
+	m_exits.push_back({ jump, index, pc });
+}
+
+void MOS6502::JitCompiler::BlockCompiler::Finish(int length, word pc, bool setPC)
+{
+	if (setPC)
+		X.MovImm16(Register(REG_PC), pc);
+
+	X.MovImm32(Field(CTX_EXIT), length);
+	X.JmpTo(m_exit);
+}
+
+void MOS6502::JitCompiler::BlockCompiler::EmitExits()
+{
+	// Side exits: the handlers take over at that instruction
+	for (const SideExit& exit : m_exits)
+	{
+		X.Bind(exit.Jump);
+		X.MovImm32(Field(CTX_EXIT), exit.Index);
+		X.MovImm16(Register(REG_PC), exit.PC);
+		X.JmpTo(m_exit);
+	}
+}
+
+void MOS6502::JitCompiler::BlockCompiler::SetNZ(int reg)
+{
+	X.MovzxRR8(RAX, reg);
+	X.MovLoad8(RDX, At(R15, RAX, 1, CTX_NZ));
+	X.Alu8MI(4, Register(REG_P), ~(FLAG_N | FLAG_Z) & 0xFF);
+	X.Alu8MR(1, Register(REG_P), RDX);
+}
+
+void MOS6502::JitCompiler::BlockCompiler::Push()
+{
+	// Push al
+	X.MovzxLoad8(RCX, Register(REG_S));
+	X.MovRI64(RDX, m_context.WritePages[0x01]);
+	X.MovStore8(At(RDX, RCX, 1, 0), RAX);
+	X.Dec8M(Register(REG_S));
+}
+
+void MOS6502::JitCompiler::BlockCompiler::Pull()
+{
+	// Pull into al
+	X.Inc8M(Register(REG_S));
+	X.MovzxLoad8(RCX, Register(REG_S));
+	X.MovRI64(RDX, m_context.ReadPages[0x01]);
+	X.MovLoad8(RAX, At(RDX, RCX, 1, 0));
+}
+
+void MOS6502::JitCompiler::BlockCompiler::LookUpPage(bool reads, bool writes, int index, word pc)
+{
+	// Address in ecx, known at run time only: find its page in the
+	// page tables, leave if that isn't direct memory
+	X.MovRR32(RAX, RCX);
+	X.Shr32RI(RAX, 8);
+	X.MovzxRR8(R9, RCX);
+
+	if (reads)
+	{
+		X.MovLoad64(RSI, At(R15, RAX, 8, CTX_READ_PAGES));
+		X.Test64RR(RSI, RSI);
+		Exit(X.Jcc(CC_Z), index, pc);
+		X.Alu64RR(0, RSI, R9);
+	}
+
+	if (writes)
+	{
+		X.MovLoad64(RDI, At(R15, RAX, 8, CTX_WRITE_PAGES));
+		X.Test64RR(RDI, RDI);
+		Exit(X.Jcc(CC_Z), index, pc);
+		X.Alu64RR(0, RDI, R9);
+	}
+}
+
+
+/**************************************************
+	Qk::MOS6502::JitCompiler
+***************************************************/
+
+/*
+	Constructor, destructor
+*/
+
+MOS6502::JitCompiler::JitCompiler(RegisterFile& registers, const OpcodeInfo* opcodes, bool decimalMode, bool cmos)
+	: m_opcodes(opcodes), m_decimalMode(decimalMode), m_cmos(cmos)
+{
+	std::memset(&m_context, 0, sizeof(m_context));
+	m_context.Registers = &registers;
+
+	for (int value = 0; value < 256; value++)
+		m_context.NZ[value] = (value & FLAG_N) | (value == 0 ? FLAG_Z : 0);
+
+	// Executable, but never writable at the same time
+	void* arena = mmap(nullptr, ARENA_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (arena == MAP_FAILED)
+		throw QkError("Cannot allocate executable memory for the JIT core", 211);
+
+	m_arena = (byte*)arena;
+	m_arenaSize = ARENA_SIZE;
+
+	EmitTrampolines();
+}
+
+MOS6502::JitCompiler::~JitCompiler()
+{
+	munmap(m_arena, m_arenaSize);
+}
+
+
+/*
+	Internals
+*/
+
+void MOS6502::JitCompiler::EmitTrampolines()
+{
+	// int Enter(Context* context, int cycles, const byte* entry): save
+	// the registers compiled code keeps its state in, then jump to entry.
+	// Compiled code jumps to Exit when done.
+	SetWritable(true);
+
+	Emitter X(m_arena, m_arenaSize);
+
+	m_enter = reinterpret_cast<EnterFunc>(X.Here());
+	X.Push(RBX);
+	X.Push(R14);
+	X.Push(R15);
+	X.MovRR64(R15, RDI);
+	X.MovLoad64(RBX, At(R15, offsetof(Context, Registers)));
+	X.MovRR32(R14, RSI);
+	X.JmpReg(RDX);
+
+	m_exit = X.Here();
+	X.MovRR32(RAX, R14);
+	X.Pop(R15);
+	X.Pop(R14);
+	X.Pop(RBX);
+	X.Ret();
+
+	SetWritable(false);
+
+	m_trampolineSize = (X.Size() + 15) & ~(size_t)15;
+	m_arenaUsed = m_trampolineSize;
+}
+
+void MOS6502::JitCompiler::SetWritable(bool writable)
+{
+	// Hosts enforcing W^X (SELinux deny_execmem, PaX) may refuse either way
+	if (mprotect(m_arena, m_arenaSize, writable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC)) != 0)
+		throw QkError("Cannot change protection of the JIT core's code memory", 211);
+}
+
+
+/*
+	Public interface methods
+*/
+
+void MOS6502::JitCompiler::MapPages(const Bus& bus)
+{
+	m_writablePages.clear();
+
+	for (int p = 0; p < 256; p++)
+	{
+		m_context.ReadPages[p] = bus.GetDirectPage((word)(p << 8), false);
+		m_context.WritePages[p] = bus.GetDirectPage((word)(p << 8), true);
+
+		// Mirrors share host memory
+		byte* page = m_context.WritePages[p];
+
+		if (page != nullptr && std::find(m_writablePages.begin(), m_writablePages.end(), page) == m_writablePages.end())
+			m_writablePages.push_back(page);
+	}
+}
+
+const std::vector<byte*>& MOS6502::JitCompiler::GetWritablePages() const
+{
+	return m_writablePages;
+}
+
+bool MOS6502::JitCompiler::Compile(word address, const byte* opcodes, const word* operands, int length, const byte* entry[])
+{
+	SetWritable(true);
+
+	Emitter X(m_arena + m_arenaUsed, m_arenaSize - m_arenaUsed);
+	BlockCompiler compiler(X, m_context, m_exit, m_opcodes, m_decimalMode, m_cmos);
+
+	// Compiled instructions run straight on into the next one
+	word pc = address;
+	bool running = false;
+
+	for (int n = 0; n < length; n++)
+	{
+		entry[n] = compiler.Instruction(n, pc, opcodes[n], operands[n], running);
+
+		if (entry[n] == nullptr && running)
+			compiler.Exit(X.Jmp(), n, pc);
+
+		running = entry[n] != nullptr;
+		pc += GetInstructionLength(m_opcodes[opcodes[n]].Mode);
+	}
+
+	if (running)
+	{
+		// Jumps, returns and branches set PC themselves
+		Operation last = m_opcodes[opcodes[length - 1]].Op;
+		bool setPC = last != Operation::JMP && last != Operation::JSR && last != Operation::RTS
+			&& !(last >= Operation::BCC && last <= Operation::BVS);
+
+		compiler.Finish(length, pc, setPC);
+	}
+
+	compiler.EmitExits();
+
+	SetWritable(false);
+
+	if (X.Overflowed())
+		return false;
+
+	m_arenaUsed += (X.Size() + 15) & ~(size_t)15;
+	return true;
+}
+
+void MOS6502::JitCompiler::Reset()
+{
+	m_arenaUsed = m_trampolineSize;
+	m_epoch++;
+}
+
+dword MOS6502::JitCompiler::GetEpoch() const
+{
+	return m_epoch;
+}
+
+int MOS6502::JitCompiler::Run(const byte* entry, int cycles)
+{
+	return m_enter(&m_context, cycles, entry);
+}
+
+MOS6502::JitCompiler::Context& MOS6502::JitCompiler::GetContext()
+{
+	return m_context;
+}
+
+#endif
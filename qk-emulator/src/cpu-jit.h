@@ -0,0 +1,366 @@
+#pragma once
+
+// JIT core implementation. Templated on the memory access policy, like the
+// other cores; cpu-ops.h includes this file. The code generator itself
+// doesn't depend on the memory policy and lives in cpu-jit.cpp.
+//
+// Compiled code behaves exactly like the block core's handlers on the
+// instructions it runs. It only runs those that touch nothing but RAM and
+// ROM, which have no side effects beyond the memory itself; every other
+// instruction goes to the handlers, at the exact point it would have run.
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include "cpu.h"
+#include "cpu-blocks.h"
+
+#ifdef QK_JIT_AVAILABLE
+
+namespace Qk
+{
+	/**************************************************
+		Qk::MOS6502::JitCompiler
+	***************************************************/
+
+	class MOS6502::JitCompiler
+	{
+	public:
+		// State shared with compiled code
+		struct Context
+		{
+			RegisterFile* Registers;
+			int CycleLimit;		// No instruction but the first may start at or past this cycle count
+			int Exit;		// Index of the first instruction in the block not run
+			int LastOpcode;		// Last instruction run
+			int LastCycles;
+			byte* ReadPages[256];	// Direct memory of each bus page, or nullptr
+			byte* WritePages[256];
+			byte NZ[256];		// N and Z flags, for each value
+		};
+
+		// Compiles for one CPU variant: its opcode table, whether decimal
+		// mode must be left to the handlers, and whether it's a 65C02
+		JitCompiler(RegisterFile& registers, const OpcodeInfo* opcodes, bool decimalMode, bool cmos);
+		~JitCompiler();
+
+		// Take direct memory from the bus page table. Code compiled
+		// before the page table changed must not be run after.
+		void MapPages(const Bus& bus);
+
+		// Host memory of all RAM the CPU can write to, page by page
+		const std::vector<byte*>& GetWritablePages() const;
+
+		// Compile a block of 'length' decoded instructions starting at
+		// 'address'. Fills 'entry' with the native entry point of each
+		// instruction, or nullptr for those that must be left to the handlers.
+		// Returns false if the code arena is full.
+		bool Compile(word address, const byte* opcodes, const word* operands, int length, const byte* entry[]);
+
+		// Drop all compiled code, to make room
+		void Reset();
+		dword GetEpoch() const;
+
+		// Run compiled code from an entry point, up to the first instruction
+		// it won't run; 'cycles' is the CPU cycle count so far, including
+		// the instructions run before. Returns the cycle count after.
+		int Run(const byte* entry, int cycles);
+		Context& GetContext();
+
+	protected:
+		typedef int(*EnterFunc)(Context* context, int cycles, const byte* entry);
+
+		Context m_context;
+		const OpcodeInfo* m_opcodes;
+		bool m_decimalMode;
+		bool m_cmos;
+
+		// Executable memory: trampolines first, then compiled blocks
+		byte* m_arena = nullptr;
+		size_t m_arenaSize = 0;
+		size_t m_arenaUsed = 0;
+		size_t m_trampolineSize = 0;
+		dword m_epoch = 0;
+
+		EnterFunc m_enter = nullptr;
+		const byte* m_exit = nullptr;
+
+		std::vector<byte*> m_writablePages;
+
+		// Code generation for a single block, see cpu-jit.cpp
+		class BlockCompiler;
+
+		void EmitTrampolines();
+		void SetWritable(bool writable);
+	};
+
+
+	/**************************************************
+		Qk::MOS6502::JitCore
+	***************************************************/
+
+	/*
+		Constructor, destructor
+	*/
+
+	template <class Memory, class Variant>
+	MOS6502::JitCore<Memory, Variant>::JitCore(MOS6502& parent, Memory& memory, bool lockstep)
+		: BlockCore<Memory, Variant>(parent, memory), m_compiler(new JitCompiler(parent.Registers, Variant::Opcodes, Variant::DecimalMode, Variant::CMOS)),
+		m_compiled(new CompiledBlock[BlockCore<Memory, Variant>::CACHE_SIZE]()), m_pagesGeneration(parent.BUS.GetMappingGeneration()),
+		m_lockstep(lockstep)
+	{
+		m_compiler->MapPages(parent.BUS);
+	}
+
+	template <class Memory, class Variant>
+	MOS6502::JitCore<Memory, Variant>::~JitCore()
+	{
+
+	}
+
+	// Compile threshold (constexpr static members need one pre-C++17)
+	template <class Memory, class Variant>
+	constexpr int MOS6502::JitCore<Memory, Variant>::COMPILE_THRESHOLD;
+
+
+	/*
+		Running blocks
+	*/
+
+	template <class Memory, class Variant>
+	int MOS6502::JitCore<Memory, Variant>::ExecuteBlock(BlockHost& host)
+	{
+		return host.WatchesRegisters() ? RunBlocks<true>(host) : RunBlocks<false>(host);
+	}
+
+	template <class Memory, class Variant>
+	template <bool Watched>
+	int MOS6502::JitCore<Memory, Variant>::RunBlocks(BlockHost& host)
+	{
+		RegisterFile& R = this->CPU.Registers;
+		int cycles = 0;
+		typename BlockCore<Memory, Variant>::IdleWatch idle;
+
+		// Handlers keep N and Z lazily, like on the block core;
+		// compiled code and the fused core need them in P
+		this->LoadFlags(R);
+
+		for (;;)
+		{
+			const Block* block = this->Lookup(R.PC);
+
+			if (block == nullptr)
+			{
+				// Not ROM code; decode as we go
+				this->StoreFlags(R);
+				cycles += FusedCore<Memory, Variant>::ExecuteNextInstruction();
+				this->LoadFlags(R);
+				idle.Loop = nullptr;
+			}
+			else
+			{
+				const CompiledBlock* code = GetCompiled(*block);
+				this->WatchIdle(idle, *block, cycles);
+
+				for (int n = 0; ; )
+				{
+					int next = n;
+
+					if (code != nullptr && code->Entry[n] != nullptr)
+					{
+						this->StoreFlags(R);
+						next = m_lockstep
+							? RunLockstep(host, *block, code->Entry[n], n, cycles)
+							: RunCompiled(host, code->Entry[n], n, cycles);
+						this->LoadFlags(R);
+					}
+
+					// Compiled code stopped short of this one
+					if (next == n)
+					{
+						const typename BlockCore<Memory, Variant>::Instruction& instruction = block->Code[n];
+
+						this->m_opcode = instruction.Opcode;
+						this->m_cycles = instruction.Execute(*this, R, instruction.Operand);
+						cycles += this->m_cycles;
+						next++;
+					}
+
+					n = next;
+
+					if (n == block->Length)
+						break;
+
+					if (!this->template MayContinue<Watched>(host, cycles))
+						return cycles;
+				}
+
+				this->SkipIdle(host, idle, *block, cycles);
+			}
+
+			// On to the next block
+			if (!this->template MayContinue<Watched>(host, cycles))
+				return cycles;
+		}
+	}
+
+	template <class Memory, class Variant>
+	int MOS6502::JitCore<Memory, Variant>::RunCompiled(BlockHost& host, const byte* entry, int index, int& cycles)
+	{
+		// Instructions after the first only start while host
+		// wouldn't have anything to do in between anyway
+		JitCompiler::Context& context = m_compiler->GetContext();
+		context.CycleLimit = host.GetQuietCycles();
+
+		cycles = m_compiler->Run(entry, cycles);
+
+		if (context.Exit != index)
+		{
+			this->m_opcode = (byte)context.LastOpcode;
+			this->m_cycles = context.LastCycles;
+
+			if (context.Exit > index + 1)
+				host.QuietInstructionsRan(cycles - context.LastCycles);
+		}
+
+		return context.Exit;
+	}
+
+	template <class Memory, class Variant>
+	int MOS6502::JitCore<Memory, Variant>::RunLockstep(BlockHost& host, const Block& block, const byte* entry, int index, int& cycles)
+	{
+		// Run compiled code, then the same instructions on the fused core
+		// from the same state, and compare everything they can change
+		RegisterFile& R = this->CPU.Registers;
+		const RegisterFile before = R;
+		const int start = cycles;
+
+		SavePages(m_memoryBefore);
+
+		int exit = RunCompiled(host, entry, index, cycles);
+
+		if (exit == index)
+			return exit;
+
+		const RegisterFile compiled = R;
+		const byte compiledOpcode = this->m_opcode;
+		const int compiledCycles = this->m_cycles;
+		SavePages(m_memoryAfter);
+
+		R = before;
+		RestorePages(m_memoryBefore);
+
+		int expected = 0;
+
+		for (int n = index; n < exit; n++)
+			expected += FusedCore<Memory, Variant>::ExecuteNextInstruction();
+
+		SavePages(m_memoryBefore);
+
+		bool same = R.A == compiled.A && R.X == compiled.X && R.Y == compiled.Y
+			&& R.PC == compiled.PC && R.P == compiled.P && R.S == compiled.S
+			&& expected == cycles - start
+			&& this->m_opcode == compiledOpcode && this->m_cycles == compiledCycles
+			&& m_memoryBefore == m_memoryAfter;
+
+		if (!same)
+		{
+			word address = block.Start;
+
+			for (int n = 0; n < index; n++)
+				address += GetInstructionLength(Variant::Opcodes[block.Code[n].Opcode].Mode);
+
+			std::ostringstream message;
+			message << "JIT lockstep mismatch: compiled code starting at $"
+				<< std::hex << address << " differs from the fused core";
+
+			throw QkError(message.str().c_str(), 210);
+		}
+
+		return exit;
+	}
+
+	template <class Memory, class Variant>
+	void MOS6502::JitCore<Memory, Variant>::SavePages(std::vector<byte>& buffer) const
+	{
+		const std::vector<byte*>& pages = m_compiler->GetWritablePages();
+		buffer.resize(pages.size() * 256);
+
+		for (size_t p = 0; p < pages.size(); p++)
+			std::memcpy(&buffer[p * 256], pages[p], 256);
+	}
+
+	template <class Memory, class Variant>
+	void MOS6502::JitCore<Memory, Variant>::RestorePages(const std::vector<byte>& buffer)
+	{
+		const std::vector<byte*>& pages = m_compiler->GetWritablePages();
+
+		for (size_t p = 0; p < pages.size(); p++)
+			std::memcpy(pages[p], &buffer[p * 256], 256);
+	}
+
+
+	/*
+		Compiled code cache
+	*/
+
+	template <class Memory, class Variant>
+	const typename MOS6502::JitCore<Memory, Variant>::CompiledBlock* MOS6502::JitCore<Memory, Variant>::GetCompiled(const Block& block)
+	{
+		// Compiled code has direct memory addresses built in; like
+		// decoded blocks, it's only good for the mapping it was made for
+		dword generation = this->CPU.BUS.GetMappingGeneration();
+
+		if (generation != m_pagesGeneration)
+		{
+			m_compiler->MapPages(this->CPU.BUS);
+			m_pagesGeneration = generation;
+		}
+
+		CompiledBlock& code = m_compiled[block.Start % BlockCore<Memory, Variant>::CACHE_SIZE];
+		bool dropped = code.Runs > COMPILE_THRESHOLD && code.Epoch != m_compiler->GetEpoch();
+
+		if (code.Start != block.Start || code.Generation != block.Generation || dropped)
+		{
+			code.Generation = block.Generation;
+			code.Start = block.Start;
+			code.Runs = 0;
+		}
+
+		// Only blocks that run a few times are worth compiling
+		if (code.Runs < COMPILE_THRESHOLD)
+		{
+			code.Runs++;
+			return nullptr;
+		}
+
+		if (code.Runs == COMPILE_THRESHOLD)
+		{
+			byte opcodes[BlockCore<Memory, Variant>::MAX_BLOCK_LENGTH];
+			word operands[BlockCore<Memory, Variant>::MAX_BLOCK_LENGTH];
+
+			for (int n = 0; n < block.Length; n++)
+			{
+				opcodes[n] = block.Code[n].Opcode;
+				operands[n] = block.Code[n].Operand;
+			}
+
+			// Arena full: start over, with this block first
+			if (!m_compiler->Compile(block.Start, opcodes, operands, block.Length, code.Entry))
+			{
+				m_compiler->Reset();
+
+				if (!m_compiler->Compile(block.Start, opcodes, operands, block.Length, code.Entry))
+					std::fill(code.Entry, code.Entry + block.Length, nullptr);
+			}
+
+			code.Epoch = m_compiler->GetEpoch();
+			code.Runs++;
+		}
+
+		return &code;
+	}
+}
+
+#endif
@@ -0,0 +1,1401 @@
+#pragma once
+
+// Instruction handler implementation. Templated on the memory access
+// policy and the CPU variant, so include wherever a CPU core for a new
+// memory map is created.
+
+#include "cpu.h"
+#include "cpu-fused.h"
+#include "cpu-blocks.h"
+#include "cpu-jit.h"
+#include "util.h"
+
+namespace Qk
+{
+	/*
+		Constructors, destructor
+	*/
+
+	template <class Memory, class Variant>
+	MOS6502::InstructionHandler<Memory, Variant>::InstructionHandler(MOS6502& parent, Memory& memory) : CPU(parent), MEM(memory)
+	{
+
+	}
+
+	// Method table storage (constexpr static members need one pre-C++17)
+	template <class Memory, class Variant>
+	constexpr typename MOS6502::InstructionHandler<Memory, Variant>::FuncPtr MOS6502::InstructionHandler<Memory, Variant>::AddressingFunctions[];
+
+	template <class Memory, class Variant>
+	constexpr typename MOS6502::InstructionHandler<Memory, Variant>::FuncPtr MOS6502::InstructionHandler<Memory, Variant>::OperationFunctions[];
+
+	template <class Memory, class Variant>
+	MOS6502::TracedCore<Memory, Variant>::TracedCore(MOS6502& parent, Memory& memory)
+		: TracedMemory<Memory>(parent, memory), FusedCore<TracedMemory<Memory>, Variant>(parent, *this)
+	{
+
+	}
+
+	template <class Memory>
+	inline byte MOS6502::TracedMemory<Memory>::Read(word address)
+	{
+		byte value = m_memory.Read(address);
+		m_cpu.m_trace->RecordAccess(address, value, false);
+		return value;
+	}
+
+	template <class Memory>
+	inline void MOS6502::TracedMemory<Memory>::Write(word address, byte data)
+	{
+		m_cpu.m_trace->RecordAccess(address, data, true);
+		m_memory.Write(address, data);
+	}
+
+	template <class Variant, class Memory>
+	void MOS6502::UseMemoryMap(Memory& memory, CoreType core)
+	{
+		m_opcodes = Variant::Opcodes;
+		m_tracedHandler.reset(new TracedCore<Memory, Variant>(*this, memory));
+
+		if (m_trace != nullptr)
+			m_trace->SetCMOS(m_opcodes == OpcodeTable65C02);
+
+		if (m_profiler != nullptr)
+			m_profiler->SetCMOS(m_opcodes == OpcodeTable65C02);
+
+		if (m_callProfiler != nullptr)
+			m_callProfiler->SetCMOS(m_opcodes == OpcodeTable65C02);
+
+#ifdef QK_JIT_AVAILABLE
+		if (core == CoreType::JIT || core == CoreType::JITLockstep)
+			m_instructionHandler.reset(new JitCore<Memory, Variant>(*this, memory, core == CoreType::JITLockstep));
+		else if (core == CoreType::Block)
+#else
+		if (core == CoreType::Block || core == CoreType::JIT || core == CoreType::JITLockstep)
+#endif
+			m_instructionHandler.reset(new BlockCore<Memory, Variant>(*this, memory));
+		else if (core == CoreType::Fused)
+			m_instructionHandler.reset(new FusedCore<Memory, Variant>(*this, memory));
+		else
+			m_instructionHandler.reset(new InstructionHandler<Memory, Variant>(*this, memory));
+	}
+
+	/*
+		External interface methods
+	*/
+
+	template <class Memory, class Variant>
+	int MOS6502::InstructionHandler<Memory, Variant>::ExecuteNextInstruction()
+	{
+		// Clear cache variables
+		m_opcode = 0xEA; // Default to NOP
+		m_cacheAbsoluteWorkingAddress = 0;
+		m_cacheFetchedData = 0;
+		m_doFetch = true;
+		m_additionalCyclesNeeded = 0;
+		m_decimalCycle = false;
+
+		m_didIRQ = false;
+		m_didNMI = false;
+
+		// Read next opcode
+		m_opcode = ReadCode(CPU.Registers.PC++);
+		const OpcodeInfo& op = Variant::Opcodes[m_opcode];
+
+		// Resolve address
+		CallFuncPtr(AddressingFunctions[static_cast<int>(op.Mode)]);
+
+		// Do operation (including fetch)
+		CallFuncPtr(OperationFunctions[static_cast<int>(op.Op)]);
+
+		return InstructionHandler::GetLastInstructionCycles();
+	}
+
+	template <class Memory, class Variant>
+	byte MOS6502::InstructionHandler<Memory, Variant>::GetLastInstructionOpcode() const
+	{
+		return m_opcode;
+	}
+
+	template <class Memory, class Variant>
+	int MOS6502::InstructionHandler<Memory, Variant>::GetLastInstructionCycles() const
+	{
+		if (m_didIRQ)
+			return 7;
+		if (m_didNMI)
+			return 8;
+
+		int cycles = Variant::Opcodes[m_opcode].BaseCycles + (m_decimalCycle ? 1 : 0);
+		return m_additionalCyclesNeeded >= 2 ? (cycles + m_additionalCyclesNeeded - 1) : cycles;
+	}
+
+	template <class Memory, class Variant>
+	std::string MOS6502::InstructionHandler<Memory, Variant>::GetLastInstructionMnemonic() const
+	{
+		return std::string(Variant::Opcodes[m_opcode].Mnemonic);
+	}
+
+	template <class Memory, class Variant>
+	std::string MOS6502::InstructionHandler<Memory, Variant>::GetLastInstructionAddressingModeMnemonic() const
+	{
+		return std::string(AddressingModeMnemonics[static_cast<int>(Variant::Opcodes[m_opcode].Mode)]);
+	}
+
+
+	/*
+		Common functionality
+	*/
+
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CallFuncPtr(FuncPtr ptr)
+	{
+		(this->*ptr)();  // C++ member function pointer syntax is truly awful
+	}
+
+	template <class Memory, class Variant>
+	inline byte MOS6502::InstructionHandler<Memory, Variant>::Read(word address)
+	{
+		return MEM.Read(address);
+	}
+
+	template <class Memory, class Variant>
+	inline byte MOS6502::InstructionHandler<Memory, Variant>::ReadCode(word address)
+	{
+		// Opcode and operand bytes, through the CPU's fetch window
+		const byte* code = CPU.FetchWindow(address);
+
+		if (code != nullptr)
+			return *code;
+
+		return Read(address);
+	}
+
+	template <class Memory, class Variant>
+	inline void MOS6502::InstructionHandler<Memory, Variant>::Write(word address, byte data)
+	{
+		MEM.Write(address, data);
+	}
+
+	template <class Memory, class Variant>
+	byte MOS6502::InstructionHandler<Memory, Variant>::Fetch()
+	{
+		if (m_doFetch)
+		{
+			m_cacheFetchedData = Read(m_cacheAbsoluteWorkingAddress);
+		}
+
+		return m_cacheFetchedData;
+	}
+
+	/*
+		ADRESSING MODES
+	*/
+
+	// Implied
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IMP()
+	{
+		m_cacheFetchedData = 0;
+		m_doFetch = false;
+	}
+
+	// Immediate
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IMM()
+	{
+		m_cacheAbsoluteWorkingAddress = CPU.Registers.PC;
+		CPU.Registers.PC++;
+	}
+
+	// Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ACC()
+	{
+		m_cacheFetchedData = CPU.Registers.A;
+		m_doFetch = false;
+	}
+
+	// Zero page
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ZP0()
+	{
+		word address = ReadCode(CPU.Registers.PC++);
+		m_cacheAbsoluteWorkingAddress = address & 0x00FF;
+	}
+
+	// Zero page X
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ZPX()
+	{
+		word address = ReadCode(CPU.Registers.PC++);
+		m_cacheAbsoluteWorkingAddress = (address + CPU.Registers.X) & 0x00FF;
+	}
+
+	// Zero page Y
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ZPY()
+	{
+		word address = ReadCode(CPU.Registers.PC++);
+		m_cacheAbsoluteWorkingAddress = (address + CPU.Registers.Y) & 0x00FF;
+	}
+
+	// Relative
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::REL()
+	{
+		byte offset = ReadCode(CPU.Registers.PC++);
+
+		if (offset > 0x7F)
+			m_cacheAbsoluteWorkingAddress = CPU.Registers.PC - (128 - (offset & 0x7F));
+		else
+			m_cacheAbsoluteWorkingAddress = CPU.Registers.PC + offset;
+
+		// May require additional cycle
+		m_additionalCyclesNeeded++;
+	}
+
+	// Absolute
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ABS()
+	{
+		// Full 16-bit address is little-endian; read lsb first
+		word lowerByte = ReadCode(CPU.Registers.PC++);
+		word upperByte = ReadCode(CPU.Registers.PC++) << 8;
+		m_cacheAbsoluteWorkingAddress = upperByte | lowerByte;
+	}
+
+	// Absolute X
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ABX()
+	{
+		word lowerByte = ReadCode(CPU.Registers.PC++);
+		word upperByte = ReadCode(CPU.Registers.PC++) << 8;
+
+		m_cacheAbsoluteWorkingAddress = (upperByte | lowerByte) + CPU.Registers.X;
+
+		// Check if we pass page boundary; extra cpu cycle may be required
+		if ((m_cacheAbsoluteWorkingAddress & 0xFF00) != upperByte)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Absolute Y
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ABY()
+	{
+		word lowerByte = ReadCode(CPU.Registers.PC++);
+		word upperByte = ReadCode(CPU.Registers.PC++) << 8;
+
+		m_cacheAbsoluteWorkingAddress = (upperByte | lowerByte) + CPU.Registers.Y;
+
+		// Check if we pass page boundary; extra cpu cycle may be required
+		if ((m_cacheAbsoluteWorkingAddress & 0xFF00) != upperByte)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Indirect
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IND()
+	{
+		// Read indirect address
+		word ptrLowerByte = ReadCode(CPU.Registers.PC++);
+		word ptrUpperByte = ReadCode(CPU.Registers.PC++) << 8;
+		word ptrAddress = (ptrUpperByte | ptrLowerByte);
+
+		// An original 6502 does not correctly fetch the target address 
+		// if the indirect vector falls on a page boundary (e.g. $xxFF 
+		// where xx is any value from $00 to $FF). In this case fetches 
+		// the LSB from $xxFF as expected but takes the MSB from $xx00. 
+		// This is fixed in some later chips like the 65SC02 so for 
+		// compatibility always ensure the indirect vector is not at 
+		// the end of the page.
+		// 
+		// Use indirect address to read true address
+		// Chip has a hardware bug where crossing page boundary
+		// when reading second byte of 16-bit address causes wrap
+		// around to lowest value in current page. Emulate here,
+		// unless this is a CMOS chip
+		if (ptrLowerByte == 0x00FF && !Variant::CMOS) // Bug
+			m_cacheAbsoluteWorkingAddress = (Read(ptrAddress & 0xFF00) << 8) | Read(ptrAddress);
+		else // Ok!
+			m_cacheAbsoluteWorkingAddress = (Read(ptrAddress + 1) << 8) | Read(ptrAddress);
+	}
+
+	// Indexed indirect
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IZX()
+	{
+		word ptr = ReadCode(CPU.Registers.PC++) + CPU.Registers.X;
+
+		word lowerByte = Read(ptr & 0x00FF); // Only zero page addresses
+		word upperByte = Read((ptr + 1) & 0x00FF) << 8;
+
+		m_cacheAbsoluteWorkingAddress = upperByte | lowerByte;
+	}
+
+	// Indirect indexed
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IZY()
+	{
+		word ptr = ReadCode(CPU.Registers.PC++);
+
+		word lowerByte = Read(ptr & 0x00FF); // Only zero page addresses
+		word upperByte = Read((ptr + 1) & 0x00FF) << 8;
+
+		m_cacheAbsoluteWorkingAddress = (upperByte | lowerByte) + CPU.Registers.Y;
+
+		// Check if we pass page boundary; extra cpu cycle may be required
+		if ((m_cacheAbsoluteWorkingAddress & 0xFF00) != upperByte)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Zero page indirect
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ZPI()
+	{
+		word ptr = ReadCode(CPU.Registers.PC++);
+
+		word lowerByte = Read(ptr & 0x00FF); // Only zero page addresses
+		word upperByte = Read((ptr + 1) & 0x00FF) << 8;
+
+		m_cacheAbsoluteWorkingAddress = upperByte | lowerByte;
+	}
+
+	// Absolute indexed indirect
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IAX()
+	{
+		word lowerByte = ReadCode(CPU.Registers.PC++);
+		word upperByte = ReadCode(CPU.Registers.PC++) << 8;
+		word ptrAddress = (upperByte | lowerByte) + CPU.Registers.X;
+
+		// No page wrap bug here
+		m_cacheAbsoluteWorkingAddress = (Read(ptrAddress + 1) << 8) | Read(ptrAddress);
+	}
+
+	/*
+		SYSTEM INTERRUPTS
+	*/
+
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::IRQ()
+	{
+		if (!CPU.CheckFlag(Flag::InterruptDisable))
+		{
+			// Push PC onto stack
+			byte upperByte = (CPU.Registers.PC >> 8) & 0x00FF;
+			byte lowerByte = CPU.Registers.PC & 0x00FF;
+
+			Write(CPU.GetStackPointerAddress(), upperByte);
+			CPU.Registers.S--;
+			Write(CPU.GetStackPointerAddress(), lowerByte);
+			CPU.Registers.S--;
+
+			CPU.ClearFlag(Flag::Break);
+			CPU.SetFlag(Flag::InterruptDisable);
+
+			// Push P onto stack
+			Write(CPU.GetStackPointerAddress(), CPU.Registers.P);
+			CPU.Registers.S--;
+
+			// CMOS chips start handlers in binary mode
+			if (Variant::CMOS)
+				CPU.ClearFlag(Flag::DecimalMode);
+
+			// Load interrupt vector into PC
+			CPU.Registers.PC = ((word)Read(0xFFFF) << 8) | (word)Read(0xFFFE);
+
+			// Interrupt takes 7 cycles; set m_didNMI tot true
+			// to signal to cycle calculator 
+			m_didNMI = true;
+		}
+	}
+
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::NMI()
+	{
+		// Push PC onto stack
+		byte upperByte = (CPU.Registers.PC >> 8) & 0x00FF;
+		byte lowerByte = CPU.Registers.PC & 0x00FF;
+
+		Write(CPU.GetStackPointerAddress(), upperByte);
+		CPU.Registers.S--;
+		Write(CPU.GetStackPointerAddress(), lowerByte);
+		CPU.Registers.S--;
+
+		CPU.ClearFlag(Flag::Break);
+		CPU.SetFlag(Flag::InterruptDisable);
+
+		// Push P onto stack
+		Write(CPU.GetStackPointerAddress(), CPU.Registers.P);
+		CPU.Registers.S--;
+
+		if (Variant::CMOS)
+			CPU.ClearFlag(Flag::DecimalMode);
+
+		// Load interrupt vector into PC
+		CPU.Registers.PC = ((word)Read(0xFFFB) << 8) | (word)Read(0xFFFA);
+
+		// Interrupt takes 8 cycles; set m_didNMI tot true
+		// to signal to cycle calculator 
+		m_didNMI = true;
+	}
+
+
+	/*
+		INSTRUCTIONS
+
+		See https://www.obelisk.me.uk/6502/reference.html for implementation details
+	*/
+
+	// Unkown or uninmplemented opcode
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::XXX()
+	{
+		return;
+	}
+
+	// No op
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::NOP()
+	{
+		// TODO: some unnoficial/undocumented instructions
+		// are functionally NOPs, but some of them
+		// are not 1 byte instructions. Should emulate
+		// 2-byte unnofficial NOPs too at some point
+		// as some programs do use them
+
+		return;
+	}
+
+	// Force interrupt
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BRK()
+	{
+		// Manually increment PC, as BRK opcode is always followed by
+		// a padding  byte
+		CPU.Registers.PC++;
+
+		// Set interrupt flag
+		CPU.SetFlag(Flag::Break);
+
+		// Push PC onto stack
+		byte upperByte = (CPU.Registers.PC >> 8) & 0xFF00;
+		byte lowerByte = CPU.Registers.PC & 0x00FF;
+
+		Write(CPU.GetStackPointerAddress(), upperByte);
+		CPU.Registers.S--;
+		Write(CPU.GetStackPointerAddress(), lowerByte);
+		CPU.Registers.S--;
+
+		// Set Break flag
+		CPU.SetFlag(Flag::Break);
+
+		// Push P onto stack
+		Write(CPU.GetStackPointerAddress(), CPU.Registers.P);
+		CPU.Registers.S--;
+
+		// Clear Break flag
+		CPU.ClearFlag(Flag::Break);
+
+		if (Variant::CMOS)
+			CPU.ClearFlag(Flag::DecimalMode);
+
+		// Load interrupt vector into PC
+		CPU.Registers.PC = (word)Read(0xFFFE) | ((word)Read(0xFFFF) << 8);
+	}
+
+	// Return from interrupt
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::RTI()
+	{
+		// Pull processor status from stack
+		CPU.Registers.S++;
+		byte p = Read(CPU.GetStackPointerAddress());
+
+		// Discard the Break flag:
+		if (CPU.CheckFlag(Flag::Break))
+			p |= static_cast<int>(Flag::Break);
+		else
+			p &= ~static_cast<int>(Flag::Break);
+
+		CPU.Registers.P = p;
+
+		// Expansion bit is always set
+		CPU.SetFlag(Flag::Expansion);
+
+		// Pull PC from stack
+		CPU.Registers.S++;
+		word lowerByte = Read(CPU.GetStackPointerAddress());
+		CPU.Registers.S++;
+		word upperByte = Read(CPU.GetStackPointerAddress());
+		CPU.Registers.PC = (upperByte << 8) | lowerByte;
+	}
+
+	// Load A
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::LDA()
+	{
+		CPU.Registers.A = Fetch();
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.A & 0x80);
+		m_additionalCyclesNeeded++;
+	}
+	// Load X
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::LDX()
+	{
+		CPU.Registers.X = Fetch();
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.X & 0x80);
+		m_additionalCyclesNeeded++;
+	}
+
+	// Load Y
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::LDY()
+	{
+		CPU.Registers.Y = Fetch();
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.Y & 0x80);
+		m_additionalCyclesNeeded++;
+	}
+
+	// STA - Store Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::STA()
+	{
+		Write(m_cacheAbsoluteWorkingAddress, CPU.Registers.A);
+	}
+
+	// Store X Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::STX()
+	{
+		Write(m_cacheAbsoluteWorkingAddress, CPU.Registers.X);
+	}
+
+	// Store Y Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::STY()
+	{
+		Write(m_cacheAbsoluteWorkingAddress, CPU.Registers.Y);
+	}
+
+	// Transfer Accumulator to X
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TAX()
+	{
+		CPU.Registers.X = CPU.Registers.A;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.X & 0x80);
+	}
+
+	// Transfer Accumulator to Y
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TAY()
+	{
+		CPU.Registers.Y = CPU.Registers.A;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.Y & 0x80);
+	}
+
+	// Transfer X to Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TXA()
+	{
+		CPU.Registers.A = CPU.Registers.X;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.A & 0x80);
+	}
+
+	// Transfer Y to Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TYA()
+	{
+		CPU.Registers.A = CPU.Registers.Y;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.Y & 0x80);
+	}
+
+	// Transfer Stack Pointer to X
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TSX()
+	{
+		CPU.Registers.X = CPU.Registers.S;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.X & 0x80);
+	}
+
+	// Transfer X to Stack Pointer
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TXS()
+	{
+		CPU.Registers.S = CPU.Registers.X;
+	}
+
+	// Push Accumulator onto stack
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PHA()
+	{
+		Write(CPU.GetStackPointerAddress(), CPU.Registers.A);
+		CPU.Registers.S--;
+	}
+
+	// Push Processor Status (flags) onto stack
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PHP()
+	{
+		// Break and expansion flag set to 1 before push
+		CPU.SetFlag(Flag::Break);
+		Write(CPU.GetStackPointerAddress(), CPU.Registers.P);
+		CPU.Registers.S--;
+		CPU.ClearFlag(Flag::Break);
+	}
+
+	// Pull byte from stack into Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PLA()
+	{
+		CPU.Registers.S++;
+		CPU.Registers.A = Read(CPU.GetStackPointerAddress());
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.A & 0x80);
+	}
+
+	// Pull byte from stack into Processor Status register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PLP()
+	{
+		CPU.Registers.S++;
+		byte p = Read(CPU.GetStackPointerAddress());
+
+		// Discard the Break flag:
+		if (CPU.CheckFlag(Flag::Break))
+			p |= static_cast<int>(Flag::Break);
+		else
+			p &= ~static_cast<int>(Flag::Break);
+
+		CPU.Registers.P = p;
+
+		// Expansion bit is always set
+		CPU.SetFlag(Flag::Expansion);
+	}
+
+	// Logical AND on Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::AND()
+	{
+		CPU.Registers.A &= Fetch();
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.A & 0x80);
+
+		m_additionalCyclesNeeded++;
+	}
+
+	// Exclusive OR on Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::EOR()
+	{
+		CPU.Registers.A ^= Fetch();
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.A & 0x80);
+
+		m_additionalCyclesNeeded++;
+	}
+
+	// Logical Inclusive OR on Accumulator
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ORA()
+	{
+		CPU.Registers.A |= Fetch();
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.A & 0x80);
+
+		m_additionalCyclesNeeded++;
+	}
+
+	// Bit Test memory with contents of Accumulator as bitmask
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BIT()
+	{
+		byte data = Fetch();
+
+		// Set zero flag if the result if the AND is zero
+		CPU.SetFlag(Flag::Zero, (data & CPU.Registers.A) == 0);
+
+		// 65C02 immediate mode affects only the zero flag
+		if (Variant::Opcodes[m_opcode].Mode == AddressingMode::IMM)
+			return;
+
+		// 65C02 absolute X mode may require an additional cycle
+		m_additionalCyclesNeeded++;
+
+		// Set overflow flag to bit 6 of the memory value
+		CPU.SetFlag(Flag::Overflow, data & 0x40);
+		// Set negative flag to bit 7 of the memory value
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+	}
+
+	// Add with Carry (add memory value with carry bit to Acc)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ADC()
+	{
+		// This instruction is affected by Decimal mode
+		// See http://www.6502.org/tutorials/decimal_mode.html#3.2
+
+		if (!Variant::DecimalMode || !CPU.CheckFlag(Flag::DecimalMode)) // Binary Mode
+		{
+			// Store A value register var larger data type
+			word aval = CPU.Registers.A;
+			// Get value in memory
+			word value = Fetch();
+
+			// Add both values and the carry bit together and store in temporary var
+			word temp = aval + value + (CPU.CheckFlag(Flag::Carry) ? 0x01 : 0x00);
+
+			// Check for overflow into upper byte, set carry flag
+			CPU.SetFlag(Flag::Carry, (temp & 0xFF00) != 0);
+			// Set zero flag
+			CPU.SetFlag(Flag::Zero, (temp & 0x00FF) == 0);
+			// Set overflow flag
+			CPU.SetFlag(Flag::Overflow, (~(aval ^ value) & (aval ^ temp)) & 0x0080);
+			// Set Negative flag
+			CPU.SetFlag(Flag::Negative, temp & 0x0080);
+
+			// Save to actual Acc
+			CPU.Registers.A = temp & 0x00FF;
+		}
+		else // Decimal mode
+		{
+			// This is my half-assed attempt at implementing BCD addition/subtraction
+			// based on http://www.6502.org/tutorials/decimal_mode.html
+			// No idea if this works as it should
+
+			byte valueBCD = Fetch();
+			byte avalBCD = CPU.Registers.A;
+
+			// Lazy mode -- just convert to regular binary and add, then convert back to BCD
+			byte temp = Util::BCDtoBIN(avalBCD) + Util::BCDtoBIN(valueBCD) + (CPU.CheckFlag(Flag::Carry) ? 0x01 : 0x00);
+
+			byte resultBCD;
+			// valid range 0-99, wrap around in case of overflow
+			if (temp > 99)
+				resultBCD = Util::BINtoBCD((temp - 100) & 0x00FF);
+			else	
+				resultBCD = Util::BINtoBCD(temp & 0x00FF);
+
+			CPU.SetFlag(Flag::Carry, temp > 99);
+			CPU.SetFlag(Flag::Zero, resultBCD == 0);
+			CPU.SetFlag(Flag::Negative, resultBCD & 0x80);
+			// Overflow flag does not have well defined meaning in Decimal Mode
+			// So just clear it, w/e
+			CPU.ClearFlag(Flag::Overflow); 
+
+			CPU.Registers.A = resultBCD;
+
+			// The 65C02 takes one more to get the flags right
+			m_decimalCycle = Variant::CMOS;
+		}
+
+		// Extra cycle if this instruction is used in conjunction
+		// with certain addressing modes and page boundary is crossed
+		m_additionalCyclesNeeded++;
+	}
+
+	// Subtract with Carry
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::SBC()
+	{
+		// This instruction is affected by Decimal mode
+		// See http://www.6502.org/tutorials/decimal_mode.html#3.2
+
+		if (!Variant::DecimalMode || !CPU.CheckFlag(Flag::DecimalMode)) // Binary Mode
+		{
+			// Store A value register var larger data type
+			word aval = CPU.Registers.A;
+
+			// Get value in memory
+			word value = Fetch();
+			// Invert bottom byte of value
+			value ^= 0x00FF;
+
+			// Add both values and the carry bit together and store in temporary var
+			word temp = aval + value + (CPU.CheckFlag(Flag::Carry) ? 0x01 : 0x00);
+
+			// Check for overflow into upper byte, set carry flag
+			CPU.SetFlag(Flag::Carry, (temp & 0xFF00) != 0);
+			// Set zero flag
+			CPU.SetFlag(Flag::Zero, (temp & 0x00FF) == 0);
+			// Set overflow flag
+			CPU.SetFlag(Flag::Overflow, (~(aval ^ value) & (aval ^ temp)) & 0x0080);
+			// Set Negative flag
+			CPU.SetFlag(Flag::Negative, temp & 0x0080);
+
+			// Save to actual Acc
+			CPU.Registers.A = temp & 0x00FF;
+		}
+		else // Decimal mode
+		{
+			// This is my half-assed attempt at implementing BCD addition/subtraction
+			// based on http://www.6502.org/tutorials/decimal_mode.html
+			// No idea if this works as it should
+
+			byte valueBCD = Fetch();
+			byte avalBCD = CPU.Registers.A;
+
+			int temp = Util::BCDtoBIN(avalBCD) - Util::BCDtoBIN(valueBCD) - (CPU.CheckFlag(Flag::Carry) ? 0x00 : 0x01);
+
+			byte resultBCD;
+
+			// valid range 0-99, wrap around in case of overflow
+			if (temp < 0)
+				resultBCD = Util::BINtoBCD((99 + temp) & 0xFF);
+			else
+				resultBCD = Util::BINtoBCD(temp & 0xFF);
+
+			CPU.SetFlag(Flag::Carry, temp < 0);
+			CPU.SetFlag(Flag::Zero, resultBCD == 0);
+			CPU.SetFlag(Flag::Negative, resultBCD & 0x80);
+			CPU.ClearFlag(Flag::Overflow);
+
+			CPU.Registers.A = resultBCD;
+			m_decimalCycle = Variant::CMOS;
+		}
+
+		m_additionalCyclesNeeded++;
+	}
+
+	// Compare Accumulator with memory value
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CMP()
+	{
+		byte data = Fetch();
+
+		// Set carry flag if A >= data
+		CPU.SetFlag(Flag::Carry, CPU.Registers.A >= data);
+		// Set zero flag if A == data
+		CPU.SetFlag(Flag::Zero, CPU.Registers.A == data);
+		// Set negative flag to bit 7 of the sum
+		CPU.SetFlag(Flag::Negative, (CPU.Registers.A - data) & 0x80);
+
+		m_additionalCyclesNeeded++;
+	}
+
+	// Compare X with memory value
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CPX()
+	{
+		byte data = Fetch();
+
+		// Set carry flag if X >= data
+		CPU.SetFlag(Flag::Carry, CPU.Registers.X >= data);
+		// Set zero flag if X == data 
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == data);
+		// Set negative flag to bit 7 of the sum
+		CPU.SetFlag(Flag::Negative, (CPU.Registers.X - data) & 0x80);
+	}
+
+	// Compare Y with memory value
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CPY()
+	{
+		byte data = Fetch();
+
+		// Set carry flag if Y >= data
+		CPU.SetFlag(Flag::Carry, CPU.Registers.Y >= data);
+		// Set zero flag if Y == data 
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == data);
+		// Set negative flag to bit 7 of the sum
+		CPU.SetFlag(Flag::Negative, (CPU.Registers.Y - data) & 0x80);
+	}
+
+	// Increment Memory
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::INC()
+	{
+		byte data = Fetch();
+		data++;
+		CPU.SetFlag(Flag::Zero, data == 0);
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+
+		// 65C02 has an accumulator mode
+		if (!m_doFetch)
+			CPU.Registers.A = data;
+		else
+			Write(m_cacheAbsoluteWorkingAddress, data);
+	}
+
+	// Increment X Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::INX()
+	{
+		CPU.Registers.X++;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.X & 0x80);
+	}
+
+	// Increment Y Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::INY()
+	{
+		CPU.Registers.Y++;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.Y & 0x80);
+	}
+
+	// Decrement Memory
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::DEC()
+	{
+		byte data = Fetch();
+		data--;
+		CPU.SetFlag(Flag::Zero, data == 0);
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+
+		// 65C02 has an accumulator mode
+		if (!m_doFetch)
+			CPU.Registers.A = data;
+		else
+			Write(m_cacheAbsoluteWorkingAddress, data);
+	}
+
+	// Decrement X Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::DEX()
+	{
+		CPU.Registers.X--;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.X & 0x80);
+	}
+
+	// Decrement Y Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::DEY()
+	{
+		CPU.Registers.Y--;
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.Y & 0x80);
+	}
+
+	//Arithmetic Shift Left
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ASL()
+	{
+		byte data = Fetch();
+
+		// Old bit 7 should be shifted into carry flag
+		CPU.SetFlag(Flag::Carry, data & 0x80);
+
+		data = data << 1; // Shift left
+
+		// Set zero flag if result is zero
+		CPU.SetFlag(Flag::Zero, data == 0x00);
+		// Set negative flag if bit 7 is set
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+
+		// If m_doFetch is false, we can safely
+		// assume ACC addressing and target
+		// the accumulator register
+		if (!m_doFetch)
+			CPU.Registers.A = data;
+		else // Otherwise, target memory address on bus
+			Write(m_cacheAbsoluteWorkingAddress, data);
+
+		// 65C02 abs,X shifts take an extra cycle only when crossing a page
+		if (Variant::CMOS)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Logical Shift Right
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::LSR()
+	{
+		byte data = Fetch();
+
+		// Rightmost bit should be shifted into carry flag
+		CPU.SetFlag(Flag::Carry, data & 0x01);
+
+		data = data >> 1; // Shift right
+
+		// Set zero flag if result is zero
+		CPU.SetFlag(Flag::Zero, data == 0x00);
+		// Set negative flag if bit 7 is set
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+
+		// If m_doFetch is false, we can safely
+		// assume ACC addressing and target
+		// the accumulator register
+		if (!m_doFetch)
+			CPU.Registers.A = data;
+		else // Otherwise, target memory address on bus
+			Write(m_cacheAbsoluteWorkingAddress, data);
+
+		if (Variant::CMOS)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Rotate Left
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ROL()
+	{
+		byte data = Fetch();
+
+		// Store current carry flag
+		bool oldCarryFlag = CPU.CheckFlag(Flag::Carry);
+
+		// Bit 7 should be moved into carry flag
+		CPU.SetFlag(Flag::Carry, data & 0x80);
+
+		data = data << 1; // Shift left
+		data |= (oldCarryFlag ? 0x01 : 0x00); // Put old carry flag in bit 0
+
+		// Set zero flag if result is zero
+		CPU.SetFlag(Flag::Zero, data == 0x00);
+		// Set negative flag if bit 7 is set
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+
+		// If m_doFetch is false, we can safely
+		// assume ACC addressing and target
+		// the accumulator register
+		if (!m_doFetch)
+			CPU.Registers.A = data;
+		else // Otherwise, target memory address on bus
+			Write(m_cacheAbsoluteWorkingAddress, data);
+
+		if (Variant::CMOS)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Rotate Right
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::ROR()
+	{
+		byte data = Fetch();
+
+		// Store current carry flag
+		bool oldCarryFlag = CPU.CheckFlag(Flag::Carry);
+
+		// Bit 0 should be moved into carry flag
+		CPU.SetFlag(Flag::Carry, data & 0x01);
+
+		data = data >>  1; // Shift right
+		data |= (oldCarryFlag ? 0x80 : 0x00); // Put old carry flag in bit 7
+
+		// Set zero flag if result is zero
+		CPU.SetFlag(Flag::Zero, data == 0x00);
+		// Set negative flag if bit 7 is set
+		CPU.SetFlag(Flag::Negative, data & 0x80);
+
+		// If m_doFetch is false, we can safely
+		// assume ACC addressing and target
+		// the accumulator register
+		if (!m_doFetch)
+			CPU.Registers.A = data;
+		else // Otherwise, target memory address on bus
+			Write(m_cacheAbsoluteWorkingAddress, data);
+
+		if (Variant::CMOS)
+			m_additionalCyclesNeeded++;
+	}
+
+	// Jump (set PC to address specified)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::JMP()
+	{
+		CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+	}
+
+	// Jump to Subroutine
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::JSR()
+	{
+		// Push current PC - 1 to stack
+		CPU.Registers.PC--;
+		byte pcUpperByte = (CPU.Registers.PC >> 8) & 0x00FF;
+		byte pcLowerByte = CPU.Registers.PC & 0x00FF;
+
+		Write(CPU.GetStackPointerAddress(), pcUpperByte);
+		CPU.Registers.S--;
+		Write(CPU.GetStackPointerAddress(), pcLowerByte);
+		CPU.Registers.S--;
+
+		CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+	}
+
+	// Return from Subroutine
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::RTS()
+	{
+		// Pull current PC + 1 from stack
+		CPU.Registers.S++;
+		word pc = Read(CPU.GetStackPointerAddress());
+		CPU.Registers.S++;
+		pc |= (word)Read(CPU.GetStackPointerAddress()) << 8;
+
+		CPU.Registers.PC = pc + 1;
+	}
+
+	// Branch if Carry Clear
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BCC()
+	{
+		if (!CPU.CheckFlag(Flag::Carry))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Carry Set
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BCS()
+	{
+		if (CPU.CheckFlag(Flag::Carry))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Equal (Zero flag set)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BEQ()
+	{
+		if (CPU.CheckFlag(Flag::Zero))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Minus (Negative flag set)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BMI()
+	{
+		if (CPU.CheckFlag(Flag::Negative))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Not Equal (Zero flag is clear)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BNE()
+	{
+		if (!CPU.CheckFlag(Flag::Zero))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Positive (Negative flag is clear)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BPL()
+	{
+		if (!CPU.CheckFlag(Flag::Negative))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Overflow Clear
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BVC()
+	{
+		if (!CPU.CheckFlag(Flag::Overflow))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Branch if Overflow Set
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BVS()
+	{
+		if (CPU.CheckFlag(Flag::Overflow))
+		{
+			// Additional cycle if branch succeeds
+			m_additionalCyclesNeeded++;
+
+			// Additional cycle in case of page boundary pass
+			if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+				m_additionalCyclesNeeded++;
+
+			CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+		}
+	}
+
+	// Clear Carry Flag
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CLC()
+	{
+		CPU.ClearFlag(Flag::Carry);
+	}
+
+	// Clear Decimal Mode
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CLD()
+	{
+		CPU.ClearFlag(Flag::DecimalMode);
+	}
+
+	// Clear Interrupt Disable
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CLI()
+	{
+		CPU.ClearFlag(Flag::InterruptDisable);
+	}
+
+	// Clear Overflow Flag
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::CLV()
+	{
+		CPU.ClearFlag(Flag::Overflow);
+	}
+
+	// Set Carry Flag
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::SEC()
+	{
+		CPU.SetFlag(Flag::Carry);
+	}
+
+	// Set Decimal Mode
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::SED()
+	{
+		CPU.SetFlag(Flag::DecimalMode);
+	}
+
+	// Set Interrupt Disable
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::SEI()
+	{
+		CPU.SetFlag(Flag::InterruptDisable);
+	}
+
+	/*
+		65C02 INSTRUCTIONS
+	*/
+
+	// Branch Always
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::BRA()
+	{
+		// Additional cycle, as branch always succeeds
+		m_additionalCyclesNeeded++;
+
+		// Additional cycle in case of page boundary pass
+		if ((CPU.Registers.PC & 0xFF00) != (m_cacheAbsoluteWorkingAddress & 0xFF00))
+			m_additionalCyclesNeeded++;
+
+		CPU.Registers.PC = m_cacheAbsoluteWorkingAddress;
+	}
+
+	// Push X Register onto stack
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PHX()
+	{
+		Write(CPU.GetStackPointerAddress(), CPU.Registers.X);
+		CPU.Registers.S--;
+	}
+
+	// Push Y Register onto stack
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PHY()
+	{
+		Write(CPU.GetStackPointerAddress(), CPU.Registers.Y);
+		CPU.Registers.S--;
+	}
+
+	// Pull byte from stack into X Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PLX()
+	{
+		CPU.Registers.S++;
+		CPU.Registers.X = Read(CPU.GetStackPointerAddress());
+		CPU.SetFlag(Flag::Zero, CPU.Registers.X == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.X & 0x80);
+	}
+
+	// Pull byte from stack into Y Register
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::PLY()
+	{
+		CPU.Registers.S++;
+		CPU.Registers.Y = Read(CPU.GetStackPointerAddress());
+		CPU.SetFlag(Flag::Zero, CPU.Registers.Y == 0);
+		CPU.SetFlag(Flag::Negative, CPU.Registers.Y & 0x80);
+	}
+
+	// Store Zero
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::STZ()
+	{
+		Write(m_cacheAbsoluteWorkingAddress, 0x00);
+	}
+
+	// Test and Reset Bits (clear bits set in A)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TRB()
+	{
+		byte data = Fetch();
+		CPU.SetFlag(Flag::Zero, (data & CPU.Registers.A) == 0);
+		Write(m_cacheAbsoluteWorkingAddress, data & ~CPU.Registers.A);
+	}
+
+	// Test and Set Bits (set bits set in A)
+	template <class Memory, class Variant>
+	void MOS6502::InstructionHandler<Memory, Variant>::TSB()
+	{
+		byte data = Fetch();
+		CPU.SetFlag(Flag::Zero, (data & CPU.Registers.A) == 0);
+		Write(m_cacheAbsoluteWorkingAddress, data | CPU.Registers.A);
+	}
+}
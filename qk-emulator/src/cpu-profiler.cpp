@@ -0,0 +1,198 @@
+#include <iomanip>
+#include "cpu-profiler.h"
+#include "cpu-trace.h"
+#include "cpu.h"
+
+
+using namespace Qk;
+
+
+/*
+	Constructor
+*/
+
+CPUProfiler::CPUProfiler()
+{
+	SetCMOS(false);
+}
+
+
+/*
+	Public interface methods
+*/
+
+void CPUProfiler::SetCMOS(bool cmos)
+{
+	using OP = MOS6502::Operation;
+
+	m_cmos = cmos;
+
+	for (int n = 0; n < 256; n++)
+	{
+		const MOS6502::OpcodeInfo& info = (cmos ? MOS6502::OpcodeTable65C02 : MOS6502::OpcodeTable)[n];
+
+		m_timing[n].BaseCycles = (byte)info.BaseCycles;
+		m_timing[n].Mode = (byte)info.Mode;
+		m_timing[n].Branch = info.Op == OP::BCC || info.Op == OP::BCS || info.Op == OP::BEQ || info.Op == OP::BMI
+			|| info.Op == OP::BNE || info.Op == OP::BPL || info.Op == OP::BVC || info.Op == OP::BVS || info.Op == OP::BRA;
+	}
+}
+
+void CPUProfiler::Reset()
+{
+	for (Counter& counter : m_pc)
+		counter = Counter();
+
+	for (OpcodeCounter& counter : m_opcodes)
+		counter = OpcodeCounter();
+
+	for (OpcodeCounter& counter : m_modes)
+		counter = OpcodeCounter();
+
+	m_interrupts = Counter();
+	m_total = Counter();
+}
+
+
+/*
+	Output
+*/
+
+void CPUProfiler::WriteCSVHeader(std::ostream& out, bool frames)
+{
+	if (frames)
+		out << "frame,";
+
+	out << "table,key,name,count,cycles,page_crosses,branches_taken,branches_not_taken\n";
+}
+
+void CPUProfiler::WriteCSV(std::ostream& out, long long frame) const
+{
+	auto row = [&](const char* table, int key, int digits, const char* name, const Counter& counter)
+	{
+		if (frame >= 0)
+			out << std::dec << frame << ",";
+
+		out << table << ",";
+
+		if (key >= 0)
+			out << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << key;
+
+		out << std::dec << "," << name << "," << counter.Count << "," << counter.Cycles;
+	};
+
+	auto opcodeRow = [&](const char* table, int key, int digits, const char* name, const OpcodeCounter& counter)
+	{
+		row(table, key, digits, name, counter);
+		out << "," << counter.PageCrosses << "," << counter.BranchesTaken << "," << counter.BranchesNotTaken << "\n";
+	};
+
+	row("total", -1, 0, "", m_total);
+	out << ",,,\n";
+
+	if (m_interrupts.Count > 0)
+	{
+		row("interrupt", -1, 0, "", m_interrupts);
+		out << ",,,\n";
+	}
+
+	for (int n = 0; n < MODE_COUNT; n++)
+	{
+		if (m_modes[n].Count > 0)
+			opcodeRow("mode", -1, 0, MOS6502::AddressingModeMnemonics[n], m_modes[n]);
+	}
+
+	for (int n = 0; n < 256; n++)
+	{
+		if (m_opcodes[n].Count > 0)
+			opcodeRow("opcode", n, 2, CPUTrace::GetMnemonic((byte)n, m_cmos), m_opcodes[n]);
+	}
+
+	for (int n = 0; n < 0x10000; n++)
+	{
+		if (m_pc[n].Count > 0)
+		{
+			row("pc", n, 4, "", m_pc[n]);
+			out << ",,,\n";
+		}
+	}
+}
+
+void CPUProfiler::WriteJSON(std::ostream& out, long long frame) const
+{
+	auto counter = [&](const Counter& c)
+	{
+		out << "\"count\": " << c.Count << ", \"cycles\": " << c.Cycles;
+	};
+
+	auto opcodeCounter = [&](const OpcodeCounter& c)
+	{
+		counter(c);
+		out << ", \"page_crosses\": " << c.PageCrosses
+			<< ", \"branches_taken\": " << c.BranchesTaken
+			<< ", \"branches_not_taken\": " << c.BranchesNotTaken;
+	};
+
+	auto hex = [&](int value, int digits)
+	{
+		out << "\"" << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << value << std::dec << "\"";
+	};
+
+	out << "{";
+
+	if (frame >= 0)
+		out << "\"frame\": " << frame << ", ";
+
+	out << "\"total\": {";
+	counter(m_total);
+	out << "}, \"interrupts\": {";
+	counter(m_interrupts);
+	out << "},\n \"modes\": [";
+
+	const char* separator = "\n  ";
+
+	for (int n = 0; n < MODE_COUNT; n++)
+	{
+		if (m_modes[n].Count == 0)
+			continue;
+
+		out << separator << "{\"mode\": \"" << MOS6502::AddressingModeMnemonics[n] << "\", ";
+		opcodeCounter(m_modes[n]);
+		out << "}";
+		separator = ",\n  ";
+	}
+
+	out << "],\n \"opcodes\": [";
+	separator = "\n  ";
+
+	for (int n = 0; n < 256; n++)
+	{
+		if (m_opcodes[n].Count == 0)
+			continue;
+
+		out << separator << "{\"opcode\": ";
+		hex(n, 2);
+		out << ", \"mnemonic\": \"" << CPUTrace::GetMnemonic((byte)n, m_cmos) << "\", ";
+		opcodeCounter(m_opcodes[n]);
+		out << "}";
+		separator = ",\n  ";
+	}
+
+	out << "],\n \"pc\": [";
+	separator = "\n  ";
+
+	for (int n = 0; n < 0x10000; n++)
+	{
+		if (m_pc[n].Count == 0)
+			continue;
+
+		out << separator << "{\"pc\": ";
+		hex(n, 4);
+		out << ", ";
+		counter(m_pc[n]);
+		out << "}";
+		separator = ",\n  ";
+	}
+
+	out << "]}";
+}
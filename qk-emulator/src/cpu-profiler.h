@@ -0,0 +1,135 @@
+#pragma once
+
+#include <ostream>
+#include "definitions.h"
+
+
+namespace Qk
+{
+	/*
+		CPU execution profiler: cycle-weighted histograms of where guest code
+		spends its time, by PC, by opcode and by addressing mode, with page
+		crossing penalties and branches taken. Attach one with
+		MOS6502::SetProfiler; detached, it costs nothing.
+
+		PCs are CPU addresses: code in different banks at the same address
+		counts as one.
+	*/
+
+	class CPUProfiler
+	{
+	public:
+		struct Counter
+		{
+			qword Count = 0;
+			qword Cycles = 0;
+		};
+
+		struct OpcodeCounter : Counter
+		{
+			qword PageCrosses = 0;		// Indexed reads and branches that took an extra cycle
+			qword BranchesTaken = 0;	// Branches only
+			qword BranchesNotTaken = 0;
+		};
+
+		static constexpr int MODE_COUNT = 15;
+
+	public:
+		CPUProfiler();
+
+		// Opcode table for names and timing; set by MOS6502::SetProfiler
+		void SetCMOS(bool cmos);
+
+		// Start over, e.g. at the start of each frame
+		void Reset();
+
+		// Filled by the CPU: one instruction, starting at pc, or an
+		// interrupt sequence
+		void RecordInstruction(word pc, byte opcode, int cycles);
+		void RecordInterrupt(int cycles);
+
+		const Counter& GetPC(word pc) const { return m_pc[pc]; }
+		const OpcodeCounter& GetOpcode(byte opcode) const { return m_opcodes[opcode]; }
+		const OpcodeCounter& GetMode(int mode) const { return m_modes[mode]; }
+		const Counter& GetInterrupts() const { return m_interrupts; }
+		const Counter& GetTotal() const { return m_total; }
+
+		// Everything counted since the last reset, non-zero entries only.
+		// CSV has one row per entry, starting with 'frame' (-1: leave the
+		// column out); JSON is one object.
+		static void WriteCSVHeader(std::ostream& out, bool frames);
+		void WriteCSV(std::ostream& out, long long frame) const;
+		void WriteJSON(std::ostream& out, long long frame) const;
+
+	protected:
+		Counter m_pc[0x10000];
+		OpcodeCounter m_opcodes[256];
+		OpcodeCounter m_modes[MODE_COUNT];
+		Counter m_interrupts;
+		Counter m_total;
+		bool m_cmos = false;
+
+		// Per opcode, from the opcode table
+		struct Timing
+		{
+			byte BaseCycles;
+			byte Mode;
+			bool Branch;
+		} m_timing[256];
+	};
+
+
+	/*
+		Recording -- inline, as it runs for every instruction profiled
+	*/
+
+	inline void CPUProfiler::RecordInstruction(word pc, byte opcode, int cycles)
+	{
+		const Timing& timing = m_timing[opcode];
+		OpcodeCounter& op = m_opcodes[opcode];
+		OpcodeCounter& mode = m_modes[timing.Mode];
+
+		m_pc[pc].Count++;
+		m_pc[pc].Cycles += cycles;
+		op.Count++;
+		op.Cycles += cycles;
+		mode.Count++;
+		mode.Cycles += cycles;
+		m_total.Count++;
+		m_total.Cycles += cycles;
+
+		// Cycles beyond the opcode's base count tell what happened: branches
+		// take one more if taken, two if that crossed a page; indexed reads
+		// take one more if indexing crossed a page
+		int extra = cycles - timing.BaseCycles;
+
+		if (timing.Branch)
+		{
+			if (extra > 0)
+			{
+				op.BranchesTaken++;
+				mode.BranchesTaken++;
+			}
+			else
+			{
+				op.BranchesNotTaken++;
+				mode.BranchesNotTaken++;
+			}
+
+			extra--;
+		}
+
+		if (extra > 0)
+		{
+			op.PageCrosses++;
+			mode.PageCrosses++;
+		}
+	}
+
+	inline void CPUProfiler::RecordInterrupt(int cycles)
+	{
+		m_interrupts.Count++;
+		m_interrupts.Cycles += cycles;
+		m_total.Cycles += cycles;
+	}
+}
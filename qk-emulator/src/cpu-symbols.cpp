@@ -0,0 +1,208 @@
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include "cpu-symbols.h"
+
+
+using namespace Qk;
+
+
+/*
+	Helpers
+*/
+
+static bool IsNameChar(char c)
+{
+	return std::isalnum((unsigned char)c) || c == '_' || c == '@' || c == '.' || c == ':';
+}
+
+// Hex number at text[pos], with an optional $ or 0x in front; pos is
+// moved past it. Returns -1 if there is none.
+static long ParseHex(const std::string& text, std::size_t& pos)
+{
+	std::size_t start = pos;
+
+	if (text.compare(pos, 1, "$") == 0)
+		pos += 1;
+	else if (text.compare(pos, 2, "0x") == 0 || text.compare(pos, 2, "0X") == 0)
+		pos += 2;
+
+	std::size_t digits = pos;
+
+	while (pos < text.size() && std::isxdigit((unsigned char)text[pos]))
+		pos++;
+
+	if (pos == digits)
+	{
+		pos = start;
+		return -1;
+	}
+
+	return std::strtol(text.substr(digits, pos - digits).c_str(), nullptr, 16);
+}
+
+
+/*
+	Public interface methods
+*/
+
+int SymbolTable::Load(const std::string& path)
+{
+	std::ifstream file(path);
+
+	if (!file)
+		throw QkError("Cannot open symbol file", 230);
+
+	std::string line;
+	int count = 0;
+
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		count += ParseLine(line) ? 1 : 0;
+	}
+
+	return count;
+}
+
+void SymbolTable::Add(word address, const std::string& name)
+{
+	// First name for an address wins: files list labels before locals
+	m_names.emplace(address, name);
+}
+
+const std::string* SymbolTable::Find(word address) const
+{
+	auto it = m_names.find(address);
+	return it != m_names.end() ? &it->second : nullptr;
+}
+
+std::size_t SymbolTable::GetSize() const
+{
+	return m_names.size();
+}
+
+
+/*
+	Parsing
+*/
+
+bool SymbolTable::ParseLine(const std::string& line)
+{
+	// ca65 debug info: labels only, not constants
+	if (line.compare(0, 4, "sym\t") == 0 || line.compare(0, 4, "sym ") == 0)
+	{
+		std::size_t name = line.find("name=\"");
+		std::size_t value = line.find("val=0x");
+
+		if (name == std::string::npos || value == std::string::npos || line.find("type=lab") == std::string::npos)
+			return false;
+
+		name += 6;
+		value += 4;
+		std::size_t end = line.find('"', name);
+		long address = ParseHex(line, value);
+
+		if (end == std::string::npos || address < 0 || address > 0xFFFF)
+			return false;
+
+		Add((word)address, line.substr(name, end - name));
+		return true;
+	}
+
+	// VICE: al [C:]<address> .<name>
+	if (line.compare(0, 3, "al ") == 0)
+	{
+		std::size_t pos = line.find_first_not_of(' ', 3);
+
+		if (pos != std::string::npos && line.compare(pos, 2, "C:") == 0)
+			pos += 2;
+
+		long address = pos != std::string::npos ? ParseHex(line, pos) : -1;
+		std::size_t name = line.find('.', pos);
+
+		if (address < 0 || name == std::string::npos || name + 1 >= line.size())
+			return false;
+
+		Add((word)(address & 0xFFFF), line.substr(name + 1));
+		return true;
+	}
+
+	// FCEUX: $<address>#<name>#<comment>
+	if (line.compare(0, 1, "$") == 0 && line.find('#') != std::string::npos)
+	{
+		std::size_t pos = 0;
+		long address = ParseHex(line, pos);
+		std::size_t end = line.find('#', pos + 1);
+
+		if (address < 0 || address > 0xFFFF || pos >= line.size() || line[pos] != '#' || end == std::string::npos || end == pos + 1)
+			return false;
+
+		Add((word)address, line.substr(pos + 1, end - pos - 1));
+		return true;
+	}
+
+	// Plain: a name and an address, either way round, comments after ';'
+	std::string text = line.substr(0, line.find(';'));
+	std::size_t pos = text.find_first_not_of(" \t");
+
+	if (pos == std::string::npos)
+		return false;
+
+	// "<name> = $<address>"
+	std::size_t equals = text.find('=');
+
+	if (equals != std::string::npos)
+	{
+		std::size_t end = text.find_last_not_of(" \t", equals - 1);
+		std::size_t value = text.find_first_not_of(" \t", equals + 1);
+
+		if (end == std::string::npos || end < pos || value == std::string::npos)
+			return false;
+
+		long address = ParseHex(text, value);
+
+		if (address < 0 || address > 0xFFFF)
+			return false;
+
+		Add((word)address, text.substr(pos, end - pos + 1));
+		return true;
+	}
+
+	// "[<bank>:]<address> <name>"
+	std::size_t start = pos;
+	long address = ParseHex(text, pos);
+
+	if (address < 0)
+		return false;
+
+	if (pos < text.size() && text[pos] == ':')
+	{
+		pos++;
+		address = ParseHex(text, pos);
+
+		if (address < 0)
+			return false;
+	}
+
+	if (address > 0xFFFF || pos == start || pos >= text.size() || (text[pos] != ' ' && text[pos] != '\t'))
+		return false;
+
+	std::size_t name = text.find_first_not_of(" \t", pos);
+
+	if (name == std::string::npos)
+		return false;
+
+	std::size_t end = name;
+
+	while (end < text.size() && IsNameChar(text[end]))
+		end++;
+
+	if (end == name)
+		return false;
+
+	Add((word)address, text.substr(name, end - name));
+	return true;
+}
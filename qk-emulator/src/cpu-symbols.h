@@ -0,0 +1,40 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "definitions.h"
+
+
+namespace Qk
+{
+	/*
+		Names for CPU addresses, for profiles and traces, loaded from an
+		assembler's or emulator's symbol files. Formats understood, told
+		apart line by line:
+
+			sym id=0,name="reset",...,val=0x8000,...,type=lab	ca65/ld65 debug info (.dbg)
+			al 008000 .reset					VICE labels (ld65 -Ln)
+			$8000#reset#comment					FCEUX (.nl)
+			reset = $8000						plain, NESASM (.fns)
+			00:8000 reset						plain, WLA DX (.sym)
+	*/
+
+	class SymbolTable
+	{
+	public:
+		// Add every label in a file; returns how many there were
+		int Load(const std::string& path);
+
+		void Add(word address, const std::string& name);
+
+		// Name at address, or nullptr
+		const std::string* Find(word address) const;
+
+		std::size_t GetSize() const;
+
+	protected:
+		std::map<word, std::string> m_names;
+
+		bool ParseLine(const std::string& line);
+	};
+}
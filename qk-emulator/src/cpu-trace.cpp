@@ -0,0 +1,368 @@
+#include <chrono>
+#include <cstring>
+#include "cpu-trace.h"
+#include "cpu.h"
+
+
+using namespace Qk;
+
+
+/*
+	Constructor, destructor
+*/
+
+CPUTrace::CPUTrace(std::size_t capacity)
+{
+	std::size_t size = 1;
+
+	while (size < capacity)
+		size <<= 1;
+
+	m_ring.reset(new TraceRecord[size]());
+	m_mask = size - 1;
+}
+
+CPUTrace::~CPUTrace()
+{
+	StopWriter();
+}
+
+
+/*
+	Public interface methods
+*/
+
+void CPUTrace::SetFilter(const Filter& filter)
+{
+	m_filter = filter;
+}
+
+const CPUTrace::Filter& CPUTrace::GetFilter() const
+{
+	return m_filter;
+}
+
+void CPUTrace::SetCMOS(bool cmos)
+{
+	m_cmos = cmos;
+}
+
+void CPUTrace::StartWriter(const std::string& path, Format format)
+{
+	StopWriter();
+
+	m_file = std::fopen(path.c_str(), format == Format::Text ? "w" : "wb");
+
+	if (m_file == nullptr)
+		throw QkError("Cannot open trace file", 220);
+
+	m_format = format;
+
+	if (format != Format::Text)
+	{
+		TraceFileHeader header = {};
+		std::memcpy(header.Magic, MAGIC, sizeof(header.Magic));
+		header.Version = VERSION;
+		header.RecordSize = sizeof(TraceRecord);
+		header.Format = (dword)format;
+		header.CMOS = m_cmos;
+		std::fwrite(&header, sizeof(header), 1, m_file);
+	}
+
+	m_stopping = false;
+	m_writing = true;
+	m_writer = std::thread(&CPUTrace::Write, this);
+}
+
+void CPUTrace::StopWriter()
+{
+	if (!m_writing)
+		return;
+
+	// Writer drains the ring before it quits
+	m_stopping = true;
+	m_writer.join();
+	m_writing = false;
+
+	std::fclose(m_file);
+	m_file = nullptr;
+}
+
+std::vector<TraceRecord> CPUTrace::GetRecords() const
+{
+	std::vector<TraceRecord> records;
+	qword head = m_head.load(std::memory_order_acquire);
+
+	for (qword n = m_tail.load(std::memory_order_acquire); n < head; n++)
+		records.push_back(m_ring[n & m_mask]);
+
+	return records;
+}
+
+qword CPUTrace::GetRecordCount() const
+{
+	return m_head.load(std::memory_order_acquire);
+}
+
+
+/*
+	Writer thread
+*/
+
+void CPUTrace::Write()
+{
+	TraceRecord previous = TraceRecord();
+	std::vector<byte> buffer;
+
+	for (;;)
+	{
+		// Check before looking at the ring, so nothing committed before
+		// StopWriter is left behind
+		bool stopping = m_stopping;
+		qword tail = m_tail.load(std::memory_order_relaxed);
+		qword head = m_head.load(std::memory_order_acquire);
+
+		if (tail != head)
+		{
+			WriteRecords(tail, head, previous, buffer);
+			m_tail.store(head, std::memory_order_release);
+		}
+		else if (stopping)
+		{
+			break;
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+
+	std::fflush(m_file);
+}
+
+void CPUTrace::WriteRecords(qword from, qword to, TraceRecord& previous, std::vector<byte>& buffer)
+{
+	buffer.clear();
+
+	for (qword n = from; n < to; n++)
+	{
+		const TraceRecord& record = m_ring[n & m_mask];
+		std::size_t used = buffer.size();
+
+		switch (m_format)
+		{
+		case Format::Binary:
+			buffer.resize(used + sizeof(TraceRecord));
+			std::memcpy(&buffer[used], &record, sizeof(TraceRecord));
+			break;
+
+		case Format::Delta:
+			buffer.resize(used + MAX_DELTA_SIZE);
+			buffer.resize(used + EncodeDelta(previous, record, &buffer[used]));
+			previous = record;
+			break;
+
+		case Format::Text:
+		{
+			char line[128];
+			int length = FormatText(record, m_cmos, line, sizeof(line));
+			buffer.insert(buffer.end(), line, line + length);
+			buffer.push_back('\n');
+			break;
+		}
+		}
+	}
+
+	std::fwrite(buffer.data(), 1, buffer.size(), m_file);
+}
+
+
+/*
+	Delta encoding: the cycle count as the difference to the one before,
+	every other byte XORed with the one before. Of the resulting 64 bytes,
+	only those that aren't zero are stored, after a bit mask saying which:
+	one byte flagging each group of 8 bytes with any, then one mask byte per
+	such group. Consecutive instructions mostly differ in a few bytes.
+*/
+
+std::size_t CPUTrace::EncodeDelta(const TraceRecord& previous, const TraceRecord& record, byte* out)
+{
+	byte delta[sizeof(TraceRecord)];
+	const byte* a = reinterpret_cast<const byte*>(&previous);
+	const byte* b = reinterpret_cast<const byte*>(&record);
+
+	qword cycles = record.Cycle - previous.Cycle;
+	std::memcpy(delta, &cycles, sizeof(qword));
+
+	for (std::size_t n = sizeof(qword); n < sizeof(TraceRecord); n++)
+		delta[n] = a[n] ^ b[n];
+
+	std::size_t size = 1;
+	out[0] = 0;
+
+	for (int group = 0; group < 8; group++)
+	{
+		byte mask = 0;
+
+		for (int n = 0; n < 8; n++)
+		{
+			if (delta[group * 8 + n] != 0)
+				mask |= 1 << n;
+		}
+
+		if (mask != 0)
+		{
+			out[0] |= 1 << group;
+			out[size++] = mask;
+		}
+	}
+
+	for (std::size_t n = 0; n < sizeof(TraceRecord); n++)
+	{
+		if (delta[n] != 0)
+			out[size++] = delta[n];
+	}
+
+	return size;
+}
+
+std::size_t CPUTrace::DecodeDelta(const TraceRecord& previous, const byte* in, std::size_t size, TraceRecord& record)
+{
+	// Returns the number of bytes taken, or 0 if the input ends first
+	if (size < 1)
+		return 0;
+
+	byte masks[8] = {};
+	std::size_t used = 1;
+
+	for (int group = 0; group < 8; group++)
+	{
+		if (in[0] & (1 << group))
+		{
+			if (used >= size)
+				return 0;
+
+			masks[group] = in[used++];
+		}
+	}
+
+	byte delta[sizeof(TraceRecord)] = {};
+
+	for (std::size_t n = 0; n < sizeof(TraceRecord); n++)
+	{
+		if (masks[n / 8] & (1 << (n % 8)))
+		{
+			if (used >= size)
+				return 0;
+
+			delta[n] = in[used++];
+		}
+	}
+
+	const byte* a = reinterpret_cast<const byte*>(&previous);
+	byte* b = reinterpret_cast<byte*>(&record);
+
+	for (std::size_t n = sizeof(qword); n < sizeof(TraceRecord); n++)
+		b[n] = a[n] ^ delta[n];
+
+	qword cycles;
+	std::memcpy(&cycles, delta, sizeof(qword));
+	record.Cycle = previous.Cycle + cycles;
+
+	return used;
+}
+
+
+/*
+	Text format, as nestest.log: mnemonic at column 16, unofficial opcodes
+	marked with a * before it, registers from column 48. Memory operands
+	show the value read, where there is one; PPU dots are not known here.
+*/
+
+int CPUTrace::FormatText(const TraceRecord& record, bool cmos, char* out, std::size_t size)
+{
+	using AM = MOS6502::AddressingMode;
+	using OP = MOS6502::Operation;
+
+	const TraceRegisters& r = record.Before;
+	char code[16] = "";
+	char text[48];
+	char mark = ' ';
+
+	if (record.Type != TraceRecord::Instruction)
+	{
+		std::snprintf(text, sizeof(text), record.Type == TraceRecord::NMI ? "NMI" : "IRQ");
+	}
+	else
+	{
+		const MOS6502::OpcodeInfo& info = (cmos ? MOS6502::OpcodeTable65C02 : MOS6502::OpcodeTable)[record.Opcode];
+
+		// Code bytes are the first accesses; BRK skips its padding byte
+		int length = info.Op == OP::BRK ? 1 : MOS6502::GetInstructionLength(info.Mode);
+		int accesses = record.AccessCount;
+		byte bytes[3] = { record.Opcode, 0, 0 };
+
+		for (int n = 1; n < length && n < accesses; n++)
+			bytes[n] = record.Accesses[n].Value;
+
+		int c = 0;
+		for (int n = 0; n < length; n++)
+			c += std::snprintf(code + c, sizeof(code) - c, n == 0 ? "%02X" : " %02X", bytes[n]);
+
+		word operand = bytes[1] | (bytes[2] << 8);
+
+		// Pointer reads come right after the code bytes, then the data
+		auto pointer = [&](int n) -> word {
+			int index = length + n;
+			return index + 1 < accesses ? (record.Accesses[index].Value | (record.Accesses[index + 1].Value << 8)) : 0;
+		};
+
+		char value[8] = "";
+		int data = length + ((info.Mode == AM::IZX || info.Mode == AM::IZY || info.Mode == AM::ZPI) ? 2 : 0);
+		bool jumps = info.Op == OP::JMP || info.Op == OP::JSR;
+
+		if (!jumps && data < accesses && !record.Accesses[data].IsWrite)
+			std::snprintf(value, sizeof(value), " = %02X", record.Accesses[data].Value);
+
+		const char* mnemonic = GetMnemonic(record.Opcode, cmos);
+
+		if (IsUnofficial(record.Opcode, cmos))
+			mark = '*';
+
+		switch (info.Mode)
+		{
+		case AM::IMP: std::snprintf(text, sizeof(text), "%s", mnemonic); break;
+		case AM::ACC: std::snprintf(text, sizeof(text), "%s A", mnemonic); break;
+		case AM::IMM: std::snprintf(text, sizeof(text), "%s #$%02X", mnemonic, bytes[1]); break;
+		case AM::ZP0: std::snprintf(text, sizeof(text), "%s $%02X%s", mnemonic, bytes[1], value); break;
+		case AM::ZPX: std::snprintf(text, sizeof(text), "%s $%02X,X @ %02X%s", mnemonic, bytes[1], (bytes[1] + r.X) & 0xFF, value); break;
+		case AM::ZPY: std::snprintf(text, sizeof(text), "%s $%02X,Y @ %02X%s", mnemonic, bytes[1], (bytes[1] + r.Y) & 0xFF, value); break;
+		case AM::REL: std::snprintf(text, sizeof(text), "%s $%04X", mnemonic, (word)(r.PC + 2 + (signed char)bytes[1])); break;
+		case AM::ABS: std::snprintf(text, sizeof(text), "%s $%04X%s", mnemonic, operand, value); break;
+		case AM::ABX: std::snprintf(text, sizeof(text), "%s $%04X,X @ %04X%s", mnemonic, operand, (word)(operand + r.X), value); break;
+		case AM::ABY: std::snprintf(text, sizeof(text), "%s $%04X,Y @ %04X%s", mnemonic, operand, (word)(operand + r.Y), value); break;
+		case AM::IND: std::snprintf(text, sizeof(text), "%s ($%04X) = %04X", mnemonic, operand, record.After.PC); break;
+		case AM::IZX: std::snprintf(text, sizeof(text), "%s ($%02X,X) @ %02X = %04X%s", mnemonic, bytes[1], (bytes[1] + r.X) & 0xFF, pointer(0), value); break;
+		case AM::IZY: std::snprintf(text, sizeof(text), "%s ($%02X),Y = %04X @ %04X%s", mnemonic, bytes[1], pointer(0), (word)(pointer(0) + r.Y), value); break;
+		case AM::ZPI: std::snprintf(text, sizeof(text), "%s ($%02X) = %04X%s", mnemonic, bytes[1], pointer(0), value); break;
+		case AM::IAX: std::snprintf(text, sizeof(text), "%s ($%04X,X) = %04X", mnemonic, operand, record.After.PC); break;
+		}
+	}
+
+	int length = std::snprintf(out, size, "%04X  %-8s %c%-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu",
+		r.PC, code, mark, text, r.A, r.X, r.Y, r.P, r.S, (unsigned long long)record.Cycle);
+
+	return length < (int)size ? length : (int)size - 1;
+}
+
+const char* CPUTrace::GetMnemonic(byte opcode, bool cmos)
+{
+	const MOS6502::OpcodeInfo& info = (cmos ? MOS6502::OpcodeTable65C02 : MOS6502::OpcodeTable)[opcode];
+
+	return IsUnofficial(opcode, cmos) && info.Op == MOS6502::Operation::NOP ? "NOP" : info.Mnemonic;
+}
+
+bool CPUTrace::IsUnofficial(byte opcode, bool cmos)
+{
+	return std::strcmp((cmos ? MOS6502::OpcodeTable65C02 : MOS6502::OpcodeTable)[opcode].Mnemonic, "XXX") == 0;
+}
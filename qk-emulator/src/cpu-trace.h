@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "definitions.h"
+
+
+namespace Qk
+{
+	class MOS6502;
+
+	/*
+		CPU execution trace: a fixed-size ring of plain records, one per
+		instruction or interrupt, filled by the CPU and drained to a file by
+		a writer thread. Attach one with MOS6502::SetTrace; detached, tracing
+		costs a pointer test per instruction.
+	*/
+
+	struct TraceRegisters
+	{
+		word PC;
+		byte A;
+		byte X;
+		byte Y;
+		byte P;
+		byte S;
+		byte Unused;
+	};
+
+	struct TraceAccess
+	{
+		word Address;
+		byte Value;
+		byte IsWrite;
+	};
+
+	struct TraceRecord
+	{
+		enum Kind : byte { Instruction, IRQ, NMI };
+		static constexpr int MAX_ACCESSES = 8;
+
+		qword Cycle;			// CPU cycle count before
+		TraceRegisters Before;
+		TraceRegisters After;
+		byte Opcode;			// 0 for interrupts
+		byte Type;			// Kind
+		byte Cycles;			// Duration
+		byte AccessCount;		// Bus accesses, code fetches included, in order
+		byte Overflowed;		// More accesses than fit
+		byte Unused[3];
+		TraceAccess Accesses[MAX_ACCESSES];
+	};
+
+	static_assert(sizeof(TraceRecord) == 64, "Trace records are one cache line");
+	static_assert(std::is_trivially_copyable<TraceRecord>::value, "Trace records are written as they are");
+
+	// Trace file header; records follow. Binary files hold records as
+	// they are, delta files each one relative to the one before (see
+	// EncodeDelta). Text files have no header.
+	struct TraceFileHeader
+	{
+		char Magic[8];			// "QKTRACE"
+		dword Version;
+		dword RecordSize;
+		dword Format;
+		dword CMOS;			// Opcodes are 65C02 ones
+	};
+
+	class CPUTrace
+	{
+	public:
+		enum class Format { Binary, Delta, Text };
+
+		// Which instructions to trace: start PC and starting cycle count
+		// both in range, inclusive
+		struct Filter
+		{
+			word PCMin = 0x0000;
+			word PCMax = 0xFFFF;
+			qword CycleMin = 0;
+			qword CycleMax = UINT64_MAX;
+
+			bool Matches(word pc, qword cycle) const
+			{
+				return pc >= PCMin && pc <= PCMax && cycle >= CycleMin && cycle <= CycleMax;
+			}
+		};
+
+		static constexpr const char* MAGIC = "QKTRACE";
+		static constexpr dword VERSION = 1;
+
+		// Longest delta-encoded record
+		static constexpr int MAX_DELTA_SIZE = 1 + 8 + sizeof(TraceRecord);
+
+	public:
+		// Capacity in records, rounded up to a power of two
+		CPUTrace(std::size_t capacity = 65536);
+		~CPUTrace();
+
+		void SetFilter(const Filter& filter);
+		const Filter& GetFilter() const;
+
+		// Stream all records to a file, from a thread of its own; the CPU
+		// waits for it if the ring fills up. Without a writer, the ring just
+		// keeps the most recent records.
+		void StartWriter(const std::string& path, Format format);
+		void StopWriter();
+
+		// Records in the ring not written out, oldest first (if there is
+		// no writer), and the number of records taken so far
+		std::vector<TraceRecord> GetRecords() const;
+		qword GetRecordCount() const;
+
+		// Filled by the CPU, one record at a time
+		TraceRecord& Begin();
+		void RecordAccess(word address, byte value, bool isWrite);
+		void Commit();
+
+		// Opcode table for disassembly; set by MOS6502::SetTrace
+		void SetCMOS(bool cmos);
+
+		// File formats, also for tools reading traces back
+		static std::size_t EncodeDelta(const TraceRecord& previous, const TraceRecord& record, byte* out);
+		static std::size_t DecodeDelta(const TraceRecord& previous, const byte* in, std::size_t size, TraceRecord& record);
+
+		// nestest.log style line, without a line break: PC, code bytes,
+		// disassembly, registers before and cycle count. Returns its length.
+		static int FormatText(const TraceRecord& record, bool cmos, char* out, std::size_t size);
+
+		// Opcode names: NOP for unofficial NOPs, XXX for the other opcodes
+		// the CPU doesn't implement; both count as unofficial
+		static const char* GetMnemonic(byte opcode, bool cmos);
+		static bool IsUnofficial(byte opcode, bool cmos);
+
+	protected:
+		std::unique_ptr<TraceRecord[]> m_ring;
+		std::size_t m_mask;
+		Filter m_filter;
+		bool m_cmos = false;
+
+		// Single producer (the CPU), single consumer (the writer, or the
+		// producer itself when there is none, dropping the oldest records)
+		std::atomic<qword> m_head{ 0 };
+		std::atomic<qword> m_tail{ 0 };
+		TraceRecord* m_current = nullptr;
+
+		std::thread m_writer;
+		std::atomic<bool> m_writing{ false };
+		std::atomic<bool> m_stopping{ false };
+		std::FILE* m_file = nullptr;
+		Format m_format = Format::Binary;
+
+		void Write();
+		void WriteRecords(qword from, qword to, TraceRecord& previous, std::vector<byte>& buffer);
+	};
+
+
+	/*
+		Producer side -- inline, as it runs for every bus access traced
+	*/
+
+	inline TraceRecord& CPUTrace::Begin()
+	{
+		qword head = m_head.load(std::memory_order_relaxed);
+
+		if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+		{
+			if (m_writing)
+			{
+				while (head - m_tail.load(std::memory_order_acquire) > m_mask)
+					std::this_thread::yield();
+			}
+			else
+			{
+				m_tail.store(head - m_mask, std::memory_order_release);
+			}
+		}
+
+		// Cleared whole, so unused fields compare and compress well
+		m_current = &m_ring[head & m_mask];
+		*m_current = TraceRecord();
+		return *m_current;
+	}
+
+	inline void CPUTrace::RecordAccess(word address, byte value, bool isWrite)
+	{
+		if (m_current->AccessCount == TraceRecord::MAX_ACCESSES)
+		{
+			m_current->Overflowed = 1;
+			return;
+		}
+
+		m_current->Accesses[m_current->AccessCount++] = { address, value, (byte)isWrite };
+	}
+
+	inline void CPUTrace::Commit()
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+}
@@ -1,30 +1,51 @@
-#ifdef _DEBUG
-
-#include <iostream>
-#include <iomanip>
-#include <sstream>
-#include <fstream>
+#include "cpu.h"
+#include "cpu-ops.h"
+#include "timers.h"
 
-#endif
 
-#include "cpu.h"
+using namespace Qk;
 
-//#define CPU_DEBUG
 
+// Opcode table storage (constexpr static members need one pre-C++17)
+constexpr MOS6502::OpcodeInfo MOS6502::OpcodeTable[256];
+constexpr MOS6502::OpcodeInfo MOS6502::OpcodeTable65C02[256];
+constexpr const MOS6502::OpcodeInfo* MOS6502::NMOS::Opcodes;
+constexpr const MOS6502::OpcodeInfo* MOS6502::WDC65C02::Opcodes;
+constexpr const char* MOS6502::AddressingModeMnemonics[];
 
-using namespace Qk;
+int MOS6502::GetInstructionLength(AddressingMode mode)
+{
+	switch (mode)
+	{
+	case AddressingMode::IMP:
+	case AddressingMode::ACC:
+		return 1;
+	case AddressingMode::ABS:
+	case AddressingMode::ABX:
+	case AddressingMode::ABY:
+	case AddressingMode::IND:
+	case AddressingMode::IAX:
+		return 3;
+	default:
+		return 2;
+	}
+}
 
 
 /*
 	Constructors, destructor
 */
 
-MOS6502::MOS6502(Bus& bus) : Device(bus), m_instructionHandler(*this)
+MOS6502::MOS6502(Bus& bus) 
+	: Device(bus), m_busMemory(bus), m_instructionHandler(new FusedCore<BusMemory, NMOS>(*this, m_busMemory)),
+	  m_tracedHandler(new TracedCore<BusMemory, NMOS>(*this, m_busMemory))
 {
-#ifdef CPU_DEBUG
-	// DEBUG
-	LOGGER = new CPUDebugLogger(*this);
-#endif
+	// Interrupt requests come in over the bus' NMI/IRQ lines;
+	// signals are still accepted from devices that emit them
+	ListenForSignal(SIGNAL_CPU_IRQ);
+	ListenForSignal(SIGNAL_CPU_NMI);
+	ListenForSignal(SIGNAL_CPU_HLT);
+	ListenForSignal(SIGNAL_CPU_RSM);
 
 	// Reset CPU, set PC to 0 for now, as we don't
 	// want to load reset vector until the user tells
@@ -34,16 +55,23 @@ MOS6502::MOS6502(Bus& bus) : Device(bus), m_instructionHandler(*this)
 
 MOS6502::~MOS6502()
 {
-#ifdef CPU_DEBUG
-	// DEBUG
-	delete LOGGER;
-#endif
+
 }
 
 /*
 	CPU control
 */
 
+void MOS6502::PowerOn()
+{
+	// Back to the state we were constructed in. Registers
+	// are set up by the reset that follows power-on.
+	m_remainingCycles = 0;
+	m_cpuCycleCount = 0;
+	m_idleCyclesSkipped = 0;
+	m_halted = false;
+}
+
 void MOS6502::Reset()
 {
 	// Read reset vector at 0xFFFC and 0xFFFD
@@ -67,56 +95,167 @@ void MOS6502::Reset(word programCounter)
 
 void MOS6502::Cycle()
 {
+	// Cycle-by-cycle stepping: execute the whole instruction on its first
+	// cycle, then idle for the remainder of its duration
 	if (m_halted)
 		return;
 
 	if (m_remainingCycles <= 0)
 	{
-#ifdef CPU_DEBUG
-		// DEBUG
-		// Start frame logging
-		LOGGER->NewFrame();
-		LOGGER->RecordPreOpCPUState();
-#endif
-		// First, deal with any interrupt requests
-		if (m_nmiPending)
-		{
-			m_nmiPending = false;
-			m_instructionHandler.NMI();
-		}
-		else if (m_irqPending)
-		{
-			m_irqPending = false;
-			m_instructionHandler.IRQ();
-		}
-		else
-		{
-			// Execute next opcode
-			m_instructionHandler.ExecuteNextInstruction();
-		}
-
-		// Add instruction duration to cycle wait counter
-		m_remainingCycles += m_instructionHandler.GetLastInstructionCycles();
-
-#ifdef CPU_DEBUG
-		// DEBUG
-		// Finish frame logging
-		LOGGER->RecordPostOpCPUState();
-#endif
+		m_remainingCycles += Step();
 	}
 
 	m_remainingCycles--;
-	m_cpuCycleCount++;
 }
 
-void MOS6502::SetDecimalModeAvailable(bool available)
+int MOS6502::Step()
+{
+	// Execute one whole instruction (or interrupt sequence)
+	// and return its duration in CPU cycles
+	if (!m_instrumented)
+		return Execute(*m_instructionHandler);
+
+	return InstrumentedStep();
+}
+
+int MOS6502::Execute(Core& core)
+{
+	int cycles;
+
+	// First, deal with any interrupt requests
+	if (BUS.NMI.Acknowledge())
+	{
+		core.NMI();
+		cycles = core.GetLastInstructionCycles();
+	}
+	else if (BUS.IRQ.Acknowledge())
+	{
+		core.IRQ();
+		cycles = core.GetLastInstructionCycles();
+	}
+	else
+	{
+		// Execute next opcode
+		cycles = core.ExecuteNextInstruction();
+	}
+
+	m_cpuCycleCount += cycles;
+
+	return cycles;
+}
+
+int MOS6502::InstrumentedStep()
 {
-	// Some variants of the 6502 chip -- notably the NES's -- do not
-	// include the hardware for decimal mode. To accurately emulate those chips,
-	// this functions can tell the CPU to block any decimal mode operations, 
-	// regardless of the decimal mode flag being set in the CPU status register
+	word pc = Registers.PC;
+	byte s = Registers.S;
+	bool nmi = BUS.NMI.IsRaised();
+	bool interrupt = nmi || BUS.IRQ.IsRaised();
+	bool traced = m_trace != nullptr && m_trace->GetFilter().Matches(pc, m_cpuCycleCount);
+
+	int cycles = traced ? TraceStep() : Execute(*m_instructionHandler);
+	byte opcode = interrupt ? 0 : (traced ? m_tracedHandler : m_instructionHandler)->GetLastInstructionOpcode();
 
-	m_decimalModeAvailable = available;
+	if (m_profiler != nullptr)
+	{
+		if (interrupt)
+			m_profiler->RecordInterrupt(cycles);
+		else
+			m_profiler->RecordInstruction(pc, opcode, cycles);
+	}
+
+	if (m_callProfiler != nullptr)
+	{
+		if (interrupt)
+			m_callProfiler->RecordInterrupt(nmi, s, Registers.S, Registers.PC, cycles);
+		else
+			m_callProfiler->RecordInstruction(s, opcode, Registers.S, Registers.PC, cycles);
+	}
+
+	return cycles;
+}
+
+int MOS6502::TraceStep()
+{
+	auto save = [this](TraceRegisters& r) {
+		r = { Registers.PC, Registers.A, Registers.X, Registers.Y, Registers.P, Registers.S, 0 };
+	};
+
+	TraceRecord& record = m_trace->Begin();
+	record.Cycle = m_cpuCycleCount;
+	record.Type = BUS.NMI.IsRaised() ? TraceRecord::NMI : BUS.IRQ.IsRaised() ? TraceRecord::IRQ : TraceRecord::Instruction;
+	save(record.Before);
+
+	// Code fetches go through the traced core's memory too
+	m_tracing = true;
+	m_fetchPage = -1;
+
+	int cycles = Execute(*m_tracedHandler);
+
+	m_tracing = false;
+	m_fetchPage = -1;
+
+	record.Opcode = record.Type == TraceRecord::Instruction ? m_tracedHandler->GetLastInstructionOpcode() : 0;
+	record.Cycles = (byte)cycles;
+	save(record.After);
+	m_trace->Commit();
+
+	return cycles;
+}
+
+int MOS6502::RunBlock(BlockHost& host)
+{
+	// Like Step(), but go on with the instructions that follow for as long
+	// as host agrees, if the core can. Interrupt requests are left to
+	// Step(), so the block cache core only ever runs plain instructions;
+	// so are instructions while tracing or profiling.
+	QK_TIMER(CPU);
+
+	if (!m_instrumented && !BUS.NMI.IsRaised() && !BUS.IRQ.IsRaised())
+	{
+		int cycles = m_instructionHandler->ExecuteBlock(host);
+		m_cpuCycleCount += cycles;
+
+		return cycles;
+	}
+
+	return Step();
+}
+
+void MOS6502::SetTrace(CPUTrace* trace)
+{
+	m_trace = trace;
+	UpdateInstrumented();
+
+	if (trace != nullptr)
+		trace->SetCMOS(m_opcodes == OpcodeTable65C02);
+}
+
+void MOS6502::SetProfiler(CPUProfiler* profiler)
+{
+	m_profiler = profiler;
+	UpdateInstrumented();
+
+	if (profiler != nullptr)
+		profiler->SetCMOS(m_opcodes == OpcodeTable65C02);
+}
+
+void MOS6502::SetCallProfiler(CPUCallProfiler* profiler)
+{
+	m_callProfiler = profiler;
+	UpdateInstrumented();
+
+	if (profiler != nullptr)
+		profiler->SetCMOS(m_opcodes == OpcodeTable65C02);
+}
+
+void MOS6502::UpdateInstrumented()
+{
+	m_instrumented = m_trace != nullptr || m_profiler != nullptr || m_callProfiler != nullptr;
+}
+
+void MOS6502::SetIdleLoopSkipping(bool enabled)
+{
+	m_idleLoopSkipping = enabled;
 }
 
 /*
@@ -126,12 +265,12 @@ void MOS6502::SetDecimalModeAvailable(bool available)
 void MOS6502::GenerateInterrupt()
 {
 	// Set pending interrupt
-	m_irqPending = true;
+	BUS.IRQ.Raise();
 }
 
 void MOS6502::GenerateNonMaskableInterrupt()
 {
-	m_nmiPending = true;
+	BUS.NMI.Raise();
 }
 
 void MOS6502::OnBusSignal(int signalId)
@@ -162,24 +301,11 @@ void MOS6502::OnBusSignal(int signalId)
 
 byte MOS6502::Read(word address)
 {
-#ifdef CPU_DEBUG
-	// DEBUG
-	byte value = BUS.ReadFromBus(address);
-	LOGGER->RecordIOEvent(address, value, false);
-	return value;
-#endif
-#ifndef CPU_DEBUG
 	return BUS.ReadFromBus(address);
-#endif
 }
 
 void MOS6502::Write(word address, byte data)
 {
-#ifdef CPU_DEBUG
-	// DEBUG
-	LOGGER->RecordIOEvent(address, data, true);
-#endif // DEBUG
-
 	BUS.WriteToBus(address, data);
 }
 
@@ -229,205 +355,17 @@ word MOS6502::GetStackPointerAddress() const
 	return 0x0100 | (word)Registers.S;
 }
 
-unsigned long MOS6502::GetCPUCycleCount() const
+qword MOS6502::GetCPUCycleCount() const
 {
 	return m_cpuCycleCount;
 }
 
-
-/*
-	DEBUGGING STUFF
-*/
-
-#ifdef _DEBUG
-
-// CPU
-
-void MOS6502::PrintDebugInfo() const
-{
-	LOGGER->PrintFrameDebugInfo();
-}
-
-void MOS6502::SaveDebugInfo(const std::string& path) const
-{
-	LOGGER->SaveDebugInfo(path);
-}
-
-
-// Debug frame
-
-CPUDebugFrame::CPUDebugFrame()
-{
-
-}
-
-CPUDebugFrame::~CPUDebugFrame()
+qword MOS6502::GetIdleCyclesSkipped() const
 {
-	for (auto ptr : IOEvents)
-	{
-		delete ptr;
-	}
-	IOEvents.clear();
-}
-
-std::string CPUDebugFrame::ToString() const
-{
-	return std::string("NOT IMPLEMENTED");
+	return m_idleCyclesSkipped;
 }
 
-std::string CPUDebugFrame::ToJSONString() const
+bool MOS6502::IsHalted() const
 {
-	using namespace std;
-
-	stringstream s;
-
-	s << "{";
-	s << "\"Cycle\": " << Cycle << ",\n";
-	s << "\"Opcode\": \"" << hex << setfill('0') << setw(2) << Opcode << "\",\n";
-	s << "\"OpcodeMnemonic\": \"" << OpcodeMnemonic << "\",\n";
-	s << "\"AddressingMode\": \"" << AddressingModeMnemonic<< "\",\n";
-
-	s << "\"PreOpState\":  {\"A\": \"" << hex << setfill('0') << setw(2) << PreOpState.A << "\",";
-	s << " \"X\": \"" << hex << setfill('0') << setw(2) << PreOpState.X << "\",";
-	s << " \"Y\": \"" << hex << setfill('0') << setw(2) << PreOpState.Y << "\",";
-	s << " \"P\": \"" << hex << setfill('0') << setw(2) << PreOpState.P << "\",";
-	s << " \"S\": \"" << hex << setfill('0') << setw(2) << PreOpState.S << "\",";
-	s << " \"PC\": \"" << hex << setfill('0') << setw(4) << PreOpState.PC << "\"},\n";
-
-	s << "\"PostOpState\":  {\"A\": \"" << hex << setfill('0') << setw(2) << PostOpState.A << "\",";
-	s << " \"X\": \"" << hex << setfill('0') << setw(2) << PostOpState.X << "\",";
-	s << " \"Y\": \"" << hex << setfill('0') << setw(2) << PostOpState.Y << "\",";
-	s << " \"P\": \"" << hex << setfill('0') << setw(2) << PostOpState.P << "\",";
-	s << " \"S\": \"" << hex << setfill('0') << setw(2) << PostOpState.S << "\",";
-	s << " \"PC\": \"" << hex << setfill('0') << setw(4) << PostOpState.PC << "\"},\n";
-
-	s << "\"IOEvents\":\n";
-	s << "\t[\n";
-
-	for (unsigned int i = 0; i < IOEvents.size(); i++)
-	{
-		auto ev = IOEvents.at(i);
-
-		// {"Type": "R", "Address": 0, "Value": 0},
-		s << "\t\t{\"Type\": ";
-		s << ((ev->IsWrite) ? "\"W\"," : "\"R\",");
-		s << "\"Address\": \"" << hex << setfill('0') << setw(4) << ev->Address << "\", ";
-		s << "\"Value\": \"" << hex << setfill('0') << setw(2) << ev->Value << "\"";
-
-		// Valid JSON requires that last item in list does not end with comma
-		if (i < IOEvents.size() - 1)
-			s << "},\n";
-		else
-			s << "}\n";
-	}
-
-	s << "\t]\n}";
-
-	return std::string(s.str());
-}
-
-
-// Logger
-
-CPUDebugLogger::CPUDebugLogger(MOS6502& cpu) : m_cpu(cpu)
-{
-	CurrentFrame = nullptr;
-}
-
-CPUDebugLogger::~CPUDebugLogger()
-{
-	for (auto ptr : Frames)
-	{
-		delete ptr;
-	}
-	Frames.clear();
-}
-
-void CPUDebugLogger::NewFrame()
-{
-	CurrentFrame = new CPUDebugFrame();
-	Frames.push_back(CurrentFrame);
-}
-
-void CPUDebugLogger::RecordIOEvent(word address, byte value, bool isWrite)
-{
-	if (CurrentFrame == nullptr)
-		return;
-
-	CPUDebugFrame::ReadWriteEvent* event = new CPUDebugFrame::ReadWriteEvent;
-
-	event->IsWrite = isWrite;
-	event->Address = address;
-	event->Value = value;
-
-	CurrentFrame->IOEvents.push_back(event);
-}
-
-void CPUDebugLogger::RecordPreOpCPUState()
-{
-	// Record cpu state
-	CurrentFrame->PreOpState.A = m_cpu.Registers.A;
-	CurrentFrame->PreOpState.X = m_cpu.Registers.X;
-	CurrentFrame->PreOpState.Y = m_cpu.Registers.Y;
-	CurrentFrame->PreOpState.P = m_cpu.Registers.P;
-	CurrentFrame->PreOpState.S = m_cpu.Registers.S;
-	CurrentFrame->PreOpState.PC = m_cpu.Registers.PC;
-}
-
-void CPUDebugLogger::RecordPostOpCPUState()
-{
-	CurrentFrame->Opcode = m_cpu.m_instructionHandler.GetLastInstructionOpcode();
-	CurrentFrame->OpcodeMnemonic = m_cpu.m_instructionHandler.GetLastInstructionMnemonic();
-	CurrentFrame->AddressingModeMnemonic = m_cpu.m_instructionHandler.GetLastInstructionAddressingModeMnemonic();
-	
-	// Record cpu state
-	CurrentFrame->PostOpState.A = m_cpu.Registers.A;
-	CurrentFrame->PostOpState.X = m_cpu.Registers.X;
-	CurrentFrame->PostOpState.Y = m_cpu.Registers.Y;
-	CurrentFrame->PostOpState.P = m_cpu.Registers.P;
-	CurrentFrame->PostOpState.S = m_cpu.Registers.S;
-	CurrentFrame->PostOpState.PC = m_cpu.Registers.PC;
-	CurrentFrame->Cycle = m_cpu.GetCPUCycleCount();
-	
-	CurrentFrame->PostOpState.AddressedLocation = m_cpu.m_instructionHandler.m_cacheAbsoluteWorkingAddress;
-	CurrentFrame->PostOpState.FetchedData = m_cpu.m_instructionHandler.m_cacheFetchedData;
-}
-
-void CPUDebugLogger::PrintFrameDebugInfo() const
-{
-	std::cout << CurrentFrame->ToString() << std::endl;
-}
-
-void CPUDebugLogger::SaveDebugInfo(const std::string& filepath) const
-{
-	std::ofstream out(filepath);
-
-	if (out)
-	{
-		out << "[\n";
-		
-		for (unsigned int i = 0; i < Frames.size(); i++)
-		{
-			auto fr = Frames.at(i);
-
-			out << fr->ToJSONString();
-
-			// Valid JSON requires that last item in list does not end with comma
-			if (i < Frames.size() - 1)
-				out << ",\n\n";
-			else
-				out << "\n\n";
-		}
-
-		out << "]";
-
-		out.close();
-		std::cout << "Saved CPU debug info to: " << filepath << std::endl;
-	}
-	else
-	{
-		std::cout << "Could not open file: " << filepath << std::endl;
-	}
-}
-
-#endif
\ No newline at end of file
+	return m_halted;
+}
\ No newline at end of file
@@ -2,9 +2,20 @@
 #pragma warning (disable:26812)
 
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 #include "definitions.h"
 #include "bus.h"
+#include "cpu-callstack.h"
+#include "cpu-profiler.h"
+#include "cpu-trace.h"
+
+// Native code generation for the JIT core needs an x86-64 host with
+// Linux' mmap; elsewhere the JIT core types fall back to the block core
+#if defined(__linux__) && defined(__x86_64__)
+#define QK_JIT_AVAILABLE
+#endif
 
 
 namespace Qk
@@ -12,7 +23,7 @@ namespace Qk
 	class MOS6502 : public Bus::Device
 	{
 	public:
-		struct
+		struct RegisterFile
 		{
 			byte A;		// Accumulator
 			byte X;		// Index X
@@ -34,19 +45,67 @@ namespace Qk
 			Negative         = 0x80
 		};
 
+		// Instruction execution cores
+		enum class CoreType
+		{
+			Reference,	// One call per addressing mode and per operation; easy to follow
+			Fused,		// One inlined handler per opcode; fast
+			Block,		// Fused handlers, run a basic block at a time from pre-decoded ROM code
+			JIT,		// Block core, with hot blocks compiled to x86-64 machine code
+			JITLockstep	// JIT, checking every run of compiled code against the fused core
+		};
+
+		// Whoever drives the CPU, when running blocks of instructions (see
+		// RunBlock): decides whether the next instruction in a block may
+		// start right away, 'cycles' after the first one did
+		class BlockHost
+		{
+		public:
+			virtual ~BlockHost() { }
+			virtual bool ContinueBlock(int cycles) = 0;
+
+			// Instructions that only access RAM and ROM can't change anything
+			// the host checks but time. Up to how many cycles after the first
+			// instruction may those start without asking ContinueBlock?
+			virtual int GetQuietCycles() { return 0; }
+
+			// Some did, the last one 'cycles' after the first instruction
+			virtual void QuietInstructionsRan(int cycles) { }
+
+			// Does ContinueBlock look at the CPU registers (e.g. a debugger
+			// condition)? If not, the N and Z flags are only written back to
+			// P once the block run is over.
+			virtual bool WatchesRegisters() { return true; }
+
+			// The CPU is spinning in a loop that reads nothing but memory and,
+			// unless 'polled' is -1, the I/O register at that address. Up to
+			// how many cycles after the first instruction can none of that
+			// change, and would no instruction need ContinueBlock? 0 if unknown.
+			virtual int GetIdleCycles(int polled) { return 0; }
+		};
+
 	public:
 		MOS6502(Bus& bus);
 		~MOS6502();
 
 		// CPU control
+		void PowerOn();
 		void Reset();
 		void Reset(word programCounter);
 		void Cycle();
-		void SetDecimalModeAvailable(bool available);
+		int Step();
+		int RunBlock(BlockHost& host);
+
+		// Idle loops: fast-forward through loops that keep polling the same
+		// memory or I/O register, waiting for something to change (block and
+		// JIT cores only). Cycles skipped count as run; results are the same.
+		void SetIdleLoopSkipping(bool enabled);
+		qword GetIdleCyclesSkipped() const;
 
 		// CPU status
 		word GetStackPointerAddress() const;
-		unsigned long GetCPUCycleCount() const;
+		qword GetCPUCycleCount() const;
+		bool IsHalted() const;
 
 		bool CheckFlag(Flag flag) const;
 		void SetFlag(Flag flag);
@@ -61,124 +120,301 @@ namespace Qk
 		// Bus signal listener
 		void OnBusSignal(int signalId) override;
 
-#ifdef _DEBUG
-		// DEBUG
-		void PrintDebugInfo() const;
-		void SaveDebugInfo(const std::string& logfile) const;
-#endif
+		// Execution trace: every instruction the trace's filter matches is
+		// recorded into it, run on the fused core. nullptr to stop tracing.
+		void SetTrace(CPUTrace* trace);
+
+		// Execution profile: every instruction is counted into it, by PC,
+		// opcode and addressing mode. nullptr to stop profiling.
+		void SetProfiler(CPUProfiler* profiler);
+
+		// Call stack profile: cycles counted by guest routine and the calls
+		// that led there. nullptr to stop.
+		void SetCallProfiler(CPUCallProfiler* profiler);
+
+		// Default memory access policy: every access goes through the bus
+		class BusMemory
+		{
+		public:
+			BusMemory(Bus& bus) : BUS(bus) { }
+
+			byte Read(word address) { return BUS.ReadFromBus(address); }
+			void Write(word address, byte data) { BUS.WriteToBus(address, data); }
+
+		protected:
+			Bus& BUS;
+		};
+
+		// Run the CPU on a memory access policy known at compile time: any
+		// class with byte Read(word) and void Write(word, byte) members. A
+		// system with a fixed memory map can resolve it there in an inlineable
+		// switch, rather than dispatching each access through the bus.
+		// Variant picks the CPU model (see below), also at compile time.
+		// Defined in cpu-ops.h.
+		struct NMOS;
+		struct RP2A03;
+		struct WDC65C02;
+
+		template <class Variant = NMOS, class Memory>
+		void UseMemoryMap(Memory& memory, CoreType core = CoreType::Fused);
+
 	protected:
-		class InstructionHandler
+		// Instruction execution, independent of memory access policy
+		class Core
 		{
 		public:
-			InstructionHandler(MOS6502& parent);
+			virtual ~Core() { }
+
+			// Returns duration in cycles
+			virtual int ExecuteNextInstruction() = 0;
 
-			void ExecuteNextInstruction();
+			// Run on through a block of instructions, for as long as host agrees;
+			// returns total duration in cycles. Cores without a block cache just
+			// run one instruction.
+			virtual int ExecuteBlock(BlockHost&) { return ExecuteNextInstruction(); }
 
-			byte GetLastInstructionOpcode() const;
-			int GetLastInstructionCycles() const;
-			word GetLastInstructionAddress() const;
-			byte GetLastInstructionValue() const;
-			std::string GetLastInstructionMnemonic() const;
-			std::string GetLastInstructionAddressingModeMnemonic() const;
+			virtual byte GetLastInstructionOpcode() const = 0;
+			virtual int GetLastInstructionCycles() const = 0;
+			virtual std::string GetLastInstructionMnemonic() const = 0;
+			virtual std::string GetLastInstructionAddressingModeMnemonic() const = 0;
 
 			// System interrupt signals
-			void IRQ();
-			void NMI();
+			virtual void IRQ() = 0;
+			virtual void NMI() = 0;
+		};
 
-		protected:
+		// Opcode table, as data: addressing mode, operation and base cycle
+		// count for each opcode. One per CPU variant; fused core handlers are
+		// generated from it, the reference core looks up its methods in it.
+		enum class AddressingMode
+		{
+			IMP, IMM, ACC, ZP0, ZPX, ZPY, REL, ABS, ABX, ABY, IND, IZX, IZY,
+			ZPI, IAX // 65C02 only
+		};
 
-#ifdef _DEBUG
-			// DEBUG
-			friend class CPUDebugLogger;
-#endif
+		enum class Operation
+		{
+			XXX, NOP, BRK, RTI,
+			LDA, LDX, LDY, STA, STX, STY,
+			TAX, TAY, TXA, TYA, TSX, TXS, PHA, PHP, PLA, PLP,
+			AND, EOR, ORA, BIT, ADC, SBC, CMP, CPX, CPY,
+			INC, INX, INY, DEC, DEX, DEY,
+			ASL, LSR, ROL, ROR,
+			JMP, JSR, RTS,
+			BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS,
+			CLC, CLD, CLI, CLV, SEC, SED, SEI,
+			BRA, PHX, PHY, PLX, PLY, STZ, TRB, TSB // 65C02 only
+		};
+
+		struct OpcodeInfo
+		{
+			const char* Mnemonic;
+			AddressingMode Mode;
+			Operation Op;
+			int BaseCycles;
+		};
+
+		// Opcode plus operand bytes
+		static int GetInstructionLength(AddressingMode mode);
+
+		static constexpr const char* AddressingModeMnemonics[] = {
+			"IMP", "IMM", "ACC", "ZP0", "ZPX", "ZPY", "REL", "ABS", "ABX", "ABY", "IND", "IZX", "IZY",
+			"ZPI", "IAX"
+		};
+
+		using AM = AddressingMode;
+		using OP = Operation;
+		static constexpr OpcodeInfo OpcodeTable[256] = {
+			{ "BRK", AM::IMM, OP::BRK, 7 }, { "ORA", AM::IZX, OP::ORA, 6 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 3 }, { "ORA", AM::ZP0, OP::ORA, 3 }, { "ASL", AM::ZP0, OP::ASL, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "PHP", AM::IMP, OP::PHP, 3 }, { "ORA", AM::IMM, OP::ORA, 2 }, { "ASL", AM::ACC, OP::ASL, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "ORA", AM::ABS, OP::ORA, 4 }, { "ASL", AM::ABS, OP::ASL, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "BPL", AM::REL, OP::BPL, 2 }, { "ORA", AM::IZY, OP::ORA, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "ORA", AM::ZPX, OP::ORA, 4 }, { "ASL", AM::ZPX, OP::ASL, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "CLC", AM::IMP, OP::CLC, 2 }, { "ORA", AM::ABY, OP::ORA, 4 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "ORA", AM::ABX, OP::ORA, 4 }, { "ASL", AM::ABX, OP::ASL, 7 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "JSR", AM::ABS, OP::JSR, 6 }, { "AND", AM::IZX, OP::AND, 6 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "BIT", AM::ZP0, OP::BIT, 3 }, { "AND", AM::ZP0, OP::AND, 3 }, { "ROL", AM::ZP0, OP::ROL, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "PLP", AM::IMP, OP::PLP, 4 }, { "AND", AM::IMM, OP::AND, 2 }, { "ROL", AM::ACC, OP::ROL, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "BIT", AM::ABS, OP::BIT, 4 }, { "AND", AM::ABS, OP::AND, 4 }, { "ROL", AM::ABS, OP::ROL, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "BMI", AM::REL, OP::BMI, 2 }, { "AND", AM::IZY, OP::AND, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "AND", AM::ZPX, OP::AND, 4 }, { "ROL", AM::ZPX, OP::ROL, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "SEC", AM::IMP, OP::SEC, 2 }, { "AND", AM::ABY, OP::AND, 4 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "AND", AM::ABX, OP::AND, 4 }, { "ROL", AM::ABX, OP::ROL, 7 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "RTI", AM::IMP, OP::RTI, 6 }, { "EOR", AM::IZX, OP::EOR, 6 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 3 }, { "EOR", AM::ZP0, OP::EOR, 3 }, { "LSR", AM::ZP0, OP::LSR, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "PHA", AM::IMP, OP::PHA, 3 }, { "EOR", AM::IMM, OP::EOR, 2 }, { "LSR", AM::ACC, OP::LSR, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "JMP", AM::ABS, OP::JMP, 3 }, { "EOR", AM::ABS, OP::EOR, 4 }, { "LSR", AM::ABS, OP::LSR, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "BVC", AM::REL, OP::BVC, 2 }, { "EOR", AM::IZY, OP::EOR, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "EOR", AM::ZPX, OP::EOR, 4 }, { "LSR", AM::ZPX, OP::LSR, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "CLI", AM::IMP, OP::CLI, 2 }, { "EOR", AM::ABY, OP::EOR, 4 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "EOR", AM::ABX, OP::EOR, 4 }, { "LSR", AM::ABX, OP::LSR, 7 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "RTS", AM::IMP, OP::RTS, 6 }, { "ADC", AM::IZX, OP::ADC, 6 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 3 }, { "ADC", AM::ZP0, OP::ADC, 3 }, { "ROR", AM::ZP0, OP::ROR, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "PLA", AM::IMP, OP::PLA, 4 }, { "ADC", AM::IMM, OP::ADC, 2 }, { "ROR", AM::ACC, OP::ROR, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "JMP", AM::IND, OP::JMP, 5 }, { "ADC", AM::ABS, OP::ADC, 4 }, { "ROR", AM::ABS, OP::ROR, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "BVS", AM::REL, OP::BVS, 2 }, { "ADC", AM::IZY, OP::ADC, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "ADC", AM::ZPX, OP::ADC, 4 }, { "ROR", AM::ZPX, OP::ROR, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "SEI", AM::IMP, OP::SEI, 2 }, { "ADC", AM::ABY, OP::ADC, 4 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "ADC", AM::ABX, OP::ADC, 4 }, { "ROR", AM::ABX, OP::ROR, 7 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 2 }, { "STA", AM::IZX, OP::STA, 6 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "STY", AM::ZP0, OP::STY, 3 }, { "STA", AM::ZP0, OP::STA, 3 }, { "STX", AM::ZP0, OP::STX, 3 }, { "XXX", AM::IMP, OP::XXX, 3 },
+			{ "DEY", AM::IMP, OP::DEY, 2 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "TXA", AM::IMP, OP::TXA, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "STY", AM::ABS, OP::STY, 4 }, { "STA", AM::ABS, OP::STA, 4 }, { "STX", AM::ABS, OP::STX, 4 }, { "XXX", AM::IMP, OP::XXX, 4 },
+			{ "BCC", AM::REL, OP::BCC, 2 }, { "STA", AM::IZY, OP::STA, 6 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "STY", AM::ZPX, OP::STY, 4 }, { "STA", AM::ZPX, OP::STA, 4 }, { "STX", AM::ZPY, OP::STX, 4 }, { "XXX", AM::IMP, OP::XXX, 4 },
+			{ "TYA", AM::IMP, OP::TYA, 2 }, { "STA", AM::ABY, OP::STA, 5 }, { "TXS", AM::IMP, OP::TXS, 2 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "XXX", AM::IMP, OP::NOP, 5 }, { "STA", AM::ABX, OP::STA, 5 }, { "XXX", AM::IMP, OP::XXX, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "LDY", AM::IMM, OP::LDY, 2 }, { "LDA", AM::IZX, OP::LDA, 6 }, { "LDX", AM::IMM, OP::LDX, 2 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "LDY", AM::ZP0, OP::LDY, 3 }, { "LDA", AM::ZP0, OP::LDA, 3 }, { "LDX", AM::ZP0, OP::LDX, 3 }, { "XXX", AM::IMP, OP::XXX, 3 },
+			{ "TAY", AM::IMP, OP::TAY, 2 }, { "LDA", AM::IMM, OP::LDA, 2 }, { "TAX", AM::IMP, OP::TAX, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "LDY", AM::ABS, OP::LDY, 4 }, { "LDA", AM::ABS, OP::LDA, 4 }, { "LDX", AM::ABS, OP::LDX, 4 }, { "XXX", AM::IMP, OP::XXX, 4 },
+			{ "BCS", AM::REL, OP::BCS, 2 }, { "LDA", AM::IZY, OP::LDA, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "LDY", AM::ZPX, OP::LDY, 4 }, { "LDA", AM::ZPX, OP::LDA, 4 }, { "LDX", AM::ZPY, OP::LDX, 4 }, { "XXX", AM::IMP, OP::XXX, 4 },
+			{ "CLV", AM::IMP, OP::CLV, 2 }, { "LDA", AM::ABY, OP::LDA, 4 }, { "TSX", AM::IMP, OP::TSX, 2 }, { "XXX", AM::IMP, OP::XXX, 4 },
+			{ "LDY", AM::ABX, OP::LDY, 4 }, { "LDA", AM::ABX, OP::LDA, 4 }, { "LDX", AM::ABY, OP::LDX, 4 }, { "XXX", AM::IMP, OP::XXX, 4 },
+			{ "CPY", AM::IMM, OP::CPY, 2 }, { "CMP", AM::IZX, OP::CMP, 6 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "CPY", AM::ZP0, OP::CPY, 3 }, { "CMP", AM::ZP0, OP::CMP, 3 }, { "DEC", AM::ZP0, OP::DEC, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "INY", AM::IMP, OP::INY, 2 }, { "CMP", AM::IMM, OP::CMP, 2 }, { "DEX", AM::IMP, OP::DEX, 2 }, { "XXX", AM::IMP, OP::XXX, 2 },
+			{ "CPY", AM::ABS, OP::CPY, 4 }, { "CMP", AM::ABS, OP::CMP, 4 }, { "DEC", AM::ABS, OP::DEC, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "BNE", AM::REL, OP::BNE, 2 }, { "CMP", AM::IZY, OP::CMP, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "CMP", AM::ZPX, OP::CMP, 4 }, { "DEC", AM::ZPX, OP::DEC, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "CLD", AM::IMP, OP::CLD, 2 }, { "CMP", AM::ABY, OP::CMP, 4 }, { "NOP", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "CMP", AM::ABX, OP::CMP, 4 }, { "DEC", AM::ABX, OP::DEC, 7 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "CPX", AM::IMM, OP::CPX, 2 }, { "SBC", AM::IZX, OP::SBC, 6 }, { "XXX", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "CPX", AM::ZP0, OP::CPX, 3 }, { "SBC", AM::ZP0, OP::SBC, 3 }, { "INC", AM::ZP0, OP::INC, 5 }, { "XXX", AM::IMP, OP::XXX, 5 },
+			{ "INX", AM::IMP, OP::INX, 2 }, { "SBC", AM::IMM, OP::SBC, 2 }, { "NOP", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::SBC, 2 },
+			{ "CPX", AM::ABS, OP::CPX, 4 }, { "SBC", AM::ABS, OP::SBC, 4 }, { "INC", AM::ABS, OP::INC, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "BEQ", AM::REL, OP::BEQ, 2 }, { "SBC", AM::IZY, OP::SBC, 5 }, { "XXX", AM::IMP, OP::XXX, 2 }, { "XXX", AM::IMP, OP::XXX, 8 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "SBC", AM::ZPX, OP::SBC, 4 }, { "INC", AM::ZPX, OP::INC, 6 }, { "XXX", AM::IMP, OP::XXX, 6 },
+			{ "SED", AM::IMP, OP::SED, 2 }, { "SBC", AM::ABY, OP::SBC, 4 }, { "NOP", AM::IMP, OP::NOP, 2 }, { "XXX", AM::IMP, OP::XXX, 7 },
+			{ "XXX", AM::IMP, OP::NOP, 4 }, { "SBC", AM::ABX, OP::SBC, 4 }, { "INC", AM::ABX, OP::INC, 7 }, { "XXX", AM::IMP, OP::XXX, 7 }
+		};
+
+		// 65C02: new instructions and (zp), (abs,X) addressing; unused opcodes
+		// are NOPs of various lengths. No Rockwell/WDC bit or wait instructions.
+		static constexpr OpcodeInfo OpcodeTable65C02[256] = {
+			{ "BRK", AM::IMM, OP::BRK, 7 }, { "ORA", AM::IZX, OP::ORA, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "TSB", AM::ZP0, OP::TSB, 5 }, { "ORA", AM::ZP0, OP::ORA, 3 }, { "ASL", AM::ZP0, OP::ASL, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "PHP", AM::IMP, OP::PHP, 3 }, { "ORA", AM::IMM, OP::ORA, 2 }, { "ASL", AM::ACC, OP::ASL, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "TSB", AM::ABS, OP::TSB, 6 }, { "ORA", AM::ABS, OP::ORA, 4 }, { "ASL", AM::ABS, OP::ASL, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BPL", AM::REL, OP::BPL, 2 }, { "ORA", AM::IZY, OP::ORA, 5 }, { "ORA", AM::ZPI, OP::ORA, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "TRB", AM::ZP0, OP::TRB, 5 }, { "ORA", AM::ZPX, OP::ORA, 4 }, { "ASL", AM::ZPX, OP::ASL, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CLC", AM::IMP, OP::CLC, 2 }, { "ORA", AM::ABY, OP::ORA, 4 }, { "INC", AM::ACC, OP::INC, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "TRB", AM::ABS, OP::TRB, 6 }, { "ORA", AM::ABX, OP::ORA, 4 }, { "ASL", AM::ABX, OP::ASL, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "JSR", AM::ABS, OP::JSR, 6 }, { "AND", AM::IZX, OP::AND, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BIT", AM::ZP0, OP::BIT, 3 }, { "AND", AM::ZP0, OP::AND, 3 }, { "ROL", AM::ZP0, OP::ROL, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "PLP", AM::IMP, OP::PLP, 4 }, { "AND", AM::IMM, OP::AND, 2 }, { "ROL", AM::ACC, OP::ROL, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BIT", AM::ABS, OP::BIT, 4 }, { "AND", AM::ABS, OP::AND, 4 }, { "ROL", AM::ABS, OP::ROL, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BMI", AM::REL, OP::BMI, 2 }, { "AND", AM::IZY, OP::AND, 5 }, { "AND", AM::ZPI, OP::AND, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BIT", AM::ZPX, OP::BIT, 4 }, { "AND", AM::ZPX, OP::AND, 4 }, { "ROL", AM::ZPX, OP::ROL, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "SEC", AM::IMP, OP::SEC, 2 }, { "AND", AM::ABY, OP::AND, 4 }, { "DEC", AM::ACC, OP::DEC, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BIT", AM::ABX, OP::BIT, 4 }, { "AND", AM::ABX, OP::AND, 4 }, { "ROL", AM::ABX, OP::ROL, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "RTI", AM::IMP, OP::RTI, 6 }, { "EOR", AM::IZX, OP::EOR, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ZP0, OP::NOP, 3 }, { "EOR", AM::ZP0, OP::EOR, 3 }, { "LSR", AM::ZP0, OP::LSR, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "PHA", AM::IMP, OP::PHA, 3 }, { "EOR", AM::IMM, OP::EOR, 2 }, { "LSR", AM::ACC, OP::LSR, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "JMP", AM::ABS, OP::JMP, 3 }, { "EOR", AM::ABS, OP::EOR, 4 }, { "LSR", AM::ABS, OP::LSR, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BVC", AM::REL, OP::BVC, 2 }, { "EOR", AM::IZY, OP::EOR, 5 }, { "EOR", AM::ZPI, OP::EOR, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ZPX, OP::NOP, 4 }, { "EOR", AM::ZPX, OP::EOR, 4 }, { "LSR", AM::ZPX, OP::LSR, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CLI", AM::IMP, OP::CLI, 2 }, { "EOR", AM::ABY, OP::EOR, 4 }, { "PHY", AM::IMP, OP::PHY, 3 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ABS, OP::NOP, 8 }, { "EOR", AM::ABX, OP::EOR, 4 }, { "LSR", AM::ABX, OP::LSR, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "RTS", AM::IMP, OP::RTS, 6 }, { "ADC", AM::IZX, OP::ADC, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "STZ", AM::ZP0, OP::STZ, 3 }, { "ADC", AM::ZP0, OP::ADC, 3 }, { "ROR", AM::ZP0, OP::ROR, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "PLA", AM::IMP, OP::PLA, 4 }, { "ADC", AM::IMM, OP::ADC, 2 }, { "ROR", AM::ACC, OP::ROR, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "JMP", AM::IND, OP::JMP, 6 }, { "ADC", AM::ABS, OP::ADC, 4 }, { "ROR", AM::ABS, OP::ROR, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BVS", AM::REL, OP::BVS, 2 }, { "ADC", AM::IZY, OP::ADC, 5 }, { "ADC", AM::ZPI, OP::ADC, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "STZ", AM::ZPX, OP::STZ, 4 }, { "ADC", AM::ZPX, OP::ADC, 4 }, { "ROR", AM::ZPX, OP::ROR, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "SEI", AM::IMP, OP::SEI, 2 }, { "ADC", AM::ABY, OP::ADC, 4 }, { "PLY", AM::IMP, OP::PLY, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "JMP", AM::IAX, OP::JMP, 6 }, { "ADC", AM::ABX, OP::ADC, 4 }, { "ROR", AM::ABX, OP::ROR, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BRA", AM::REL, OP::BRA, 2 }, { "STA", AM::IZX, OP::STA, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "STY", AM::ZP0, OP::STY, 3 }, { "STA", AM::ZP0, OP::STA, 3 }, { "STX", AM::ZP0, OP::STX, 3 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "DEY", AM::IMP, OP::DEY, 2 }, { "BIT", AM::IMM, OP::BIT, 2 }, { "TXA", AM::IMP, OP::TXA, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "STY", AM::ABS, OP::STY, 4 }, { "STA", AM::ABS, OP::STA, 4 }, { "STX", AM::ABS, OP::STX, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BCC", AM::REL, OP::BCC, 2 }, { "STA", AM::IZY, OP::STA, 6 }, { "STA", AM::ZPI, OP::STA, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "STY", AM::ZPX, OP::STY, 4 }, { "STA", AM::ZPX, OP::STA, 4 }, { "STX", AM::ZPY, OP::STX, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "TYA", AM::IMP, OP::TYA, 2 }, { "STA", AM::ABY, OP::STA, 5 }, { "TXS", AM::IMP, OP::TXS, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "STZ", AM::ABS, OP::STZ, 4 }, { "STA", AM::ABX, OP::STA, 5 }, { "STZ", AM::ABX, OP::STZ, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "LDY", AM::IMM, OP::LDY, 2 }, { "LDA", AM::IZX, OP::LDA, 6 }, { "LDX", AM::IMM, OP::LDX, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "LDY", AM::ZP0, OP::LDY, 3 }, { "LDA", AM::ZP0, OP::LDA, 3 }, { "LDX", AM::ZP0, OP::LDX, 3 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "TAY", AM::IMP, OP::TAY, 2 }, { "LDA", AM::IMM, OP::LDA, 2 }, { "TAX", AM::IMP, OP::TAX, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "LDY", AM::ABS, OP::LDY, 4 }, { "LDA", AM::ABS, OP::LDA, 4 }, { "LDX", AM::ABS, OP::LDX, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BCS", AM::REL, OP::BCS, 2 }, { "LDA", AM::IZY, OP::LDA, 5 }, { "LDA", AM::ZPI, OP::LDA, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "LDY", AM::ZPX, OP::LDY, 4 }, { "LDA", AM::ZPX, OP::LDA, 4 }, { "LDX", AM::ZPY, OP::LDX, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CLV", AM::IMP, OP::CLV, 2 }, { "LDA", AM::ABY, OP::LDA, 4 }, { "TSX", AM::IMP, OP::TSX, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "LDY", AM::ABX, OP::LDY, 4 }, { "LDA", AM::ABX, OP::LDA, 4 }, { "LDX", AM::ABY, OP::LDX, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CPY", AM::IMM, OP::CPY, 2 }, { "CMP", AM::IZX, OP::CMP, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CPY", AM::ZP0, OP::CPY, 3 }, { "CMP", AM::ZP0, OP::CMP, 3 }, { "DEC", AM::ZP0, OP::DEC, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "INY", AM::IMP, OP::INY, 2 }, { "CMP", AM::IMM, OP::CMP, 2 }, { "DEX", AM::IMP, OP::DEX, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CPY", AM::ABS, OP::CPY, 4 }, { "CMP", AM::ABS, OP::CMP, 4 }, { "DEC", AM::ABS, OP::DEC, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BNE", AM::REL, OP::BNE, 2 }, { "CMP", AM::IZY, OP::CMP, 5 }, { "CMP", AM::ZPI, OP::CMP, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ZPX, OP::NOP, 4 }, { "CMP", AM::ZPX, OP::CMP, 4 }, { "DEC", AM::ZPX, OP::DEC, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CLD", AM::IMP, OP::CLD, 2 }, { "CMP", AM::ABY, OP::CMP, 4 }, { "PHX", AM::IMP, OP::PHX, 3 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ABS, OP::NOP, 4 }, { "CMP", AM::ABX, OP::CMP, 4 }, { "DEC", AM::ABX, OP::DEC, 7 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CPX", AM::IMM, OP::CPX, 2 }, { "SBC", AM::IZX, OP::SBC, 6 }, { "NOP", AM::IMM, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CPX", AM::ZP0, OP::CPX, 3 }, { "SBC", AM::ZP0, OP::SBC, 3 }, { "INC", AM::ZP0, OP::INC, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "INX", AM::IMP, OP::INX, 2 }, { "SBC", AM::IMM, OP::SBC, 2 }, { "NOP", AM::IMP, OP::NOP, 2 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "CPX", AM::ABS, OP::CPX, 4 }, { "SBC", AM::ABS, OP::SBC, 4 }, { "INC", AM::ABS, OP::INC, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "BEQ", AM::REL, OP::BEQ, 2 }, { "SBC", AM::IZY, OP::SBC, 5 }, { "SBC", AM::ZPI, OP::SBC, 5 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ZPX, OP::NOP, 4 }, { "SBC", AM::ZPX, OP::SBC, 4 }, { "INC", AM::ZPX, OP::INC, 6 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "SED", AM::IMP, OP::SED, 2 }, { "SBC", AM::ABY, OP::SBC, 4 }, { "PLX", AM::IMP, OP::PLX, 4 }, { "NOP", AM::IMP, OP::NOP, 1 },
+			{ "NOP", AM::ABS, OP::NOP, 4 }, { "SBC", AM::ABX, OP::SBC, 4 }, { "INC", AM::ABX, OP::INC, 7 }, { "NOP", AM::IMP, OP::NOP, 1 }
+		};
+
+	public:
+		// CPU variants, as policies for UseMemoryMap: decimal mode, opcode
+		// table, and whether 65C02 behaviour applies (no JMP ($xxFF) page
+		// wrap bug, D cleared on interrupts)
+		struct NMOS
+		{
+			static constexpr bool DecimalMode = true;
+			static constexpr bool CMOS = false;
+			static constexpr const OpcodeInfo* Opcodes = OpcodeTable;
+		};
+
+		// NES CPU: an NMOS 6502 without the decimal mode hardware; D can
+		// still be set and pushed, but ADC and SBC ignore it
+		struct RP2A03 : NMOS
+		{
+			static constexpr bool DecimalMode = false;
+		};
+
+		struct WDC65C02
+		{
+			static constexpr bool DecimalMode = true;
+			static constexpr bool CMOS = true;
+			static constexpr const OpcodeInfo* Opcodes = OpcodeTable65C02;
+		};
+
+	protected:
+
+		// Reference core: decodes each instruction into an addressing mode
+		// and an operation call, which pass data along in member fields
+		template <class Memory, class Variant>
+		class InstructionHandler : public Core
+		{
+		public:
+			InstructionHandler(MOS6502& parent, Memory& memory);
+
+			int ExecuteNextInstruction() override;
+
+			byte GetLastInstructionOpcode() const override;
+			int GetLastInstructionCycles() const override;
+			std::string GetLastInstructionMnemonic() const override;
+			std::string GetLastInstructionAddressingModeMnemonic() const override;
+
+			// System interrupt signals
+			void IRQ() override;
+			void NMI() override;
+
+		protected:
 			// Reference to parent object
 			MOS6502& CPU;
 
-			// Shorthand for addressing/op methods function pointer
-			typedef void(MOS6502::InstructionHandler::* FuncPtr)();
+			// Memory access policy
+			Memory& MEM;
 
-			// Instruction definition format
-			struct Instruction
-			{
-				Instruction(const char* mnemonic, byte opcode, int baseCycles, FuncPtr addressingFunction, FuncPtr operationFunction)
-					: Mnemonic(mnemonic), Opcode(opcode), BaseCycles(baseCycles), AdressingFunction(addressingFunction), OperationFunction(operationFunction) { }
-
-				const char* Mnemonic;
-				const byte Opcode;
-				const int BaseCycles;
-				const FuncPtr AdressingFunction;
-				const FuncPtr OperationFunction;
-			};
-
-			// Opcode map
-			using o = InstructionHandler;
-			using i = Instruction;
-			Instruction OpcodeMap[256] = {
-				i("BRK", 0x00, 7, &o::IMM, &o::BRK), i("ORA", 0x01, 6, &o::IZX, &o::ORA), i("XXX", 0x02, 2, &o::IMP, &o::XXX), i("XXX", 0x03, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x04, 3, &o::IMP, &o::NOP), i("ORA", 0x05, 3, &o::ZP0, &o::ORA), i("ASL", 0x06, 5, &o::ZP0, &o::ASL), i("XXX", 0x07, 5, &o::IMP, &o::XXX),
-				i("PHP", 0x08, 3, &o::IMP, &o::PHP), i("ORA", 0x09, 2, &o::IMM, &o::ORA), i("ASL", 0x0a, 2, &o::ACC, &o::ASL), i("XXX", 0x0b, 2, &o::IMP, &o::XXX),
-				i("XXX", 0x0c, 4, &o::IMP, &o::NOP), i("ORA", 0x0d, 4, &o::ABS, &o::ORA), i("ASL", 0x0e, 6, &o::ABS, &o::ASL), i("XXX", 0x0f, 6, &o::IMP, &o::XXX),
-				i("BPL", 0x10, 2, &o::REL, &o::BPL), i("ORA", 0x11, 5, &o::IZY, &o::ORA), i("XXX", 0x12, 2, &o::IMP, &o::XXX), i("XXX", 0x13, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x14, 4, &o::IMP, &o::NOP), i("ORA", 0x15, 4, &o::ZPX, &o::ORA), i("ASL", 0x16, 6, &o::ZPX, &o::ASL), i("XXX", 0x17, 6, &o::IMP, &o::XXX),
-				i("CLC", 0x18, 2, &o::IMP, &o::CLC), i("ORA", 0x19, 4, &o::ABY, &o::ORA), i("XXX", 0x1a, 2, &o::IMP, &o::NOP), i("XXX", 0x1b, 7, &o::IMP, &o::XXX),
-				i("XXX", 0x1c, 4, &o::IMP, &o::NOP), i("ORA", 0x1d, 4, &o::ABX, &o::ORA), i("ASL", 0x1e, 7, &o::ABX, &o::ASL), i("XXX", 0x1f, 7, &o::IMP, &o::XXX),
-				i("JSR", 0x20, 6, &o::ABS, &o::JSR), i("AND", 0x21, 6, &o::IZX, &o::AND), i("XXX", 0x22, 2, &o::IMP, &o::XXX), i("XXX", 0x23, 8, &o::IMP, &o::XXX),
-				i("BIT", 0x24, 3, &o::ZP0, &o::BIT), i("AND", 0x25, 3, &o::ZP0, &o::AND), i("ROL", 0x26, 5, &o::ZP0, &o::ROL), i("XXX", 0x27, 5, &o::IMP, &o::XXX),
-				i("PLP", 0x28, 4, &o::IMP, &o::PLP), i("AND", 0x29, 2, &o::IMM, &o::AND), i("ROL", 0x2a, 2, &o::ACC, &o::ROL), i("XXX", 0x2b, 2, &o::IMP, &o::XXX),
-				i("BIT", 0x2c, 4, &o::ABS, &o::BIT), i("AND", 0x2d, 4, &o::ABS, &o::AND), i("ROL", 0x2e, 6, &o::ABS, &o::ROL), i("XXX", 0x2f, 6, &o::IMP, &o::XXX),
-				i("BMI", 0x30, 2, &o::REL, &o::BMI), i("AND", 0x31, 5, &o::IZY, &o::AND), i("XXX", 0x32, 2, &o::IMP, &o::XXX), i("XXX", 0x33, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x34, 4, &o::IMP, &o::NOP), i("AND", 0x35, 4, &o::ZPX, &o::AND), i("ROL", 0x36, 6, &o::ZPX, &o::ROL), i("XXX", 0x37, 6, &o::IMP, &o::XXX),
-				i("SEC", 0x38, 2, &o::IMP, &o::SEC), i("AND", 0x39, 4, &o::ABY, &o::AND), i("XXX", 0x3a, 2, &o::IMP, &o::NOP), i("XXX", 0x3b, 7, &o::IMP, &o::XXX),
-				i("XXX", 0x3c, 4, &o::IMP, &o::NOP), i("AND", 0x3d, 4, &o::ABX, &o::AND), i("ROL", 0x3e, 7, &o::ABX, &o::ROL), i("XXX", 0x3f, 7, &o::IMP, &o::XXX),
-				i("RTI", 0x40, 6, &o::IMP, &o::RTI), i("EOR", 0x41, 6, &o::IZX, &o::EOR), i("XXX", 0x42, 2, &o::IMP, &o::XXX), i("XXX", 0x43, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x44, 3, &o::IMP, &o::NOP), i("EOR", 0x45, 3, &o::ZP0, &o::EOR), i("LSR", 0x46, 5, &o::ZP0, &o::LSR), i("XXX", 0x47, 5, &o::IMP, &o::XXX),
-				i("PHA", 0x48, 3, &o::IMP, &o::PHA), i("EOR", 0x49, 2, &o::IMM, &o::EOR), i("LSR", 0x4a, 2, &o::ACC, &o::LSR), i("XXX", 0x4b, 2, &o::IMP, &o::XXX),
-				i("JMP", 0x4c, 3, &o::ABS, &o::JMP), i("EOR", 0x4d, 4, &o::ABS, &o::EOR), i("LSR", 0x4e, 6, &o::ABS, &o::LSR), i("XXX", 0x4f, 6, &o::IMP, &o::XXX),
-				i("BVC", 0x50, 2, &o::REL, &o::BVC), i("EOR", 0x51, 5, &o::IZY, &o::EOR), i("XXX", 0x52, 2, &o::IMP, &o::XXX), i("XXX", 0x53, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x54, 4, &o::IMP, &o::NOP), i("EOR", 0x55, 4, &o::ZPX, &o::EOR), i("LSR", 0x56, 6, &o::ZPX, &o::LSR), i("XXX", 0x57, 6, &o::IMP, &o::XXX),
-				i("CLI", 0x58, 2, &o::IMP, &o::CLI), i("EOR", 0x59, 4, &o::ABY, &o::EOR), i("XXX", 0x5a, 2, &o::IMP, &o::NOP), i("XXX", 0x5b, 7, &o::IMP, &o::XXX),
-				i("XXX", 0x5c, 4, &o::IMP, &o::NOP), i("EOR", 0x5d, 4, &o::ABX, &o::EOR), i("LSR", 0x5e, 7, &o::ABX, &o::LSR), i("XXX", 0x5f, 7, &o::IMP, &o::XXX),
-				i("RTS", 0x60, 6, &o::IMP, &o::RTS), i("ADC", 0x61, 6, &o::IZX, &o::ADC), i("XXX", 0x62, 2, &o::IMP, &o::XXX), i("XXX", 0x63, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x64, 3, &o::IMP, &o::NOP), i("ADC", 0x65, 3, &o::ZP0, &o::ADC), i("ROR", 0x66, 5, &o::ZP0, &o::ROR), i("XXX", 0x67, 5, &o::IMP, &o::XXX),
-				i("PLA", 0x68, 4, &o::IMP, &o::PLA), i("ADC", 0x69, 2, &o::IMM, &o::ADC), i("ROR", 0x6a, 2, &o::ACC, &o::ROR), i("XXX", 0x6b, 2, &o::IMP, &o::XXX),
-				i("JMP", 0x6c, 5, &o::IND, &o::JMP), i("ADC", 0x6d, 4, &o::ABS, &o::ADC), i("ROR", 0x6e, 6, &o::ABS, &o::ROR), i("XXX", 0x6f, 6, &o::IMP, &o::XXX),
-				i("BVS", 0x70, 2, &o::REL, &o::BVS), i("ADC", 0x71, 5, &o::IZY, &o::ADC), i("XXX", 0x72, 2, &o::IMP, &o::XXX), i("XXX", 0x73, 8, &o::IMP, &o::XXX),
-				i("XXX", 0x74, 4, &o::IMP, &o::NOP), i("ADC", 0x75, 4, &o::ZPX, &o::ADC), i("ROR", 0x76, 6, &o::ZPX, &o::ROR), i("XXX", 0x77, 6, &o::IMP, &o::XXX),
-				i("SEI", 0x78, 2, &o::IMP, &o::SEI), i("ADC", 0x79, 4, &o::ABY, &o::ADC), i("XXX", 0x7a, 2, &o::IMP, &o::NOP), i("XXX", 0x7b, 7, &o::IMP, &o::XXX),
-				i("XXX", 0x7c, 4, &o::IMP, &o::NOP), i("ADC", 0x7d, 4, &o::ABX, &o::ADC), i("ROR", 0x7e, 7, &o::ABX, &o::ROR), i("XXX", 0x7f, 7, &o::IMP, &o::XXX),
-				i("XXX", 0x80, 2, &o::IMP, &o::NOP), i("STA", 0x81, 6, &o::IZX, &o::STA), i("XXX", 0x82, 2, &o::IMP, &o::NOP), i("XXX", 0x83, 6, &o::IMP, &o::XXX),
-				i("STY", 0x84, 3, &o::ZP0, &o::STY), i("STA", 0x85, 3, &o::ZP0, &o::STA), i("STX", 0x86, 3, &o::ZP0, &o::STX), i("XXX", 0x87, 3, &o::IMP, &o::XXX),
-				i("DEY", 0x88, 2, &o::IMP, &o::DEY), i("XXX", 0x89, 2, &o::IMP, &o::NOP), i("TXA", 0x8a, 2, &o::IMP, &o::TXA), i("XXX", 0x8b, 2, &o::IMP, &o::XXX),
-				i("STY", 0x8c, 4, &o::ABS, &o::STY), i("STA", 0x8d, 4, &o::ABS, &o::STA), i("STX", 0x8e, 4, &o::ABS, &o::STX), i("XXX", 0x8f, 4, &o::IMP, &o::XXX),
-				i("BCC", 0x90, 2, &o::REL, &o::BCC), i("STA", 0x91, 6, &o::IZY, &o::STA), i("XXX", 0x92, 2, &o::IMP, &o::XXX), i("XXX", 0x93, 6, &o::IMP, &o::XXX),
-				i("STY", 0x94, 4, &o::ZPX, &o::STY), i("STA", 0x95, 4, &o::ZPX, &o::STA), i("STX", 0x96, 4, &o::ZPY, &o::STX), i("XXX", 0x97, 4, &o::IMP, &o::XXX),
-				i("TYA", 0x98, 2, &o::IMP, &o::TYA), i("STA", 0x99, 5, &o::ABY, &o::STA), i("TXS", 0x9a, 2, &o::IMP, &o::TXS), i("XXX", 0x9b, 5, &o::IMP, &o::XXX),
-				i("XXX", 0x9c, 5, &o::IMP, &o::NOP), i("STA", 0x9d, 5, &o::ABX, &o::STA), i("XXX", 0x9e, 5, &o::IMP, &o::XXX), i("XXX", 0x9f, 5, &o::IMP, &o::XXX),
-				i("LDY", 0xa0, 2, &o::IMM, &o::LDY), i("LDA", 0xa1, 6, &o::IZX, &o::LDA), i("LDX", 0xa2, 2, &o::IMM, &o::LDX), i("XXX", 0xa3, 6, &o::IMP, &o::XXX),
-				i("LDY", 0xa4, 3, &o::ZP0, &o::LDY), i("LDA", 0xa5, 3, &o::ZP0, &o::LDA), i("LDX", 0xa6, 3, &o::ZP0, &o::LDX), i("XXX", 0xa7, 3, &o::IMP, &o::XXX),
-				i("TAY", 0xa8, 2, &o::IMP, &o::TAY), i("LDA", 0xa9, 2, &o::IMM, &o::LDA), i("TAX", 0xaa, 2, &o::IMP, &o::TAX), i("XXX", 0xab, 2, &o::IMP, &o::XXX),
-				i("LDY", 0xac, 4, &o::ABS, &o::LDY), i("LDA", 0xad, 4, &o::ABS, &o::LDA), i("LDX", 0xae, 4, &o::ABS, &o::LDX), i("XXX", 0xaf, 4, &o::IMP, &o::XXX),
-				i("BCS", 0xb0, 2, &o::REL, &o::BCS), i("LDA", 0xb1, 5, &o::IZY, &o::LDA), i("XXX", 0xb2, 2, &o::IMP, &o::XXX), i("XXX", 0xb3, 5, &o::IMP, &o::XXX),
-				i("LDY", 0xb4, 4, &o::ZPX, &o::LDY), i("LDA", 0xb5, 4, &o::ZPX, &o::LDA), i("LDX", 0xb6, 4, &o::ZPY, &o::LDX), i("XXX", 0xb7, 4, &o::IMP, &o::XXX),
-				i("CLV", 0xb8, 2, &o::IMP, &o::CLV), i("LDA", 0xb9, 4, &o::ABY, &o::LDA), i("TSX", 0xba, 2, &o::IMP, &o::TSX), i("XXX", 0xbb, 4, &o::IMP, &o::XXX),
-				i("LDY", 0xbc, 4, &o::ABX, &o::LDY), i("LDA", 0xbd, 4, &o::ABX, &o::LDA), i("LDX", 0xbe, 4, &o::ABY, &o::LDX), i("XXX", 0xbf, 4, &o::IMP, &o::XXX),
-				i("CPY", 0xc0, 2, &o::IMM, &o::CPY), i("CMP", 0xc1, 6, &o::IZX, &o::CMP), i("XXX", 0xc2, 2, &o::IMP, &o::NOP), i("XXX", 0xc3, 8, &o::IMP, &o::XXX),
-				i("CPY", 0xc4, 3, &o::ZP0, &o::CPY), i("CMP", 0xc5, 3, &o::ZP0, &o::CMP), i("DEC", 0xc6, 5, &o::ZP0, &o::DEC), i("XXX", 0xc7, 5, &o::IMP, &o::XXX),
-				i("INY", 0xc8, 2, &o::IMP, &o::INY), i("CMP", 0xc9, 2, &o::IMM, &o::CMP), i("DEX", 0xca, 2, &o::IMP, &o::DEX), i("XXX", 0xcb, 2, &o::IMP, &o::XXX),
-				i("CPY", 0xcc, 4, &o::ABS, &o::CPY), i("CMP", 0xcd, 4, &o::ABS, &o::CMP), i("DEC", 0xce, 6, &o::ABS, &o::DEC), i("XXX", 0xcf, 6, &o::IMP, &o::XXX),
-				i("BNE", 0xd0, 2, &o::REL, &o::BNE), i("CMP", 0xd1, 5, &o::IZY, &o::CMP), i("XXX", 0xd2, 2, &o::IMP, &o::XXX), i("XXX", 0xd3, 8, &o::IMP, &o::XXX),
-				i("XXX", 0xd4, 4, &o::IMP, &o::NOP), i("CMP", 0xd5, 4, &o::ZPX, &o::CMP), i("DEC", 0xd6, 6, &o::ZPX, &o::DEC), i("XXX", 0xd7, 6, &o::IMP, &o::XXX),
-				i("CLD", 0xd8, 2, &o::IMP, &o::CLD), i("CMP", 0xd9, 4, &o::ABY, &o::CMP), i("NOP", 0xda, 2, &o::IMP, &o::NOP), i("XXX", 0xdb, 7, &o::IMP, &o::XXX),
-				i("XXX", 0xdc, 4, &o::IMP, &o::NOP), i("CMP", 0xdd, 4, &o::ABX, &o::CMP), i("DEC", 0xde, 7, &o::ABX, &o::DEC), i("XXX", 0xdf, 7, &o::IMP, &o::XXX),
-				i("CPX", 0xe0, 2, &o::IMM, &o::CPX), i("SBC", 0xe1, 6, &o::IZX, &o::SBC), i("XXX", 0xe2, 2, &o::IMP, &o::NOP), i("XXX", 0xe3, 8, &o::IMP, &o::XXX),
-				i("CPX", 0xe4, 3, &o::ZP0, &o::CPX), i("SBC", 0xe5, 3, &o::ZP0, &o::SBC), i("INC", 0xe6, 5, &o::ZP0, &o::INC), i("XXX", 0xe7, 5, &o::IMP, &o::XXX),
-				i("INX", 0xe8, 2, &o::IMP, &o::INX), i("SBC", 0xe9, 2, &o::IMM, &o::SBC), i("NOP", 0xea, 2, &o::IMP, &o::NOP), i("XXX", 0xeb, 2, &o::IMP, &o::SBC),
-				i("CPX", 0xec, 4, &o::ABS, &o::CPX), i("SBC", 0xed, 4, &o::ABS, &o::SBC), i("INC", 0xee, 6, &o::ABS, &o::INC), i("XXX", 0xef, 6, &o::IMP, &o::XXX),
-				i("BEQ", 0xf0, 2, &o::REL, &o::BEQ), i("SBC", 0xf1, 5, &o::IZY, &o::SBC), i("XXX", 0xf2, 2, &o::IMP, &o::XXX), i("XXX", 0xf3, 8, &o::IMP, &o::XXX),
-				i("XXX", 0xf4, 4, &o::IMP, &o::NOP), i("SBC", 0xf5, 4, &o::ZPX, &o::SBC), i("INC", 0xf6, 6, &o::ZPX, &o::INC), i("XXX", 0xf7, 6, &o::IMP, &o::XXX),
-				i("SED", 0xf8, 2, &o::IMP, &o::SED), i("SBC", 0xf9, 4, &o::ABY, &o::SBC), i("NOP", 0xfa, 2, &o::IMP, &o::NOP), i("XXX", 0xfb, 7, &o::IMP, &o::XXX),
-				i("XXX", 0xfc, 4, &o::IMP, &o::NOP), i("SBC", 0xfd, 4, &o::ABX, &o::SBC), i("INC", 0xfe, 7, &o::ABX, &o::INC), i("XXX", 0xff, 7, &o::IMP, &o::XXX)
-			};
+			// Shorthand for addressing/op methods function pointer
+			typedef void(InstructionHandler::* FuncPtr)();
 
 			// Data cache for use accross "micro-ops" within a single instruction
 			byte m_opcode = 0xEA; // Default to NOP
@@ -186,6 +422,7 @@ namespace Qk
 			byte m_cacheFetchedData = 0;
 			bool m_doFetch = true;
 			int m_additionalCyclesNeeded = 0;
+			bool m_decimalCycle = false;
 
 			bool m_didIRQ = false;
 			bool m_didNMI = false;
@@ -193,6 +430,9 @@ namespace Qk
 			// Common functionality
 			void CallFuncPtr(FuncPtr ptr);
 			byte Fetch();
+			byte Read(word address);
+			byte ReadCode(word address);
+			void Write(word address, byte data);
 
 			// Addressing Modes
 			void IMP(); // Implied
@@ -208,6 +448,8 @@ namespace Qk
 			void IND(); // Indirect
 			void IZX(); // Indexed indirect
 			void IZY(); // Indirect indexed
+			void ZPI(); // Zero page indirect (65C02)
+			void IAX(); // Absolute indexed indirect (65C02)
 
 			// Operations
 			void XXX(); // Unused or unimplemented opcode
@@ -278,102 +520,369 @@ namespace Qk
 			void SEC(); // Set carry flag
 			void SED(); // Set decimal mode flag
 			void SEI(); // Set interrupt disable flag
+
+			void BRA(); // Branch always (65C02)
+			void PHX(); // Push X on stack (65C02)
+			void PHY(); // Push Y on stack (65C02)
+			void PLX(); // Pull X from stack (65C02)
+			void PLY(); // Pull Y from stack (65C02)
+			void STZ(); // Store zero (65C02)
+			void TRB(); // Test and reset bits (65C02)
+			void TSB(); // Test and set bits (65C02)
+
+			// Methods implementing each addressing mode and operation,
+			// in the order of the AddressingMode and Operation enums
+			using o = InstructionHandler;
+			static constexpr FuncPtr AddressingFunctions[] = {
+				&o::IMP, &o::IMM, &o::ACC, &o::ZP0, &o::ZPX, &o::ZPY, &o::REL,
+				&o::ABS, &o::ABX, &o::ABY, &o::IND, &o::IZX, &o::IZY, &o::ZPI, &o::IAX
+			};
+			static constexpr FuncPtr OperationFunctions[] = {
+				&o::XXX, &o::NOP, &o::BRK, &o::RTI, &o::LDA, &o::LDX, &o::LDY, &o::STA, &o::STX, &o::STY,
+				&o::TAX, &o::TAY, &o::TXA, &o::TYA, &o::TSX, &o::TXS, &o::PHA, &o::PHP, &o::PLA, &o::PLP,
+				&o::AND, &o::EOR, &o::ORA, &o::BIT, &o::ADC, &o::SBC, &o::CMP, &o::CPX, &o::CPY, &o::INC,
+				&o::INX, &o::INY, &o::DEC, &o::DEX, &o::DEY, &o::ASL, &o::LSR, &o::ROL, &o::ROR, &o::JMP,
+				&o::JSR, &o::RTS, &o::BCC, &o::BCS, &o::BEQ, &o::BMI, &o::BNE, &o::BPL, &o::BVC, &o::BVS,
+				&o::CLC, &o::CLD, &o::CLI, &o::CLV, &o::SEC, &o::SED, &o::SEI, &o::BRA,
+				&o::PHX, &o::PHY, &o::PLX, &o::PLY, &o::STZ, &o::TRB, &o::TSB
+			};
 		};
-		friend class InstructionHandler;
-	protected:
-#ifdef _DEBUG
-		// DEBUG
-		friend class CPUDebugLogger;
-		CPUDebugLogger* LOGGER;
-#endif
 
-		// Instruction handler object
-		InstructionHandler m_instructionHandler;
+		// Fused core: every opcode is one handler, instantiated from the opcode 
+		// table and inlined into a single switch. Per-instruction state (address,
+		// operand, extra cycles) lives in locals rather than member fields.
+		template <class Memory, class Variant>
+		class FusedCore : public Core
+		{
+		public:
+			FusedCore(MOS6502& parent, Memory& memory);
 
-		// Remaing cycles for current op
-		int m_remainingCycles = 0;
+			int ExecuteNextInstruction() override;
 
-		// Decimal mode hardware available?
-		bool m_decimalModeAvailable = true;
+			byte GetLastInstructionOpcode() const override;
+			int GetLastInstructionCycles() const override;
+			std::string GetLastInstructionMnemonic() const override;
+			std::string GetLastInstructionAddressingModeMnemonic() const override;
 
-		// CPU cycle tracker
-		unsigned long m_cpuCycleCount = 0;
+			// System interrupt signals
+			void IRQ() override;
+			void NMI() override;
 
-		// Status and pending interrupt requests
-		// Deal with at next CPU clock cycle
-		bool m_irqPending = false;
-		bool m_nmiPending = false;
-		bool m_halted = false;
+		protected:
+			// Reference to parent object
+			MOS6502& CPU;
 
-		// Bus I/O
-		byte Read(word address);
-		void Write(word address, byte data);
-	};
+			// Memory access policy
+			Memory& MEM;
 
-	/*
-		DEBUGGING
+			// Last instruction, for cycle count and debugging
+			byte m_opcode = 0xEA; // Default to NOP
+			int m_cycles = 2;
+
+			// Status register bits
+			static constexpr byte FLAG_C = 0x01;
+			static constexpr byte FLAG_Z = 0x02;
+			static constexpr byte FLAG_I = 0x04;
+			static constexpr byte FLAG_D = 0x08;
+			static constexpr byte FLAG_B = 0x10;
+			static constexpr byte FLAG_U = 0x20;
+			static constexpr byte FLAG_V = 0x40;
+			static constexpr byte FLAG_N = 0x80;
+
+			// Common functionality. Handlers work on a local copy of the
+			// registers (R), which the compiler can keep in host registers.
+			byte Read(word address);
+			byte ReadCode(word address);
+			void Write(word address, byte data);
+			void Push(RegisterFile& R, byte data);
+			byte Pull(RegisterFile& R);
+			void SetFlag(RegisterFile& R, byte flag, bool state);
+			int Branch(RegisterFile& R, bool condition, word target);
+			void Interrupt(word vector);
+
+			// N and Z flags, from 'value'; or N from bit 7 of 'n', Z if 'z'
+			// is zero. Lazy handlers don't update those bits of P: they keep
+			// the values the flags derive from until something needs all of
+			// P, 'n' in the upper byte of m_nz and 'z' in the lower. Block
+			// runs do that, see cpu-blocks.h. C and V stay eager: C is read
+			// back by ADC, SBC, rotates and BCC/BCS about as often as it is
+			// written, and V is only written by ADC, SBC and BIT, so deferring
+			// them would move the work to their readers rather than save it.
+			word m_nz = 1;
+
+			template <bool Lazy>
+			void SetNZ(RegisterFile& R, byte value);
+			template <bool Lazy>
+			void SetNZ(RegisterFile& R, byte n, byte z);
+			template <bool Lazy>
+			bool CheckN(const RegisterFile& R) const;
+			template <bool Lazy>
+			bool CheckZ(const RegisterFile& R) const;
+
+			// All of P, e.g. to push it; and setting it
+			template <bool Lazy>
+			byte GetP(const RegisterFile& R) const;
+			template <bool Lazy>
+			void SetP(RegisterFile& R, byte p);
+
+			// Switching between P and the lazy flags
+			void LoadFlags(const RegisterFile& R);
+			void StoreFlags(RegisterFile& R) const;
+
+			// Operand bytes following the opcode: read from memory, or taken
+			// from 'operand' if the block cache decoded them ahead of time
+			template <bool Decoded>
+			byte OperandByte(RegisterFile& R, word operand, int index);
+
+			// Operand access, for a given addressing mode
+			template <AddressingMode Mode, bool Decoded>
+			byte Fetch(RegisterFile& R, word address, word operand);
+
+			template <AddressingMode Mode>
+			void Store(RegisterFile& R, word address, byte data);
+
+			// Instruction handlers; return duration in cycles
+			template <byte Opcode>
+			int ExecuteOpcode(RegisterFile& R);
+
+			template <AddressingMode Mode, Operation Op, int BaseCycles, bool Decoded = false, bool Lazy = false>
+			int Execute(RegisterFile& R, word operand = 0);
+		};
 
-			100% "Dirtiest logging solution you've ever seen" guarantee
-	*/
+		// Block cache core: runs the fused core's handlers on instructions
+		// decoded ahead of time, a basic block at a time. Blocks are decoded
+		// from ROM only, as found in the bus page table, and are dropped
+		// whenever the page table changes (bank switches). Code anywhere else,
+		// e.g. in RAM, runs on the plain fused core. Defined in cpu-blocks.h.
+		template <class Memory, class Variant>
+		class BlockCore : public FusedCore<Memory, Variant>
+		{
+		public:
+			BlockCore(MOS6502& parent, Memory& memory);
 
-#ifdef _DEBUG
+			int ExecuteBlock(BlockHost& host) override;
 
-	class CPUDebugFrame
-	{
-	public:
-		struct CPUState {
-			int A = 0;
-			int X = 0;
-			int Y = 0;
-			int P = 0;
-			int S = 0;
-			int PC = 0;
-			int AddressedLocation = 0;
-			int FetchedData = 0;
-		} PreOpState, PostOpState;
-
-		struct ReadWriteEvent
-		{
-			bool IsWrite = false;
-			int Address = 0;
-			int Value = 0;
+		protected:
+			// Handler for one opcode, with its operand bytes at hand
+			typedef int(*Handler)(BlockCore& core, RegisterFile& R, word operand);
+
+			struct Instruction
+			{
+				Handler Execute;
+				word Operand;
+				byte Opcode;
+			};
+
+			// Straight-line code from Start up to and including the first
+			// jump, branch, return or interrupt, or as long as fits
+			static constexpr int MAX_BLOCK_LENGTH = 16;
+			static constexpr int CACHE_SIZE = 1024; // Blocks; direct-mapped by start address
+
+			struct Block
+			{
+				dword Generation;
+				word Start;
+				int Length;
+				bool MayIdle;	// Only reads memory, then jumps back to Start
+				int Polled;	// I/O register it reads, or -1
+				Instruction Code[MAX_BLOCK_LENGTH];
+			};
+
+			// A block that may idle, as it runs: once two runs in a row leave
+			// the registers as they found them, every run after that will too,
+			// for as long as what it reads stays the same
+			struct IdleWatch
+			{
+				const Block* Loop = nullptr;
+				RegisterFile Entry = {};
+				int Start = 0;
+				int Streak = 0;
+			};
+
+			std::unique_ptr<Block[]> m_blocks;
+			dword m_generation;
+
+			const Block* Lookup(word address);
+			void Decode(Block& block, word address);
+			const byte* GetCode(word address) const;
+			void DetectIdleLoop(Block& block) const;
+
+			// Around each run of a whole block
+			void WatchIdle(IdleWatch& watch, const Block& block, int cycles);
+			void SkipIdle(BlockHost& host, IdleWatch& watch, const Block& block, int& cycles);
+
+			// Running blocks, for a host that does or doesn't look at the
+			// registers in between instructions (see BlockHost)
+			template <bool Watched>
+			int RunBlocks(BlockHost& host);
+			template <bool Watched>
+			bool MayContinue(BlockHost& host, int cycles);
+
+			template <byte Opcode>
+			static int ExecuteDecoded(BlockCore& core, RegisterFile& R, word operand);
+
+			static const Handler Handlers[256];
 		};
 
-		unsigned long Cycle = 0;
-		int Opcode = 0;
-		std::string OpcodeMnemonic;
-		std::string AddressingModeMnemonic;
-		std::vector<ReadWriteEvent*> IOEvents;
+#ifdef QK_JIT_AVAILABLE
+		// Translates decoded instructions to x86-64 code; see cpu-jit.h
+		class JitCompiler;
+
+		// JIT core: block cache core that compiles blocks to x86-64 machine
+		// code once they've run a few times. Compiled code only accesses RAM
+		// and ROM, straight through the bus page table; for anything else (I/O
+		// registers, decimal mode, interrupts, code outside ROM) it hands back
+		// to the block core's handlers. Defined in cpu-jit.h.
+		template <class Memory, class Variant>
+		class JitCore : public BlockCore<Memory, Variant>
+		{
+		public:
+			JitCore(MOS6502& parent, Memory& memory, bool lockstep);
+			~JitCore();
 
-	public:
-		CPUDebugFrame();
-		~CPUDebugFrame();
+			int ExecuteBlock(BlockHost& host) override;
 
-		std::string ToString() const;
-		std::string ToJSONString() const;
-	};
+		protected:
+			using typename BlockCore<Memory, Variant>::Block;
 
-	class CPUDebugLogger
-	{
-	public:
-		std::vector<CPUDebugFrame*> Frames;
-		CPUDebugFrame* CurrentFrame;
+			static constexpr int COMPILE_THRESHOLD = 4; // Runs of a block before it's compiled
 
-	public:
-		CPUDebugLogger(MOS6502& cpu);
-		~CPUDebugLogger();
+			// Native entry point for each instruction of a block,
+			// or nullptr for instructions left to the handlers
+			struct CompiledBlock
+			{
+				dword Generation;
+				dword Epoch;
+				word Start;
+				int Runs;
+				const byte* Entry[BlockCore<Memory, Variant>::MAX_BLOCK_LENGTH];
+			};
+
+			std::unique_ptr<JitCompiler> m_compiler;
+			std::unique_ptr<CompiledBlock[]> m_compiled;
+			dword m_pagesGeneration;
+			bool m_lockstep;
+
+			// Lockstep validation buffers
+			std::vector<byte> m_memoryBefore;
+			std::vector<byte> m_memoryAfter;
+
+			const CompiledBlock* GetCompiled(const Block& block);
 
-		void NewFrame();
-		void RecordIOEvent(word address, byte value, bool isWrite);
-		void RecordPreOpCPUState();
-		void RecordPostOpCPUState();
+			template <bool Watched>
+			int RunBlocks(BlockHost& host);
 
-		void PrintFrameDebugInfo() const;
-		void SaveDebugInfo(const std::string& filepath) const;
+			// Run compiled code from instruction 'index' of a block on; returns
+			// the index of the first instruction it left to the handlers
+			int RunCompiled(BlockHost& host, const byte* entry, int index, int& cycles);
+			int RunLockstep(BlockHost& host, const Block& block, const byte* entry, int index, int& cycles);
+			void SavePages(std::vector<byte>& buffer) const;
+			void RestorePages(const std::vector<byte>& buffer);
+		};
+#endif
+
+		// Memory access policy wrapper that records every access into the
+		// CPU's trace, for the traced core
+		template <class Memory>
+		class TracedMemory
+		{
+		public:
+			TracedMemory(MOS6502& cpu, Memory& memory) : m_cpu(cpu), m_memory(memory) { }
+
+			byte Read(word address);
+			void Write(word address, byte data);
+
+		protected:
+			MOS6502& m_cpu;
+			Memory& m_memory;
+		};
+
+		// Traced core: the fused core, on the same memory access policy as
+		// the core in use, with every access recorded. Runs the instructions
+		// being traced; defined in cpu-ops.h.
+		template <class Memory, class Variant>
+		class TracedCore : private TracedMemory<Memory>, public FusedCore<TracedMemory<Memory>, Variant>
+		{
+		public:
+			TracedCore(MOS6502& parent, Memory& memory);
+		};
+
+		friend class CPUTrace;
+		friend class CPUProfiler;
+		friend class CPUCallProfiler;
 
 	protected:
-		MOS6502& m_cpu;
+		// Instruction handler object, bound to the memory access policy in use
+		BusMemory m_busMemory;
+		std::unique_ptr<Core> m_instructionHandler;
+
+		// Trace being recorded into, if any, and the core running instructions
+		// traced. Code fetches bypass the fetch window while tracing.
+		CPUTrace* m_trace = nullptr;
+		std::unique_ptr<Core> m_tracedHandler;
+		const OpcodeInfo* m_opcodes = OpcodeTable;
+		bool m_tracing = false;
+
+		// Profiles being counted into, if any
+		CPUProfiler* m_profiler = nullptr;
+		CPUCallProfiler* m_callProfiler = nullptr;
+
+		// Any of the above attached: step through InstrumentedStep()
+		bool m_instrumented = false;
+		void UpdateInstrumented();
+
+		// One instruction or interrupt sequence, on a given core; and
+		// with tracing and profiling
+		int Execute(Core& core);
+		int InstrumentedStep();
+		int TraceStep();
+
+		// Remaing cycles for current op
+		int m_remainingCycles = 0;
+
+		// Idle loop fast-forward
+		bool m_idleLoopSkipping = true;
+		qword m_idleCyclesSkipped = 0;
+
+		// CPU cycle tracker
+		qword m_cpuCycleCount = 0;
+
+		// Status; pending interrupt requests are
+		// held by the bus' NMI and IRQ lines
+		bool m_halted = false;
+
+		// Bus I/O
+		byte Read(word address);
+		void Write(word address, byte data);
+
+		// Instruction fetch window: host pointer to the 256-byte page code was
+		// last fetched from, if that's plain memory (RAM or ROM). Opcode and
+		// operand fetches there are a pointer dereference. Moved on page
+		// crossings, and whenever the bus page table changes: a mapper write
+		// that switches PRG banks rebuilds it (CartridgeSlot::WriteToDevice).
+		const byte* m_fetchMemory = nullptr;
+		int m_fetchPage = -1;
+		dword m_fetchGeneration = 0;
+
+		// Host pointer to the code byte at address, or nullptr if
+		// it must be read through the memory access policy
+		const byte* FetchWindow(word address);
 	};
 
-#endif
+
+	/*
+		Instruction fetch fast path -- inline, as every code byte goes through here
+	*/
+
+	inline const byte* MOS6502::FetchWindow(word address)
+	{
+		if ((address >> 8) != m_fetchPage || BUS.GetMappingGeneration() != m_fetchGeneration)
+		{
+			m_fetchPage = address >> 8;
+			m_fetchGeneration = BUS.GetMappingGeneration();
+			m_fetchMemory = m_tracing ? nullptr : BUS.GetDirectPage(address, false);
+		}
+
+		return m_fetchMemory != nullptr ? m_fetchMemory + (address & 0x00FF) : nullptr;
+	}
 }
\ No newline at end of file
@@ -1,13 +1,21 @@
 #pragma once
 
 #include <cstdint>
-#include <exception>
+#include <stdexcept>
+
+// For hot paths where the compiler's inlining heuristics give up too early
+#if defined(_MSC_VER)
+#define QK_FORCEINLINE __forceinline
+#else
+#define QK_FORCEINLINE inline __attribute__((always_inline))
+#endif
 
 namespace Qk 
 {
 	typedef uint8_t byte;
 	typedef uint16_t word;
 	typedef uint32_t dword;
+	typedef uint64_t qword;
 
 	struct AddressRange
 	{
@@ -18,8 +26,8 @@ namespace Qk
 
 	struct Pixel
 	{
-		Pixel() : Red(0), Green(0), Blue(0) { };
-		Pixel(byte r, byte g, byte b) : Red(r), Green(g), Blue(b) { };
+		constexpr Pixel() : Red(0), Green(0), Blue(0) { };
+		constexpr Pixel(byte r, byte g, byte b) : Red(r), Green(g), Blue(b) { };
 		byte Red;
 		byte Green;
 		byte Blue;
@@ -35,13 +43,13 @@ namespace Qk
 
 	typedef uint8_t audiosample;
 
-	class QkError : public std::exception
+	class QkError : public std::runtime_error
 	{
 	protected:
 		int m_errorCode = 0;
 
 	public:
-		QkError(const char* message, const int errorCode) : exception(message), m_errorCode(errorCode) {};
+		QkError(const char* message, const int errorCode) : runtime_error(message), m_errorCode(errorCode) {};
 		int code() const { return m_errorCode; };
 	};
 }
\ No newline at end of file
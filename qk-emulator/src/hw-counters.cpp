@@ -0,0 +1,242 @@
+#include <iomanip>
+#include "hw-counters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+using namespace Qk;
+
+
+const char* const HardwareCounters::EventNames[EVENT_COUNT] = {
+	"cycles", "instructions", "branch-misses", "L1-dcache-load-misses", "LLC-load-misses", "iTLB-load-misses"
+};
+
+
+/*
+	Opening and closing
+*/
+
+HardwareCounters::~HardwareCounters()
+{
+	Close();
+}
+
+#ifdef __linux__
+
+bool HardwareCounters::Open()
+{
+	Close();
+	m_error.clear();
+
+	auto cache = [](qword cache) {
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	};
+
+	const struct { dword Type; qword Config; } events[EVENT_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D) },
+		{ PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL) },
+		{ PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_ITLB) },
+	};
+
+	for (int n = 0; n < EVENT_COUNT; n++)
+	{
+		// Not grouped, so that one the PMU lacks doesn't take the rest with
+		// it; user space only, as unprivileged users may only count that
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[n].Type;
+		attr.config = events[n].Config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		m_fd[n] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		m_available[n] = m_fd[n] >= 0;
+
+		if (m_fd[n] < 0 && m_error.empty())
+			m_error = std::string("perf_event_open: ") + std::strerror(errno);
+	}
+
+	if (!IsAnyAvailable())
+		return false;
+
+	m_error.clear();
+
+	for (int fd : m_fd)
+	{
+		if (fd >= 0)
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	m_frameStart = Read();
+	return true;
+}
+
+void HardwareCounters::Close()
+{
+	for (int& fd : m_fd)
+	{
+		if (fd >= 0)
+			close(fd);
+
+		fd = -1;
+	}
+}
+
+HardwareCounters::Sample HardwareCounters::Read() const
+{
+	Sample sample;
+
+	for (int n = 0; n < EVENT_COUNT; n++)
+	{
+		qword data[3];	// Value, time enabled, time running
+
+		if (m_fd[n] < 0 || read(m_fd[n], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+			continue;
+
+		sample.Values[n] = data[2] < data[1] ? (qword)((double)data[0] * data[1] / data[2]) : data[0];
+	}
+
+	return sample;
+}
+
+#else
+
+bool HardwareCounters::Open()
+{
+	m_error = "hardware counters need Linux perf_event_open";
+	return false;
+}
+
+void HardwareCounters::Close()
+{
+}
+
+HardwareCounters::Sample HardwareCounters::Read() const
+{
+	return Sample();
+}
+
+#endif
+
+bool HardwareCounters::IsAnyAvailable() const
+{
+	for (bool available : m_available)
+	{
+		if (available)
+			return true;
+	}
+
+	return false;
+}
+
+HardwareCounters::Sample HardwareCounters::Difference(const Sample& from, const Sample& to)
+{
+	// Scaled counts can step back a little; clamp rather than wrap
+	Sample sample;
+
+	for (int n = 0; n < EVENT_COUNT; n++)
+		sample.Values[n] = to.Values[n] > from.Values[n] ? to.Values[n] - from.Values[n] : 0;
+
+	return sample;
+}
+
+
+/*
+	Frames
+*/
+
+void HardwareCounters::BeginFrame()
+{
+	m_frameStart = Read();
+}
+
+void HardwareCounters::EndFrame()
+{
+	// Without counters, an empty sample; the frames are still listed
+	m_frames.push_back(Difference(m_frameStart, Read()));
+}
+
+
+/*
+	Output
+*/
+
+void HardwareCounters::WriteCSV(std::ostream& out) const
+{
+	out << "frame";
+
+	for (int n = 0; n < EVENT_COUNT; n++)
+	{
+		if (m_available[n])
+			out << "," << EventNames[n];
+	}
+
+	out << std::endl;
+
+	for (std::size_t f = 0; f < m_frames.size(); f++)
+	{
+		out << f;
+
+		for (int n = 0; n < EVENT_COUNT; n++)
+		{
+			if (m_available[n])
+				out << "," << m_frames[f].Values[n];
+		}
+
+		out << std::endl;
+	}
+}
+
+void HardwareCounters::WriteSummary(std::ostream& out) const
+{
+	if (!IsAnyAvailable())
+	{
+		out << "counters:  unavailable (" << m_error << ")" << std::endl;
+		return;
+	}
+
+	Sample total;
+
+	for (const Sample& frame : m_frames)
+	{
+		for (int n = 0; n < EVENT_COUNT; n++)
+			total.Values[n] += frame.Values[n];
+	}
+
+	double frames = m_frames.empty() ? 1.0 : (double)m_frames.size();
+	double instructions = (double)total.Get(Event::Instructions);
+
+	out << std::left << std::setw(24) << "counter" << std::right << std::setw(15) << "per frame"
+		<< std::setw(16) << "total" << std::setw(15) << "per 1k instr" << std::endl;
+
+	for (int n = 0; n < EVENT_COUNT; n++)
+	{
+		if (!m_available[n])
+			continue;
+
+		out << std::left << std::setw(24) << EventNames[n] << std::right << std::fixed
+			<< std::setprecision(0) << std::setw(15) << total.Values[n] / frames
+			<< std::setw(16) << total.Values[n];
+
+		if (n >= (int)Event::BranchMisses && IsAvailable(Event::Instructions) && instructions > 0)
+			out << std::setprecision(3) << std::setw(15) << total.Values[n] * 1000.0 / instructions;
+
+		out << std::endl;
+	}
+
+	if (IsAvailable(Event::Cycles) && IsAvailable(Event::Instructions) && total.Get(Event::Cycles) > 0)
+		out << "ipc:       " << std::setprecision(3) << instructions / total.Get(Event::Cycles) << std::endl;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "definitions.h"
+
+
+namespace Qk
+{
+	/*
+		Host hardware performance counters: cycles, instructions, branch
+		misses and L1D, LLC and iTLB misses on the calling thread, user space
+		only, through Linux perf_event_open. Read around a measured region, or
+		per emulated frame, they tell whether a change helped the branch
+		predictor or the caches rather than just the wall clock.
+
+		Counters the host won't give us (other CPUs, virtual machines,
+		containers, perf_event_paranoid, not Linux) are left out; if none are
+		left, Open fails and everything else does nothing.
+	*/
+
+	class HardwareCounters
+	{
+	public:
+		enum class Event
+		{
+			Cycles,
+			Instructions,
+			BranchMisses,
+			L1DMisses,		// Loads
+			LLCMisses,		// Loads
+			ITLBMisses,
+			Count
+		};
+
+		static constexpr int EVENT_COUNT = (int)Event::Count;
+		static const char* const EventNames[EVENT_COUNT];
+
+		struct Sample
+		{
+			qword Values[EVENT_COUNT] = {};
+
+			qword Get(Event event) const { return Values[(int)event]; }
+		};
+
+	public:
+		HardwareCounters() = default;
+		~HardwareCounters();
+
+		HardwareCounters(const HardwareCounters&) = delete;
+		HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+		// Open and start the counters for the calling thread; false if none
+		// could be, see GetError. Close stops them; what they counted stays.
+		bool Open();
+		void Close();
+
+		bool IsAvailable(Event event) const { return m_available[(int)event]; }
+		bool IsAnyAvailable() const;
+		const std::string& GetError() const { return m_error; }
+
+		// Counts since Open, scaled up if the kernel had to share the
+		// hardware between counters; unavailable ones read 0
+		Sample Read() const;
+		static Sample Difference(const Sample& from, const Sample& to);
+
+		// Per frame, between these two
+		void BeginFrame();
+		void EndFrame();
+
+		qword GetFrameCount() const { return m_frames.size(); }
+
+		// Frame counts, one CSV row per frame and a column per available
+		// counter
+		void WriteCSV(std::ostream& out) const;
+
+		// Totals and per frame averages, with instructions per cycle and
+		// misses per thousand instructions
+		void WriteSummary(std::ostream& out) const;
+
+	protected:
+		int m_fd[EVENT_COUNT] = { -1, -1, -1, -1, -1, -1 };
+		bool m_available[EVENT_COUNT] = {};
+		std::string m_error;
+
+		Sample m_frameStart;
+		std::vector<Sample> m_frames;
+	};
+}
@@ -12,6 +12,10 @@ MemoryMirror::MemoryMirror(Bus& bus, Bus::Device& mirroredDevice, const AddressR
 	AddressRange r = m_mirroredDevice.GetAddressableRange();
 	m_mirrorLength = r.Max - r.Min;
 	m_mirroredDeviceBaseAddress = r.Min;
+
+	// Mirror is resolved at map time: have the bus route our range
+	// straight to the mirrored device, so we're never called at runtime
+	RedirectBusMapping(m_mirroredDevice, m_mirroredDeviceBaseAddress, (word)m_mirrorLength);
 }
 
 /*
@@ -39,10 +43,10 @@ word MemoryMirror::GetMirroredAddress(word address)
 
 byte MemoryMirror::ReadFromDevice(word address, bool peek)
 {
-	return m_mirroredDevice.ReadFromDevice(GetMirroredAddress(address));
+	return m_mirroredDevice.ReadFromDevice(GetMirroredAddress(address), peek);
 }
 
 void MemoryMirror::WriteToDevice(word address, byte data)
 {
 	m_mirroredDevice.WriteToDevice(GetMirroredAddress(address), data);
-}
\ No newline at end of file
+}
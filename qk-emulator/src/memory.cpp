@@ -3,6 +3,7 @@
 #endif
 
 #include <fstream>
+#include <algorithm>
 #include "memory.h"
 
 using namespace Qk;
@@ -21,6 +22,9 @@ RAM::RAM(Bus& bus, const AddressRange& addressableRange)
 {
 	m_size = addressableRange.Max - addressableRange.Min + 1;
 	m_data = new byte[m_size](); // Allocate to heap and initialize "RAM"
+
+	// Memory exists now; let the bus map our pages directly
+	RefreshBusMapping();
 }
 
 RAM::~RAM()
@@ -46,6 +50,11 @@ word RAM::GetSize() const
 	return m_size;
 }
 
+void RAM::Clear()
+{
+	std::fill(m_data, m_data + m_size, 0);
+}
+
 byte RAM::ReadFromDevice(word address, bool peek)
 {
 	word localAddress = LocalizeAddress(address);
@@ -60,6 +69,17 @@ void RAM::WriteToDevice(word address, byte data)
 	m_data[localAddress] = data;
 }
 
+byte* RAM::GetDirectMemory(word address, bool isWrite)
+{
+	unsigned int localAddress = LocalizeAddress(address);
+
+	// Whole page must fit in our memory
+	if (localAddress + 0x00FF >= m_size)
+		return nullptr;
+
+	return m_data + localAddress;
+}
+
 
 /**************************************************
 	ROM (Generic ROM emulation)
@@ -68,7 +88,8 @@ void RAM::WriteToDevice(word address, byte data)
 
 ROM::ROM(Bus& bus, const AddressRange& addressableRange) : RAM(bus, addressableRange)
 {
-
+	// Remap now that we're a ROM -- RAM constructor mapped our pages writable
+	RefreshBusMapping();
 }
 
 void ROM::WriteToDevice(word address, byte data)
@@ -79,6 +100,15 @@ void ROM::WriteToDevice(word address, byte data)
 	return;
 }
 
+byte* ROM::GetDirectMemory(word address, bool isWrite)
+{
+	// Reads only -- writes must end up in WriteToDevice
+	if (isWrite)
+		return nullptr;
+
+	return RAM::GetDirectMemory(address, false);
+}
+
 bool ROM::LoadROM(const std::string& filepath)
 {
 	std::ifstream input(filepath, std::ios::binary);
@@ -20,8 +20,10 @@ namespace Qk
 		~RAM();
 
 		word GetSize() const;
+		void Clear();
 		byte ReadFromDevice(word address, bool peek = false) override;
 		void WriteToDevice(word address, byte data) override;
+		byte* GetDirectMemory(word address, bool isWrite) override;
 	};
 
 	class ROM : public RAM
@@ -29,6 +31,7 @@ namespace Qk
 	public:
 		ROM(Bus& bus, const AddressRange& addressableRange);
 		void WriteToDevice(word address, byte data) override;
+		byte* GetDirectMemory(word address, bool isWrite) override;
 		bool LoadROM(const std::string& path);
 	};
 }
@@ -1,4 +1,5 @@
 #include "nes-apu.h"
+#include "timers.h"
 #include <iostream>
 
 
@@ -6,29 +7,77 @@ using namespace Qk;
 using namespace Qk::NES;
 
 
+// Lookup table storage (constexpr static members need one pre-C++17)
+constexpr APUMixerTables APU::MixerTables;
+constexpr byte APU::LengthTable[32];
+constexpr byte APU::DutyTable[4][8];
+constexpr byte APU::TriangleTable[64];
+constexpr byte APU::DMCTable[16];
+constexpr word APU::NoiseTable[16];
+
+
 /*
 	Constructors, intitializtion
 */
 
 APU::APU(Bus& bus)
-	: Bus::Device(bus, true, AddressRange(0x4000, 0x4015)),
+	: Bus::Device(bus, true, AddressRange(0x4000, 0x4013)),
 	  ChPulse1(*this, 1), ChPulse2(*this, 2), ChTriangle(*this),
-	  ChNoise(*this), m_audiobuffer(APU_SAMPLE_BUFFER_SIZE)
+	  ChNoise(*this), m_audiobuffer(APU_SAMPLE_QUEUE_SIZE)
 {
 	Initialize();
 }
 
 APU::APU(Bus& bus, const AddressRange& addressableRange)
-	: Bus::Device(bus, true, AddressRange(0x4000, 0x4015)),
+	: Bus::Device(bus, true, AddressRange(0x4000, 0x4013)),
 	  ChPulse1(*this, 1), ChPulse2(*this, 2), ChTriangle(*this),
-	  ChNoise(*this), m_audiobuffer(APU_SAMPLE_BUFFER_SIZE)
+	  ChNoise(*this), m_audiobuffer(APU_SAMPLE_QUEUE_SIZE)
 {
 	Initialize();
 }
 
 void APU::Initialize()
 {
-	PopulateMixerLookupTables();
+#ifdef NES_AUDIO_ENABLED
+	// Frame counter steps at fixed intervals, so rather than counting them
+	// down every cycle, have the scheduler tell us when the next one is due
+	ListenForSignal(SIGNAL_APU_FRC);
+	BUS.Events.Post(BUS.Events.Now(), SIGNAL_APU_FRC);
+#endif
+
+	// Status and frame counter registers lie past $4014 (OAM DMA, owned by
+	// the PPU). $4017 reads belong to the controllers; we only take writes.
+	MapReadHandler(AddressRange(0x4015, 0x4015), &APU::ReadFromDevice);
+	MapWriteHandler(AddressRange(0x4015, 0x4015), &APU::WriteToDevice);
+	MapWriteHandler(AddressRange(0x4017, 0x4017), &APU::WriteToDevice);
+
+	Reset();
+}
+
+void APU::PowerOn()
+{
+	// Back to the state we were constructed in
+	ChPulse1 = PulseChannel(*this, 1);
+	ChPulse2 = PulseChannel(*this, 2);
+	ChTriangle = TriangleChannel(*this);
+	ChNoise = NoiseChannel(*this);
+
+	FrameCounter = decltype(FrameCounter)();
+	m_fcUpdateInterval = (int)(NES_CPU_CLOCK_FREQ / 240.0);
+	m_updateLengths = true;
+	m_cycleCount = 0;
+
+	// Samples already queued are left to play out; the
+	// audio device may be reading them as we speak
+	m_sampleBatchCount = 0;
+	m_sampleInterval = APU_SAMPLE_INTERVAL_CYCLES;
+	m_sampleIntervalCounter = 0;
+
+#ifdef NES_AUDIO_ENABLED
+	BUS.Events.Cancel(SIGNAL_APU_FRC);
+	BUS.Events.Post(BUS.Events.Now(), SIGNAL_APU_FRC);
+#endif
+
 	Reset();
 }
 
@@ -59,21 +108,27 @@ double APU::GetAudioSampleRate() const
 
 void APU::FillAudioBuffer(audiosample* buffer, size_t numSamples)
 {
+	// Called from the audio device's thread. Play whatever has been generated;
+	// if emulation is behind, hold the last sample rather than click.
+	size_t count = m_audiobuffer.Read(buffer, numSamples);
 
-	// Buffer may be accessed from different thread
-	// that is feeding the audio device, so acquire
-	// a lock before checking/changing the buffer's state
-	std::lock_guard<std::mutex> lock(m_buffermutex);
+	if (count > 0)
+		m_lastSamplePlayed = buffer[count - 1];
 
-	if (numSamples > m_audiobuffer.GetSize())
+	for (size_t i = count; i < numSamples; i++)
 	{
-		// Will likely be thrown in a thread other than main thread,
-		// which is inconvenient -- renderer implementation will have 
-		// to deal with that (or better yet: just not cause silly errors)
-		throw QkError("APU error: incompatible buffer size", 710);
+		buffer[i] = m_lastSamplePlayed;
 	}
+}
+
+qword APU::GetAudioUnderrunCount() const
+{
+	return m_audiobuffer.GetUnderrunCount();
+}
 
-	m_audiobuffer.Copy(buffer, numSamples);
+qword APU::GetAudioOverrunCount() const
+{
+	return m_audiobuffer.GetOverrunCount();
 }
 
 
@@ -83,10 +138,6 @@ void APU::FillAudioBuffer(audiosample* buffer, size_t numSamples)
 
 void APU::Cycle()
 {
-#ifndef NES_AUDIO_ENABLED	// APU code does not work as of now, so audio is disabled
-	return;
-#endif
-
 	// CHANNEL TIMERS
 	if (m_updateLengths)
 	{
@@ -104,37 +155,55 @@ void APU::Cycle()
 		ChTriangle.UpdateTimer();
 	}
 
-	// FRAME COUNTER
-	if (FrameCounterClock())
-	{
-		UpdateFrameCounter();
-	}
-
 	// GENERATE SAMPLE
 	if (SampleClock())
 	{
-		audiosample sample = MixSample();
+		m_sampleBatch[m_sampleBatchCount++] = MixSample();
 
-		// Buffer may be accessed from different thread
-		// that is feeding the audio device, so acquire
-		// a lock before changing the buffer's state
-		std::unique_lock<std::mutex> lock(m_buffermutex);
-		m_audiobuffer.Push(sample);
-		lock.unlock();
+		if (m_sampleBatchCount == APU_SAMPLE_BATCH_SIZE)
+			FlushSamples();
 	}
 }
 
-bool APU::FrameCounterClock()
+void APU::FlushSamples()
+{
+	// Hand generated samples to the audio queue
+	m_audiobuffer.Write(m_sampleBatch, m_sampleBatchCount);
+	m_sampleBatchCount = 0;
+}
+
+void APU::RunUntil(qword cycle)
 {
-	if (m_fcUpdateCounter == 0)
+	// Catch up with CPU: run cycles up to (not including) 'cycle'
+	QK_TIMER(APU);
+
+#ifdef NES_AUDIO_ENABLED
+	while (m_cycleCount < cycle)
 	{
-		m_fcUpdateCounter = m_fcUpdateInterval;
-		return true;
+		Cycle();
+		m_cycleCount++;
 	}
-	else
+
+	FlushSamples();
+#else
+	// APU code does not work as of now, so audio is disabled; nothing to run
+	if (cycle > m_cycleCount)
+		m_cycleCount = cycle;
+#endif
+}
+
+void APU::OnBusSignal(int signalId)
+{
+	if (signalId == SIGNAL_APU_FRC)
 	{
-		m_fcUpdateCounter--;
-		return false;
+		// Frame counter step is due: bring channels up to date, update
+		// them and schedule next step
+		qword now = BUS.Events.Now();
+
+		RunUntil(now / NES_PPU_TICKS_PER_CPU_CYCLE);
+		UpdateFrameCounter();
+
+		BUS.Events.Post(now + (m_fcUpdateInterval + 1) * NES_PPU_TICKS_PER_CPU_CYCLE, SIGNAL_APU_FRC);
 	}
 }
 
@@ -171,7 +240,7 @@ void APU::UpdateFrameCounter()
 	auto do_irq = [&]()
 	{
 		if (!FrameCounter.IRQInhibit)
-			BUS.EmitSignal(SIGNAL_CPU_IRQ);
+			BUS.IRQ.Raise();
 	};
 
 	/*
@@ -256,11 +325,13 @@ byte APU::ReadFromDevice(word address, bool peek)
 {
 	byte data = 0;
 
+	// The CPU may run a few instructions between our catch-ups; run
+	// up to the current one before it gets to see anything
+	if (!peek)
+		RunUntil(BUS.Events.Now() / NES_PPU_TICKS_PER_CPU_CYCLE);
+
 	switch (address - m_addressableRange.Min)
 	{
-		case 0x14: // OAM DMA register
-			return m_addressDMA;
-
 		case 0x15: // APU Status
 			data |= Status.DMCInterrupt ? 0x80 : 0x00;
 			//data |= FRAMEINTERRUPT ? 0x40 : 0x00;
@@ -278,6 +349,8 @@ byte APU::ReadFromDevice(word address, bool peek)
 
 void APU::WriteToDevice(word address, byte data)
 {
+	RunUntil(BUS.Events.Now() / NES_PPU_TICKS_PER_CPU_CYCLE);
+
 	switch (address - m_addressableRange.Min)
 	{
 		/* PULSE CHANNEL 1 REGISTERS */
@@ -330,11 +403,6 @@ void APU::WriteToDevice(word address, byte data)
 			ChNoise.WriteRegisterLength(data);
 			break;
 
-		case 0x14: // OAM DMA register
-			m_addressDMA = data;            // Store address for OAM DMA; PPU reads it from bus next cycle
-			BUS.EmitSignal(SIGNAL_PPU_DMA); // Forward DMA request to PPU using bus signal
-			break;
-
 		case 0x15: // APU Status
 			Status.EnableDMC = (data & 0x10) != 0 ? true : false;
 			Status.EnableNoise = (data & 0x08) != 0 ? true : false;
@@ -344,46 +412,21 @@ void APU::WriteToDevice(word address, byte data)
 			Status.DMCInterrupt = false;
 			break;
 
-		// 0x17 Frame Counter -- handled by ControllerInterface, see OnBusSignal
+		case 0x17: // Frame Counter
+			FrameCounter.IRQInhibit = (data & 0x40) != 0 ? true : false;
+			FrameCounter.Period = (data & 0x80) != 0 ? 5 : 4;
+			break;
 
 		default:
 			break;
 	}
 }
 
-void APU::OnBusSignal(int signalId)
-{
-	// $4017 frame counter flags -- forwarded by ControllerInterface
-	// which occupies $4017 on the bus
-	if (signalId >= SIGNAL_APU_FRC_NONE && signalId <= SIGNAL_APU_FRC_MI)
-	{
-		FrameCounter.IRQInhibit = (signalId & 0x01) != 0 ? true : false;
-		FrameCounter.Period = (signalId & 0x02) != 0 ? 5 : 4;
-	}
-}
-
 
 /*
 	Audio synthesis
 */
 
-void APU::PopulateMixerLookupTables()
-{
-	// See http://wiki.nesdev.com/w/index.php/APU_Mixer#Lookup_Table
-
-	// Pulse channels
-	for (int n = 0; n < 31; n++)
-	{
-		m_mixtables.Pulse[n] = (word)((95.52 / (8128.0 / (double)n + 100)) * UINT8_MAX);
-	}
-
-	// Triangle, noise and DMC channels
-	for (int n = 0; n < 203; n++)
-	{
-		m_mixtables.TND[n] = (word)((163.67 / (24329.0 / (double)n + 100)) * UINT8_MAX);
-	}
-}
-
 audiosample APU::MixSample()
 {
 	// See http://wiki.nesdev.com/w/index.php/APU_Mixer#Lookup_Table
@@ -395,8 +438,8 @@ audiosample APU::MixSample()
 	byte noise = ChNoise.Output();
 	byte dmc = 0;
 
-	audiosample pulseOut = m_mixtables.Pulse[pulse1 + pulse2];
-	audiosample tndOut = m_mixtables.TND[3 * triangle + 2 * noise + dmc];
+	audiosample pulseOut = MixerTables.Pulse[pulse1 + pulse2];
+	audiosample tndOut = MixerTables.TND[3 * triangle + 2 * noise + dmc];
 
 	return pulseOut + tndOut;
 }
@@ -406,13 +449,13 @@ audiosample APU::MixSample()
 
 byte APU::PulseChannel::Output()
 {
-	if ((m_pulseChId == 1 && APU.Status.EnablePulse1) || (m_pulseChId == 2 && APU.Status.EnablePulse2))
+	if ((m_pulseChId == 1 && m_apu->Status.EnablePulse1) || (m_pulseChId == 2 && m_apu->Status.EnablePulse2))
 	{
 		// Channel enabled -- calculate output value
 		if (LengthCounter == 0 
 			|| TimerPeriod < 8 
 			|| TimerPeriod > 0x7FF 
-			|| APU.m_tableDuty[DutyCycle][SequencerStep] == 0)
+			|| DutyTable[DutyCycle][SequencerStep] == 0)
 		{
 			return 0;
 		}
@@ -548,9 +591,9 @@ void APU::PulseChannel::WriteRegisterTimerHigh(byte data)
 	TimerPeriod = (((word)data & 0xF8) << 8) | (TimerPeriod & 0x00FF);
 	TimerCounter = TimerPeriod;
 
-	if ((m_pulseChId == 1 && APU.Status.EnablePulse1) || (m_pulseChId == 2 && APU.Status.EnablePulse2))
+	if ((m_pulseChId == 1 && m_apu->Status.EnablePulse1) || (m_pulseChId == 2 && m_apu->Status.EnablePulse2))
 	{
-		LengthCounter = APU.m_tableLength[data >> 3];
+		LengthCounter = LengthTable[data >> 3];
 	}
 }
 
@@ -559,9 +602,9 @@ void APU::PulseChannel::WriteRegisterTimerHigh(byte data)
 
 byte APU::TriangleChannel::Output()
 {
-	if (APU.Status.EnableTriangle && LengthCounter > 0 && LinearCounter > 0)
+	if (m_apu->Status.EnableTriangle && LengthCounter > 0 && LinearCounter > 0)
 	{
-		return APU.m_tableTriangle[SequencerStep];
+		return TriangleTable[SequencerStep];
 	}
 	else
 	{
@@ -623,7 +666,7 @@ void APU::TriangleChannel::WriteRegisterTimerLow(byte data)
 void APU::TriangleChannel::WriteRegisterTimerHigh(byte data)
 {
 	TimerPeriod = (((word)data & 0xF8) << 8) | (TimerPeriod & 0x00FF);
-	LengthCounter = APU.m_tableLength[data >> 3];
+	LengthCounter = LengthTable[data >> 3];
 	LinearCounterStart = true;
 }
 
@@ -631,7 +674,7 @@ void APU::TriangleChannel::WriteRegisterTimerHigh(byte data)
 
 byte APU::NoiseChannel::Output()
 {
-	if (!APU.Status.EnableNoise || LengthCounter == 0 || (ShiftRegister & 0x0001) != 0)
+	if (!m_apu->Status.EnableNoise || LengthCounter == 0 || (ShiftRegister & 0x0001) != 0)
 	{
 		return 0;
 	}
@@ -707,12 +750,12 @@ void APU::NoiseChannel::WriteRegisterControl(byte data)
 void APU::NoiseChannel::WriteRegisterPeriod(byte data)
 {
 	Mode = (data & 0x80) != 0 ? true : false;
-	TimerPeriod = APU.m_tableNoise[data & 0x0F];
+	TimerPeriod = NoiseTable[data & 0x0F];
 }
 
 void APU::NoiseChannel::WriteRegisterLength(byte data)
 {
-	LengthCounter = APU.m_tableLength[data >> 3];
+	LengthCounter = LengthTable[data >> 3];
 	EnvelopeStart = true;
 }
 
@@ -1,7 +1,6 @@
 #pragma once
 #pragma warning (disable:4244)
 
-#include <mutex>
 #include "definitions.h"
 #include "nes-definitions.h"
 #include "bus.h"
@@ -14,6 +13,35 @@ namespace Qk {namespace NES {
 	static constexpr int APU_SAMPLERATE_HZ = 44100;
 	static constexpr int APU_SAMPLE_BUFFER_SIZE = 2048;
 	static constexpr int APU_SAMPLE_INTERVAL_CYCLES = (int)NES_CPU_CLOCK_FREQ / (double)APU_SAMPLERATE_HZ;
+	static constexpr int APU_SAMPLE_QUEUE_SIZE = APU_SAMPLE_BUFFER_SIZE * 4;	// Samples generated, but not yet played
+	static constexpr int APU_SAMPLE_BATCH_SIZE = 64;	// Samples handed to queue at once
+
+	// Mixer lookup tables, computed at compile time.
+	// See http://wiki.nesdev.com/w/index.php/APU_Mixer#Lookup_Table
+	struct APUMixerTables
+	{
+		word Pulse[31];
+		word TND[203];
+	};
+
+	constexpr APUMixerTables BuildAPUMixerTables()
+	{
+		APUMixerTables tables = {};
+
+		// Pulse channels (entry 0 stays 0: no output, no division by zero)
+		for (int n = 1; n < 31; n++)
+		{
+			tables.Pulse[n] = (word)((95.52 / (8128.0 / (double)n + 100)) * UINT8_MAX);
+		}
+
+		// Triangle, noise and DMC channels
+		for (int n = 1; n < 203; n++)
+		{
+			tables.TND[n] = (word)((163.67 / (24329.0 / (double)n + 100)) * UINT8_MAX);
+		}
+
+		return tables;
+	}
 
 	class APU : public Bus::Device
 	{
@@ -39,12 +67,16 @@ namespace Qk {namespace NES {
 		APU(Bus& bus);
 		APU(Bus& bus, const AddressRange& addressableRange);
 
+		void PowerOn();
 		void Reset();
 		void Cycle();
+		void RunUntil(qword cycle);
 		 
 		int GetAudioBufferSize() const;
 		double GetAudioSampleRate() const;
 		void FillAudioBuffer(audiosample* buffer, size_t numSamples);
+		qword GetAudioUnderrunCount() const;
+		qword GetAudioOverrunCount() const;
 
 		byte ReadFromDevice(word address, bool peek = false) override;
 		void WriteToDevice(word address, byte data) override;
@@ -52,12 +84,11 @@ namespace Qk {namespace NES {
 
 	protected:
 		void Initialize();
-		void PopulateMixerLookupTables();
 		
 		audiosample MixSample();
 		bool SampleClock();
+		void FlushSamples();
 		void UpdateFrameCounter();
-		bool FrameCounterClock();
 
 	protected:
 		// APU Channels
@@ -89,7 +120,7 @@ namespace Qk {namespace NES {
 			word TimerCounter = 0;
 			word TimerPeriod = 0;
 		public:
-			PulseChannel(APU& apu, int channelId) : APU(apu), m_pulseChId(channelId) {};
+			PulseChannel(APU& apu, int channelId) : m_apu(&apu), m_pulseChId(channelId) {};
 
 			byte Output();
 			void UpdateTimer();
@@ -103,7 +134,7 @@ namespace Qk {namespace NES {
 			void WriteRegisterTimerHigh(byte data);
 
 		protected:
-			APU& APU;
+			APU* m_apu;
 			int m_pulseChId;
 		} ChPulse1, ChPulse2;
 
@@ -123,7 +154,7 @@ namespace Qk {namespace NES {
 			word TimerPeriod = 0;
 
 		public:
-			TriangleChannel(APU& parent) : APU(parent) {};
+			TriangleChannel(APU& parent) : m_apu(&parent) {};
 
 			byte Output();
 			void UpdateTimer();
@@ -135,7 +166,7 @@ namespace Qk {namespace NES {
 			void WriteRegisterTimerHigh(byte data);
 
 		protected:
-			APU& APU;
+			APU* m_apu;
 		} ChTriangle;
 
 		class NoiseChannel
@@ -160,7 +191,7 @@ namespace Qk {namespace NES {
 			word TimerPeriod = 0;
 
 		public:
-			NoiseChannel(APU& parent) : APU(parent) {};
+			NoiseChannel(APU& parent) : m_apu(&parent) {};
 
 			void WriteRegisterControl(byte data);
 			void WriteRegisterPeriod(byte data);
@@ -172,62 +203,58 @@ namespace Qk {namespace NES {
 			void UpdateLength();
 
 		protected:
-			APU& APU;
+			APU* m_apu;
 		} ChNoise;
 
-		// APU lookup tables
-		struct
-		{
-			word Pulse[31] = { 0 };
-			word TND[203] = { 0 };
-		} m_mixtables;
+		// APU lookup tables, shared by all instances
+		static constexpr APUMixerTables MixerTables = BuildAPUMixerTables();
 
-		const byte m_tableLength[32] = {
+		static constexpr byte LengthTable[32] = {
 			10,  254, 20,  2,   40,  4,   80,  6,
 			160, 8,   60,  10,  14,  12,  26,  14,
 			12,  16,  24,  18, 	48,  20,  96,  22,
 			192, 24,  72,  26,  16,  28,  32,  30
 		};
 
-		const byte m_tableDuty[4][8] = {
+		static constexpr byte DutyTable[4][8] = {
 			{0, 1, 0, 0, 0, 0, 0, 0},
 			{0, 1, 1, 0, 0, 0, 0, 0},
 			{0, 1, 1, 1, 1, 0, 0, 0},
 			{1, 0, 0, 1, 1, 1, 1, 1}
 		};
 
-		const byte m_tableTriangle[64] = {
+		static constexpr byte TriangleTable[64] = {
 			15, 14, 13, 12, 11, 10, 9,  8,
 			7,  6,  5,  4,  3,  2,  1,  0,
 			0,  1,  2,  3,  4,  5,  6,  7,
 			8,  9,  10, 11, 12, 13, 14, 15
 		};
 
-		const byte m_tableDMC[16] = {
+		static constexpr byte DMCTable[16] = {
 			214, 190, 170, 160, 143, 127, 113, 107,
 			95,  80,  71,  64,  53,  42,  36,  27
 		};
 
-		const word m_tableNoise[16] = {
+		static constexpr word NoiseTable[16] = {
 			4,   8,   16,  32,  64,  96,   128,  160,
 			202, 254, 380, 508, 762, 1016, 2034, 4068
 		};
 
-		// Frame counter updates
+		// Frame counter updates, driven by scheduled events
 		int m_fcUpdateInterval = (int)(NES_CPU_CLOCK_FREQ / 240.0);
-		int m_fcUpdateCounter = 0;
 		bool m_updateLengths = true;
 
+		// APU cycles run so far
+		qword m_cycleCount = 0;
+
 
-		// APU audio sample buffer
-		Util::CircularBuffer<audiosample> m_audiobuffer;
-		std::mutex m_buffermutex;
+		// APU audio samples. Generated by the emulation thread, played
+		// from the audio device's; the queue keeps them from contending.
+		Util::SPSCRingBuffer<audiosample> m_audiobuffer;
+		audiosample m_sampleBatch[APU_SAMPLE_BATCH_SIZE];
+		int m_sampleBatchCount = 0;
+		audiosample m_lastSamplePlayed = 0;
 		int m_sampleInterval = APU_SAMPLE_INTERVAL_CYCLES;
 		int m_sampleIntervalCounter = 0;
-		
-		// PPU OAM DMA forward -- not APU related
-		// but APU memory range occupies DMA register,
-		// so we handle it here for convenience
-		byte m_addressDMA = 0;
 	};
 }}
\ No newline at end of file
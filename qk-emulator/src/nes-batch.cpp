@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include "nes-batch.h"
+#include "systems.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+
+using namespace Qk;
+using namespace Qk::NES;
+
+
+/**************************************************
+	Input scripts
+***************************************************/
+
+std::vector<InputEvent> Qk::NES::LoadInputScript(const std::string& path)
+{
+	static const struct { const char* Name; Controller::Button Button; } buttons[] = {
+		{ "a", Controller::Button::A },
+		{ "b", Controller::Button::B },
+		{ "select", Controller::Button::Select },
+		{ "start", Controller::Button::Start },
+		{ "up", Controller::Button::Up },
+		{ "down", Controller::Button::Down },
+		{ "left", Controller::Button::Left },
+		{ "right", Controller::Button::Right },
+	};
+
+	std::ifstream file(path);
+
+	if (!file)
+		throw QkError("Cannot open input script", 810);
+
+	std::vector<InputEvent> events;
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		// Skip blank lines and comments
+		std::size_t start = line.find_first_not_of(" \t\r");
+
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		qword frame;
+		int player;
+		std::string button, state;
+
+		if (!(fields >> frame >> player >> button >> state) || (player != 1 && player != 2)
+			|| (state != "down" && state != "up"))
+		{
+			throw QkError("Invalid line in input script", 811);
+		}
+
+		InputEvent event = { frame, player == 1 ? Controller::Player::One : Controller::Player::Two,
+			Controller::Button::A, state == "down" };
+
+		bool known = false;
+
+		for (const auto& b : buttons)
+		{
+			if (button == b.Name)
+			{
+				event.Button = b.Button;
+				known = true;
+			}
+		}
+
+		if (!known)
+			throw QkError("Invalid line in input script", 811);
+
+		events.push_back(event);
+	}
+
+	std::stable_sort(events.begin(), events.end(),
+		[](const InputEvent& a, const InputEvent& b) { return a.Frame < b.Frame; });
+
+	return events;
+}
+
+InputPlayback::InputPlayback(const std::vector<InputEvent>& script)
+	: m_script(script)
+{
+}
+
+void InputPlayback::Apply(NESConsole& nes, qword frame)
+{
+	// Events for frames already run have had their chance
+	while (m_next < m_script.size() && m_script[m_next].Frame < frame)
+		m_next++;
+
+	while (m_next < m_script.size() && m_script[m_next].Frame == frame)
+	{
+		const InputEvent& event = m_script[m_next++];
+		nes.ControllerInput(event.Pad, event.Button, event.Pressed);
+	}
+}
+
+
+/**************************************************
+	Qk::NES::BatchRunner
+***************************************************/
+
+/*
+	Constructor
+*/
+
+BatchRunner::BatchRunner(unsigned int threads, bool pinThreads)
+	: m_threadCount(threads), m_pinThreads(pinThreads)
+{
+	if (m_threadCount == 0)
+		m_threadCount = std::thread::hardware_concurrency();
+
+	if (m_threadCount == 0)
+		m_threadCount = 1;
+
+	m_queues.reset(new WorkQueue[m_threadCount]);
+}
+
+unsigned int BatchRunner::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
+void BatchRunner::SetCPUCore(MOS6502::CoreType core)
+{
+	m_core = core;
+}
+
+void BatchRunner::SetIdleLoopSkipping(bool enabled)
+{
+	m_idleSkipping = enabled;
+}
+
+
+/*
+	Running jobs
+*/
+
+void BatchRunner::Run(const std::vector<BatchJob>& jobs, const ResultHandler& onResult)
+{
+	// Deal out jobs in contiguous blocks, one per worker
+	for (std::size_t i = 0; i < jobs.size(); i++)
+	{
+		m_queues[i * m_threadCount / jobs.size()].Jobs.push_back(i);
+	}
+
+	std::vector<std::thread> workers;
+
+	for (unsigned int w = 0; w < m_threadCount; w++)
+	{
+		workers.emplace_back(&BatchRunner::Work, this, w, std::cref(jobs), std::cref(onResult));
+	}
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+bool BatchRunner::TakeJob(unsigned int worker, std::size_t& job)
+{
+	// Own queue first, from the front...
+	{
+		WorkQueue& own = m_queues[worker];
+		std::lock_guard<std::mutex> lock(own.Lock);
+
+		if (!own.Jobs.empty())
+		{
+			job = own.Jobs.front();
+			own.Jobs.pop_front();
+			return true;
+		}
+	}
+
+	// ...then steal from the back of someone else's. No jobs are added
+	// once running, so if all queues are empty, we're done.
+	for (unsigned int i = 1; i < m_threadCount; i++)
+	{
+		WorkQueue& victim = m_queues[(worker + i) % m_threadCount];
+		std::lock_guard<std::mutex> lock(victim.Lock);
+
+		if (!victim.Jobs.empty())
+		{
+			job = victim.Jobs.back();
+			victim.Jobs.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void BatchRunner::Work(unsigned int worker, const std::vector<BatchJob>& jobs, const ResultHandler& onResult)
+{
+	if (m_pinThreads)
+		PinToCore(worker);
+
+	// Console is big, and only needed once we have work
+	std::unique_ptr<NESConsole> nes;
+	std::size_t index;
+
+	while (TakeJob(worker, index))
+	{
+		const BatchJob& job = jobs[index];
+
+		BatchResult result;
+		result.Job = index;
+		result.Worker = worker;
+
+		auto start = std::chrono::steady_clock::now();
+
+		try
+		{
+			if (!nes)
+			{
+				nes.reset(new NESConsole());
+				nes->SetCPUCore(m_core);
+				nes->SetIdleLoopSkipping(m_idleSkipping);
+			}
+
+			// Fresh cartridge (PRG RAM, mapper state) on the shared ROM image
+			nes->InsertCartridge(std::make_shared<Cartridge>(job.ROM));
+			nes->PowerCycle();
+
+			InputPlayback input(job.Input);
+
+			for (qword frame = 0; frame < job.Frames; frame++)
+			{
+				input.Apply(*nes, frame);
+				nes->RunFrame();
+			}
+
+			result.Succeeded = true;
+			result.Frames = job.Frames;
+			result.MasterClock = nes->GetMasterClock();
+			result.StateHash = nes->GetStateHash();
+		}
+		catch (const QkError& ex)
+		{
+			result.ErrorCode = ex.code();
+			result.ErrorMessage = ex.what();
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		result.WallSeconds = std::chrono::duration<double>(end - start).count();
+
+		std::lock_guard<std::mutex> lock(m_resultLock);
+		onResult(result);
+	}
+}
+
+void BatchRunner::PinToCore(unsigned int core)
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+
+	if (cores == 0)
+		return;
+
+	core %= cores;
+
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core);
+#endif
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include "definitions.h"
+#include "nes-definitions.h"
+#include "nes-cartridge.h"
+#include "cpu.h"
+
+
+namespace Qk { namespace NES
+{
+	// Scripted controller input, applied at the start of a frame
+	struct InputEvent
+	{
+		qword Frame;
+		Controller::Player Pad;
+		Controller::Button Button;
+		bool Pressed;
+	};
+
+	class NESConsole;
+
+	// Read input script: one event per line, as <frame> <player 1|2> <button> <down|up>.
+	// Button names: a b select start up down left right. Lines starting with # are ignored.
+	// Events come back sorted by frame, in script order within a frame.
+	std::vector<InputEvent> LoadInputScript(const std::string& path);
+
+	// Plays a script sorted by frame into a console, one frame at a time
+	class InputPlayback
+	{
+	public:
+		InputPlayback(const std::vector<InputEvent>& script);
+
+		// Press and release what the script says for this frame, before running
+		// it; frames must come in increasing order
+		void Apply(NESConsole& nes, qword frame);
+
+	protected:
+		const std::vector<InputEvent>& m_script;
+		std::size_t m_next = 0;
+	};
+
+	// One console session: power on with a cartridge, run a number of frames
+	struct BatchJob
+	{
+		std::shared_ptr<const ROMImage> ROM;
+		qword Frames = 0;
+		std::vector<InputEvent> Input;
+	};
+
+	struct BatchResult
+	{
+		std::size_t Job = 0;		// Index into job list
+		unsigned int Worker = 0;	// Thread that ran the job
+		bool Succeeded = false;
+		int ErrorCode = 0;
+		std::string ErrorMessage;
+
+		qword Frames = 0;
+		qword MasterClock = 0;
+		qword StateHash = 0;
+		double WallSeconds = 0;
+	};
+
+	// Runs independent console sessions on a pool of worker threads. Each worker
+	// owns one NESConsole, which it power cycles between jobs. Jobs are dealt out
+	// to the workers up front; a worker that runs out steals from the others.
+	class BatchRunner
+	{
+	public:
+		typedef std::function<void(const BatchResult&)> ResultHandler;
+
+		// Zero threads means one per hardware thread. Pinning binds worker n to core n.
+		BatchRunner(unsigned int threads = 0, bool pinThreads = false);
+
+		// CPU core and idle loop skipping for every session, as on NESConsole;
+		// block core with skipping by default, like qk-headless
+		void SetCPUCore(MOS6502::CoreType core);
+		void SetIdleLoopSkipping(bool enabled);
+
+		// Run all jobs, and block until done. onResult is called for each job as
+		// soon as it completes, from the worker threads, but never concurrently.
+		void Run(const std::vector<BatchJob>& jobs, const ResultHandler& onResult);
+
+		unsigned int GetThreadCount() const;
+
+	protected:
+		struct WorkQueue
+		{
+			std::mutex Lock;
+			std::deque<std::size_t> Jobs;
+		};
+
+		void Work(unsigned int worker, const std::vector<BatchJob>& jobs, const ResultHandler& onResult);
+		bool TakeJob(unsigned int worker, std::size_t& job);
+		static void PinToCore(unsigned int core);
+
+	protected:
+		unsigned int m_threadCount;
+		bool m_pinThreads;
+		MOS6502::CoreType m_core = MOS6502::CoreType::Block;
+		bool m_idleSkipping = true;
+
+		std::unique_ptr<WorkQueue[]> m_queues;
+		std::mutex m_resultLock;
+	};
+}}
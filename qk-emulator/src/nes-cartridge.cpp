@@ -1,6 +1,8 @@
 #include <fstream>
+#include <utility>
 #include "nes-cartridge.h"
 #include "nes-mapper.h"
+#include "timers.h"
 
 
 using namespace Qk;
@@ -19,10 +21,17 @@ CartridgeSlot::CartridgeSlot(Bus& bus, const AddressRange& addressableRange)
 
 void CartridgeSlot::InsertCartridge(const std::shared_ptr<Cartridge>& cartridge)
 {
+	// The PPU must finish rendering with the old cartridge's CHR
+	if (m_cart)
+		BUS.EmitSignal(SIGNAL_PPU_SYN);
+
 	m_cart = cartridge;
+
+	// PRG ROM/RAM pages can now be mapped directly
+	RefreshBusMapping();
 }
 
-CartridgeMetadata& CartridgeSlot::GetMetadata() const
+const CartridgeMetadata& CartridgeSlot::GetMetadata() const
 {
 	return m_cart->Metadata;
 }
@@ -43,7 +52,25 @@ byte CartridgeSlot::ReadFromDevice(word address, bool peek)
 void CartridgeSlot::WriteToDevice(word address, byte data)
 {
 	if (m_cart)
-		m_cart->MainBusWrite(address, data);
+	{
+		// Writes that don't go straight to PRG RAM may hit mapper registers and
+		// switch CHR banks or mirroring, so have the PPU catch up first
+		BUS.EmitSignal(SIGNAL_PPU_SYN);
+
+		// New PRG banks: pages mapped directly, decoded blocks, compiled
+		// code and the CPU's fetch window all go by the bus mapping
+		// generation, which this bumps
+		if (m_cart->MainBusWrite(address, data))
+			RefreshBusMapping();
+	}
+}
+
+byte* CartridgeSlot::GetDirectMemory(word address, bool isWrite)
+{
+	if (m_cart)
+		return m_cart->GetDirectMemory(address, isWrite);
+	else
+		return nullptr;
 }
 
 byte CartridgeSlot::PPUReadFromDevice(word address, bool peek)
@@ -61,6 +88,43 @@ void CartridgeSlot::PPUWriteToDevice(word address, byte data)
 }
 
 
+/**************************************************
+	Qk::NES::ROMImage
+***************************************************/
+
+ROMImage::ROMImage(const std::string& filepath)
+{
+	ROMFile rom(filepath);
+	m_metadata = rom.GetMetadata();
+
+	if (m_metadata.FileFormat == CartridgeMetadata::FileFormatType::INVALID)
+		throw QkError("Invalid ROM dump file", 510);
+
+	rom.LoadPRGROM(m_PRGROM);
+	rom.LoadCHRROM(m_CHRROM);
+}
+
+ROMImage::ROMImage(const CartridgeMetadata& metadata, std::vector<byte> prgrom, std::vector<byte> chrrom)
+	: m_metadata(metadata), m_PRGROM(std::move(prgrom)), m_CHRROM(std::move(chrrom))
+{
+}
+
+const CartridgeMetadata& ROMImage::GetMetadata() const
+{
+	return m_metadata;
+}
+
+const std::vector<byte>& ROMImage::GetPRGROM() const
+{
+	return m_PRGROM;
+}
+
+const std::vector<byte>& ROMImage::GetCHRROM() const
+{
+	return m_CHRROM;
+}
+
+
 /**************************************************
 	Qk::NES::Cartridge
 ***************************************************/
@@ -70,17 +134,14 @@ void CartridgeSlot::PPUWriteToDevice(word address, byte data)
 */
 
 Cartridge::Cartridge(const std::string& filepath)
+	: Cartridge(std::make_shared<const ROMImage>(filepath))
 {
-	ROMFile rom(filepath);
-	Metadata = rom.GetMetadata();
-
-	if (Metadata.FileFormat == CartridgeMetadata::FileFormatType::INVALID)
-		throw QkError("Invalid ROM dump file", 510);
 
-	// Set up PRG and CHR ROM
-	rom.LoadPRGROM(m_PRGROM);
-	rom.LoadCHRROM(m_CHRROM);
+}
 
+Cartridge::Cartridge(const std::shared_ptr<const ROMImage>& image)
+	: Metadata(image->GetMetadata()), m_image(image), m_PRGROM(image->GetPRGROM()), m_CHRROM(image->GetCHRROM())
+{
 	// Set up cartridge PRG RAM
 	if (Metadata.PRGRAMSize > 0)
 		m_PRGRAM.resize(Metadata.PRGRAMSize);
@@ -120,12 +181,8 @@ void Cartridge::WriteInternal(Mapper::MappedAddress address, byte data)
 	case Mapper::Memory::PRGRAM:
 		m_PRGRAM[address.Offset] = data;
 		break;
-	case Mapper::Memory::PRGROM:
-		m_PRGROM[address.Offset] = data; // Let mapper decide if we can write to ROM
-	case Mapper::Memory::CHRROM:
-		m_CHRROM[address.Offset] = data; // Let mapper decide if we can write to ROM
-		break;
 	default:
+		// ROM image is shared with other cartridges; never write to it
 		break;
 	}
 }
@@ -136,24 +193,57 @@ void Cartridge::WriteInternal(Mapper::MappedAddress address, byte data)
 
 byte Cartridge::MainBusRead(word address)
 {
+	QK_TIMER(Mapper);
 	return ReadInternal(m_mapper->MapBusAddress(address, false));
 }
 
-void Cartridge::MainBusWrite(word address, byte data)
+bool Cartridge::MainBusWrite(word address, byte data)
 {
+	QK_TIMER(Mapper);
 	WriteInternal(m_mapper->MapBusAddress(address, true), data);
+
+	return m_mapper->WriteRegister(address, data);
 }
 
 byte Cartridge::PPUBusRead(word address)
 {
+	QK_TIMER(Mapper);
 	return ReadInternal(m_mapper->MapPPUAddress(address, false));
 }
 
 void Cartridge::PPUBusWrite(word address, byte data)
 {
+	QK_TIMER(Mapper);
 	WriteInternal(m_mapper->MapPPUAddress(address, true), data);
 }
 
+byte* Cartridge::GetDirectMemory(word address, bool isWrite)
+{
+	// Only pages that the mapper maps onto one contiguous
+	// 256 byte stretch of PRG ROM/RAM can be accessed directly
+	Mapper::MappedAddress first = m_mapper->MapBusAddress(address, isWrite);
+	Mapper::MappedAddress last = m_mapper->MapBusAddress(address + 0x00FF, isWrite);
+
+	if (first.Target != last.Target || last.Offset != first.Offset + 0x00FF)
+		return nullptr;
+
+	switch (first.Target)
+	{
+	case Mapper::Memory::PRGROM:
+		// ROM is read-only, so never map writes. The bus only reads
+		// through read pages, so handing out a non-const pointer is safe.
+		if (isWrite || last.Offset >= m_PRGROM.size())
+			return nullptr;
+		return const_cast<byte*>(&m_PRGROM[first.Offset]);
+	case Mapper::Memory::PRGRAM:
+		if (last.Offset >= m_PRGRAM.size())
+			return nullptr;
+		return &m_PRGRAM[first.Offset];
+	default:
+		return nullptr;
+	}
+}
+
 NametableMirrorMode Cartridge::GetNametableMirrorMode() const
 {
 	return m_mapper->GetNametableMirrorMode(Metadata.DefaultMirrorMode);
@@ -12,23 +12,51 @@
 
 namespace Qk { namespace NES 
 {
+	// Contents of a ROM file. Immutable once loaded, so one image can
+	// back any number of cartridges, in any number of threads.
+	class ROMImage
+	{
+	public:
+		ROMImage(const std::string& filepath);
+
+		// Built in memory, e.g. for benchmarks
+		ROMImage(const CartridgeMetadata& metadata, std::vector<byte> prgrom, std::vector<byte> chrrom);
+
+		const CartridgeMetadata& GetMetadata() const;
+		const std::vector<byte>& GetPRGROM() const;
+		const std::vector<byte>& GetCHRROM() const;
+
+	protected:
+		CartridgeMetadata m_metadata;
+		std::vector<byte> m_PRGROM;
+		std::vector<byte> m_CHRROM;
+	};
+
+	// A cartridge as plugged into one console: a (shared) ROM image, plus
+	// the state that is the cartridge's own -- PRG RAM and mapper registers
 	class Cartridge
 	{
 	public:		
 		Cartridge(const std::string& filepath);
+		Cartridge(const std::shared_ptr<const ROMImage>& image);
 
 		byte MainBusRead(word address);
-		void MainBusWrite(word address, byte data);
+		// True if the write switched PRG banks
+		bool MainBusWrite(word address, byte data);
 		
 		byte PPUBusRead(word address);
 		void PPUBusWrite(word address, byte data);
 
 		NametableMirrorMode GetNametableMirrorMode() const;
 
+		// Host memory backing a main bus page, if the mapper maps it linearly
+		byte* GetDirectMemory(word address, bool isWrite);
+
 		CartridgeMetadata Metadata;
 	protected:
-		std::vector<byte> m_PRGROM;
-		std::vector<byte> m_CHRROM;
+		std::shared_ptr<const ROMImage> m_image;
+		const std::vector<byte>& m_PRGROM;
+		const std::vector<byte>& m_CHRROM;
 		std::vector<byte> m_PRGRAM;
 		std::shared_ptr<Mapper> m_mapper;
 
@@ -43,12 +71,13 @@ namespace Qk { namespace NES
 
 		void InsertCartridge(const std::shared_ptr<Cartridge>& cartridge);
 
-		CartridgeMetadata& GetMetadata() const;
+		const CartridgeMetadata& GetMetadata() const;
 		NametableMirrorMode GetNametableMirrorMode() const;
 
 		// Main bus connectivity
 		byte ReadFromDevice(word address, bool peek = false) override;
 		void WriteToDevice(word address, byte data) override;
+		byte* GetDirectMemory(word address, bool isWrite) override;
 
 		// PPU "bus" connectivity
 		byte PPUReadFromDevice(word address, bool peek = false);
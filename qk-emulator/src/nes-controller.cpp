@@ -8,15 +8,17 @@ using namespace Qk::NES;
 */
 
 ControllerInterface::ControllerInterface(Bus& bus) 
-	: Bus::Device(bus, true, AddressRange(0x4016, 0x4017))
+	: Bus::Device(bus, true, AddressRange(0x4016, 0x4016))
 {
-
+	// Gamepad 2 port; writes to $4017 go to the APU frame counter
+	MapReadHandler(AddressRange(0x4017, 0x4017), &ControllerInterface::ReadFromDevice);
 }
 
 ControllerInterface::ControllerInterface(Bus& bus, const AddressRange& addressableRange) 
-	: Bus::Device(bus, true, addressableRange)
+	: Bus::Device(bus, true, AddressRange(addressableRange.Min, addressableRange.Min))
 {
-
+	// Gamepad 2 port; writes to it go to the APU frame counter
+	MapReadHandler(AddressRange(addressableRange.Max, addressableRange.Max), &ControllerInterface::ReadFromDevice);
 }
 
 
@@ -24,6 +26,15 @@ ControllerInterface::ControllerInterface(Bus& bus, const AddressRange& addressab
 	Controller interface
 */
 
+void ControllerInterface::PowerOn()
+{
+	// No buttons held, nothing latched
+	m_ctlr1Parallel = 0;
+	m_ctlr2Parallel = 0;
+	m_ctlr1Shift = 0;
+	m_ctlr2Shift = 0;
+}
+
 void ControllerInterface::PressButton(Controller::Player pad, Controller::Button button)
 {
 	byte& ctrlr = pad == Controller::Player::One ? m_ctlr1Parallel : m_ctlr2Parallel;
@@ -43,18 +54,9 @@ void ControllerInterface::ReleaseButton(Controller::Player pad, Controller::Butt
 
 void ControllerInterface::WriteToDevice(word address, byte data)
 {
-	if (address == m_addressableRange.Min)
-	{
-		// CPU is polling controllers
-		m_ctlr1Shift = m_ctlr1Parallel;
-		m_ctlr2Shift = m_ctlr2Parallel;
-	}
-	else
-	{
-		// CPU is updating APU frame counter
-		byte flag = (data & 0xC0) >> 6;
-		BUS.EmitSignal(SIGNAL_APU_FRC_NONE | flag);
-	}
+	// CPU is polling controllers
+	m_ctlr1Shift = m_ctlr1Parallel;
+	m_ctlr2Shift = m_ctlr2Parallel;
 }
 
 byte ControllerInterface::ReadFromDevice(word address, bool peek)
@@ -12,6 +12,7 @@ namespace Qk { namespace NES
 		ControllerInterface(Bus& bus);
 		ControllerInterface(Bus& bus, const AddressRange& addressableRange);
 
+		void PowerOn();
 		void PressButton(Controller::Player pad, Controller::Button button);
 		void ReleaseButton(Controller::Player pad, Controller::Button buton);
 
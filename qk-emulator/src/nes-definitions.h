@@ -5,13 +5,13 @@ namespace Qk { namespace NES
 	// NES system information
 	static constexpr double NES_CPU_CLOCK_FREQ = 1789773.0;
 
-	// NES-specific bus signals
-	static constexpr int SIGNAL_PPU_DMA = 1100; // PPU OAM DMA transfer
+	// Master clock runs at PPU dot rate; PPU does 3 cycles for every CPU cycle
+	static constexpr int NES_PPU_TICKS_PER_CPU_CYCLE = 3;
 
-	static constexpr int SIGNAL_APU_FRC_NONE = 1200; // APU frame counter updates
-	static constexpr int SIGNAL_APU_FRC_I = 1201;  
-	static constexpr int SIGNAL_APU_FRC_M = 1202;
-	static constexpr int SIGNAL_APU_FRC_MI = 1203;
+	// NES-specific bus signals
+	static constexpr int SIGNAL_APU_FRC = 1200; // APU frame counter step
+	static constexpr int SIGNAL_PPU_VBL = 1300; // PPU reaches vertical blank (NMI deadline)
+	static constexpr int SIGNAL_PPU_SYN = 1301; // PPU must catch up, e.g. before mapper changes CHR/mirroring
 
 	enum class NametableMirrorMode
 	{
@@ -17,6 +17,12 @@ Mapper::Mapper(unsigned int PRGROMSize, unsigned int CHRROMSize, unsigned int PR
 	m_chrromSize = CHRROMSize;
 }
 
+bool Mapper::WriteRegister(word address, byte data)
+{
+	// No registers
+	return false;
+}
+
 std::shared_ptr<Mapper> Mapper::GetMapper(unsigned int mapperId, unsigned int PRGROMSize, 
 	unsigned int CHRROMSize, unsigned int PRGRAMSize)
 {
@@ -34,6 +34,10 @@ namespace Qk { namespace NES
 		virtual MappedAddress MapPPUAddress(word address, bool isWrite) = 0;
 		virtual NametableMirrorMode GetNametableMirrorMode(const NametableMirrorMode defaultMode) const = 0;
 
+		// CPU writes, for mappers with registers; true if one switched PRG
+		// banks, so the bus must map its pages afresh
+		virtual bool WriteRegister(word address, byte data);
+
 		static std::shared_ptr<Mapper> GetMapper(unsigned int mapperId, 
 			unsigned int PRGROMSize, unsigned int CHRROMSize, unsigned int PRGRAMSize);
 	};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "definitions.h"
+#include "bus.h"
+#include "memory.h"
+#include "nes-ppu.h"
+
+
+namespace Qk { namespace NES
+{
+	// NES CPU memory map, fixed at compile time. Serves as the CPU's memory
+	// access policy (see MOS6502::UseMemoryMap), so CPU reads and writes to
+	// internal RAM and PPU registers compile down to an inlined switch. APU/IO
+	// registers and cartridge space still go through the bus page table,
+	// as their mapping can change at runtime (mappers).
+	class MemoryMap
+	{
+	public:
+		MemoryMap(Bus& bus, RAM& ram, RP2C02& ppu) 
+			: BUS(bus), m_ram(ram.GetDirectMemory(0x0000, true)), m_ppu(ppu) { }
+
+		byte Read(word address);
+		void Write(word address, byte data);
+
+	protected:
+		Bus& BUS;
+		byte* m_ram;
+		RP2C02& m_ppu;
+	};
+
+	inline byte MemoryMap::Read(word address)
+	{
+		switch (address >> 13)
+		{
+		case 0: // $0000-$1FFF: 2KB internal RAM and its mirrors
+			return m_ram[address & 0x07FF];
+
+		case 1: // $2000-$3FFF: PPU registers, mirrored every 8 bytes
+			return m_ppu.ReadFromDevice(0x2000 | (address & 0x0007), false);
+
+		default: // $4000-$FFFF: APU and I/O registers, cartridge space
+			return BUS.ReadFromBus(address);
+		}
+	}
+
+	inline void MemoryMap::Write(word address, byte data)
+	{
+		switch (address >> 13)
+		{
+		case 0:
+			m_ram[address & 0x07FF] = data;
+			break;
+
+		case 1:
+			m_ppu.WriteToDevice(0x2000 | (address & 0x0007), data);
+			break;
+
+		default:
+			BUS.WriteToBus(address, data);
+			break;
+		}
+	}
+}}
@@ -1,24 +1,45 @@
 #include "nes-ppu.h"
 #include "util.h"
+#include "timers.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <iterator>
 
 using namespace Qk;
 using namespace Qk::NES;
 
+
+// Palette storage (constexpr static members need one pre-C++17)
+constexpr Pixel RP2C02::PaletteRGB[64];
+
 /*
-	Constructors, destructor
+	Constructors, initialization
 */
 
 RP2C02::RP2C02(Bus& bus, CartridgeSlot& cartridge) 
 	: Bus::Device(bus, true, AddressRange(0x2000, 0x2007)), m_cart(cartridge), m_fi(m_framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT)
 {
-	Reset();
+	Initialize();
 }
 
 RP2C02::RP2C02(Bus& bus, const AddressRange& addressableRange, CartridgeSlot& cartridge) 
 	: Bus::Device(bus, true, addressableRange), m_cart(cartridge), m_fi(m_framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT)
 {
+	Initialize();
+}
+
+void RP2C02::Initialize()
+{
+	// OAM DMA register sits apart from the other PPU registers, in the APU/IO range
+	MapWriteHandler(AddressRange(0x4014, 0x4014), &RP2C02::WriteOAMDMA);
+
+	// Catch up at every vertical blank, so NMIs are raised on time,
+	// and whenever the cartridge is about to change under our feet
+	ListenForSignal(SIGNAL_PPU_VBL);
+	ListenForSignal(SIGNAL_PPU_SYN);
+	BUS.Events.Post(BUS.Events.Now() + GetTicksToVBlank(), SIGNAL_PPU_VBL);
+
 	Reset();
 }
 
@@ -27,6 +48,24 @@ RP2C02::RP2C02(Bus& bus, const AddressRange& addressableRange, CartridgeSlot& ca
 	API
 */
 
+void RP2C02::PowerOn()
+{
+	// Back to the state we were constructed in
+	VRAM = decltype(VRAM)();
+	m_state = RenderState();
+	m_ppuRegWriteBuf = 0;
+	m_dmaPage = 0;
+	m_frameCounter = 0;
+	m_tickCount = 0;
+
+	std::fill(std::begin(m_framebuffer), std::end(m_framebuffer), Pixel());
+
+	BUS.Events.Cancel(SIGNAL_PPU_VBL);
+	BUS.Events.Post(BUS.Events.Now() + GetTicksToVBlank(), SIGNAL_PPU_VBL);
+
+	Reset();
+}
+
 void RP2C02::Reset()
 {
 	Registers.PPUCtrl = 0;
@@ -38,12 +77,24 @@ void RP2C02::Reset()
 	Registers.PPUAddr = 0;
 	Registers.PPUData = 0;
 
-	m_doDMA = false;
 	m_videoModeCheck = false;
 }
 
 void RP2C02::Cycle()
 {
+	// Run a single master clock tick
+	RunUntil(m_tickCount + 1);
+}
+
+void RP2C02::RunUntil(qword timestamp)
+{
+	// Catch up with the rest of the system: run ticks up to (not including)
+	// 'timestamp'. Called on demand, so the renderer runs in batches.
+	if (m_tickCount >= timestamp)
+		return;
+
+	QK_TIMER(PPU);
+
 	if (!m_videoModeCheck)
 	{
 		if (m_cart.GetMetadata().TVSystem != CartridgeMetadata::TVSystemType::NTSC)
@@ -54,25 +105,30 @@ void RP2C02::Cycle()
 		m_videoModeCheck = true;
 	}
 
-	// Direct Memory Access requests to OAM
-	if (m_remainingOAMDMACycles > 0)
+	// Rendering
+	for (qword n = timestamp - m_tickCount; n > 0; n--)
 	{
-		if (m_doDMA)
-		{
-			m_doDMA = false;
-			BUS.EmitSignal(SIGNAL_CPU_HLT); // Suspend CPU during OAM DMA transer
-			OAMDMA(); // Instanteneous DMA transfer -- not going to emulate individual read/write cycles for now
-		}
-		else if (m_remainingOAMDMACycles == 1)
-		{
-			BUS.EmitSignal(SIGNAL_CPU_RSM); // OAM DMA tranfser done; signal CPU to resume
-		}
-
-		m_remainingOAMDMACycles--;
+		CycleRenderer();
 	}
 
-	// Rendering
-	CycleRenderer();
+	m_tickCount = timestamp;
+}
+
+void RP2C02::OnBusSignal(int signalId)
+{
+	qword now = BUS.Events.Now();
+
+	if (signalId == SIGNAL_PPU_VBL)
+	{
+		// Vertical blank (and NMI, if enabled) is due: catch up through
+		// this tick, then schedule the next one
+		RunUntil(now + 1);
+		BUS.Events.Post(now + 1 + GetTicksToVBlank(), SIGNAL_PPU_VBL);
+	}
+	else if (signalId == SIGNAL_PPU_SYN)
+	{
+		RunUntil(now + 1);
+	}
 }
 
 FramebufferDescriptor* RP2C02::GetVideoOutput()
@@ -80,7 +136,7 @@ FramebufferDescriptor* RP2C02::GetVideoOutput()
 	return &m_fi;
 }
 
-unsigned long RP2C02::GetFrameCount() const
+qword RP2C02::GetFrameCount() const
 {
 	return m_frameCounter;
 }
@@ -146,11 +202,8 @@ void RP2C02::WriteNametable(word address, byte data)
 
 void RP2C02::OAMDMA()
 {
-	// Read high byte of starting address from 0x4014 on main bus
-	// (on real NES, this is a PPU register, but our current bus
-	// implementation does not allow for non-contiguous addresses,
-	// so we use a "dummy" DMA forwarder device at 0x4014)
-	word addr = MainBusRead(0x4014) << 8;
+	// High byte of starting address was written to $4014
+	word addr = m_dmaPage << 8;
 
 	// Read 256 bytes of data from main bus into OAM memory
 	for (int lsb = 0; lsb < 256; lsb++)
@@ -225,8 +278,14 @@ void RP2C02::MainBusWrite(word address, byte data)
 
 byte RP2C02::ReadFromDevice(word address, bool peek)
 {
+	QK_TIMER(Bus);
 	byte tmp = 0;
 
+	// CPU accesses happen at the current master clock tick; bring
+	// registers up to date with everything rendered through it
+	if (!peek)
+		RunUntil(BUS.Events.Now() + 1);
+
 	switch (address - m_addressableRange.Min)
 	{
 	case 0x00: // PPU CTRL
@@ -311,6 +370,11 @@ byte RP2C02::ReadFromDevice(word address, bool peek)
 
 void RP2C02::WriteToDevice(word address, byte data)
 {
+	QK_TIMER(Bus);
+
+	// Render everything up to this tick with the old register values
+	RunUntil(BUS.Events.Now() + 1);
+
 	// Buffer written data -- needed later
 	// for correctly emulating PPUSTATUS read
 	m_ppuRegWriteBuf = data;
@@ -406,22 +470,20 @@ void RP2C02::WriteToDevice(word address, byte data)
 	}
 }
 
-void RP2C02::OnBusSignal(int signalId)
+void RP2C02::WriteOAMDMA(word address, byte data)
 {
-	// TODO: OAM load
-	switch (signalId)
-	{
-	case SIGNAL_PPU_DMA:
-		m_doDMA = true;
-		// OAM transfer takes 513/514 cycles, depending on whether CPU is on even or odd cycle. 
-		// For convenience, we'll assume 513 cycles is okay. Because PPU does 3 cycles for
-		// every CPU cycle, we'll multiply by 3.
-		m_remainingOAMDMACycles = 513 * 3;
-
-		break;
-	default:
-		break;
-	}
+	// $4014 write: start OAM DMA transfer from CPU page 'data'
+	RunUntil(BUS.Events.Now() + 1);
+	m_dmaPage = data;
+
+	// Instanteneous DMA transfer -- not going to emulate individual read/write cycles for now
+	OAMDMA();
+
+	// Suspend CPU for the duration of the transfer, and schedule it to resume once done.
+	// OAM transfer takes 513/514 cycles, depending on whether CPU is on even or odd cycle. 
+	// For convenience, we'll assume 513 cycles is okay.
+	BUS.EmitSignal(SIGNAL_CPU_HLT);
+	BUS.Events.Post(BUS.Events.Now() + 513 * NES_PPU_TICKS_PER_CPU_CYCLE, SIGNAL_CPU_RSM);
 }
 
 
@@ -538,7 +600,7 @@ void RP2C02::CycleRenderer()
 		SetFlag(StatusFlag::VBlank, true);
 
 		if (CheckFlag(CtrlFlag::NMIEnable))
-			BUS.EmitSignal(SIGNAL_CPU_NMI);
+			BUS.NMI.Raise();
 
 		m_frameCounter++;
 	}
@@ -632,7 +694,55 @@ void RP2C02::CycleRenderer()
 	}
 }
 
-Pixel& RP2C02::Muxer()
+qword RP2C02::GetTicksToVBlank() const
+{
+	// Number of ticks to run before the one that starts vertical blank
+	// (scanline 241, dot 1). Frame timing doesn't depend on anything the
+	// CPU can change, so this can be predicted from the scan position.
+	const int dotsPerLine = 341;
+	const int vblankStart = 241 * dotsPerLine + 1;
+	const int frameEnd = 262 * dotsPerLine;
+	const int oddFrameSkip = 261 * dotsPerLine + 339;
+
+	int pos = m_state.ScanPos.Scanline * dotsPerLine + m_state.ScanPos.Dots;
+
+	if (pos <= vblankStart)
+		return vblankStart - pos;
+
+	// Wraps around into the next frame; on odd frames,
+	// the pre-render scanline is one dot shorter
+	int ticks = (frameEnd - pos) + vblankStart;
+
+	if ((m_frameCounter % 2) != 0 && pos <= oddFrameSkip)
+		ticks--;
+
+	return ticks;
+}
+
+qword RP2C02::GetStatusStableUntil() const
+{
+	// Vertical blank starts and ends at fixed points in the frame. Sprite
+	// zero hit and overflow are only set while rendering, on the visible
+	// and pre-render scanlines -- unless they're both set already.
+	const int dotsPerLine = 341;
+	const int vblankEnd = 261 * dotsPerLine + 1;
+
+	int pos = m_state.ScanPos.Scanline * dotsPerLine + m_state.ScanPos.Dots;
+	bool renderEnable = CheckFlag(MaskFlag::BackgroundEnable) || CheckFlag(MaskFlag::SpriteEnable);
+	bool spritesDone = CheckFlag(StatusFlag::SpriteZeroHit) && CheckFlag(StatusFlag::SpriteOverflow);
+
+	if (renderEnable && !spritesDone && (m_state.ScanPos.Scanline < 240 || pos > vblankEnd))
+		return m_tickCount;
+
+	qword ticks = GetTicksToVBlank();
+
+	if (pos <= vblankEnd && (qword)(vblankEnd - pos) < ticks)
+		ticks = vblankEnd - pos;
+
+	return m_tickCount + ticks;
+}
+
+const Pixel& RP2C02::Muxer()
 {
 	byte bgpix = 0;
 	byte bgpal = 0;
@@ -750,7 +860,7 @@ Pixel& RP2C02::Muxer()
 	return GetRGBColorFromPalette(outpal, outpix);
 }
 
-Pixel& RP2C02::GetRGBColorFromPalette(byte paletteIndex, byte twoBitPixelValue)
+const Pixel& RP2C02::GetRGBColorFromPalette(byte paletteIndex, byte twoBitPixelValue)
 {
 	// 1. Fetch 1 byte "NES-format" color data from palette memory
 	// 2. Use lookup table to determine corresponding 3-byte RGB color value
@@ -763,16 +873,16 @@ Pixel& RP2C02::GetRGBColorFromPalette(byte paletteIndex, byte twoBitPixelValue)
 	byte nesColor = InternalBusRead(addr);
 
 	// Lookup and return
-	return m_paletteRGB[nesColor & 0x3F];
+	return PaletteRGB[nesColor & 0x3F];
 }
 
-void RP2C02::DrawPixel(Pixel& pixel, int x, int y)
+void RP2C02::DrawPixel(const Pixel& pixel, int x, int y)
 {
 	int offset = y * SCREEN_WIDTH + x;
 
 #ifdef _DEBUG
 	// Bounds checking
-	if (offset > (SCREEN_WIDTH * SCREEN_HEIGTH - 1))
+	if (offset > (SCREEN_WIDTH * SCREEN_HEIGHT - 1))
 		throw QkError("PPU screen array index out of bounds", 666);
 	else
 		m_framebuffer[offset] = pixel;
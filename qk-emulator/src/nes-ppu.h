@@ -11,7 +11,7 @@ namespace Qk { namespace NES
 	constexpr int SCREEN_WIDTH = 256;
 	constexpr int SCREEN_HEIGHT = 240;
 
-	class RP2C02 : public Bus::Device
+	class RP2C02 final : public Bus::Device
 	{
 	public:
 		enum class CtrlFlag
@@ -67,11 +67,14 @@ namespace Qk { namespace NES
 		RP2C02(Bus& bus, const AddressRange& addressableRange, CartridgeSlot& cartridge);
 			   		
 		void Cycle();
+		void RunUntil(qword timestamp);
+		void PowerOn();
 		void Reset();
 
 		// Incoming I/O from main bus
 		byte ReadFromDevice(word address, bool peek = false) override;
 		void WriteToDevice(word address, byte data) override;
+		void WriteOAMDMA(word address, byte data);
 		void OnBusSignal(int signalId) override;
 
 		// Flags
@@ -84,9 +87,16 @@ namespace Qk { namespace NES
 
 		// Output handles
 		FramebufferDescriptor* GetVideoOutput();
-		unsigned long GetFrameCount() const;
+		qword GetFrameCount() const;
+
+		// First master clock tick that may change PPU STATUS without the CPU
+		// accessing the PPU, as of the ticks run so far
+		qword GetStatusStableUntil() const;
 
 	protected:
+		// Shared by the constructors
+		void Initialize();
+
 		// Background fetches
 		void FetchNextBgAddress();
 		void FetchNextBgAttribute();
@@ -113,9 +123,10 @@ namespace Qk { namespace NES
 
 		// Rendering
 		void CycleRenderer();
-		Pixel& Muxer();
-		Pixel& GetRGBColorFromPalette(byte palette, byte pixelValue);
-		void DrawPixel(Pixel& pixel, int x, int y);
+		qword GetTicksToVBlank() const;
+		const Pixel& Muxer();
+		const Pixel& GetRGBColorFromPalette(byte palette, byte pixelValue);
+		void DrawPixel(const Pixel& pixel, int x, int y);
 
 	protected:
 		class RenderState
@@ -194,15 +205,19 @@ namespace Qk { namespace NES
 		bool m_videoModeCheck = false;
 
 		byte m_ppuRegWriteBuf = 0;
-		bool m_doDMA = false;
-		int m_remainingOAMDMACycles = 0;
+		byte m_dmaPage = 0;
+
+		qword m_frameCounter = 0;
+
+		// Master clock ticks run so far. The PPU runs behind the rest of the
+		// system and only catches up when its state becomes observable.
+		qword m_tickCount = 0;
 
-		unsigned long m_frameCounter = 0;
 		Pixel m_framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
 		FramebufferDescriptor m_fi;
 
 		// NES palette RGB values sourced from: https://wiki.nesdev.com/w/index.php/PPU_palettes#2C02
-		Pixel m_paletteRGB[64] = {
+		static constexpr Pixel PaletteRGB[64] = {
 			Pixel(84, 84, 84),		Pixel(0, 30, 116),		Pixel(8, 16, 144),		Pixel(48, 0, 136),
 			Pixel(68, 0, 100),		Pixel(92, 0, 48),		Pixel(84, 4, 0),		Pixel(60, 24, 0),
 			Pixel(32, 42, 0),		Pixel(8, 58, 0),		Pixel(0, 64, 0),		Pixel(0, 60, 0),
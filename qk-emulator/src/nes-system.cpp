@@ -1,6 +1,9 @@
 #pragma warning (disable:26812)
 
 #include "systems.h"
+#include "cpu-ops.h"
+#include "timers.h"
+#include <climits>
 #include <iostream>
 #include <iomanip>
 
@@ -45,26 +48,24 @@ NESConsole::NESConsole()
 	m_ppu = new RP2C02(*m_bus, AddressRange(0x2000, 0x2007), *m_cas);
 	m_pmm = new MemoryMirror(*m_bus, *m_ppu, AddressRange(0x2008, 0x3FFF));
 	
-	// Because OAM DMA address $4014 inconveniently falls within what is otherwise APU address range ($4000-$4015), 
-	// and our bus code assumes that devices occupy a contiguous address range, we'll handle DMA forwards in the APU
-	// class, even though it's not really related. Kinda janky, but avoids code rewrites and additional complexity.
 	// On a real NES, addresses $4000-$4017 all connect to the custom 6502 CPU chip, which includes the APU
-	// and some I/O registers
-	m_apu = new APU(*m_bus, AddressRange(0x4000, 0x4015));
-
-	// Likewise, because NES controllers and APU frame counter share $4017,
-	// forward frame counter updates to APU in the ControllerInterface class.
-	// Yuck.
+	// and some I/O registers. Each register is mapped straight to the device that owns it: the PPU takes
+	// OAM DMA writes at $4014, the APU its registers and $4017 frame counter writes, and the controller
+	// interface $4016 and $4017 reads
+	m_apu = new APU(*m_bus);
 	m_ctr = new ControllerInterface(*m_bus, AddressRange(0x4016, 0x4017));
 
+	// The device set above is fixed, so let the CPU resolve the memory
+	// map at compile time instead of dispatching every access via the bus.
+	// The NES's 6502 chip does not include hardware support for decimal
+	// mode; the RP2A03 variant leaves it out at compile time too.
+	m_map = new MemoryMap(*m_bus, *m_ram, *m_ppu);
+	m_cpu->UseMemoryMap<MOS6502::RP2A03>(*m_map);
+
 	// Initialize components
 	m_cpu->Reset();
 	m_ppu->Reset();
 
-	// The NES's 6502 chip does not include hardware support for
-	// decimal mode, so disable it
-	m_cpu->SetDecimalModeAvailable(false);
-
 	// Keep track of PPU frame rendering status
 	m_ppu_ps = m_ppu->GetVideoOutput();
 }
@@ -80,6 +81,7 @@ NESConsole::~NESConsole()
 	delete m_pmm;
 	delete m_apu;
 	delete m_ctr;
+	delete m_map;
 }
 
 /*
@@ -88,18 +90,246 @@ NESConsole::~NESConsole()
 
 void NESConsole::Clock()
 {
-	// Cycle components at proper relative frequencies
-	// PPU does 3 cycles for every 1 CPU cycle
+	// Run a single master clock tick
+	Advance(m_masterClock + 1, []() { return false; });
+}
+
+void NESConsole::RunFrame()
+{
+	// Run until the PPU finishes drawing the current frame,
+	// i.e. up to and including the tick vertical blank starts
+	QK_TIMER(Frame);
+	qword frame = m_ppu->GetFrameCount();
+
+	Advance(Scheduler::NEVER, [&]() { return m_ppu->GetFrameCount() != frame; });
+}
+
+void NESConsole::RunCycles(qword cycles)
+{
+	// Run for a number of CPU cycles
+	Advance(m_masterClock + cycles * NES_PPU_TICKS_PER_CPU_CYCLE, []() { return false; });
+}
+
+void NESConsole::RunUntil(qword timestamp)
+{
+	// Run all master clock ticks up to (not including) timestamp
+	Advance(timestamp, []() { return false; });
+}
+
+void NESConsole::RunUntil(const std::function<bool()>& predicate)
+{
+	// Run until predicate holds. It is checked after every CPU instruction 
+	// or scheduled event, so it should be cheap.
+	Advance(Scheduler::NEVER, predicate, false);
+}
+
+qword NESConsole::GetMasterClock() const
+{
+	return m_masterClock;
+}
+
+template <class Predicate>
+void NESConsole::Advance(qword timestamp, Predicate stop, bool quiet)
+{
+	// Run all master clock ticks up to (not including) timestamp, or
+	// until stop() returns true -- whichever comes first.
+	// 
+	// Rather than stepping every component on every tick, jump from one
+	// point of interest to the next: the start of a CPU instruction or a
+	// scheduled event. Within a tick, the order is PPU, then due events,
+	// then CPU, then APU -- the same as stepping tick by tick, where
+	// the PPU does 3 cycles for every 1 CPU (and APU) cycle.
+	//
+	// The PPU isn't stepped here at all: it lags behind and catches up
+	// by itself when its state can be observed -- CPU access to its
+	// registers, mapper writes and vertical blank (a scheduled event).
+	//
+	// 'quiet' says stop() can't change while the CPU only accesses RAM
+	// and ROM, so it needn't be checked after each of those instructions,
+	// and that it doesn't look at the CPU registers.
+
+	const qword tpc = NES_PPU_TICKS_PER_CPU_CYCLE;
+
+	// Lets the CPU start its next instruction right away if this loop would
+	// have done just that: still before timestamp, no event due before it,
+	// and stop() didn't hold after the previous one
+	struct BlockRun : MOS6502::BlockHost
+	{
+		NESConsole& NES;
+		qword Timestamp;
+		Predicate& Stop;
+		qword Start;
+		qword Last;	// Tick the latest instruction started on
+		bool Quiet;
+		bool Stopped = false;
+
+		BlockRun(NESConsole& nes, qword timestamp, Predicate& stop, bool quiet, qword start)
+			: NES(nes), Timestamp(timestamp), Stop(stop), Start(start), Last(start), Quiet(quiet) { }
+
+		bool ContinueBlock(int cycles) override
+		{
+			qword now = Start + cycles * NES_PPU_TICKS_PER_CPU_CYCLE;
+
+			if (now >= Timestamp || now >= NES.m_bus->Events.GetNextEventTime())
+				return false;
+
+			if (Stop())
+			{
+				Stopped = true;
+				return false;
+			}
+
+			Started(now);
+			return true;
+		}
+
+		void QuietInstructionsRan(int cycles) override
+		{
+			Started(Start + cycles * NES_PPU_TICKS_PER_CPU_CYCLE);
+		}
+
+		void Started(qword now)
+		{
+			Last = now;
+			NES.m_masterClock = now + 1;
+			NES.m_bus->Events.SetTime(now);
+		}
+
+		bool WatchesRegisters() override
+		{
+			return !Quiet;
+		}
+
+		int GetQuietCycles() override
+		{
+			// RAM and ROM accesses can't post events or make stop() hold,
+			// so only time can make the loop want to step in -- unless
+			// stop() already holds, after the instruction that started this
+			if (!Quiet || Stop())
+				return 0;
+
+			qword limit = NES.m_bus->Events.GetNextEventTime();
+
+			if (Timestamp < limit)
+				limit = Timestamp;
+
+			if (limit <= Start)
+				return 0;
+
+			qword cycles = (limit - Start + NES_PPU_TICKS_PER_CPU_CYCLE - 1) / NES_PPU_TICKS_PER_CPU_CYCLE;
+
+			return cycles < INT_MAX ? (int)cycles : INT_MAX;
+		}
+
+		int GetIdleCycles(int polled) override
+		{
+			// Loops on RAM and ROM only see a change once the loop would
+			// have stepped in anyway; polling PPU STATUS, only once the
+			// PPU gets to the next point where it changes by itself
+			int cycles = GetQuietCycles();
+
+			if (polled == -1 || cycles == 0)
+				return cycles;
+
+			if ((polled & 0xE007) != 0x2002)
+				return 0;
+
+			qword limit = NES.m_ppu->GetStatusStableUntil();
+
+			if (limit <= Start)
+				return 0;
+
+			qword stable = (limit - Start + NES_PPU_TICKS_PER_CPU_CYCLE - 1) / NES_PPU_TICKS_PER_CPU_CYCLE;
+
+			return stable < (qword)cycles ? (int)stable : cycles;
+		}
+	};
+
+	while (m_masterClock < timestamp)
+	{
+		qword next = timestamp - 1;
+		qword due = m_bus->Events.GetNextEventTime();
+
+		if (due < m_masterClock)
+			due = m_masterClock;
+
+		if (due < next)
+			next = due;
+
+		if (!m_cpu->IsHalted() && m_cpuClock < next)
+			next = m_cpuClock;
+
+		m_masterClock = next + 1;
+		m_bus->Events.SetTime(next);
+
+		// Scheduled events
+		bool wasHalted = m_cpu->IsHalted();
+		m_bus->RunEvents(next);
+		OnCPUHaltChanged(wasHalted, ((next + tpc - 1) / tpc) * tpc);
+
+		// CPU executes whole instructions, on the first tick of each. The
+		// block cache core may run on through the ones that follow, as
+		// long as BlockRun finds there's nothing else to do in between.
+		if (!m_cpu->IsHalted() && m_cpuClock == next)
+		{
+			m_apu->RunUntil(next / tpc);
+
+			BlockRun run(*this, timestamp, stop, quiet, next);
+			m_cpuClock += m_cpu->RunBlock(run) * tpc;
 
-	m_ppu->Cycle();
+			// An instruction that halts the CPU (e.g. by starting DMA) has 
+			// done its first cycle; halt takes effect from the next one
+			OnCPUHaltChanged(false, run.Last + tpc);
 
-	if (m_systemClockCount % 3 == 0)
+			if (run.Stopped)
+				break;
+		}
+
+		if (stop())
+			break;
+	}
+
+	// Leave all components up to date for the caller
+	m_ppu->RunUntil(m_masterClock);
+	m_apu->RunUntil((m_masterClock + tpc - 1) / tpc);
+}
+
+void NESConsole::OnCPUHaltChanged(bool wasHalted, qword haltStart)
+{
+	// CPU time stands still while halted: remember what's left of the current
+	// instruction at the first halted CPU cycle, and continue from there when resumed
+	bool isHalted = m_cpu->IsHalted();
+
+	if (isHalted && !wasHalted)
 	{
-		m_cpu->Cycle();
-		m_apu->Cycle();
+		m_cpuHaltedRemaining = m_cpuClock > haltStart ? m_cpuClock - haltStart : 0;
 	}
+	else if (wasHalted && !isHalted)
+	{
+		m_cpuClock = haltStart + m_cpuHaltedRemaining;
+	}
+}
 
-	m_systemClockCount++;
+void NESConsole::PowerCycle()
+{
+	// Return everything but the cartridge to its power-on state, so
+	// one console object can be reused to run any number of sessions
+	m_bus->Events.Clear();
+	m_bus->Events.SetTime(0);
+	m_bus->NMI.Clear();
+	m_bus->IRQ.Clear();
+
+	m_masterClock = 0;
+	m_cpuClock = 0;
+	m_cpuHaltedRemaining = 0;
+
+	m_ram->Clear();
+	m_cpu->PowerOn();
+	m_ppu->PowerOn();
+	m_apu->PowerOn();
+	m_ctr->PowerOn();
+
+	m_cpu->Reset();
 }
 
 void NESConsole::Reset()
@@ -118,12 +348,42 @@ void NESConsole::InsertCartridge(const std::shared_ptr<Cartridge>& cartridge)
 	m_cas->InsertCartridge(cartridge);
 }
 
+void NESConsole::SetCPUCore(MOS6502::CoreType core)
+{
+	m_cpu->UseMemoryMap<MOS6502::RP2A03>(*m_map, core);
+}
+
+void NESConsole::SetIdleLoopSkipping(bool enabled)
+{
+	m_cpu->SetIdleLoopSkipping(enabled);
+}
+
+qword NESConsole::GetIdleCyclesSkipped() const
+{
+	return m_cpu->GetIdleCyclesSkipped();
+}
+
+void NESConsole::SetCPUTrace(CPUTrace* trace)
+{
+	m_cpu->SetTrace(trace);
+}
+
+void NESConsole::SetCPUProfiler(CPUProfiler* profiler)
+{
+	m_cpu->SetProfiler(profiler);
+}
+
+void NESConsole::SetCPUCallProfiler(CPUCallProfiler* profiler)
+{
+	m_cpu->SetCallProfiler(profiler);
+}
+
 FramebufferDescriptor* NESConsole::GetVideoOutput()
 {
 	return m_ppu_ps;
 }
 
-unsigned long NESConsole::GetPPUFrameCount() const
+qword NESConsole::GetPPUFrameCount() const
 {
 	return m_ppu->GetFrameCount();
 }
@@ -143,6 +403,16 @@ double NESConsole::GetAudioSampleRate() const
 	return m_apu->GetAudioSampleRate();
 }
 
+qword NESConsole::GetAudioUnderrunCount() const
+{
+	return m_apu->GetAudioUnderrunCount();
+}
+
+qword NESConsole::GetAudioOverrunCount() const
+{
+	return m_apu->GetAudioOverrunCount();
+}
+
 void NESConsole::ControllerInput(Controller::Player pad, Controller::Button button, bool pressed)
 {
 	if (pressed)
@@ -151,6 +421,50 @@ void NESConsole::ControllerInput(Controller::Player pad, Controller::Button butt
 		m_ctr->ReleaseButton(pad, button);
 }
 
+qword NESConsole::GetStateHash()
+{
+	// 64-bit FNV-1a over everything a program can observe
+	qword hash = 0xCBF29CE484222325;
+
+	auto mix = [&hash](byte data)
+	{
+		hash ^= data;
+		hash *= 0x00000100000001B3;
+	};
+
+	mix(m_cpu->Registers.A);
+	mix(m_cpu->Registers.X);
+	mix(m_cpu->Registers.Y);
+	mix(m_cpu->Registers.S);
+	mix(m_cpu->Registers.P);
+	mix(m_cpu->Registers.PC & 0x00FF);
+	mix(m_cpu->Registers.PC >> 8);
+
+	for (int address = 0x0000; address <= 0x07FF; address++)
+		mix(m_bus->Peek(address));
+
+	for (auto& nametable : m_ppu->VRAM.Nametable)
+	{
+		for (byte data : nametable)
+			mix(data);
+	}
+
+	for (byte data : m_ppu->VRAM.Palette)
+		mix(data);
+
+	for (byte data : m_ppu->VRAM.OAM)
+		mix(data);
+
+	for (int i = 0; i < m_ppu_ps->Width * m_ppu_ps->Height; i++)
+	{
+		mix(m_ppu_ps->PixelArray[i].Red);
+		mix(m_ppu_ps->PixelArray[i].Green);
+		mix(m_ppu_ps->PixelArray[i].Blue);
+	}
+
+	return hash;
+}
+
 
 /*
 	DEBUG
@@ -174,9 +488,4 @@ void NESConsole::PrintMemory(word addressStart, word addressEnd)
 	}
 }
 
-void NESConsole::DumpCPUFrameLog(const std::string& path)
-{
-	m_cpu->SaveDebugInfo(path);
-}
-
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "scheduler.h"
+
+using namespace Qk;
+
+/*
+	Time
+*/
+
+qword Scheduler::Now() const
+{
+	return m_now;
+}
+
+void Scheduler::SetTime(qword timestamp)
+{
+	m_now = timestamp;
+}
+
+
+/*
+	Events
+*/
+
+void Scheduler::Post(qword timestamp, int signalId)
+{
+	// Insert ahead of (i.e. to fire after) events with the same timestamp
+	auto it = m_events.begin();
+
+	while (it != m_events.end() && it->Timestamp > timestamp)
+		it++;
+
+	m_events.insert(it, { timestamp, signalId });
+}
+
+void Scheduler::Cancel(int signalId)
+{
+	for (auto it = m_events.begin(); it != m_events.end();)
+	{
+		if (it->SignalId == signalId)
+			it = m_events.erase(it);
+		else
+			it++;
+	}
+}
+
+bool Scheduler::IsPending(int signalId) const
+{
+	for (const Event& ev : m_events)
+	{
+		if (ev.SignalId == signalId)
+			return true;
+	}
+
+	return false;
+}
+
+void Scheduler::Clear()
+{
+	m_events.clear();
+}
+
+qword Scheduler::GetNextEventTime() const
+{
+	return m_events.empty() ? NEVER : m_events.back().Timestamp;
+}
+
+int Scheduler::PopNextEvent()
+{
+	Event ev = m_events.back();
+	m_events.pop_back();
+
+	if (ev.Timestamp > m_now)
+		m_now = ev.Timestamp;
+
+	return ev.SignalId;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "definitions.h"
+
+
+namespace Qk
+{
+	// Timestamped events on a 64-bit master clock. Each event is a bus
+	// signal that is to be emitted at a known future time, e.g. the end of
+	// a DMA transfer. The system driving the clock pops events as it reaches
+	// their timestamps; see Bus::RunEvents.
+	class Scheduler
+	{
+	public:
+		static constexpr qword NEVER = UINT64_MAX;
+
+	public:
+		// Current master clock time, as set by the system driving the clock
+		qword Now() const;
+		void SetTime(qword timestamp);
+
+		// Events posted for the same timestamp fire in the order they were posted
+		void Post(qword timestamp, int signalId);
+		void Cancel(int signalId);
+		bool IsPending(int signalId) const;
+		void Clear();
+
+		qword GetNextEventTime() const;
+
+		// Remove earliest event, advance time to its timestamp
+		// and return its signal id
+		int PopNextEvent();
+
+	protected:
+		struct Event
+		{
+			qword Timestamp;
+			int SignalId;
+		};
+
+		// Sorted latest first, so the next event to fire sits at the back
+		std::vector<Event> m_events;
+		qword m_now = 0;
+	};
+}
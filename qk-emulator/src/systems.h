@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <functional>
 #include "definitions.h"
 #include "bus.h"
 #include "cpu.h"
@@ -10,6 +11,7 @@
 #include "nes-cartridge.h"
 #include "nes-controller.h"
 #include "nes-apu.h"
+#include "nes-memorymap.h"
 
 
 namespace Qk {
@@ -30,35 +32,79 @@ namespace Qk {
 			APU* m_apu = nullptr;
 			CartridgeSlot* m_cas = nullptr;
 			ControllerInterface* m_ctr = nullptr;
+			MemoryMap* m_map = nullptr;
 
-			unsigned long m_systemClockCount = 0;
+			// Master clock, in PPU ticks: all ticks before m_masterClock have run.
+			// CPU starts its next instruction at tick m_cpuClock, unless halted;
+			// m_cpuHaltedRemaining then holds what's left of its current instruction
+			qword m_masterClock = 0;
+			qword m_cpuClock = 0;
+			qword m_cpuHaltedRemaining = 0;
 			FramebufferDescriptor* m_ppu_ps = nullptr;
 
+			template <class Predicate>
+			void Advance(qword timestamp, Predicate stop, bool quiet = true);
+			void OnCPUHaltChanged(bool wasHalted, qword haltStart);
+
 		public:
 			NESConsole();
 			~NESConsole();
 
+			// Running the system. These keep CPU, PPU and APU interleaved in one
+			// loop internally; prefer them over calling Clock() for every tick.
 			void Clock();
+			void RunFrame();
+			void RunCycles(qword cycles);
+			void RunUntil(qword timestamp);
+			void RunUntil(const std::function<bool()>& predicate);
+			qword GetMasterClock() const;
+
+			void PowerCycle();
 			void Reset();
 			void Reset(word programCounter);
 			void InsertCartridge(const std::shared_ptr<Cartridge>& cart);
 
+			// Switch CPU instruction core; state carries over
+			void SetCPUCore(MOS6502::CoreType core);
+
+			// Fast-forward through idle loops (on by default); results don't change
+			void SetIdleLoopSkipping(bool enabled);
+			qword GetIdleCyclesSkipped() const;
+
+			// Record CPU instructions into a trace (see cpu-trace.h); nullptr
+			// to stop. With one set, the CPU steps an instruction at a time: no
+			// block or JIT core runs.
+			void SetCPUTrace(CPUTrace* trace);
+
+			// Count CPU instructions into a profile (see cpu-profiler.h);
+			// nullptr to stop. Steps the CPU one instruction at a time too.
+			void SetCPUProfiler(CPUProfiler* profiler);
+
+			// Count CPU cycles by guest routine and call chain (see
+			// cpu-callstack.h); nullptr to stop. Steps one at a time too.
+			void SetCPUCallProfiler(CPUCallProfiler* profiler);
+
 			// Video
 			FramebufferDescriptor* GetVideoOutput();
-			unsigned long GetPPUFrameCount() const;
+			qword GetPPUFrameCount() const;
 
 			// Audio
 			void FillAudioBuffer(audiosample* buffer, size_t numSamples);
 			int GetAudioBufferSize() const;
 			double GetAudioSampleRate() const;
+			qword GetAudioUnderrunCount() const;
+			qword GetAudioOverrunCount() const;
 
 			// Controller inputs
 			void ControllerInput(Controller::Player pad, Controller::Button button, bool pressed);
 
+			// Fingerprint of the emulated machine state (CPU registers, RAM, PPU
+			// memory and framebuffer), for checking that two runs behave the same
+			qword GetStateHash();
+
 #ifdef _DEBUG
 			// DEBUG
 			void PrintMemory(word addressStart, word addressEnd);
-			void DumpCPUFrameLog(const std::string& path);
 #endif
 		};
 	}
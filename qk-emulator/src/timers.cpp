@@ -0,0 +1,158 @@
+#include <iomanip>
+#include "timers.h"
+
+
+using namespace Qk;
+
+
+const char* const HostTimers::SectionNames[SECTION_COUNT] = {
+	"Frame", "CPU", "PPU", "APU", "Bus", "Mapper", "Present"
+};
+
+thread_local HostTimers* HostTimers::s_current = nullptr;
+
+
+/*
+	Constructor
+*/
+
+HostTimers::HostTimers()
+	: m_startTicks(Now()),
+	  m_startTime(std::chrono::steady_clock::now())
+{
+}
+
+
+/*
+	Public interface methods
+*/
+
+void HostTimers::Attach(HostTimers* timers)
+{
+	s_current = timers;
+}
+
+void HostTimers::SetTimeline(bool enabled, std::size_t maxEvents)
+{
+	m_timeline = enabled;
+	m_maxEvents = maxEvents;
+}
+
+double HostTimers::GetSeconds(qword ticks) const
+{
+	return ticks / GetTicksPerMicrosecond() / 1e6;
+}
+
+
+/*
+	Frames
+*/
+
+void HostTimers::BeginFrame()
+{
+	for (int n = 0; n < SECTION_COUNT; n++)
+		m_frameSelf[n] = m_counters[n].Self;
+}
+
+void HostTimers::EndFrame(qword start, qword duration)
+{
+	Frame frame;
+	frame.Start = start;
+	frame.Duration = duration;
+
+	for (int n = 0; n < SECTION_COUNT; n++)
+		frame.Self[n] = m_counters[n].Self - m_frameSelf[n];
+
+	m_frames.push_back(frame);
+}
+
+double HostTimers::GetTicksPerMicrosecond() const
+{
+#ifdef QK_TIMERS_RDTSC
+	// Time stamp counter rate, from how far it got since construction
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+	qword ticks = Now() - m_startTicks;
+
+	return elapsed > 0 && ticks > 0 ? ticks / elapsed : 1.0;
+#else
+	return 1000.0;
+#endif
+}
+
+
+/*
+	Output
+*/
+
+void HostTimers::WriteSummary(std::ostream& out) const
+{
+	double scale = 1e3 / GetTicksPerMicrosecond() / 1e6;
+
+	out << "section       calls     self ms    incl ms     max ms" << std::endl;
+
+	for (int n = 0; n < SECTION_COUNT; n++)
+	{
+		const Counter& counter = m_counters[n];
+
+		if (counter.Calls == 0)
+			continue;
+
+		out << std::left << std::setw(8) << SectionNames[n] << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(11) << counter.Calls
+			<< std::setw(12) << counter.Self * scale
+			<< std::setw(11) << counter.Inclusive * scale
+			<< std::setw(11) << counter.Max * scale << std::endl;
+	}
+}
+
+void HostTimers::WriteChromeTrace(std::ostream& out) const
+{
+	// Complete ('X') events on one thread, times in microseconds from the
+	// start; nesting shows as stacking
+	double rate = GetTicksPerMicrosecond();
+	auto us = [&](qword ticks) { return ticks / rate; };
+
+	out << std::fixed << std::setprecision(3)
+		<< "{\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n"
+		<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"emulation\"}}";
+
+	for (std::size_t f = 0; f < m_frames.size(); f++)
+	{
+		const Frame& frame = m_frames[f];
+
+		out << ",\n{\"name\": \"Frame\", \"cat\": \"frame\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+			<< ", \"ts\": " << us(frame.Start - m_startTicks) << ", \"dur\": " << us(frame.Duration)
+			<< ", \"args\": {\"frame\": " << f;
+
+		for (int n = 1; n < SECTION_COUNT; n++)
+		{
+			if (frame.Self[n] > 0)
+				out << ", \"" << SectionNames[n] << " self us\": " << us(frame.Self[n]);
+		}
+
+		out << "}}";
+	}
+
+	for (const Event& event : m_events)
+	{
+		out << ",\n{\"name\": \"" << SectionNames[(int)event.Which] << "\", \"cat\": \"emulation\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+			<< ", \"ts\": " << us(event.Start - m_startTicks) << ", \"dur\": " << us(event.Duration) << "}";
+	}
+
+	out << "\n],\n\"otherData\": {\"ticks_per_us\": \"" << rate << "\", \"events_dropped\": \"" << m_eventsDropped << "\"},\n"
+		<< "\"counters\": [";
+
+	const char* separator = "\n";
+
+	for (int n = 0; n < SECTION_COUNT; n++)
+	{
+		const Counter& counter = m_counters[n];
+
+		out << separator << "{\"section\": \"" << SectionNames[n] << "\", \"calls\": " << counter.Calls
+			<< ", \"self_us\": " << us(counter.Self) << ", \"inclusive_us\": " << us(counter.Inclusive)
+			<< ", \"max_us\": " << us(counter.Max) << "}";
+		separator = ",\n";
+	}
+
+	out << "\n]}\n";
+}
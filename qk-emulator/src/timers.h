@@ -0,0 +1,229 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+#include "definitions.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define QK_TIMERS_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define QK_TIMERS_RDTSC
+#endif
+
+
+namespace Qk
+{
+	/*
+		Host time instrumentation: where the emulator's own time goes. Scoped
+		timers at subsystem boundaries count calls and inclusive and self
+		time per subsystem (self: less the subsystems it called), per frame
+		and over the run, and can log a timeline in Chrome trace_event JSON
+		for Perfetto or chrome://tracing.
+
+		Timers are compiled in only when QK_TIMERS is defined (cmake
+		-DQK_TIMERS=ON); otherwise QK_TIMER() is nothing. Compiled in, they
+		record into the HostTimers attached to the calling thread, if any.
+	*/
+
+	class HostTimers
+	{
+	public:
+		enum class Section
+		{
+			Frame,		// NESConsole::RunFrame
+			CPU,		// Instructions, between scheduler stops
+			PPU,		// Rendering, caught up on demand
+			APU,		// Audio, likewise
+			Bus,		// Device register I/O, not RAM or ROM
+			Mapper,		// Cartridge address mapping, both buses
+			Present,	// Frontend video output
+			Count
+		};
+
+		static constexpr int SECTION_COUNT = (int)Section::Count;
+		static const char* const SectionNames[SECTION_COUNT];
+
+		// In ticks; see GetSeconds
+		struct Counter
+		{
+			qword Calls = 0;
+			qword Inclusive = 0;
+			qword Self = 0;
+			qword Max = 0;		// Longest single call, inclusive
+		};
+
+		static constexpr bool IsCompiledIn()
+		{
+#ifdef QK_TIMERS
+			return true;
+#else
+			return false;
+#endif
+		}
+
+	public:
+		HostTimers();
+
+		// Timers on the calling thread count into timers; nullptr to stop
+		static void Attach(HostTimers* timers);
+		static HostTimers* GetCurrent() { return s_current; }
+
+		// Keep a timeline of every CPU, PPU, APU and Present call, up to a
+		// number of events; frames are always kept. Bus and Mapper calls are
+		// too short and too many, so they only count.
+		void SetTimeline(bool enabled, std::size_t maxEvents = 1 << 22);
+
+		void Begin(Section section);
+		void End();
+
+		const Counter& Get(Section section) const { return m_counters[(int)section]; }
+		qword GetFrameCount() const { return m_frames.size(); }
+		double GetSeconds(qword ticks) const;
+
+		// Aggregate counters, one row per section, in milliseconds
+		void WriteSummary(std::ostream& out) const;
+
+		// Timeline, with per-frame self times as the frame events' arguments
+		// and the aggregate counters as metadata
+		void WriteChromeTrace(std::ostream& out) const;
+
+		static qword Now();
+
+	protected:
+		static thread_local HostTimers* s_current;
+
+		static constexpr int MAX_DEPTH = 32;
+
+		struct Open
+		{
+			Section Which;
+			qword Start;
+			qword Children;
+		};
+
+		struct Event
+		{
+			qword Start;
+			qword Duration;
+			Section Which;
+		};
+
+		struct Frame
+		{
+			qword Start;
+			qword Duration;
+			qword Self[SECTION_COUNT];
+		};
+
+		Counter m_counters[SECTION_COUNT];
+		Open m_stack[MAX_DEPTH];
+		int m_depth = 0;
+
+		bool m_timeline = false;
+		std::size_t m_maxEvents = 0;
+		std::vector<Event> m_events;
+		qword m_eventsDropped = 0;
+
+		// Per frame, and self times at the start of the current one
+		std::vector<Frame> m_frames;
+		qword m_frameSelf[SECTION_COUNT] = {};
+
+		// Tick rate, measured between construction and output
+		qword m_startTicks;
+		std::chrono::steady_clock::time_point m_startTime;
+
+		void BeginFrame();
+		void EndFrame(qword start, qword duration);
+		double GetTicksPerMicrosecond() const;
+	};
+
+	// Times the enclosing scope
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(HostTimers::Section section) : m_timers(HostTimers::GetCurrent())
+		{
+			if (m_timers != nullptr)
+				m_timers->Begin(section);
+		}
+
+		~ScopedTimer()
+		{
+			if (m_timers != nullptr)
+				m_timers->End();
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		HostTimers* m_timers;
+	};
+
+
+	/*
+		Timing -- inline, as it runs at every subsystem boundary
+	*/
+
+	inline qword HostTimers::Now()
+	{
+#ifdef QK_TIMERS_RDTSC
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	inline void HostTimers::Begin(Section section)
+	{
+		if (section == Section::Frame)
+			BeginFrame();
+
+		if (m_depth < MAX_DEPTH)
+			m_stack[m_depth] = { section, Now(), 0 };
+
+		m_depth++;
+	}
+
+	inline void HostTimers::End()
+	{
+		qword now = Now();
+
+		if (--m_depth >= MAX_DEPTH)
+			return;
+
+		const Open& open = m_stack[m_depth];
+		Counter& counter = m_counters[(int)open.Which];
+		qword elapsed = now - open.Start;
+
+		counter.Calls++;
+		counter.Inclusive += elapsed;
+		counter.Self += elapsed - open.Children;
+
+		if (elapsed > counter.Max)
+			counter.Max = elapsed;
+
+		if (m_depth > 0)
+			m_stack[m_depth - 1].Children += elapsed;
+
+		if (open.Which == Section::Frame)
+			EndFrame(open.Start, elapsed);
+
+		if (m_timeline && open.Which != Section::Frame && open.Which != Section::Bus && open.Which != Section::Mapper)
+		{
+			if (m_events.size() < m_maxEvents)
+				m_events.push_back({ open.Start, elapsed, open.Which });
+			else
+				m_eventsDropped++;
+		}
+	}
+}
+
+#ifdef QK_TIMERS
+#define QK_TIMER(section) Qk::ScopedTimer qkScopedTimer(Qk::HostTimers::Section::section)
+#else
+#define QK_TIMER(section)
+#endif
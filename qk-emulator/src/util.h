@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
+#include <cstddef>
 #include "definitions.h"
 
 namespace Qk { namespace Util
@@ -13,53 +15,118 @@ namespace Qk { namespace Util
 
 	void PrintBits(byte data);
 
+	// Lock-free ring buffer for exactly one producer thread and one consumer
+	// thread, e.g. emulation generating audio samples and the audio device
+	// callback playing them. Neither side ever waits for the other: writes that
+	// don't fit are dropped (overrun), reads of more than is available come up
+	// short (underrun). Both are counted.
 	template<typename T>
-	class CircularBuffer
+	class SPSCRingBuffer
 	{
-	protected:
-		std::vector<T> m_vec;
-		int m_maxSize;
+	public:
+		static constexpr std::size_t CACHE_LINE_SIZE = 64;
 
 	public:
-		CircularBuffer(int size) : m_maxSize(size) 
-		{ 
-			m_vec.resize(m_maxSize);
-		};
+		// Capacity is rounded up to a power of two
+		SPSCRingBuffer(std::size_t capacity)
+		{
+			std::size_t size = 1;
+
+			while (size < capacity)
+				size <<= 1;
 
-		void SetSize(int size)
+			m_data.resize(size);
+			m_mask = size - 1;
+		}
+
+		std::size_t GetCapacity() const
 		{
-			m_maxSize = size;
-			m_vec.resize(size);
+			return m_mask + 1;
 		}
 
-		int GetSize() const
+		// Number of items waiting to be read; exact only when called by either side
+		std::size_t GetSize() const
 		{
-			return m_vec.size();
+			return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_acquire);
 		}
 
-		void Push(T value)
+		qword GetOverrunCount() const
 		{
-			if (m_vec.size() == m_maxSize)
-				m_vec.erase(m_vec.begin());
+			return m_overruns.load(std::memory_order_relaxed);
+		}
 
-			m_vec.push_back(value);
+		qword GetUnderrunCount() const
+		{
+			return m_underruns.load(std::memory_order_relaxed);
 		}
 
-		void Copy(T* target, size_t size)
+		// Producer side
+		bool Push(const T& value)
 		{
-			if (size >= m_vec.size())
-			{
-				std::copy(m_vec.begin(), m_vec.end(), target);
-			}
-			else
+			return Write(&value, 1) == 1;
+		}
+
+		std::size_t Write(const T* data, std::size_t count)
+		{
+			std::size_t write = m_writeIndex.load(std::memory_order_relaxed);
+
+			// Only look at the consumer's index (and touch its cache line)
+			// if the last one we saw doesn't leave enough room
+			if (GetCapacity() - (write - m_readIndexCache) < count)
+				m_readIndexCache = m_readIndex.load(std::memory_order_acquire);
+
+			std::size_t space = GetCapacity() - (write - m_readIndexCache);
+
+			if (count > space)
 			{
-				std::copy(m_vec.begin(), m_vec.begin() + (size - 1), target);
+				m_overruns.fetch_add(1, std::memory_order_relaxed);
+				count = space;
 			}
+
+			for (std::size_t i = 0; i < count; i++)
+				m_data[(write + i) & m_mask] = data[i];
+
+			m_writeIndex.store(write + count, std::memory_order_release);
+			return count;
 		}
 
-		T* Data()
+		// Consumer side
+		std::size_t Read(T* target, std::size_t count)
 		{
-			return m_vec.data();
+			std::size_t read = m_readIndex.load(std::memory_order_relaxed);
+
+			if (m_writeIndexCache - read < count)
+				m_writeIndexCache = m_writeIndex.load(std::memory_order_acquire);
+
+			std::size_t available = m_writeIndexCache - read;
+
+			if (count > available)
+			{
+				m_underruns.fetch_add(1, std::memory_order_relaxed);
+				count = available;
+			}
+
+			for (std::size_t i = 0; i < count; i++)
+				target[i] = m_data[(read + i) & m_mask];
+
+			m_readIndex.store(read + count, std::memory_order_release);
+			return count;
 		}
+
+	protected:
+		// Indices count up forever (wrapping at size_t max, which is a multiple of
+		// capacity); masking them gives the position in m_data. Each side's index
+		// and private copy of the other side's index get their own cache line,
+		// so the two threads don't keep stealing it from each other.
+		alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_writeIndex{ 0 };
+		std::size_t m_readIndexCache = 0;
+		std::atomic<qword> m_overruns{ 0 };
+
+		alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_readIndex{ 0 };
+		std::size_t m_writeIndexCache = 0;
+		std::atomic<qword> m_underruns{ 0 };
+
+		alignas(CACHE_LINE_SIZE) std::vector<T> m_data;
+		std::size_t m_mask;
 	};
 }}
\ No newline at end of file
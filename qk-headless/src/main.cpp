@@ -0,0 +1,452 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include "systems.h"
+#include "nes-batch.h"
+#include "timers.h"
+#include "hw-counters.h"
+
+
+using namespace Qk;
+using namespace Qk::NES;
+
+
+/*
+	Headless NES runner: runs a ROM for a number of frames without any video,
+	audio or input devices, and reports how fast that went. Intended for
+	throughput measurements and regression checks on machines without a display.
+*/
+
+struct Options
+{
+	std::string RomPath;
+	qword Frames = 600;
+	std::string InputScript;
+	std::string DumpFramebuffer;
+	bool PrintHash = false;
+	bool IdleSkipping = true;
+	MOS6502::CoreType Core = MOS6502::CoreType::Block;
+	std::string TracePath;
+	CPUTrace::Format TraceFormat = CPUTrace::Format::Binary;
+	CPUTrace::Filter TraceFilter;
+	std::string ProfilePath;
+	bool ProfileJSON = false;
+	bool ProfilePerFrame = false;
+	std::string CallStacksPath;
+	std::string RoutinesPath;
+	std::vector<std::string> SymbolPaths;
+	std::string TimersPath;
+	std::string CountersPath;
+};
+
+static void PrintUsage()
+{
+	std::cout
+		<< "usage: qk-headless [options] [path to nes romfile]" << std::endl
+		<< std::endl
+		<< "  -f, --frames N        run N frames (default 600)" << std::endl
+		<< "  -i, --input FILE      scripted controller input, one event per line:" << std::endl
+		<< "                        <frame> <player 1|2> <button> <down|up>" << std::endl
+		<< "                        button: a b select start up down left right" << std::endl
+		<< "  -d, --dump FILE       write final framebuffer to FILE (binary PPM)" << std::endl
+		<< "  -s, --hash            print hash of final machine state" << std::endl
+		<< "  -c, --core NAME       CPU core: block (default), fused, reference, jit" << std::endl
+		<< "                        or jit-lockstep (checks jit against fused)" << std::endl
+		<< "  -n, --no-idle-skip    run idle loops instruction by instruction" << std::endl
+		<< "  -t, --trace FILE      write a CPU instruction trace to FILE" << std::endl
+		<< "  --trace-format NAME   binary (default), delta (compressed binary)" << std::endl
+		<< "                        or text (nestest.log style)" << std::endl
+		<< "  --trace-pc A-B        trace instructions at PC $A to $B only (hex)" << std::endl
+		<< "  --trace-cycles A-B    trace from CPU cycle A to B only" << std::endl
+		<< "  -p, --profile FILE    write a CPU profile to FILE: cycles spent by PC," << std::endl
+		<< "                        opcode and addressing mode" << std::endl
+		<< "  --profile-format NAME csv (default) or json" << std::endl
+		<< "  --profile-per-frame   one profile per frame, rather than for the run" << std::endl
+		<< "  --call-stacks FILE    write cycles by guest call stack to FILE, in" << std::endl
+		<< "                        folded form for flame graph tools" << std::endl
+		<< "  --routines FILE       write calls and cycles by guest routine to FILE (csv)" << std::endl
+		<< "  --symbols FILE        name routines from FILE (ca65 .dbg, VICE, FCEUX .nl," << std::endl
+		<< "                        NESASM .fns or WLA DX .sym); may be repeated" << std::endl
+		<< "  --timers FILE         time the emulator by subsystem and write a Chrome" << std::endl
+		<< "                        trace_event timeline to FILE (needs a QK_TIMERS build)" << std::endl
+		<< "  --counters FILE       count host cycles, instructions, branch misses and" << std::endl
+		<< "                        cache and TLB misses per frame into FILE (csv);" << std::endl
+		<< "                        Linux perf_event_open, skipped if unavailable" << std::endl;
+}
+
+// "A-B", both bounds inclusive
+static bool ParseRange(const std::string& text, int base, qword& min, qword& max)
+{
+	std::size_t dash = text.find('-');
+
+	if (dash == std::string::npos || dash == 0 || dash + 1 == text.size())
+		return false;
+
+	char* end;
+	min = std::strtoull(text.c_str(), &end, base);
+
+	if (end != text.c_str() + dash)
+		return false;
+
+	max = std::strtoull(text.c_str() + dash + 1, &end, base);
+
+	return *end == '\0' && min <= max;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue = i + 1 < argc;
+
+		if ((arg == "-f" || arg == "--frames") && hasValue)
+			options.Frames = std::strtoull(argv[++i], nullptr, 10);
+		else if ((arg == "-i" || arg == "--input") && hasValue)
+			options.InputScript = argv[++i];
+		else if ((arg == "-d" || arg == "--dump") && hasValue)
+			options.DumpFramebuffer = argv[++i];
+		else if (arg == "-s" || arg == "--hash")
+			options.PrintHash = true;
+		else if (arg == "-n" || arg == "--no-idle-skip")
+			options.IdleSkipping = false;
+		else if ((arg == "-c" || arg == "--core") && hasValue)
+		{
+			std::string core(argv[++i]);
+
+			if (core == "jit")
+				options.Core = MOS6502::CoreType::JIT;
+			else if (core == "jit-lockstep")
+				options.Core = MOS6502::CoreType::JITLockstep;
+			else if (core == "block")
+				options.Core = MOS6502::CoreType::Block;
+			else if (core == "fused")
+				options.Core = MOS6502::CoreType::Fused;
+			else if (core == "reference")
+				options.Core = MOS6502::CoreType::Reference;
+			else
+				return false;
+		}
+		else if ((arg == "-t" || arg == "--trace") && hasValue)
+			options.TracePath = argv[++i];
+		else if (arg == "--trace-format" && hasValue)
+		{
+			std::string format(argv[++i]);
+
+			if (format == "binary")
+				options.TraceFormat = CPUTrace::Format::Binary;
+			else if (format == "delta")
+				options.TraceFormat = CPUTrace::Format::Delta;
+			else if (format == "text")
+				options.TraceFormat = CPUTrace::Format::Text;
+			else
+				return false;
+		}
+		else if (arg == "--trace-pc" && hasValue)
+		{
+			qword min, max;
+
+			if (!ParseRange(argv[++i], 16, min, max) || max > 0xFFFF)
+				return false;
+
+			options.TraceFilter.PCMin = (word)min;
+			options.TraceFilter.PCMax = (word)max;
+		}
+		else if (arg == "--trace-cycles" && hasValue)
+		{
+			if (!ParseRange(argv[++i], 10, options.TraceFilter.CycleMin, options.TraceFilter.CycleMax))
+				return false;
+		}
+		else if ((arg == "-p" || arg == "--profile") && hasValue)
+			options.ProfilePath = argv[++i];
+		else if (arg == "--profile-format" && hasValue)
+		{
+			std::string format(argv[++i]);
+
+			if (format != "csv" && format != "json")
+				return false;
+
+			options.ProfileJSON = format == "json";
+		}
+		else if (arg == "--profile-per-frame")
+			options.ProfilePerFrame = true;
+		else if (arg == "--call-stacks" && hasValue)
+			options.CallStacksPath = argv[++i];
+		else if (arg == "--routines" && hasValue)
+			options.RoutinesPath = argv[++i];
+		else if (arg == "--symbols" && hasValue)
+			options.SymbolPaths.push_back(argv[++i]);
+		else if (arg == "--timers" && hasValue)
+			options.TimersPath = argv[++i];
+		else if (arg == "--counters" && hasValue)
+			options.CountersPath = argv[++i];
+		else if (arg[0] != '-' && options.RomPath.empty())
+			options.RomPath = arg;
+		else
+			return false;
+	}
+
+	return !options.RomPath.empty();
+}
+
+static void DumpFramebuffer(const FramebufferDescriptor& fb, const std::string& path)
+{
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file)
+		throw QkError("Cannot write framebuffer dump", 7402);
+
+	file << "P6\n" << fb.Width << " " << fb.Height << "\n255\n";
+
+	for (int i = 0; i < fb.Width * fb.Height; i++)
+	{
+		file.put(fb.PixelArray[i].Red);
+		file.put(fb.PixelArray[i].Green);
+		file.put(fb.PixelArray[i].Blue);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	try
+	{
+		std::vector<InputEvent> script;
+
+		if (!options.InputScript.empty())
+			script = LoadInputScript(options.InputScript);
+
+		// Console is big; keep it off the stack
+		std::unique_ptr<NESConsole> nes(new NESConsole());
+		nes->SetCPUCore(options.Core);
+		nes->SetIdleLoopSkipping(options.IdleSkipping);
+		nes->InsertCartridge(std::make_shared<Cartridge>(options.RomPath));
+		nes->Reset();
+
+		// Tracing, if asked for; the writer thread keeps up with the CPU
+		std::unique_ptr<CPUTrace> trace;
+
+		if (!options.TracePath.empty())
+		{
+			trace.reset(new CPUTrace());
+			trace->SetFilter(options.TraceFilter);
+			nes->SetCPUTrace(trace.get());
+			trace->StartWriter(options.TracePath, options.TraceFormat);
+		}
+
+		// Profiling, likewise; the profiler is big, so it's on the heap too
+		std::unique_ptr<CPUProfiler> profiler;
+		std::ofstream profile;
+
+		if (!options.ProfilePath.empty())
+		{
+			profile.open(options.ProfilePath);
+
+			if (!profile)
+				throw QkError("Cannot write profile file", 7403);
+
+			profiler.reset(new CPUProfiler());
+			nes->SetCPUProfiler(profiler.get());
+
+			if (!options.ProfileJSON)
+				CPUProfiler::WriteCSVHeader(profile, options.ProfilePerFrame);
+			else if (options.ProfilePerFrame)
+				profile << "[\n";
+		}
+
+		// Call stack profiling
+		std::unique_ptr<CPUCallProfiler> callProfiler;
+		SymbolTable symbols;
+
+		for (const std::string& path : options.SymbolPaths)
+			symbols.Load(path);
+
+		if (!options.CallStacksPath.empty() || !options.RoutinesPath.empty())
+		{
+			callProfiler.reset(new CPUCallProfiler());
+			callProfiler->SetSymbols(&symbols);
+			nes->SetCPUCallProfiler(callProfiler.get());
+		}
+
+		// Host timers, on this thread
+		std::unique_ptr<HostTimers> timers;
+
+		if (!options.TimersPath.empty())
+		{
+			if (!HostTimers::IsCompiledIn())
+				throw QkError("Host timers not compiled in; build with QK_TIMERS", 7405);
+
+			timers.reset(new HostTimers());
+			timers->SetTimeline(true);
+			HostTimers::Attach(timers.get());
+		}
+
+		// Hardware counters, last so the setup above isn't counted; without
+		// them, the run goes on and the report says why
+		std::unique_ptr<HardwareCounters> counters;
+		std::ofstream countersFile;
+
+		if (!options.CountersPath.empty())
+		{
+			countersFile.open(options.CountersPath);
+
+			if (!countersFile)
+				throw QkError("Cannot write hardware counter file", 7407);
+
+			counters.reset(new HardwareCounters());
+			counters->Open();
+		}
+
+		InputPlayback input(script);
+		auto start = std::chrono::steady_clock::now();
+
+		for (qword frame = 0; frame < options.Frames; frame++)
+		{
+			input.Apply(*nes, frame);
+
+			if (counters)
+				counters->BeginFrame();
+
+			nes->RunFrame();
+
+			if (counters)
+				counters->EndFrame();
+
+			if (profiler && options.ProfilePerFrame)
+			{
+				if (options.ProfileJSON)
+				{
+					profiler->WriteJSON(profile, frame);
+					profile << (frame + 1 < options.Frames ? ",\n" : "\n");
+				}
+				else
+				{
+					profiler->WriteCSV(profile, frame);
+				}
+
+				profiler->Reset();
+			}
+		}
+
+		auto end = std::chrono::steady_clock::now();
+
+		if (counters)
+		{
+			counters->Close();
+			counters->WriteCSV(countersFile);
+		}
+
+		if (trace)
+		{
+			nes->SetCPUTrace(nullptr);
+			trace->StopWriter();
+		}
+
+		if (profiler)
+		{
+			nes->SetCPUProfiler(nullptr);
+
+			if (options.ProfilePerFrame)
+			{
+				if (options.ProfileJSON)
+					profile << "]\n";
+			}
+			else if (options.ProfileJSON)
+			{
+				profiler->WriteJSON(profile, -1);
+				profile << "\n";
+			}
+			else
+			{
+				profiler->WriteCSV(profile, -1);
+			}
+		}
+
+		if (timers)
+		{
+			HostTimers::Attach(nullptr);
+
+			std::ofstream file(options.TimersPath);
+
+			if (!file)
+				throw QkError("Cannot write timer file", 7406);
+
+			timers->WriteChromeTrace(file);
+		}
+
+		if (callProfiler)
+		{
+			nes->SetCPUCallProfiler(nullptr);
+
+			if (!options.CallStacksPath.empty())
+			{
+				std::ofstream file(options.CallStacksPath);
+
+				if (!file)
+					throw QkError("Cannot write call stack file", 7404);
+
+				callProfiler->WriteFolded(file);
+			}
+
+			if (!options.RoutinesPath.empty())
+			{
+				std::ofstream file(options.RoutinesPath);
+
+				if (!file)
+					throw QkError("Cannot write call stack file", 7404);
+
+				callProfiler->WriteRoutines(file);
+			}
+		}
+
+		// Report
+		double wallSeconds = std::chrono::duration<double>(end - start).count();
+		double emulatedSeconds = nes->GetMasterClock() / (NES_CPU_CLOCK_FREQ * NES_PPU_TICKS_PER_CPU_CYCLE);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "frames:    " << options.Frames << std::endl
+			<< "wall:      " << wallSeconds << " s" << std::endl
+			<< "emulated:  " << emulatedSeconds << " s" << std::endl
+			<< "fps:       " << (wallSeconds > 0 ? options.Frames / wallSeconds : 0.0) << std::endl
+			<< "ratio:     " << (wallSeconds > 0 ? emulatedSeconds / wallSeconds : 0.0) << "x" << std::endl
+			<< "idle:      " << nes->GetIdleCyclesSkipped() << " cycles skipped" << std::endl;
+
+		if (trace)
+			std::cout << "trace:     " << trace->GetRecordCount() << " records" << std::endl;
+
+		if (timers)
+			timers->WriteSummary(std::cout);
+
+		if (counters)
+			counters->WriteSummary(std::cout);
+
+		if (options.PrintHash)
+		{
+			std::cout << "hash:      " << std::hex << std::setfill('0') << std::setw(16)
+				<< nes->GetStateHash() << std::endl;
+		}
+
+		if (!options.DumpFramebuffer.empty())
+			DumpFramebuffer(*nes->GetVideoOutput(), options.DumpFramebuffer);
+	}
+	catch (const QkError& ex)
+	{
+		std::cout << "[ERROR] " << ex.what() << std::endl;
+		return ex.code();
+	}
+
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include <SDL.h>
 #include "system-renderers.h"
 
@@ -8,13 +9,23 @@ using namespace Qk;
 
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	// qk [--timers FILE] romfile
+	std::string timersPath;
+	int arg = 1;
+
+	if (argc > 3 && std::string(argv[1]) == "--timers")
+	{
+		timersPath = argv[2];
+		arg = 3;
+	}
+
+	if (argc <= arg)
 	{
-		std::cout << "usage: qk [path to nes romfile]" << std::endl;
+		std::cout << "usage: qk [--timers FILE] [path to nes romfile]" << std::endl;
 		return 0;
 	}
 
-	std::string romPath(argv[1]);
+	std::string romPath(argv[arg]);
 	int returnCode = 0;
 
 	SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO);
@@ -23,6 +34,7 @@ int main(int argc, char* argv[])
 	{
 		SDLNES nesrender;
 		nesrender.LoadROM(romPath);
+		nesrender.SetTimersOutput(timersPath);
 		nesrender.Run();
 	}
 	catch (const QkError& ex)
@@ -1,9 +1,11 @@
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <SDL.h>
 #include "system-renderers.h"
 #include "pixeldisplay.h"
 #include "frameratecontroller.h"
+#include "timers.h"
 
 using namespace Qk;
 using namespace Qk::NES;
@@ -20,6 +22,14 @@ void SDLNES::LoadROM(const std::string& path)
 	m_nes.Reset();
 }
 
+void SDLNES::SetTimersOutput(const std::string& path)
+{
+	if (!path.empty() && !HostTimers::IsCompiledIn())
+		throw QkError("Host timers not compiled in; build with QK_TIMERS", 7302);
+
+	m_timersPath = path;
+}
+
 void SDLNES::Run()
 {
 	// Set up video
@@ -53,47 +63,61 @@ void SDLNES::Run()
 
 #endif
 
+	// Host timers, if asked for
+	std::unique_ptr<HostTimers> timers;
+
+	if (!m_timersPath.empty())
+	{
+		timers.reset(new HostTimers());
+		timers->SetTimeline(true);
+		HostTimers::Attach(timers.get());
+	}
+
 	// MAIN LOOP
 	FramerateController timer;
 	SDL_Event event;
 	bool exit = false;
-	unsigned long frames = 0;
-	const int inputPollingInterval = 300;
 
 	while (!exit)
 	{
 		timer.StartFrameTimer();
 
-		while(frames == m_nes.GetPPUFrameCount())
-		{
-			for (int i = 0; i < inputPollingInterval; i++)
-			{
-				m_nes.Clock();
-			}
+		// Emulate a whole frame in one go, then handle input
+		m_nes.RunFrame();
 
-			if (SDL_PollEvent(&event))
+		while (SDL_PollEvent(&event))
+		{
+			switch (event.type)
 			{
-				switch (event.type)
-				{
-				case SDL_QUIT:
-					exit = true;
-					break;
-				case SDL_KEYDOWN:
-					OnKeyBoard(event.key, true);
-					break;
-				case SDL_KEYUP:
-					OnKeyBoard(event.key, false);
-					break;
-				}
+			case SDL_QUIT:
+				exit = true;
+				break;
+			case SDL_KEYDOWN:
+				OnKeyBoard(event.key, true);
+				break;
+			case SDL_KEYUP:
+				OnKeyBoard(event.key, false);
+				break;
 			}
 		}
 
-		frames = m_nes.GetPPUFrameCount();
 		display.RenderFrame();
 
 		timer.StopFrameTimer();
 		timer.SleepRemaining();
 	}
+
+	if (timers)
+	{
+		HostTimers::Attach(nullptr);
+
+		std::ofstream file(m_timersPath);
+
+		if (!file)
+			throw QkError("Cannot write timer file", 7303);
+
+		timers->WriteChromeTrace(file);
+	}
 }
 
 void SDLNES::OnKeyBoard(SDL_KeyboardEvent& event, bool pressed)
@@ -1,4 +1,5 @@
 #include "pixeldisplay.h"
+#include "timers.h"
 
 
 using namespace Qk;
@@ -72,6 +73,8 @@ void PixelDisplay::RenderFrame()
 	if (m_fi == nullptr)
 		return;
 
+	QK_TIMER(Present);
+
 	SDL_UpdateTexture(m_texture, NULL, m_fi->PixelArray, m_fi->Width * sizeof(Qk::Pixel));
 	
 	// Clearing not needed as long as texture overwrites entire screen
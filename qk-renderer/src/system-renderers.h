@@ -17,11 +17,16 @@ namespace Qk
 		void Run();
 		void LoadROM(const std::string& path);
 
+		// Time the emulator and frontend by subsystem, and write a Chrome
+		// trace_event timeline to path on exit (QK_TIMERS builds only)
+		void SetTimersOutput(const std::string& path);
+
 	private:
 		void OnKeyBoard(SDL_KeyboardEvent& event, bool pressed);
 
 	private:
 		NESConsole m_nes;
 		std::string m_windowTitle;
+		std::string m_timersPath;
 	};
 }
\ No newline at end of file
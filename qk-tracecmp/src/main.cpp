@@ -0,0 +1,1013 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "cpu-trace.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+using namespace Qk;
+
+
+/*
+	Trace comparator: streams two CPU traces side by side, one instruction at
+	a time, and reports where they diverge. Reads qk-headless traces (binary,
+	delta or text), nestest.log style text logs from other emulators
+	(nestest, Nintendulator, Mesen) and the JSON logs of the old debug logger.
+	Each is compared on whatever both logs record: registers, flags, cycle
+	counts and bus accesses.
+*/
+
+struct Options
+{
+	std::string PathA;
+	std::string PathB;
+	bool All = false;
+	int Context = 5;
+	bool IgnoreUnimplemented = false;
+	bool Cycles = true;
+	bool RelativeCycles = false;
+	bool Bus = true;
+	byte FlagMask = 0xFF;
+};
+
+static void PrintUsage()
+{
+	std::cout
+		<< "usage: qk-tracecmp [options] [trace a] [trace b]" << std::endl
+		<< std::endl
+		<< "Traces are qk-headless trace files (any format), nestest.log style" << std::endl
+		<< "text logs, or JSON CPU logs; the format is detected." << std::endl
+		<< std::endl
+		<< "  -a, --all                  report every mismatch, not just the first" << std::endl
+		<< "  -c, --context N            instructions shown before a mismatch (default 5)" << std::endl
+		<< "  --ignore-unimplemented     don't report opcode mismatches on unofficial" << std::endl
+		<< "                             or unimplemented opcodes" << std::endl
+		<< "  --relative-cycles          count cycles from each trace's first instruction" << std::endl
+		<< "  --no-cycles                don't compare cycle counts" << std::endl
+		<< "  --no-bus                   don't compare bus accesses" << std::endl
+		<< "  --flag-mask HEX            P bits to compare (default FF)" << std::endl
+		<< std::endl
+		<< "Exits with 1 if the traces differ." << std::endl;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "-a" || arg == "--all")
+			options.All = true;
+		else if ((arg == "-c" || arg == "--context") && hasValue)
+			options.Context = std::atoi(argv[++i]);
+		else if (arg == "--ignore-unimplemented")
+			options.IgnoreUnimplemented = true;
+		else if (arg == "--relative-cycles")
+			options.RelativeCycles = true;
+		else if (arg == "--no-cycles")
+			options.Cycles = false;
+		else if (arg == "--no-bus")
+			options.Bus = false;
+		else if (arg == "--flag-mask" && hasValue)
+			options.FlagMask = (byte)std::strtoul(argv[++i], nullptr, 16);
+		else if (arg[0] != '-' && options.PathA.empty())
+			options.PathA = arg;
+		else if (arg[0] != '-' && options.PathB.empty())
+			options.PathB = arg;
+		else
+			return false;
+	}
+
+	return !options.PathB.empty() && options.Context >= 0;
+}
+
+
+/*
+	Input files, memory-mapped where the platform allows
+*/
+
+class MappedFile
+{
+public:
+	MappedFile(const std::string& path)
+	{
+#ifndef _WIN32
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat info;
+
+		if (fd < 0 || fstat(fd, &info) != 0)
+		{
+			if (fd >= 0)
+				close(fd);
+
+			throw QkError("Cannot open trace file", 7600);
+		}
+
+		m_size = info.st_size;
+
+		if (m_size > 0)
+		{
+			void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+
+			if (data == MAP_FAILED)
+				throw QkError("Cannot open trace file", 7600);
+
+			// Read front to back, once
+			madvise(data, m_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const char*>(data);
+		}
+		else
+		{
+			close(fd);
+		}
+#else
+		std::ifstream file(path, std::ios::binary);
+
+		if (!file)
+			throw QkError("Cannot open trace file", 7600);
+
+		m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		m_data = m_buffer.data();
+		m_size = m_buffer.size();
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (m_data != nullptr)
+			munmap(const_cast<char*>(m_data), m_size);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* Begin() const { return m_data; }
+	const char* End() const { return m_data + m_size; }
+	std::size_t Size() const { return m_size; }
+
+private:
+	const char* m_data = nullptr;
+	std::size_t m_size = 0;
+#ifdef _WIN32
+	std::vector<char> m_buffer;
+#endif
+};
+
+
+/*
+	Trace readers: every format is read into the same entries, flagging
+	which parts of them the format records
+*/
+
+struct Entry
+{
+	TraceRecord Record;
+	qword CycleAfter;
+	qword Number;			// Record or line number, from 1
+	bool HasOpcode;
+	bool HasCycle;
+	bool HasCycleAfter;
+	bool HasAfter;
+	bool HasAccesses;
+	bool Unofficial;
+	char Mnemonic[4];
+	const char* Line;		// Text logs: the line as is
+	std::size_t LineLength;
+};
+
+class TraceReader
+{
+public:
+	TraceReader(const MappedFile& file) : m_begin(file.Begin()), m_position(file.Begin()), m_end(file.End()) { }
+	virtual ~TraceReader() { }
+
+	std::size_t GetBytesRead() const { return m_position - m_begin; }
+
+	virtual const char* GetFormatName() const = 0;
+	virtual bool IsCMOS() const { return false; }
+
+	// Next instruction or interrupt; false at the end of the trace
+	virtual bool Next(Entry& entry) = 0;
+
+protected:
+	const char* m_begin;
+	const char* m_position;
+	const char* m_end;
+	qword m_count = 0;
+
+	void Begin(Entry& entry)
+	{
+		entry = Entry();
+		entry.Number = ++m_count;
+	}
+};
+
+// qk-headless binary and delta traces
+class RecordReader : public TraceReader
+{
+public:
+	RecordReader(const MappedFile& file) : TraceReader(file)
+	{
+		std::memcpy(&m_header, m_position, sizeof(m_header));
+		m_position += sizeof(m_header);
+
+		if (m_header.Version != CPUTrace::VERSION || m_header.RecordSize != sizeof(TraceRecord)
+			|| m_header.Format > (dword)CPUTrace::Format::Delta)
+			throw QkError("Unsupported trace file version", 7601);
+	}
+
+	const char* GetFormatName() const override
+	{
+		return m_header.Format == (dword)CPUTrace::Format::Delta ? "delta" : "binary";
+	}
+
+	bool IsCMOS() const override { return m_header.CMOS != 0; }
+
+	bool Next(Entry& entry) override
+	{
+		if (m_position == m_end)
+			return false;
+
+		Begin(entry);
+		TraceRecord& record = entry.Record;
+
+		if (m_header.Format == (dword)CPUTrace::Format::Delta)
+		{
+			std::size_t used = CPUTrace::DecodeDelta(m_previous, reinterpret_cast<const byte*>(m_position), m_end - m_position, record);
+
+			if (used == 0)
+				throw QkError("Truncated trace file", 7601);
+
+			m_position += used;
+			m_previous = record;
+		}
+		else
+		{
+			if ((std::size_t)(m_end - m_position) < sizeof(TraceRecord))
+				throw QkError("Truncated trace file", 7601);
+
+			std::memcpy(&record, m_position, sizeof(TraceRecord));
+			m_position += sizeof(TraceRecord);
+		}
+
+		bool cmos = IsCMOS();
+		entry.CycleAfter = record.Cycle + record.Cycles;
+		entry.HasOpcode = record.Type == TraceRecord::Instruction;
+		entry.HasCycle = true;
+		entry.HasCycleAfter = true;
+		entry.HasAfter = true;
+		entry.HasAccesses = true;
+
+		if (entry.HasOpcode)
+		{
+			std::memcpy(entry.Mnemonic, CPUTrace::GetMnemonic(record.Opcode, cmos), 3);
+			entry.Unofficial = CPUTrace::IsUnofficial(record.Opcode, cmos);
+		}
+		else
+		{
+			std::memcpy(entry.Mnemonic, record.Type == TraceRecord::NMI ? "NMI" : "IRQ", 3);
+		}
+
+		return true;
+	}
+
+protected:
+	TraceFileHeader m_header;
+	TraceRecord m_previous = TraceRecord();
+};
+
+// nestest.log style text: PC, code bytes, disassembly, then fields like A:00
+// and CYC:7, in any order. Lines that don't start with a PC are skipped.
+class TextReader : public TraceReader
+{
+public:
+	TextReader(const MappedFile& file) : TraceReader(file) { }
+
+	const char* GetFormatName() const override { return "text"; }
+
+	bool Next(Entry& entry) override
+	{
+		while (m_position < m_end)
+		{
+			const char* line = m_position;
+			const char* end = static_cast<const char*>(std::memchr(line, '\n', m_end - line));
+
+			if (end == nullptr)
+				end = m_end;
+
+			m_position = end + (end < m_end ? 1 : 0);
+			m_line++;
+
+			if (end > line && end[-1] == '\r')
+				end--;
+
+			if (ParseLine(line, end, entry))
+				return true;
+		}
+
+		return false;
+	}
+
+protected:
+	qword m_line = 0;
+
+	static int HexDigit(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		return -1;
+	}
+
+	// 'digits' hex digits at p, or -1
+	static int ParseHex(const char* p, const char* end, int digits)
+	{
+		int value = 0;
+
+		for (int n = 0; n < digits; n++)
+		{
+			if (p + n >= end || HexDigit(p[n]) < 0)
+				return -1;
+
+			value = (value << 4) | HexDigit(p[n]);
+		}
+
+		return value;
+	}
+
+	// Value of a field like " X:05", or nullptr if the line hasn't got it
+	static const char* FindField(const char* p, const char* end, const char* name)
+	{
+		std::size_t length = std::strlen(name);
+
+		for (; p + length <= end; p++)
+		{
+			if (std::memcmp(p, name, length) == 0 && (p[-1] == ' ' || p[-1] == '\t'))
+				return p + length;
+		}
+
+		return nullptr;
+	}
+
+	bool ParseLine(const char* line, const char* end, Entry& entry)
+	{
+		int pc = ParseHex(line, end, 4);
+
+		if (pc < 0 || (line + 4 < end && line[4] != ' ' && line[4] != '\t'))
+			return false;
+
+		Begin(entry);
+		entry.Number = m_line;
+		entry.Line = line;
+		entry.LineLength = end - line;
+
+		TraceRecord& record = entry.Record;
+		record.Before.PC = (word)pc;
+
+		// Code bytes, up to the mnemonic
+		const char* p = line + 4;
+		int length = 0;
+
+		for (;;)
+		{
+			while (p < end && (*p == ' ' || *p == '\t'))
+				p++;
+
+			const char* token = p + (p < end && *p == '$' ? 1 : 0);
+			int value = ParseHex(token, end, 2);
+
+			if (value < 0 || (token + 2 < end && token[2] != ' ' && token[2] != '\t') || length == 3)
+				break;
+
+			if (length == 0)
+				record.Opcode = (byte)value;
+			else
+				record.Accesses[length] = { (word)(pc + length), (byte)value, 0 };
+
+			length++;
+			p = token + 2;
+		}
+
+		if (p < end && *p == '*')
+		{
+			entry.Unofficial = true;
+			p++;
+		}
+
+		for (int n = 0; n < 3 && p + n < end; n++)
+			entry.Mnemonic[n] = (char)std::toupper((unsigned char)p[n]);
+
+		bool interrupt = std::strcmp(entry.Mnemonic, "NMI") == 0 || std::strcmp(entry.Mnemonic, "IRQ") == 0;
+
+		if (interrupt && length == 0)
+			record.Type = entry.Mnemonic[0] == 'N' ? TraceRecord::NMI : TraceRecord::IRQ;
+		else if (length > 0)
+			entry.HasOpcode = true;
+		else
+			return false;
+
+		if (std::strcmp(entry.Mnemonic, "XXX") == 0)
+			entry.Unofficial = true;
+
+		// Registers
+		const char* a = FindField(p, end, "A:");
+		const char* x = FindField(p, end, "X:");
+		const char* y = FindField(p, end, "Y:");
+		const char* s = FindField(p, end, "SP:");
+		const char* f = FindField(p, end, "P:");
+
+		if (s == nullptr)
+			s = FindField(p, end, "S:");
+
+		if (a == nullptr || x == nullptr || y == nullptr || s == nullptr || f == nullptr)
+			throw QkError("Text trace line without registers", 7601);
+
+		record.Before.A = (byte)ParseHex(a, end, 2);
+		record.Before.X = (byte)ParseHex(x, end, 2);
+		record.Before.Y = (byte)ParseHex(y, end, 2);
+		record.Before.S = (byte)ParseHex(s, end, 2);
+		record.Before.P = ParseFlags(f, end);
+
+		// CPU cycles; old nestest logs count PPU dots in CYC, next to SL
+		const char* cycle = FindField(p, end, "CYC:");
+
+		if (cycle != nullptr && FindField(p, end, "SL:") == nullptr)
+		{
+			while (cycle < end && *cycle == ' ')
+				cycle++;
+
+			record.Cycle = std::strtoull(std::string(cycle, std::min<std::size_t>(end - cycle, 20)).c_str(), nullptr, 10);
+			entry.HasCycle = true;
+		}
+
+		return true;
+	}
+
+	// Hex (P:24), or one letter per flag, upper case when set (P:nvUbdIzc)
+	static byte ParseFlags(const char* p, const char* end)
+	{
+		int value = ParseHex(p, end, 2);
+
+		if (value >= 0 && (p + 2 == end || !std::isalpha((unsigned char)p[2])))
+			return (byte)value;
+
+		byte flags = 0;
+
+		for (int n = 0; n < 8 && p + n < end; n++)
+		{
+			if (std::isupper((unsigned char)p[n]))
+				flags |= 0x80 >> n;
+		}
+
+		return flags;
+	}
+};
+
+// JSON logs of the old debug logger: one object per instruction, registers
+// as hex strings, with the cycle count after it and every bus access
+class JsonReader : public TraceReader
+{
+public:
+	JsonReader(const MappedFile& file) : TraceReader(file)
+	{
+		SkipSpace();
+		Expect('[');
+	}
+
+	const char* GetFormatName() const override { return "json"; }
+
+	bool Next(Entry& entry) override
+	{
+		SkipSpace();
+
+		if (m_position < m_end && *m_position == ',')
+		{
+			m_position++;
+			SkipSpace();
+		}
+
+		if (m_position == m_end || *m_position == ']')
+			return false;
+
+		Begin(entry);
+		entry.HasOpcode = true;
+		entry.HasCycleAfter = true;
+		entry.HasAfter = true;
+		entry.HasAccesses = true;
+
+		TraceRecord& record = entry.Record;
+
+		ParseObject([&](const std::string& key)
+		{
+			if (key == "Cycle")
+				entry.CycleAfter = std::strtoull(ParseToken().c_str(), nullptr, 10);
+			else if (key == "Opcode")
+				record.Opcode = (byte)std::strtoul(ParseToken().c_str(), nullptr, 16);
+			else if (key == "OpcodeMnemonic")
+				std::snprintf(entry.Mnemonic, sizeof(entry.Mnemonic), "%.3s", ParseToken().c_str());
+			else if (key == "PreOpState")
+				ParseRegisters(record.Before);
+			else if (key == "PostOpState")
+				ParseRegisters(record.After);
+			else if (key == "IOEvents")
+				ParseAccesses(record);
+			else
+				ParseToken();
+		});
+
+		entry.Unofficial = std::strcmp(entry.Mnemonic, "XXX") == 0;
+
+		return true;
+	}
+
+protected:
+	void SkipSpace()
+	{
+		while (m_position < m_end && std::isspace((unsigned char)*m_position))
+			m_position++;
+	}
+
+	void Expect(char c)
+	{
+		SkipSpace();
+
+		if (m_position == m_end || *m_position != c)
+			throw QkError("Malformed JSON trace", 7601);
+
+		m_position++;
+	}
+
+	// Up to the closing quote of a string; an escape may not take us past
+	// the end of the file
+	void SkipString()
+	{
+		while (m_position < m_end && *m_position != '"')
+			m_position += *m_position == '\\' && m_end - m_position > 1 ? 2 : 1;
+
+		if (m_position == m_end)
+			throw QkError("Malformed JSON trace", 7601);
+	}
+
+	// A string or number, as text; objects and arrays are skipped
+	std::string ParseToken()
+	{
+		SkipSpace();
+
+		if (m_position == m_end)
+			throw QkError("Malformed JSON trace", 7601);
+
+		if (*m_position == '"')
+		{
+			const char* start = ++m_position;
+
+			SkipString();
+			return std::string(start, m_position++);
+		}
+
+		if (*m_position == '{' || *m_position == '[')
+		{
+			int depth = 0;
+
+			do
+			{
+				char c = *m_position++;
+
+				if (c == '{' || c == '[')
+					depth++;
+				else if (c == '}' || c == ']')
+					depth--;
+				else if (c == '"')
+				{
+					SkipString();
+					m_position++;
+				}
+			} while (depth > 0 && m_position < m_end);
+
+			if (depth > 0)
+				throw QkError("Malformed JSON trace", 7601);
+
+			return std::string();
+		}
+
+		const char* start = m_position;
+
+		while (m_position < m_end && *m_position != ',' && *m_position != '}' && *m_position != ']'
+			&& !std::isspace((unsigned char)*m_position))
+			m_position++;
+
+		return std::string(start, m_position);
+	}
+
+	template <class F>
+	void ParseObject(F value)
+	{
+		Expect('{');
+		SkipSpace();
+
+		while (m_position < m_end && *m_position != '}')
+		{
+			std::string key = ParseToken();
+			Expect(':');
+			value(key);
+			SkipSpace();
+
+			if (m_position < m_end && *m_position == ',')
+			{
+				m_position++;
+				SkipSpace();
+			}
+		}
+
+		Expect('}');
+	}
+
+	void ParseRegisters(TraceRegisters& registers)
+	{
+		ParseObject([&](const std::string& key)
+		{
+			unsigned long value = std::strtoul(ParseToken().c_str(), nullptr, 16);
+
+			if (key == "A") registers.A = (byte)value;
+			else if (key == "X") registers.X = (byte)value;
+			else if (key == "Y") registers.Y = (byte)value;
+			else if (key == "P") registers.P = (byte)value;
+			else if (key == "S") registers.S = (byte)value;
+			else if (key == "PC") registers.PC = (word)value;
+		});
+	}
+
+	void ParseAccesses(TraceRecord& record)
+	{
+		Expect('[');
+		SkipSpace();
+
+		while (m_position < m_end && *m_position != ']')
+		{
+			TraceAccess access = {};
+
+			ParseObject([&](const std::string& key)
+			{
+				std::string value = ParseToken();
+
+				if (key == "Type")
+					access.IsWrite = value == "W";
+				else if (key == "Address")
+					access.Address = (word)std::strtoul(value.c_str(), nullptr, 16);
+				else if (key == "Value")
+					access.Value = (byte)std::strtoul(value.c_str(), nullptr, 16);
+			});
+
+			if (record.AccessCount < TraceRecord::MAX_ACCESSES)
+				record.Accesses[record.AccessCount++] = access;
+			else
+				record.Overflowed = 1;
+
+			SkipSpace();
+
+			if (m_position < m_end && *m_position == ',')
+			{
+				m_position++;
+				SkipSpace();
+			}
+		}
+
+		Expect(']');
+	}
+};
+
+static std::unique_ptr<TraceReader> OpenReader(const MappedFile& file)
+{
+	if (file.Size() >= sizeof(TraceFileHeader) && std::memcmp(file.Begin(), CPUTrace::MAGIC, 8) == 0)
+		return std::unique_ptr<TraceReader>(new RecordReader(file));
+
+	const char* p = file.Begin();
+
+	while (p < file.End() && std::isspace((unsigned char)*p))
+		p++;
+
+	if (p < file.End() && *p == '[')
+		return std::unique_ptr<TraceReader>(new JsonReader(file));
+
+	return std::unique_ptr<TraceReader>(new TextReader(file));
+}
+
+
+/*
+	Comparison
+*/
+
+class Comparator
+{
+public:
+	Comparator(const Options& options, TraceReader& a, TraceReader& b)
+		: m_options(options), m_a(a), m_b(b), m_history(options.Context) { }
+
+	qword Compared = 0;
+	qword Mismatches = 0;
+	qword UnimplementedIgnored = 0;
+
+	void Run()
+	{
+		Entry a, b;
+		bool first = true;
+
+		for (;;)
+		{
+			bool hasA = Read(m_a, a);
+			bool hasB = Read(m_b, b);
+
+			// An interrupt only one side logs (text logs have none) is
+			// left out; the instructions around it still line up
+			while (hasA && hasB && a.Record.Type != b.Record.Type
+				&& (a.Record.Type == TraceRecord::Instruction || b.Record.Type == TraceRecord::Instruction))
+			{
+				if (a.Record.Type != TraceRecord::Instruction)
+					hasA = Read(m_a, a);
+				else
+					hasB = Read(m_b, b);
+			}
+
+			// One trace ending before the other is a mismatch too: the
+			// emulator that wrote it may have crashed
+			if (!hasA || !hasB)
+			{
+				if (hasA)
+					CheckEnd("b", a, m_a);
+				else if (hasB)
+					CheckEnd("a", b, m_b);
+
+				return;
+			}
+
+			if (first && m_options.RelativeCycles)
+			{
+				m_baseA = a;
+				m_baseB = b;
+			}
+
+			first = false;
+
+			Compared++;
+
+			if (!Compare(a, b) && !m_options.All)
+				return;
+
+			if (m_options.Context > 0)
+			{
+				m_history[m_next % m_options.Context] = { a, b };
+				m_next++;
+			}
+		}
+	}
+
+protected:
+	const Options& m_options;
+	TraceReader& m_a;
+	TraceReader& m_b;
+	// First pair, for --relative-cycles
+	Entry m_baseA = Entry();
+	Entry m_baseB = Entry();
+
+	// Last pairs compared, for context
+	std::vector<std::pair<Entry, Entry>> m_history;
+	qword m_next = 0;
+
+	static bool Read(TraceReader& reader, Entry& entry)
+	{
+		return reader.Next(entry);
+	}
+
+	// The other trace has ended; entry is what this one has left, past
+	// which only interrupts the other couldn't have logged may follow
+	void CheckEnd(const char* ended, Entry& entry, TraceReader& reader)
+	{
+		bool more = true;
+
+		while (more && entry.Record.Type != TraceRecord::Instruction)
+			more = Read(reader, entry);
+
+		if (!more)
+			return;
+
+		Mismatches++;
+
+		std::cout << "mismatch at instruction " << Compared + 1 << std::endl;
+		PrintHistory();
+		Print(&reader == &m_a ? " > a " : " > b ", entry, reader);
+		std::cout << "     trace " << ended << " ends after " << Compared << " instructions" << std::endl << std::endl;
+	}
+
+	bool Compare(const Entry& a, const Entry& b)
+	{
+		std::vector<std::string> details;
+		char line[128];
+
+		auto detail = [&](const char* format, auto... values)
+		{
+			std::snprintf(line, sizeof(line), format, values...);
+			details.push_back(line);
+		};
+
+		// Interrupt or instruction
+		if (a.Record.Type != b.Record.Type)
+			detail("type      %s / %s", a.Mnemonic, b.Mnemonic);
+
+		// Opcode
+		if (a.HasOpcode && b.HasOpcode
+			&& (a.Record.Opcode != b.Record.Opcode || std::strcmp(a.Mnemonic, b.Mnemonic) != 0))
+		{
+			if (m_options.IgnoreUnimplemented && (a.Unofficial || b.Unofficial))
+				UnimplementedIgnored++;
+			else
+				detail("opcode    %02X %-3s / %02X %-3s", a.Record.Opcode, a.Mnemonic, b.Record.Opcode, b.Mnemonic);
+		}
+
+		// Registers before, and after where both have them
+		CompareRegisters(a.Record.Before, b.Record.Before, "", detail);
+
+		if (a.HasAfter && b.HasAfter)
+			CompareRegisters(a.Record.After, b.Record.After, " after", detail);
+
+		// Cycle counts
+		if (m_options.Cycles)
+		{
+			if (a.HasCycle && b.HasCycle
+				&& a.Record.Cycle - m_baseA.Record.Cycle != b.Record.Cycle - m_baseB.Record.Cycle)
+				detail("cycle     %llu / %llu", (unsigned long long)a.Record.Cycle, (unsigned long long)b.Record.Cycle);
+
+			if (a.HasCycleAfter && b.HasCycleAfter
+				&& a.CycleAfter - m_baseA.CycleAfter != b.CycleAfter - m_baseB.CycleAfter)
+				detail("cycle after %llu / %llu", (unsigned long long)a.CycleAfter, (unsigned long long)b.CycleAfter);
+		}
+
+		// Bus accesses; only as many as both recorded, if one ran out of room
+		if (m_options.Bus && a.HasAccesses && b.HasAccesses)
+		{
+			int count = std::min(a.Record.AccessCount, b.Record.AccessCount);
+
+			for (int n = 0; n < count; n++)
+			{
+				const TraceAccess& x = a.Record.Accesses[n];
+				const TraceAccess& y = b.Record.Accesses[n];
+
+				if (x.Address != y.Address || x.Value != y.Value || x.IsWrite != y.IsWrite)
+				{
+					detail("bus %d     %c $%04X = %02X / %c $%04X = %02X", n,
+						x.IsWrite ? 'W' : 'R', x.Address, x.Value, y.IsWrite ? 'W' : 'R', y.Address, y.Value);
+					break;
+				}
+			}
+
+			if (a.Record.AccessCount != b.Record.AccessCount && !a.Record.Overflowed && !b.Record.Overflowed)
+				detail("accesses  %d / %d", a.Record.AccessCount, b.Record.AccessCount);
+		}
+
+		if (details.empty())
+			return true;
+
+		Mismatches++;
+		Report(a, b, details);
+
+		return false;
+	}
+
+	template <class F>
+	void CompareRegisters(const TraceRegisters& a, const TraceRegisters& b, const char* when, F& detail)
+	{
+		if (a.PC != b.PC)
+			detail("PC%-7s %04X / %04X", when, a.PC, b.PC);
+		if (a.A != b.A)
+			detail("A%-8s %02X / %02X", when, a.A, b.A);
+		if (a.X != b.X)
+			detail("X%-8s %02X / %02X", when, a.X, b.X);
+		if (a.Y != b.Y)
+			detail("Y%-8s %02X / %02X", when, a.Y, b.Y);
+		if (a.S != b.S)
+			detail("SP%-7s %02X / %02X", when, a.S, b.S);
+
+		byte flags = (a.P ^ b.P) & m_options.FlagMask;
+
+		if (flags != 0)
+		{
+			char names[9] = "";
+			int count = 0;
+
+			for (int n = 0; n < 8; n++)
+			{
+				if (flags & (0x80 >> n))
+					names[count++] = "NV-BDIZC"[n];
+			}
+
+			detail("P%-8s %02X / %02X  (%s)", when, a.P, b.P, names);
+		}
+	}
+
+	void Report(const Entry& a, const Entry& b, const std::vector<std::string>& details)
+	{
+		std::cout << "mismatch at instruction " << Compared
+			<< " (a: " << a.Number << ", b: " << b.Number << ")" << std::endl;
+
+		PrintHistory();
+		Print(" > a ", a, m_a);
+		Print(" > b ", b, m_b);
+
+		for (const std::string& detail : details)
+			std::cout << "     " << detail << std::endl;
+
+		std::cout << std::endl;
+	}
+
+	void PrintHistory()
+	{
+		qword shown = std::min<qword>(m_next, m_options.Context);
+
+		for (qword n = m_next - shown; n < m_next; n++)
+		{
+			const auto& pair = m_history[n % m_options.Context];
+			Print("   a ", pair.first, m_a);
+			Print("   b ", pair.second, m_b);
+		}
+	}
+
+	static void Print(const char* prefix, const Entry& entry, const TraceReader& reader)
+	{
+		if (entry.Line != nullptr)
+		{
+			std::cout << prefix << std::string(entry.Line, entry.LineLength) << std::endl;
+		}
+		else
+		{
+			char line[128];
+			CPUTrace::FormatText(entry.Record, reader.IsCMOS(), line, sizeof(line));
+			std::cout << prefix << line << std::endl;
+		}
+	}
+};
+
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	try
+	{
+		MappedFile fileA(options.PathA);
+		MappedFile fileB(options.PathB);
+		std::unique_ptr<TraceReader> a = OpenReader(fileA);
+		std::unique_ptr<TraceReader> b = OpenReader(fileB);
+
+		auto start = std::chrono::steady_clock::now();
+
+		Comparator comparator(options, *a, *b);
+		comparator.Run();
+
+		auto end = std::chrono::steady_clock::now();
+		double wallSeconds = std::chrono::duration<double>(end - start).count();
+		double megabytes = (a->GetBytesRead() + b->GetBytesRead()) / 1e6;
+
+		// Summary
+		std::cout << std::fixed << std::setprecision(3)
+			<< "a:          " << options.PathA << " (" << a->GetFormatName() << ")" << std::endl
+			<< "b:          " << options.PathB << " (" << b->GetFormatName() << ")" << std::endl
+			<< "compared:   " << comparator.Compared << " instructions" << std::endl
+			<< "mismatches: " << comparator.Mismatches;
+
+		if (options.IgnoreUnimplemented)
+			std::cout << " (" << comparator.UnimplementedIgnored << " unimplemented opcodes ignored)";
+
+		std::cout << std::endl
+			<< "wall:       " << wallSeconds << " s (" << (wallSeconds > 0 ? megabytes / wallSeconds : 0.0) << " MB/s)" << std::endl;
+
+		return comparator.Mismatches > 0 ? 1 : 0;
+	}
+	catch (const QkError& ex)
+	{
+		std::cout << "[ERROR] " << ex.what() << std::endl;
+		return ex.code();
+	}
+}